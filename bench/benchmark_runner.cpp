@@ -0,0 +1,198 @@
+#include "benchmark_runner.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	volatile uint64_t SINK = 0;
+
+	// value following "key": on a line written by writeJson
+	bool FindField(const std::string& line, const std::string& key, std::string& value)
+	{
+		std::string pattern = "\"" + key + "\": ";
+		size_t start = line.find(pattern);
+		if (start == std::string::npos)
+			return false;
+		start += pattern.size();
+		if (start < line.size() && line[start] == '"')
+		{
+			size_t end = line.find('"', start + 1);
+			if (end == std::string::npos)
+				return false;
+			value = line.substr(start + 1, end - start - 1);
+			return true;
+		}
+		size_t end = line.find_first_of(",}", start);
+		value = line.substr(start, end == std::string::npos ? std::string::npos : end - start);
+		return true;
+	}
+}
+
+
+BenchmarkRunner::BenchmarkRunner()
+	: BenchmarkRunner(Options())
+{
+}
+
+BenchmarkRunner::BenchmarkRunner(const Options& options)
+	: m_Options(options)
+{
+	m_Options.minRuns = std::max(1u, m_Options.minRuns);
+	m_Options.maxRuns = std::max(m_Options.minRuns, m_Options.maxRuns);
+}
+
+
+void BenchmarkRunner::run(const std::string& name, uint64_t items, const std::function<void()>& setup, const std::function<void()>& body)
+{
+	if (!m_Options.filter.empty() && name.find(m_Options.filter) == std::string::npos)
+		return;
+
+	// the first run warms the caches and the allocator up
+	if (setup)
+		setup();
+	body();
+
+	std::vector<double> times;
+	double total = 0.0;
+	while (times.size() < m_Options.maxRuns && (times.size() < m_Options.minRuns || total < m_Options.minSeconds * 1000.0))
+	{
+		if (setup)
+			setup();
+		Clock::time_point start = Clock::now();
+		body();
+		double milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		times.push_back(milliseconds);
+		total += milliseconds;
+	}
+
+	std::sort(times.begin(), times.end());
+	BenchmarkResult result;
+	result.name = name;
+	result.items = std::max<uint64_t>(1, items);
+	result.runs = (unsigned int)times.size();
+	result.medianMs = times[times.size() / 2];
+	result.minMs = times.front();
+	result.nsPerItem = result.medianMs * 1e6 / (double)result.items;
+	m_Results.push_back(result);
+
+	std::cout << std::setw(28) << std::left << name << std::fixed << std::setprecision(4) << result.medianMs << " MS  "
+		<< std::setprecision(2) << result.nsPerItem << " NS/ITEM  " << result.runs << " RUNS" << std::endl;
+}
+
+
+void BenchmarkRunner::Consume(uint64_t value)
+{
+	SINK = SINK + value;
+}
+
+
+const std::vector<BenchmarkResult>& BenchmarkRunner::results() const
+{
+	return m_Results;
+}
+
+
+bool BenchmarkRunner::writeJson(const std::string& path) const
+{
+	std::ofstream file(path, std::ios::trunc);
+	file << "{\n\t\"benchmarks\": [\n" << std::setprecision(6) << std::fixed;
+	for (size_t i = 0; i < m_Results.size(); ++i)
+	{
+		const BenchmarkResult& result = m_Results[i];
+		file << "\t\t{ \"name\": \"" << result.name << "\", \"items\": " << result.items << ", \"runs\": " << result.runs
+			<< ", \"medianMs\": " << result.medianMs << ", \"minMs\": " << result.minMs << ", \"nsPerItem\": " << result.nsPerItem << " }"
+			<< (i + 1 < m_Results.size() ? "," : "") << "\n";
+	}
+	file << "\t]\n}\n";
+	if (!file)
+	{
+		std::cout << "ERROR::BENCHMARK::UNABLE TO WRITE: " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+
+bool BenchmarkRunner::ReadJson(const std::string& path, std::vector<BenchmarkResult>& results)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		std::cout << "ERROR::BENCHMARK::UNABLE TO OPEN: " << path << std::endl;
+		return false;
+	}
+
+	results.clear();
+	std::string line;
+	while (std::getline(file, line))
+	{
+		BenchmarkResult result;
+		std::string value;
+		if (!FindField(line, "name", result.name) || !FindField(line, "medianMs", value))
+			continue;
+		result.medianMs = std::atof(value.c_str());
+		if (FindField(line, "items", value))
+			result.items = (uint64_t)std::atoll(value.c_str());
+		if (FindField(line, "runs", value))
+			result.runs = (unsigned int)std::atoi(value.c_str());
+		if (FindField(line, "minMs", value))
+			result.minMs = std::atof(value.c_str());
+		if (FindField(line, "nsPerItem", value))
+			result.nsPerItem = std::atof(value.c_str());
+		results.push_back(result);
+	}
+	if (results.empty())
+		std::cout << "ERROR::BENCHMARK::NO RESULT IN: " << path << std::endl;
+	return !results.empty();
+}
+
+
+bool BenchmarkRunner::Compare(const std::vector<BenchmarkResult>& baseline, const std::vector<BenchmarkResult>& current, double tolerance, std::ostream& out)
+{
+	bool passed = true;
+	out << " -- BENCHMARK: CHANGE OF THE MEDIAN, " << std::fixed << std::setprecision(0) << tolerance * 100.0 << "% ALLOWED -- " << std::endl;
+	for (const BenchmarkResult& before : baseline)
+	{
+		auto after = std::find_if(current.begin(), current.end(), [&before](const BenchmarkResult& result)
+		{
+			return result.name == before.name;
+		});
+		out << std::setw(28) << std::left << before.name;
+		if (after == current.end())
+		{
+			out << "MISSING" << std::endl;
+			passed = false;
+			continue;
+		}
+
+		double ratio = before.medianMs > 0.0 ? after->medianMs / before.medianMs : 1.0;
+		const char* verdict = "OK";
+		if (ratio > 1.0 + tolerance)
+		{
+			verdict = "REGRESSION";
+			passed = false;
+		}
+		else if (ratio < 1.0 - tolerance)
+			verdict = "FASTER";
+		out << std::setprecision(4) << before.medianMs << " -> " << after->medianMs << " MS  "
+			<< std::showpos << std::setprecision(1) << (ratio - 1.0) * 100.0 << "%" << std::noshowpos << "  " << verdict << std::endl;
+	}
+
+	// new benchmarks have nothing to regress against
+	for (const BenchmarkResult& after : current)
+	{
+		bool known = std::any_of(baseline.begin(), baseline.end(), [&after](const BenchmarkResult& result)
+		{
+			return result.name == after.name;
+		});
+		if (!known)
+			out << std::setw(28) << std::left << after.name << "NEW" << std::endl;
+	}
+	return passed;
+}
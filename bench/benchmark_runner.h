@@ -0,0 +1,94 @@
+#ifndef BENCHMARK_RUNNER_H
+#define BENCHMARK_RUNNER_H
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*!
+ * Timing of a benchmark, over all its runs
+ *
+ */
+struct BenchmarkResult
+{
+	std::string name;
+	uint64_t items = 0;         // work items of a run, matrices, spheres, keys...
+	unsigned int runs = 0;
+	double medianMs = 0.0;      // per run, compared against baselines
+	double minMs = 0.0;
+	double nsPerItem = 0.0;     // from the median
+};
+
+/*!
+ * Repeats benchmarks, keeps their timings and writes or compares them as JSON
+ *
+ * A benchmark runs once untimed, then as long as it takes to reach both a
+ * minimum number of runs and a minimum duration. The median run is kept,
+ * it moves less than the mean when the machine is busy. Results are
+ * written one benchmark per line so ReadJson needs no JSON library.
+ */
+class BenchmarkRunner
+{
+public:
+	struct Options
+	{
+		double minSeconds = 0.25;       // per benchmark
+		unsigned int minRuns = 5;
+		unsigned int maxRuns = 10000;
+		std::string filter;             // only benchmarks whose name holds it, all when empty
+	};
+
+	BenchmarkRunner();
+	explicit BenchmarkRunner(const Options& options);
+
+	/*!
+	 * Time a benchmark
+	 *
+	 * \param name : identifier in the results, kept stable for the comparisons
+	 * \param items : work items processed by a run
+	 * \param setup : untimed, called before every run, may be empty
+	 * \param body : timed run
+	 */
+	void run(const std::string& name, uint64_t items, const std::function<void()>& setup, const std::function<void()>& body);
+
+	/*!
+	 * Keep a value computed by a benchmark so the compiler can not remove its work
+	 *
+	 */
+	static void Consume(uint64_t value);
+
+	const std::vector<BenchmarkResult>& results() const;
+
+	/*!
+	 * Write the results
+	 *
+	 * \return : false(bool) if the file can not be written
+	 */
+	bool writeJson(const std::string& path) const;
+
+	/*!
+	 * Read results written by writeJson
+	 *
+	 * \return : false(bool) if the file is missing or holds no result
+	 */
+	static bool ReadJson(const std::string& path, std::vector<BenchmarkResult>& results);
+
+	/*!
+	 * Print how each benchmark moved against a baseline
+	 *
+	 * \param baseline : stored results
+	 * \param current : new results
+	 * \param tolerance : relative slowdown of the median allowed, 0.1 for 10%
+	 * \param out : table of the comparison
+	 * \return : false(bool) if a benchmark got slower than allowed or disappeared
+	 */
+	static bool Compare(const std::vector<BenchmarkResult>& baseline, const std::vector<BenchmarkResult>& current, double tolerance, std::ostream& out);
+
+private:
+
+	Options m_Options;
+	std::vector<BenchmarkResult> m_Results;
+};
+#endif
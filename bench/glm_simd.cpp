@@ -0,0 +1,64 @@
+#include "glm_simd.h"
+
+// for this file only, see glm_simd.h
+#define GLM_FORCE_INTRINSICS
+#include <detail/setup.hpp>
+#include <simd/matrix.h>
+
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+
+bool GlmSimd::Available()
+{
+	return true;
+}
+
+
+void GlmSimd::Multiply(const float* a, const float* b, float* out, size_t count)
+{
+	for (size_t m = 0; m < count; ++m, a += 16, b += 16, out += 16)
+	{
+		glm_vec4 left[4], right[4], result[4];
+		for (int c = 0; c < 4; ++c)
+		{
+			left[c] = _mm_loadu_ps(a + c * 4);
+			right[c] = _mm_loadu_ps(b + c * 4);
+		}
+		glm_mat4_mul(left, right, result);
+		for (int c = 0; c < 4; ++c)
+			_mm_storeu_ps(out + c * 4, result[c]);
+	}
+}
+
+
+void GlmSimd::Inverse(const float* in, float* out, size_t count)
+{
+	for (size_t m = 0; m < count; ++m, in += 16, out += 16)
+	{
+		glm_vec4 source[4], result[4];
+		for (int c = 0; c < 4; ++c)
+			source[c] = _mm_loadu_ps(in + c * 4);
+		glm_mat4_inverse(source, result);
+		for (int c = 0; c < 4; ++c)
+			_mm_storeu_ps(out + c * 4, result[c]);
+	}
+}
+
+#else
+
+bool GlmSimd::Available()
+{
+	return false;
+}
+
+
+void GlmSimd::Multiply(const float*, const float*, float*, size_t)
+{
+}
+
+
+void GlmSimd::Inverse(const float*, float*, size_t)
+{
+}
+
+#endif
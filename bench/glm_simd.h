@@ -0,0 +1,34 @@
+#ifndef GLM_SIMD_H
+#define GLM_SIMD_H
+
+#include <cstddef>
+
+/*!
+ * Matrix kernels of the SSE code path of GLM
+ *
+ * The rest of the build uses the default, scalar, GLM code. Turning the
+ * intrinsics on changes how glm::mat4 operators are compiled, so they live
+ * in their own file behind plain float arrays, 16 floats per column major
+ * matrix, and no glm template is instantiated both ways.
+ */
+namespace GlmSimd
+{
+	/*!
+	 * Whether the SSE path was compiled in, the kernels do nothing otherwise
+	 *
+	 */
+	bool Available();
+
+	/*!
+	 * out[i] = a[i] * b[i]
+	 *
+	 */
+	void Multiply(const float* a, const float* b, float* out, size_t count);
+
+	/*!
+	 * out[i] = inverse(in[i])
+	 *
+	 */
+	void Inverse(const float* in, float* out, size_t count);
+}
+#endif
@@ -0,0 +1,289 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <glm.hpp>
+#include <gtc/matrix_transform.hpp>
+#include "benchmark_runner.h"
+#include "glm_simd.h"
+#include "frustum.h"
+#include "job_system.h"
+#include "mesh.h"
+#include "meshlet.h"
+#include "point_cloud.h"
+#include "radix_sort.h"
+
+// CPU kernels of the viewer timed in isolation
+//
+//   OpenGLViewerBench [--out results.json] [--filter name] [--quick]
+//   OpenGLViewerBench --compare baseline.json results.json [--tolerance 0.1]
+//
+// the compare mode exits with a failure status when a benchmark got slower than allowed
+
+namespace
+{
+	const size_t MATRIX_COUNT = 4096;
+	const size_t CULL_COUNT = 100000;
+	const unsigned int GRID_SIZE = 512;         // vertices per side of the normal and welding meshes
+	const size_t POINT_COUNT = 100000;
+	const size_t KEY_COUNT = 1 << 18;
+
+	std::vector<glm::mat4> RandomTransforms(size_t count, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::vector<glm::mat4> matrices(count);
+		for (glm::mat4& matrix : matrices)
+		{
+			glm::vec3 axis = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) + glm::vec3(0.0f, 0.0f, 2.0f));
+			matrix = glm::translate(glm::mat4(1.0f), glm::vec3(unit(random), unit(random), unit(random)) * 10.0f);
+			matrix = glm::rotate(matrix, unit(random) * 3.0f, axis);
+			matrix = glm::scale(matrix, glm::vec3(1.5f + unit(random)));
+		}
+		return matrices;
+	}
+
+	// grid of GRID_SIZE^2 vertices with a height field, two triangles per cell
+	Mesh GridMesh()
+	{
+		Mesh mesh;
+		for (unsigned int y = 0; y < GRID_SIZE; ++y)
+		{
+			for (unsigned int x = 0; x < GRID_SIZE; ++x)
+				mesh.positions.push_back(glm::vec3((float)x, std::sin(x * 0.1f) * std::cos(y * 0.13f) * 4.0f, (float)y));
+		}
+		for (unsigned int y = 0; y + 1 < GRID_SIZE; ++y)
+		{
+			for (unsigned int x = 0; x + 1 < GRID_SIZE; ++x)
+			{
+				unsigned int corner = y * GRID_SIZE + x;
+				mesh.indices.insert(mesh.indices.end(), { corner, corner + GRID_SIZE, corner + 1, corner + 1, corner + GRID_SIZE, corner + GRID_SIZE + 1 });
+			}
+		}
+		return mesh;
+	}
+
+	// same layout as RenderQueue::MakeKey for opaque items: pass, shader, material, mesh, depth
+	std::vector<SortEntry> RenderKeys(size_t count, std::mt19937& random)
+	{
+		std::vector<SortEntry> entries(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			uint64_t shader = random() % 16, material = random() % 512, mesh = random() % 4096, depth = random() & 0xFFFF;
+			entries[i].key = (1ull << 60) | (shader << 50) | (material << 36) | (mesh << 16) | depth;
+			entries[i].index = (uint32_t)i;
+		}
+		return entries;
+	}
+
+	bool WritePointFiles(const std::string& xyzPath, const std::string& plyPath, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> coordinate(-100.0f, 100.0f);
+		std::ofstream xyz(xyzPath, std::ios::trunc);
+		std::ofstream ply(plyPath, std::ios::binary | std::ios::trunc);
+		ply << "ply\nformat binary_little_endian 1.0\nelement vertex " << POINT_COUNT
+			<< "\nproperty float x\nproperty float y\nproperty float z\nproperty uchar red\nproperty uchar green\nproperty uchar blue\nend_header\n";
+		for (size_t i = 0; i < POINT_COUNT; ++i)
+		{
+			float position[3] = { coordinate(random), coordinate(random), coordinate(random) };
+			unsigned char color[3] = { (unsigned char)random(), (unsigned char)random(), (unsigned char)random() };
+			xyz << position[0] << " " << position[1] << " " << position[2] << " " << (int)color[0] << " " << (int)color[1] << " " << (int)color[2] << "\n";
+			ply.write((const char*)position, sizeof(position));
+			ply.write((const char*)color, sizeof(color));
+		}
+		return (bool)xyz && (bool)ply;
+	}
+
+	uint64_t ReadAllPoints(const std::string& path)
+	{
+		PointReader reader;
+		if (!reader.open(path))
+			return 0;
+		std::vector<Point> points;
+		uint64_t count = 0;
+		while (reader.read(points, 65536))
+			count += points.size();
+		return count;
+	}
+
+	uint64_t Checksum(const glm::mat4& matrix)
+	{
+		float sum = matrix[0][0] + matrix[1][1] + matrix[2][2] + matrix[3][0];
+		uint32_t bits;
+		memcpy(&bits, &sum, sizeof(bits));
+		return bits;
+	}
+
+	int CompareFiles(int argc, char** argv)
+	{
+		double tolerance = 0.1;
+		for (int i = 4; i + 1 < argc; ++i)
+		{
+			if (std::string(argv[i]) == "--tolerance")
+				tolerance = std::atof(argv[i + 1]);
+		}
+
+		std::vector<BenchmarkResult> baseline, current;
+		if (!BenchmarkRunner::ReadJson(argv[2], baseline) || !BenchmarkRunner::ReadJson(argv[3], current))
+			return EXIT_FAILURE;
+		return BenchmarkRunner::Compare(baseline, current, tolerance, std::cout) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+}
+
+
+int main(int argc, char** argv)
+{
+	if (argc >= 4 && std::string(argv[1]) == "--compare")
+		return CompareFiles(argc, argv);
+
+	BenchmarkRunner::Options options;
+	std::string outPath = "benchmark_results.json";
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string argument = argv[i];
+		if (argument == "--out" && i + 1 < argc)
+			outPath = argv[++i];
+		else if (argument == "--filter" && i + 1 < argc)
+			options.filter = argv[++i];
+		else if (argument == "--quick")
+		{
+			options.minSeconds = 0.02;
+			options.minRuns = 3;
+		}
+		else
+		{
+			std::cout << "usage: " << argv[0] << " [--out results.json] [--filter name] [--quick]" << std::endl;
+			std::cout << "       " << argv[0] << " --compare baseline.json results.json [--tolerance 0.1]" << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	BenchmarkRunner runner(options);
+	std::mt19937 random(1234);
+
+	// matrices, GLM default code against its SSE path
+	std::vector<glm::mat4> left = RandomTransforms(MATRIX_COUNT, random);
+	std::vector<glm::mat4> right = RandomTransforms(MATRIX_COUNT, random);
+	std::vector<glm::mat4> products(MATRIX_COUNT);
+	runner.run("mat4_multiply_scalar", MATRIX_COUNT, nullptr, [&]()
+	{
+		for (size_t i = 0; i < MATRIX_COUNT; ++i)
+			products[i] = left[i] * right[i];
+		BenchmarkRunner::Consume(Checksum(products.back()));
+	});
+	runner.run("mat4_inverse_scalar", MATRIX_COUNT, nullptr, [&]()
+	{
+		for (size_t i = 0; i < MATRIX_COUNT; ++i)
+			products[i] = glm::inverse(left[i]);
+		BenchmarkRunner::Consume(Checksum(products.back()));
+	});
+	if (GlmSimd::Available())
+	{
+		runner.run("mat4_multiply_simd", MATRIX_COUNT, nullptr, [&]()
+		{
+			GlmSimd::Multiply(&left[0][0][0], &right[0][0][0], &products[0][0][0], MATRIX_COUNT);
+			BenchmarkRunner::Consume(Checksum(products.back()));
+		});
+		runner.run("mat4_inverse_simd", MATRIX_COUNT, nullptr, [&]()
+		{
+			GlmSimd::Inverse(&left[0][0][0], &products[0][0][0], MATRIX_COUNT);
+			BenchmarkRunner::Consume(Checksum(products.back()));
+		});
+	}
+	else
+		std::cout << "BENCHMARK::SKIPPED SIMD MATRICES, NO SSE2 PATH ON THIS TARGET" << std::endl;
+
+	// frustum culling of objects scattered around the camera
+	std::uniform_real_distribution<float> scatter(-50.0f, 50.0f);
+	std::uniform_real_distribution<float> extent(0.5f, 2.0f);
+	std::vector<glm::vec4> spheres(CULL_COUNT);
+	for (glm::vec4& sphere : spheres)
+		sphere = glm::vec4(scatter(random), scatter(random), scatter(random), extent(random));
+	Frustum frustum(glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 100.0f) *
+		glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+	runner.run("frustum_cull_spheres", CULL_COUNT, nullptr, [&]()
+	{
+		uint64_t visible = 0;
+		for (const glm::vec4& sphere : spheres)
+			visible += frustum.isSphereVisible(glm::vec3(sphere), sphere.w) ? 1 : 0;
+		BenchmarkRunner::Consume(visible);
+	});
+	runner.run("frustum_cull_boxes", CULL_COUNT, nullptr, [&]()
+	{
+		uint64_t visible = 0;
+		for (const glm::vec4& sphere : spheres)
+			visible += frustum.isBoxVisible(glm::vec3(sphere) - sphere.w, glm::vec3(sphere) + sphere.w) ? 1 : 0;
+		BenchmarkRunner::Consume(visible);
+	});
+
+	// mesh import kernels
+	Mesh grid = GridMesh();
+	ComputeNormals(grid);
+	runner.run("mesh_compute_normals", grid.indices.size() / 3, nullptr, [&]()
+	{
+		ComputeNormals(grid);
+		BenchmarkRunner::Consume((uint64_t)grid.normals.size());
+	});
+	Mesh soup;
+	for (unsigned int index : grid.indices)
+	{
+		soup.positions.push_back(grid.positions[index]);
+		soup.normals.push_back(grid.normals[index]);
+	}
+	Mesh welded;
+	runner.run("mesh_weld_vertices", soup.positions.size(), [&]() { welded = soup; }, [&]()
+	{
+		BenchmarkRunner::Consume((uint64_t)WeldVertices(welded));
+	});
+
+	// meshlet frustum and cone culling of the grid seen from above one corner, items are the triangles tested
+	MeshletMesh meshlets;
+	meshlets.build(grid);
+	glm::vec3 eye((float)GRID_SIZE * 0.25f, 40.0f, (float)GRID_SIZE * 0.25f);
+	Frustum meshletFrustum(glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f) *
+		glm::lookAt(eye, glm::vec3((float)GRID_SIZE * 0.5f, 0.0f, (float)GRID_SIZE * 0.5f), glm::vec3(0.0f, 1.0f, 0.0f)));
+	std::vector<DrawElementsIndirectCommand> commands;
+	runner.run("meshlet_cull", grid.indices.size() / 3, nullptr, [&]()
+	{
+		BenchmarkRunner::Consume(meshlets.cull(meshletFrustum, eye, commands) + commands.size());
+	});
+
+	// point cloud parsers, text and binary
+	std::string xyzPath = "opengl_viewer_bench.xyz";
+	std::string plyPath = "opengl_viewer_bench.ply";
+	if (WritePointFiles(xyzPath, plyPath, random))
+	{
+		runner.run("parse_points_xyz", POINT_COUNT, nullptr, [&]() { BenchmarkRunner::Consume(ReadAllPoints(xyzPath)); });
+		runner.run("parse_points_ply", POINT_COUNT, nullptr, [&]() { BenchmarkRunner::Consume(ReadAllPoints(plyPath)); });
+	}
+	else
+		std::cout << "ERROR::BENCHMARK::UNABLE TO WRITE THE POINT FILES IN THE WORKING DIRECTORY" << std::endl;
+	std::remove(xyzPath.c_str());
+	std::remove(plyPath.c_str());
+
+	// draw sort keys, the radix sort of the render queue against std::sort
+	std::vector<SortEntry> keys = RenderKeys(KEY_COUNT, random);
+	std::vector<SortEntry> sorted;
+	std::vector<SortEntry> scratch;
+	JobSystem& jobs = JobSystem::instance();
+	runner.run("sort_keys_radix", KEY_COUNT, [&]() { sorted = keys; }, [&]()
+	{
+		RadixSort(sorted, scratch, jobs);
+		BenchmarkRunner::Consume(sorted.front().key);
+	});
+	runner.run("sort_keys_std", KEY_COUNT, [&]() { sorted = keys; }, [&]()
+	{
+		std::sort(sorted.begin(), sorted.end(), [](const SortEntry& a, const SortEntry& b)
+		{
+			return a.key < b.key;
+		});
+		BenchmarkRunner::Consume(sorted.front().key);
+	});
+
+	return runner.writeJson(outPath) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
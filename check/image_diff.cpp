@@ -0,0 +1,109 @@
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "image_diff.h"
+
+// tolerance of ImageDiff::Compare on synthetic images
+//
+//   OpenGLViewerImageDiffCheck
+//
+// edges moved by a pixel must not count, a missing thin line must,
+// a uniform drift passes below the threshold and fails above it
+
+namespace
+{
+	const unsigned int SIZE = 64;
+	const float THRESHOLD = 3.0f;               // as RegressionSuite::Options
+	const float MAX_DIFFERENT_FRACTION = 0.001f;
+
+	RgbImage Filled(unsigned char gray)
+	{
+		RgbImage image;
+		image.size = glm::uvec2(SIZE);
+		image.pixels.assign(SIZE * SIZE * 3, gray);
+		return image;
+	}
+
+	void SetPixel(RgbImage& image, unsigned int x, unsigned int y, unsigned char gray)
+	{
+		size_t i = ((size_t)y * SIZE + x) * 3;
+		image.pixels[i] = image.pixels[i + 1] = image.pixels[i + 2] = gray;
+	}
+
+	// black left of the edge, white right of it
+	RgbImage Edge(unsigned int edge)
+	{
+		RgbImage image = Filled(255);
+		for (unsigned int y = 0; y < SIZE; ++y)
+		{
+			for (unsigned int x = 0; x < edge; ++x)
+				SetPixel(image, x, y, 0);
+		}
+		return image;
+	}
+
+	bool Passes(const ImageDiffResult& result)
+	{
+		return result.sameSize && result.differentFraction <= MAX_DIFFERENT_FRACTION;
+	}
+
+	/*!
+	 * Gray image drifting from a mid gray reference by about a delta E
+	 *
+	 * \param deltaE : wanted mean delta E, the closest 8 bits gray is picked
+	 */
+	ImageDiffResult UniformShift(float deltaE)
+	{
+		RgbImage reference = Filled(128);
+		ImageDiffResult closest;
+		for (unsigned int gray = 129; gray < 256; ++gray)
+		{
+			ImageDiffResult result = ImageDiff::Compare(Filled((unsigned char)gray), reference, THRESHOLD);
+			if (gray == 129 || std::fabs(result.meanDeltaE - deltaE) < std::fabs(closest.meanDeltaE - deltaE))
+				closest = result;
+		}
+		return closest;
+	}
+}
+
+
+int main()
+{
+	bool passed = true;
+
+	ImageDiffResult shifted = ImageDiff::Compare(Edge(SIZE / 2 + 1), Edge(SIZE / 2), THRESHOLD);
+	if (shifted.differentPixels != 0)
+	{
+		std::cout << "ERROR::CHECK::EDGE SHIFTED BY A PIXEL GIVES " << shifted.differentPixels << " DIFFERENT PIXELS" << std::endl;
+		passed = false;
+	}
+
+	RgbImage withLine = Filled(255);
+	for (unsigned int x = 0; x < SIZE; ++x)
+		SetPixel(withLine, x, SIZE / 3, 0);
+	ImageDiffResult missing = ImageDiff::Compare(Filled(255), withLine, THRESHOLD);
+	if (missing.differentPixels != SIZE || Passes(missing))
+	{
+		std::cout << "ERROR::CHECK::MISSING LINE GIVES " << missing.differentPixels << " DIFFERENT PIXELS INSTEAD OF " << SIZE << std::endl;
+		passed = false;
+	}
+
+	ImageDiffResult slight = UniformShift(1.0f);
+	ImageDiffResult visible = UniformShift(5.0f);
+	if (std::fabs(slight.meanDeltaE - 1.0f) > 0.5f || std::fabs(visible.meanDeltaE - 5.0f) > 0.5f)
+	{
+		std::cout << "ERROR::CHECK::NO GRAY AT DELTA E 1 AND 5, CLOSEST " << slight.meanDeltaE << " AND " << visible.meanDeltaE << std::endl;
+		passed = false;
+	}
+	if (!Passes(slight) || Passes(visible))
+	{
+		std::cout << "ERROR::CHECK::UNIFORM SHIFT OF DELTA E " << slight.meanDeltaE << (Passes(slight) ? " PASSES" : " FAILS")
+			<< ", OF DELTA E " << visible.meanDeltaE << (Passes(visible) ? " PASSES" : " FAILS") << std::endl;
+		passed = false;
+	}
+
+	std::cout << "CHECK::IMAGE DIFF::" << (passed ? "PASSED" : "FAILED") << " SHIFTED EDGE " << shifted.differentPixels
+		<< ", MISSING LINE " << missing.differentPixels << ", DELTA E " << slight.meanDeltaE << " AND " << visible.meanDeltaE << std::endl;
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
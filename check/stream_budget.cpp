@@ -0,0 +1,126 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <glm.hpp>
+#include <gtc/matrix_transform.hpp>
+#include "chunked_mesh.h"
+#include "frame_arena.h"
+#include "job_system.h"
+#include "mesh_streamer.h"
+
+// residency of MeshStreamer over a scripted flight, without a GL context
+//
+//   OpenGLViewerStreamCheck [directory]
+//
+// a height field is written as OBJ, turned into a chunk cache by ChunkedMesh::BuildFromFile
+// and streamed under a budget far below its size, the resident bytes must never exceed it
+
+namespace
+{
+	const unsigned int GRID_SIZE = 384;         // vertices per side of the height field
+	const unsigned int FRAME_COUNT = 240;
+	const uint64_t RESIDENT_BUDGET = 1024 * 1024;
+
+	float Height(float x, float z)
+	{
+		return std::sin(x * 0.05f) * std::cos(z * 0.07f) * 8.0f;
+	}
+
+	// quads, cut into triangles by the reader
+	bool WriteHeightField(const std::string& path)
+	{
+		std::ofstream file(path, std::ios::trunc);
+		for (unsigned int z = 0; z < GRID_SIZE; ++z)
+		{
+			for (unsigned int x = 0; x < GRID_SIZE; ++x)
+				file << "v " << x << " " << Height((float)x, (float)z) << " " << z << "\n";
+		}
+		for (unsigned int z = 0; z + 1 < GRID_SIZE; ++z)
+		{
+			for (unsigned int x = 0; x + 1 < GRID_SIZE; ++x)
+			{
+				unsigned int corner = z * GRID_SIZE + x + 1;
+				file << "f " << corner << " " << corner + GRID_SIZE << " " << corner + GRID_SIZE + 1 << " " << corner + 1 << "\n";
+			}
+		}
+		return file.good();
+	}
+}
+
+
+int main(int argc, char** argv)
+{
+	std::string directory = argc > 1 ? std::string(argv[1]) + "/" : std::string();
+	std::string meshPath = directory + "stream_budget_check.obj";
+	std::string cachePath = meshPath + ".ogvc";
+
+	ChunkedMesh::Options buildOptions;
+	buildOptions.trianglesPerChunk = 2048;
+	buildOptions.gridLevels = 2;
+	buildOptions.batchTriangles = 10000;
+	if (!WriteHeightField(meshPath) || !ChunkedMesh::BuildFromFile(meshPath, cachePath, buildOptions))
+	{
+		std::cout << "ERROR::CHECK::UNABLE TO BUILD: " << cachePath << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	MeshStreamer::Options options;
+	options.residentBudget = RESIDENT_BUDGET;
+	options.uploadToGpu = false;
+	MeshStreamer streamer;
+	if (!streamer.open(cachePath, options))
+		return EXIT_FAILURE;
+
+	// low flight along the diagonal, looking ahead and slightly down
+	FrameArena frameArena(256 * 1024, 3, JobSystem::instance().concurrency());
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+	bool passed = true;
+	uint64_t uploadedBytes = 0;
+	unsigned int evictions = 0;
+	for (unsigned int frame = 0; frame < FRAME_COUNT; ++frame)
+	{
+		frameArena.beginFrame();
+		float along = (float)frame / (float)(FRAME_COUNT - 1) * (float)(GRID_SIZE - 1);
+		glm::vec3 camera(along, 20.0f, along);
+		glm::vec3 heading = glm::normalize(glm::vec3(std::cos(frame * 0.02f), -0.3f, std::sin(frame * 0.02f) + 1.0f));
+		glm::mat4 view = glm::lookAt(camera, camera + heading, glm::vec3(0.0f, 1.0f, 0.0f));
+
+		streamer.update(projection * view, camera, frameArena.threadArena());
+		streamer.upload();
+		const MeshStreamerStats& stats = streamer.stats();
+		uploadedBytes += stats.uploadedBytes;
+		evictions += stats.evictions;
+		if (stats.residentBytes > RESIDENT_BUDGET)
+		{
+			std::cout << "ERROR::CHECK::FRAME " << frame << " HOLDS " << stats.residentBytes << " BYTES OVER A BUDGET OF " << RESIDENT_BUDGET << std::endl;
+			passed = false;
+		}
+
+		// time for the I/O threads, the frames of the viewer are not faster than this
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+	}
+
+	const MeshStreamerStats& stats = streamer.stats();
+	if (stats.peakResidentBytes > RESIDENT_BUDGET)
+	{
+		std::cout << "ERROR::CHECK::PEAK OF " << stats.peakResidentBytes << " BYTES OVER A BUDGET OF " << RESIDENT_BUDGET << std::endl;
+		passed = false;
+	}
+	if (uploadedBytes == 0 || evictions == 0)
+	{
+		std::cout << "ERROR::CHECK::BUDGET NOT EXERCISED, " << uploadedBytes << " BYTES LOADED, " << evictions << " EVICTIONS" << std::endl;
+		passed = false;
+	}
+	streamer.close();
+	std::remove(meshPath.c_str());
+	std::remove(cachePath.c_str());
+
+	std::cout << "CHECK::STREAM BUDGET::" << (passed ? "PASSED" : "FAILED") << " PEAK " << stats.peakResidentBytes << " OF "
+		<< RESIDENT_BUDGET << " BYTES, " << uploadedBytes << " BYTES LOADED, " << evictions << " EVICTIONS" << std::endl;
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
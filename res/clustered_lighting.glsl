@@ -0,0 +1,65 @@
+// Clustered forward lighting, lists built by ClusteredLighting on the CPU
+
+struct Light
+{
+	vec3 position;
+	float range;
+	vec3 color;
+	float spotCosInner;
+	vec3 direction;
+	float spotCosOuter;     // -1 for point lights
+};
+
+layout(std430, binding = 2) readonly buffer Lights
+{
+	Light lights[];
+};
+
+layout(std430, binding = 3) readonly buffer Clusters
+{
+	uvec2 clusters[];       // offset and count in lightIndices
+};
+
+layout(std430, binding = 4) readonly buffer LightIndices
+{
+	uint lightIndices[];
+};
+
+uniform vec3 clusterGrid;
+uniform vec2 clusterTileSize;    // pixels
+uniform float clusterSliceScale;
+uniform float clusterSliceBias;
+
+// froxel of the fragment, viewDepth is positive in front of the camera
+uint ClusterIndex(vec2 fragCoord, float viewDepth)
+{
+	uvec3 grid = uvec3(clusterGrid);
+	uvec2 tile = min(uvec2(fragCoord / clusterTileSize), grid.xy - 1u);
+	uint slice = uint(clamp(log(viewDepth) * clusterSliceScale - clusterSliceBias, 0.0, clusterGrid.z - 1.0));
+	return (slice * grid.y + tile.y) * grid.x + tile.x;
+}
+
+// diffuse light of every light of the froxel
+vec3 ClusteredDiffuse(vec3 position, vec3 normal, vec2 fragCoord, float viewDepth)
+{
+	uvec2 cluster = clusters[ClusterIndex(fragCoord, viewDepth)];
+	vec3 result = vec3(0.0);
+	for (uint i = 0u; i < cluster.y; ++i)
+	{
+		Light light = lights[lightIndices[cluster.x + i]];
+		vec3 toLight = light.position - position;
+		float distance = length(toLight);
+		if (distance >= light.range)
+			continue;
+		vec3 lightDir = toLight / max(distance, 1e-5);
+
+		// smooth window to zero at the range
+		float falloff = 1.0 - (distance * distance) / (light.range * light.range);
+		float attenuation = falloff * falloff;
+		if (light.spotCosOuter > -1.0)
+			attenuation *= smoothstep(light.spotCosOuter, light.spotCosInner, dot(-lightDir, light.direction));
+
+		result += max(dot(normal, lightDir), 0.0) * attenuation * light.color;
+	}
+	return result;
+}
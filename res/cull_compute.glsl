@@ -0,0 +1,62 @@
+#version 430 core
+
+layout(local_size_x = 64) in;
+
+struct ObjectData
+{
+	mat4 model;
+	vec4 sphere;     // xyz center in model space, w radius
+	uint indexCount;
+	uint firstIndex;
+	int baseVertex;
+	uint padding;
+};
+
+struct DrawCommand
+{
+	uint count;
+	uint instanceCount;
+	uint firstIndex;
+	int baseVertex;
+	uint baseInstance;
+};
+
+layout(std430, binding = 0) readonly buffer Objects
+{
+	ObjectData objects[];
+};
+
+layout(std430, binding = 1) writeonly buffer Commands
+{
+	DrawCommand commands[];
+};
+
+uniform vec4 frustumPlanes[6];
+uniform int objectCount;
+
+void main()
+{
+	uint id = gl_GlobalInvocationID.x;
+	if (id >= uint(objectCount))
+		return;
+
+	ObjectData object = objects[id];
+
+	// world space bounding sphere, radius scaled by the largest axis scale
+	vec3 center = vec3(object.model * vec4(object.sphere.xyz, 1.0));
+	float scale = max(length(object.model[0].xyz), max(length(object.model[1].xyz), length(object.model[2].xyz)));
+	float radius = object.sphere.w * scale;
+
+	bool visible = true;
+	for (int i = 0; i < 6; ++i)
+	{
+		if (dot(frustumPlanes[i].xyz, center) + frustumPlanes[i].w < -radius)
+			visible = false;
+	}
+
+	commands[id].count = object.indexCount;
+	commands[id].instanceCount = visible ? 1u : 0u;
+	commands[id].firstIndex = object.firstIndex;
+	commands[id].baseVertex = object.baseVertex;
+	commands[id].baseInstance = id;
+}
@@ -0,0 +1,157 @@
+#version 430 core
+
+// tiled light accumulation of DeferredRenderer, one work group per 16x16 pixel tile
+//  SHADOWS : lightColor is a directional light along sunDirection with cascaded shadows
+
+layout(local_size_x = 16, local_size_y = 16) in;
+
+struct Light
+{
+	vec3 position;
+	float range;
+	vec3 color;
+	float spotCosInner;
+	vec3 direction;
+	float spotCosOuter;     // -1 for point lights
+};
+
+layout(std430, binding = 2) readonly buffer Lights
+{
+	Light lights[];
+};
+
+layout(std430, binding = 5) readonly buffer Materials
+{
+	vec4 materials[];       // albedo per material id
+};
+
+layout(rgba8, binding = 0) writeonly uniform image2D outputImage;
+
+uniform usampler2D gbuffer;
+uniform sampler2D depthBuffer;
+uniform mat4 view;
+uniform mat4 projection;
+uniform mat4 inverseViewProjection;
+uniform vec2 viewportSize;
+uniform vec3 lightColor;
+uniform int lightCount;
+
+#ifdef SHADOWS
+#include "shadows.glsl"
+#endif
+
+// lights past the cap are dropped for the tile, the cost per pixel stays bounded
+const uint MAX_TILE_LIGHTS = 256u;
+
+shared uint tileDepthMin;   // float bits, view depths are positive so they sort as uints
+shared uint tileDepthMax;
+shared uint tileLightCount;
+shared uint tileLights[MAX_TILE_LIGHTS];
+
+vec3 OctahedralDecode(vec2 e)
+{
+	e = e * 2.0 - 1.0;
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (n.z < 0.0)
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(n);
+}
+
+// view space point at depth 1 through a pixel corner of the viewport
+vec3 ViewRay(vec2 pixel)
+{
+	vec2 ndc = pixel / viewportSize * 2.0 - 1.0;
+	return vec3((ndc + vec2(projection[2][0], projection[2][1])) / vec2(projection[0][0], projection[1][1]), -1.0);
+}
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+	bool inside = all(lessThan(vec2(pixel), viewportSize));
+	if (gl_LocalInvocationIndex == 0u)
+	{
+		tileDepthMin = floatBitsToUint(3.0e38);
+		tileDepthMax = 0u;
+		tileLightCount = 0u;
+	}
+	barrier();
+
+	// position back from the depth
+	float depth = inside ? texelFetch(depthBuffer, pixel, 0).r : 1.0;
+	bool covered = depth < 1.0;
+	vec4 world = inverseViewProjection * vec4((vec2(pixel) + 0.5) / viewportSize * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+	vec3 position = world.xyz / world.w;
+	float viewDepth = -(view * vec4(position, 1.0)).z;
+	if (covered)
+	{
+		atomicMin(tileDepthMin, floatBitsToUint(viewDepth));
+		atomicMax(tileDepthMax, floatBitsToUint(viewDepth));
+	}
+	barrier();
+
+	// side planes of the tile through the eye, normals pointing inside
+	vec2 tileMin = vec2(gl_WorkGroupID.xy * gl_WorkGroupSize.xy);
+	vec2 tileMax = tileMin + vec2(gl_WorkGroupSize.xy);
+	vec3 corners[4] = vec3[4](ViewRay(tileMin), ViewRay(vec2(tileMax.x, tileMin.y)), ViewRay(tileMax), ViewRay(vec2(tileMin.x, tileMax.y)));
+	vec3 planes[4];
+	for (int i = 0; i < 4; ++i)
+		planes[i] = normalize(cross(corners[(i + 1) % 4], corners[i]));
+	float depthMin = uintBitsToFloat(tileDepthMin);
+	float depthMax = uintBitsToFloat(tileDepthMax);
+
+	// every thread tests a share of the lights
+	uint groupSize = gl_WorkGroupSize.x * gl_WorkGroupSize.y;
+	for (uint i = gl_LocalInvocationIndex; i < uint(lightCount) && depthMin <= depthMax; i += groupSize)
+	{
+		vec3 center = (view * vec4(lights[i].position, 1.0)).xyz;
+		float range = lights[i].range;
+		bool visible = -center.z + range >= depthMin && -center.z - range <= depthMax;
+		for (int p = 0; p < 4 && visible; ++p)
+			visible = dot(planes[p], center) >= -range;
+		if (visible)
+		{
+			uint slot = atomicAdd(tileLightCount, 1u);
+			if (slot < MAX_TILE_LIGHTS)
+				tileLights[slot] = i;
+		}
+	}
+	barrier();
+
+	if (!inside)
+		return;
+	if (!covered)
+	{
+		imageStore(outputImage, pixel, vec4(0.0, 0.0, 0.0, 1.0));
+		return;
+	}
+
+	uint encoded = texelFetch(gbuffer, pixel, 0).r;
+	vec3 norm = OctahedralDecode(vec2(encoded & 4095u, (encoded >> 12) & 4095u) / 4095.0);
+	vec3 albedo = materials[encoded >> 24].rgb;
+
+	// same terms as res/fragment.glsl
+	vec3 ambient = 0.1 * lightColor;
+	vec3 diffuse = vec3(0.0);
+#ifdef SHADOWS
+	diffuse += max(dot(norm, -sunDirection), 0.0) * ShadowFactor(position, norm, viewDepth) * lightColor;
+#endif
+	uint count = min(tileLightCount, MAX_TILE_LIGHTS);
+	for (uint i = 0u; i < count; ++i)
+	{
+		Light light = lights[tileLights[i]];
+		vec3 toLight = light.position - position;
+		float distance = length(toLight);
+		if (distance >= light.range)
+			continue;
+		vec3 lightDir = toLight / max(distance, 1e-5);
+
+		float falloff = 1.0 - (distance * distance) / (light.range * light.range);
+		float attenuation = falloff * falloff;
+		if (light.spotCosOuter > -1.0)
+			attenuation *= smoothstep(light.spotCosOuter, light.spotCosInner, dot(-lightDir, light.direction));
+
+		diffuse += max(dot(norm, lightDir), 0.0) * attenuation * light.color;
+	}
+
+	imageStore(outputImage, pixel, vec4((ambient + diffuse) * albedo, 1.0));
+}
@@ -2,13 +2,27 @@
 
 out vec4 FragColor;
 
+#ifndef NO_NORMALS
 in vec3 Normal;
+#endif
 in vec3 FragPos;
 
 uniform vec3 lightPos;
 uniform vec3 lightColor;
 uniform vec3 objectColor;
 
+// CLUSTERED_LIGHTS : lights of res/clustered_lighting.glsl instead of lightPos/lightColor
+// SHADOWS          : lightColor is a directional light along sunDirection with cascaded shadows
+#ifdef CLUSTERED_LIGHTS
+#include "clustered_lighting.glsl"
+#endif
+#ifdef SHADOWS
+#include "shadows.glsl"
+#endif
+#if defined(CLUSTERED_LIGHTS) || defined(SHADOWS)
+uniform mat4 view;
+#endif
+
 void main()
 {
 	// ambient
@@ -16,11 +30,27 @@ void main()
 	vec3 ambient = ambientStrength * lightColor;
 
 	// diffuse 
+#ifdef NO_NORMALS
+	// flat shading out of the screen space derivatives of the position
+	vec3 norm = normalize(cross(dFdx(FragPos), dFdy(FragPos)));
+#else
 	vec3 norm = normalize(Normal);
+#endif
+#if defined(CLUSTERED_LIGHTS) || defined(SHADOWS)
+	float viewDepth = -(view * vec4(FragPos, 1.0)).z;
+	vec3 diffuse = vec3(0.0);
+#ifdef SHADOWS
+	diffuse += max(dot(norm, -sunDirection), 0.0) * ShadowFactor(FragPos, norm, viewDepth) * lightColor;
+#endif
+#ifdef CLUSTERED_LIGHTS
+	diffuse += ClusteredDiffuse(FragPos, norm, gl_FragCoord.xy, viewDepth);
+#endif
+#else
 	vec3 lightDir = normalize(lightPos - FragPos);
 	float diff = max(dot(norm, lightDir), 0.0);
 	vec3 diffuse = diff * lightColor;
+#endif
 
 	vec3 result = (ambient + diffuse) * objectColor;
 	FragColor = vec4(result, 1.0);
-}
\ No newline at end of file
+}
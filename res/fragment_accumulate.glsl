@@ -0,0 +1,49 @@
+#version 430 core
+
+// ProgressiveRefinement, blends a frame and its ambient occlusion into the running average
+
+in vec2 TexCoord;
+
+out vec4 FragColor;
+
+uniform sampler2D sceneColor;
+uniform sampler2D sceneDepth;
+uniform vec2 sourceScale;      // part of the scene target drawn this frame
+uniform vec2 sourceTexel;
+uniform float weight;          // 1 / samples, alpha of the blend
+uniform float aoStrength;      // 0 skips the occlusion
+uniform int aoSamples;
+uniform float aoRadius;        // texels
+uniform float aoAngle;         // rotation of the pattern, changes every sample
+uniform float nearPlane;
+uniform float farPlane;
+
+float LinearDepth(vec2 uv)
+{
+	float depth = texture(sceneDepth, uv).r * 2.0 - 1.0;
+	return 2.0 * nearPlane * farPlane / (farPlane + nearPlane - depth * (farPlane - nearPlane));
+}
+
+void main()
+{
+	vec2 uv = TexCoord * sourceScale;
+	vec3 color = texture(sceneColor, uv).rgb;
+
+	// obscurance of the depth buffer neighbourhood, occluders far in front fade out
+	float depth = LinearDepth(uv);
+	if (aoStrength > 0.0 && aoSamples > 0 && depth < farPlane * 0.999)
+	{
+		float occlusion = 0.0;
+		for (int i = 0; i < aoSamples; ++i)
+		{
+			float angle = aoAngle + float(i) * 2.3999632;
+			float radius = aoRadius * sqrt((float(i) + 0.5) / float(aoSamples));
+			vec2 sampleUv = clamp(uv + vec2(cos(angle), sin(angle)) * radius * sourceTexel, vec2(0.0), sourceScale - sourceTexel);
+			float difference = (depth - LinearDepth(sampleUv)) / depth;
+			occlusion += step(0.002, difference) * (1.0 - smoothstep(0.02, 0.1, difference));
+		}
+		color *= 1.0 - 0.6 * aoStrength * occlusion / float(aoSamples);
+	}
+
+	FragColor = vec4(color, weight);
+}
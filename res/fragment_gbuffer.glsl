@@ -0,0 +1,33 @@
+#version 430 core
+
+// geometry pass of DeferredRenderer, normal and material packed in 32 bits
+
+layout(location = 0) out uint GBuffer;
+
+#ifndef NO_NORMALS
+in vec3 Normal;
+#endif
+in vec3 FragPos;
+
+uniform int materialId;     // row of the material table, 0 to 255
+
+// octahedral mapping of a unit vector to [0, 1]^2
+vec2 OctahedralEncode(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 folded = n.xy;
+	if (n.z < 0.0)
+		folded = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return folded * 0.5 + 0.5;
+}
+
+void main()
+{
+#ifdef NO_NORMALS
+	vec3 norm = normalize(cross(dFdx(FragPos), dFdy(FragPos)));
+#else
+	vec3 norm = normalize(Normal);
+#endif
+	uvec2 octahedral = uvec2(round(OctahedralEncode(norm) * 4095.0));
+	GBuffer = octahedral.x | (octahedral.y << 12) | (uint(materialId & 255) << 24);
+}
@@ -0,0 +1,14 @@
+#version 430 core
+
+in vec3 PointColor;
+
+out vec4 FragColor;
+
+void main()
+{
+	// round points
+	vec2 offset = gl_PointCoord * 2.0 - 1.0;
+	if (dot(offset, offset) > 1.0)
+		discard;
+	FragColor = vec4(PointColor, 1.0);
+}
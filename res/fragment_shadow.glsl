@@ -0,0 +1,7 @@
+#version 430 core
+
+// depth only passes, shadow casters and depth pre-pass, nothing to write
+
+void main()
+{
+}
@@ -0,0 +1,75 @@
+#version 430 core
+
+in vec3 CubePosition;
+
+out vec4 FragColor;
+
+uniform sampler3D atlas;         // bricks with a one voxel apron
+uniform usampler3D pageTable;    // xyz atlas slot, w 0 missing, 1 resident, 2 constant
+uniform sampler3D brickRange;    // normalized min and max of every brick
+uniform vec3 cameraPosition;     // in the unit cube
+uniform vec3 volumeSize;         // voxels
+uniform float atlasSize;         // texels per axis
+uniform float stepSize;          // in the unit cube
+uniform float transferLow;
+uniform float transferHigh;
+uniform float opacityScale = 0.05;
+
+const float BRICK_SIZE = 32.0;
+const float BRICK_STORED = 34.0;
+
+vec4 Transfer(float value)
+{
+	float alpha = clamp((value - transferLow) / (transferHigh - transferLow), 0.0, 1.0);
+	vec3 color = mix(vec3(0.2, 0.4, 1.0), vec3(1.0, 0.9, 0.7), alpha);
+	return vec4(color, alpha * opacityScale);
+}
+
+void main()
+{
+	// the back face ends the ray, it starts at the camera or where it enters the cube
+	vec3 rayEnd = CubePosition;
+	vec3 direction = rayEnd - cameraPosition;
+	float rayLength = length(direction);
+	direction /= rayLength;
+	vec3 inverse = 1.0 / direction;
+	vec3 t0 = (vec3(0.0) - cameraPosition) * inverse;
+	vec3 t1 = (vec3(1.0) - cameraPosition) * inverse;
+	vec3 tNear = min(t0, t1);
+	float t = max(max(max(tNear.x, tNear.y), tNear.z), 0.0);
+
+	vec3 bricks = ceil(volumeSize / BRICK_SIZE);
+	vec4 result = vec4(0.0);
+	while (t < rayLength && result.a < 0.99)
+	{
+		vec3 voxel = clamp((cameraPosition + direction * t) * volumeSize, vec3(0.0), volumeSize - 1e-3);
+		vec3 brick = floor(voxel / BRICK_SIZE);
+		vec2 range = texelFetch(brickRange, ivec3(brick), 0).xy;
+		uvec4 page = texelFetch(pageTable, ivec3(brick), 0);
+
+		if (range.y < transferLow || page.w == 0u)
+		{
+			// empty or not paged in, jump to where the ray leaves the brick
+			vec3 boxMin = brick * BRICK_SIZE / volumeSize;
+			vec3 boxMax = min((brick + 1.0) * BRICK_SIZE / volumeSize, vec3(1.0));
+			vec3 tFar = max((boxMin - cameraPosition) * inverse, (boxMax - cameraPosition) * inverse);
+			float exit = min(min(tFar.x, tFar.y), tFar.z);
+			t = max(t + stepSize, exit + 0.5 * stepSize);
+			continue;
+		}
+
+		float value = range.x;
+		if (page.w == 1u)
+		{
+			vec3 texel = vec3(page.xyz) * BRICK_STORED + 1.0 + (voxel - brick * BRICK_SIZE);
+			value = texture(atlas, texel / atlasSize).r;
+		}
+
+		// front to back compositing with premultiplied colors
+		vec4 sampleColor = Transfer(value);
+		result.rgb += (1.0 - result.a) * sampleColor.a * sampleColor.rgb;
+		result.a += (1.0 - result.a) * sampleColor.a;
+		t += stepSize;
+	}
+	FragColor = result;
+}
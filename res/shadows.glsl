@@ -0,0 +1,38 @@
+// Cascaded shadows of the directional light, atlas kept by ShadowCascades
+
+uniform sampler2DShadow shadowAtlas;
+uniform mat4 cascadeMatrices[4];   // world to atlas, depth in z
+uniform vec4 cascadeSplits;        // view depth where each cascade ends
+uniform vec4 cascadeTexels;        // world size of a texel of each cascade
+uniform int cascadeCount;
+uniform float shadowAtlasTexel;
+uniform vec3 sunDirection;         // direction the light travels
+
+// 1 lit, 0 in shadow, viewDepth is positive in front of the camera
+float ShadowFactor(vec3 position, vec3 normal, float viewDepth)
+{
+	if (viewDepth > cascadeSplits[cascadeCount - 1])
+		return 1.0;
+	int cascade = 0;
+	while (cascade < cascadeCount - 1 && viewDepth > cascadeSplits[cascade])
+		++cascade;
+
+	// pushed along the normal by a texel and a half against acne
+	vec3 offsetPosition = position + normal * cascadeTexels[cascade] * 1.5;
+	vec3 coord = (cascadeMatrices[cascade] * vec4(offsetPosition, 1.0)).xyz;
+
+	// 3x3 PCF kept inside the quarter of the cascade
+	vec2 tile = vec2(cascade % 2, cascade / 2) * 0.5;
+	vec2 low = tile + shadowAtlasTexel * 1.5;
+	vec2 high = tile + 0.5 - shadowAtlasTexel * 1.5;
+	float lit = 0.0;
+	for (int y = -1; y <= 1; ++y)
+	{
+		for (int x = -1; x <= 1; ++x)
+		{
+			vec2 uv = clamp(coord.xy, low, high) + vec2(x, y) * shadowAtlasTexel;
+			lit += texture(shadowAtlas, vec3(uv, coord.z));
+		}
+	}
+	return lit / 9.0;
+}
@@ -1,19 +1,53 @@
 #version 430 core
 
+// feature keywords, injected as defines by ShaderVariants
+//  INSTANCED           : model matrix per instance in locations 3 to 6
+//  QUANTIZED_POSITIONS : positions stored as normalized shorts, rebuilt with positionScale/positionOffset
+//  NO_NORMALS          : no normal attribute, the fragment shader uses a flat normal
+
 layout(location = 0) in vec3 aPos;
+#ifndef NO_NORMALS
 layout(location = 1) in vec3 aNormal;
+#endif
+#ifdef INSTANCED
+layout(location = 3) in mat4 aModel;
+#endif
 
 out vec3 FragPos;
+#ifndef NO_NORMALS
 out vec3 Normal;
+#endif
+invariant gl_Position; // depth equal to the pre-pass, for GL_EQUAL
 
+#ifndef INSTANCED
 uniform mat4 model;
+#endif
 uniform mat4 view;
 uniform mat4 projection;
+#ifdef QUANTIZED_POSITIONS
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+#endif
 
 void main()
 {
-	FragPos = vec3(model * vec4(aPos, 1.0));
+#ifdef QUANTIZED_POSITIONS
+	vec3 position = aPos * positionScale + positionOffset;
+#else
+	vec3 position = aPos;
+#endif
+
+#ifdef INSTANCED
+	FragPos = vec3(aModel * vec4(position, 1.0));
+#ifndef NO_NORMALS
+	Normal = mat3(aModel) * aNormal;
+#endif
+#else
+	FragPos = vec3(model * vec4(position, 1.0));
+#ifndef NO_NORMALS
 	Normal = aNormal;
+#endif
+#endif
 
 	gl_Position = projection * view * vec4(FragPos, 1.0);
-}
\ No newline at end of file
+}
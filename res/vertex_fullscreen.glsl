@@ -0,0 +1,12 @@
+#version 430 core
+
+// triangle covering the viewport, drawn with 3 vertices and no attribute
+
+out vec2 TexCoord;
+
+void main()
+{
+	vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	TexCoord = corner;
+	gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
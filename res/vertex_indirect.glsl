@@ -0,0 +1,45 @@
+#version 430 core
+
+// feature keywords, injected as defines by GpuScene
+//  NO_NORMALS : positions only, for the depth pre-pass
+
+layout(location = 0) in vec3 aPos;
+#ifndef NO_NORMALS
+layout(location = 1) in vec3 aNormal;
+#endif
+layout(location = 2) in uint aObjectId; // instanced, equals baseInstance of the draw command
+
+struct ObjectData
+{
+	mat4 model;
+	vec4 sphere;
+	uint indexCount;
+	uint firstIndex;
+	int baseVertex;
+	uint padding;
+};
+
+layout(std430, binding = 0) readonly buffer Objects
+{
+	ObjectData objects[];
+};
+
+out vec3 FragPos;
+#ifndef NO_NORMALS
+out vec3 Normal;
+#endif
+invariant gl_Position; // NO_NORMALS pre-pass and shading pass write the same depth
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+	mat4 model = objects[aObjectId].model;
+	FragPos = vec3(model * vec4(aPos, 1.0));
+#ifndef NO_NORMALS
+	Normal = mat3(model) * aNormal;
+#endif
+
+	gl_Position = projection * view * vec4(FragPos, 1.0);
+}
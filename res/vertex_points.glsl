@@ -0,0 +1,25 @@
+#version 430 core
+
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec4 aColor;
+
+out vec3 PointColor;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+uniform float spacing;      // point spacing of the octree node
+uniform float screenScale;  // pixels per unit at distance 1
+uniform float minPointSize = 1.0;
+uniform float maxPointSize = 32.0;
+
+void main()
+{
+	vec4 viewPosition = view * model * vec4(aPos, 1.0);
+	gl_Position = projection * viewPosition;
+
+	// a point covers the gap to its neighbours, shrinking with distance
+	float size = spacing * screenScale / max(-viewPosition.z, 1e-4);
+	gl_PointSize = clamp(size, minPointSize, maxPointSize);
+	PointColor = aColor.rgb;
+}
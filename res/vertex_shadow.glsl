@@ -0,0 +1,22 @@
+#version 430 core
+
+// depth only pass of the shadow casters
+//  INSTANCED : model matrix per instance in locations 3 to 6, as in vertex.glsl
+
+layout(location = 0) in vec3 aPos;
+#ifdef INSTANCED
+layout(location = 3) in mat4 aModel;
+#else
+uniform mat4 model;
+#endif
+
+uniform mat4 lightViewProjection;
+
+void main()
+{
+#ifdef INSTANCED
+	gl_Position = lightViewProjection * aModel * vec4(aPos, 1.0);
+#else
+	gl_Position = lightViewProjection * model * vec4(aPos, 1.0);
+#endif
+}
@@ -0,0 +1,50 @@
+#version 430 core
+
+// CDLOD grid, one instance per selected quadtree node, shaded by fragment.glsl
+
+layout(location = 0) in vec2 aGrid;   // sample of the tile, 0 to TILE_SIZE
+layout(location = 1) in vec4 aNode;   // origin x, origin z, size, level
+layout(location = 2) in vec4 aTile;   // layer, morph start, morph end
+
+out vec3 FragPos;
+out vec3 Normal;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+uniform sampler2DArray heights;
+uniform float heightScale;     // terrain units per normalized height
+uniform vec3 cameraPosition;   // in the terrain space
+
+const float TILE_SIZE = 64.0;
+const float TILE_SAMPLES = 65.0;
+
+float Height(vec2 grid)
+{
+	return texture(heights, vec3((grid + 0.5) / TILE_SAMPLES, aTile.x)).r * heightScale;
+}
+
+void main()
+{
+	float spacing = aNode.z / TILE_SIZE;
+	vec2 position = aNode.xy + aGrid * spacing;
+	float height = Height(aGrid);
+
+	// odd vertices slide onto the grid of the parent level as the node gets far
+	float distance = length(cameraPosition - vec3(position.x, height, position.y));
+	float morph = clamp((distance - aTile.y) / (aTile.z - aTile.y), 0.0, 1.0);
+	vec2 grid = aGrid - fract(aGrid * 0.5) * 2.0 * morph;
+	position = aNode.xy + grid * spacing;
+	height = Height(grid);
+
+	// central differences, clamped at the tile border
+	float left = Height(max(grid - vec2(1.0, 0.0), 0.0));
+	float right = Height(min(grid + vec2(1.0, 0.0), TILE_SIZE));
+	float back = Height(max(grid - vec2(0.0, 1.0), 0.0));
+	float front = Height(min(grid + vec2(0.0, 1.0), TILE_SIZE));
+	vec3 normal = normalize(vec3(left - right, 2.0 * spacing, back - front));
+
+	FragPos = vec3(model * vec4(position.x, height, position.y, 1.0));
+	Normal = mat3(model) * normal;
+	gl_Position = projection * view * vec4(FragPos, 1.0);
+}
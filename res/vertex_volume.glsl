@@ -0,0 +1,15 @@
+#version 430 core
+
+layout(location = 0) in vec3 aPos;
+
+out vec3 CubePosition;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+	CubePosition = aPos;
+	gl_Position = projection * view * model * vec4(aPos, 1.0);
+}
@@ -0,0 +1,155 @@
+#include "async_file_reader.h"
+#include <algorithm>
+#include <iostream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+AsyncFileReader::AsyncFileReader()
+	: m_File(-1), m_Stop(false)
+{
+}
+
+AsyncFileReader::~AsyncFileReader()
+{
+	close();
+}
+
+
+bool AsyncFileReader::open(const std::string& path, unsigned int threadCount)
+{
+	close();
+
+#ifndef _WIN32
+	m_File = ::open(path.c_str(), O_RDONLY);
+	if (m_File < 0)
+	{
+		std::cout << "ERROR::ASYNC FILE READER::UNABLE TO OPEN: " << path << std::endl;
+		return false;
+	}
+#endif
+
+	m_Path = path;
+	m_Stop = false;
+	for (unsigned int i = 0; i < std::max(1u, threadCount); ++i)
+		m_Threads.emplace_back(&AsyncFileReader::IoLoop, this);
+	return true;
+}
+
+
+void AsyncFileReader::close()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stop = true;
+		m_Queue.clear();
+	}
+	m_Wake.notify_all();
+	for (std::thread& thread : m_Threads)
+		thread.join();
+	m_Threads.clear();
+	m_Completed.clear();
+
+#ifndef _WIN32
+	if (m_File >= 0)
+		::close(m_File);
+#endif
+	m_File = -1;
+}
+
+
+void AsyncFileReader::replaceQueue(FrameVector<Request>& requests, FrameVector<uint64_t>& dropped)
+{
+	std::sort(requests.begin(), requests.end(), [](const Request& a, const Request& b)
+	{
+		return a.priority < b.priority;
+	});
+
+	bool wake = !requests.empty();
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		for (const Request& request : m_Queue)
+			dropped.push_back(request.id);
+		// assign keeps the capacity of the queue, the requests live in a frame arena
+		m_Queue.assign(requests.begin(), requests.end());
+	}
+	requests.clear();
+	if (wake)
+		m_Wake.notify_all();
+}
+
+
+void AsyncFileReader::takeCompleted(std::vector<Result>& results)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	for (Result& result : m_Completed)
+		results.push_back(std::move(result));
+	m_Completed.clear();
+}
+
+
+void AsyncFileReader::IoLoop()
+{
+#ifdef _WIN32
+	// no pread, every thread reads through its own stream
+	std::ifstream file(m_Path, std::ios::binary);
+	std::ifstream* fallback = &file;
+#else
+	std::ifstream* fallback = nullptr;
+#endif
+
+	for (;;)
+	{
+		Request request;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_Wake.wait(lock, [this] { return m_Stop || !m_Queue.empty(); });
+			if (m_Stop)
+				return;
+			request = m_Queue.back();
+			m_Queue.pop_back();
+		}
+
+		Result result;
+		result.id = request.id;
+		result.data.resize((size_t)request.size);
+		if (!ReadRange(request.offset, request.size, result.data.data(), fallback))
+		{
+			std::cout << "ERROR::ASYNC FILE READER::READ FAILED AT OFFSET " << request.offset << std::endl;
+			result.data.clear();
+		}
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Completed.push_back(std::move(result));
+	}
+}
+
+
+bool AsyncFileReader::ReadRange(uint64_t offset, uint64_t size, char* destination, std::ifstream* fallback)
+{
+	if (fallback)
+	{
+		fallback->clear();
+		fallback->seekg((std::streamoff)offset);
+		fallback->read(destination, (std::streamsize)size);
+		return (bool)*fallback;
+	}
+
+#ifndef _WIN32
+	while (size > 0)
+	{
+		ssize_t count = pread(m_File, destination, (size_t)size, (off_t)offset);
+		if (count <= 0)
+			return false;
+		destination += count;
+		offset += (uint64_t)count;
+		size -= (uint64_t)count;
+	}
+	return true;
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,87 @@
+#ifndef ASYNC_FILE_READER_H
+#define ASYNC_FILE_READER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "frame_arena.h"
+
+/*!
+ * Prioritized reads of file ranges on a pool of I/O threads
+ *
+ * The owner replaces the whole queue every frame with what the current
+ * camera needs, reads not started yet are handed back as dropped. Reads use
+ * pread so the threads share one descriptor, Windows falls back to a stream
+ * per thread.
+ */
+class AsyncFileReader
+{
+public:
+	struct Request
+	{
+		uint64_t id;        // chosen by the owner, returned with the result
+		uint64_t offset;
+		uint64_t size;
+		float priority;     // larger is read first
+	};
+
+	struct Result
+	{
+		uint64_t id;
+		std::vector<char> data;  // empty when the read failed
+	};
+
+	AsyncFileReader();
+	~AsyncFileReader();
+
+	AsyncFileReader(const AsyncFileReader&) = delete;
+	AsyncFileReader& operator=(const AsyncFileReader&) = delete;
+
+	/*!
+	 * Open the file and start the threads
+	 *
+	 * \param path : file to read from
+	 * \param threadCount : I/O threads, at least 1
+	 * \return : false(bool) if the file can not be opened
+	 */
+	bool open(const std::string& path, unsigned int threadCount);
+
+	/*!
+	 * Stop the threads, queued and finished reads are discarded
+	 *
+	 */
+	void close();
+
+	/*!
+	 * Replace the queued reads
+	 *
+	 * \param requests : new queue in any order, copied and emptied by the call
+	 * \param dropped : receives the ids of queued reads that never started
+	 */
+	void replaceQueue(FrameVector<Request>& requests, FrameVector<uint64_t>& dropped);
+
+	/*!
+	 * Move the finished reads out
+	 *
+	 */
+	void takeCompleted(std::vector<Result>& results);
+
+private:
+
+	std::mutex m_Mutex;
+	std::condition_variable m_Wake;
+	std::vector<Request> m_Queue;     // sorted by priority, next read at the back
+	std::vector<Result> m_Completed;
+	std::vector<std::thread> m_Threads;
+	std::string m_Path;
+	int m_File;
+	bool m_Stop;
+
+	void IoLoop();
+	bool ReadRange(uint64_t offset, uint64_t size, char* destination, std::ifstream* fallback);
+};
+#endif
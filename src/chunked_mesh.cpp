@@ -0,0 +1,545 @@
+#include "chunked_mesh.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+#include "job_system.h"
+#include "mesh_cache.h"
+#include "mesh_io.h"
+
+namespace
+{
+	const size_t BATCH_CHUNKS = 64;
+	// vertices this close in the temporary file are read with their neighbours in one go
+	const uint64_t MAX_READ_GAP = 256;
+
+	struct ChunkGeometry
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> normals;
+		std::vector<unsigned int> indices;
+	};
+
+	struct BuiltChunk
+	{
+		ChunkedMesh::ChunkRecord record;
+		std::vector<char> blobs[ChunkedMesh::MAX_LODS];
+	};
+
+	glm::vec3 TriangleCentroid(const Mesh& mesh, unsigned int triangle)
+	{
+		return (mesh.positions[mesh.indices[triangle * 3]] +
+			mesh.positions[mesh.indices[triangle * 3 + 1]] +
+			mesh.positions[mesh.indices[triangle * 3 + 2]]) / 3.0f;
+	}
+
+	/*!
+	 * Median split on the longest axis until ranges are small enough
+	 *
+	 */
+	void SplitTriangles(const Mesh& mesh, std::vector<unsigned int>& triangles, size_t begin, size_t end,
+		unsigned int trianglesPerChunk, std::vector<std::pair<size_t, size_t>>& ranges)
+	{
+		if (end - begin <= trianglesPerChunk)
+		{
+			ranges.push_back(std::make_pair(begin, end));
+			return;
+		}
+
+		glm::vec3 low(INFINITY), high(-INFINITY);
+		for (size_t i = begin; i < end; ++i)
+		{
+			glm::vec3 centroid = TriangleCentroid(mesh, triangles[i]);
+			low = glm::min(low, centroid);
+			high = glm::max(high, centroid);
+		}
+		glm::vec3 extent = high - low;
+		int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+
+		size_t middle = begin + (end - begin) / 2;
+		std::nth_element(triangles.begin() + begin, triangles.begin() + middle, triangles.begin() + end,
+			[&mesh, axis](unsigned int a, unsigned int b)
+		{
+			return TriangleCentroid(mesh, a)[axis] < TriangleCentroid(mesh, b)[axis];
+		});
+
+		SplitTriangles(mesh, triangles, begin, middle, trianglesPerChunk, ranges);
+		SplitTriangles(mesh, triangles, middle, end, trianglesPerChunk, ranges);
+	}
+
+	/*!
+	 * Copy the triangles of a chunk with indices local to the chunk
+	 *
+	 */
+	void ExtractChunk(const Mesh& mesh, const unsigned int* triangles, size_t count, ChunkGeometry& chunk)
+	{
+		std::unordered_map<unsigned int, unsigned int> remap;
+		remap.reserve(count * 2);
+		chunk.indices.reserve(count * 3);
+		for (size_t t = 0; t < count; ++t)
+		{
+			for (int corner = 0; corner < 3; ++corner)
+			{
+				unsigned int source = mesh.indices[triangles[t] * 3 + corner];
+				auto found = remap.find(source);
+				if (found == remap.end())
+				{
+					found = remap.emplace(source, (unsigned int)chunk.positions.size()).first;
+					chunk.positions.push_back(mesh.positions[source]);
+					chunk.normals.push_back(source < mesh.normals.size() ? mesh.normals[source] : glm::vec3(0.0f, 0.0f, 1.0f));
+				}
+				chunk.indices.push_back(found->second);
+			}
+		}
+	}
+
+	/*!
+	 * Vertex clustering on a grid, one vertex per occupied cell
+	 *
+	 * \return : largest distance between a vertex and its cluster representative
+	 */
+	float Simplify(const ChunkGeometry& source, const glm::vec3& origin, float cellSize, ChunkGeometry& simplified)
+	{
+		std::unordered_map<uint64_t, unsigned int> cells;
+		std::vector<unsigned int> remap(source.positions.size());
+		std::vector<float> weights;
+
+		for (size_t v = 0; v < source.positions.size(); ++v)
+		{
+			glm::vec3 cell = glm::floor((source.positions[v] - origin) / cellSize);
+			uint64_t key = ((uint64_t)(uint32_t)(int)cell.x & 0x1FFFFF) |
+				(((uint64_t)(uint32_t)(int)cell.y & 0x1FFFFF) << 21) |
+				(((uint64_t)(uint32_t)(int)cell.z & 0x1FFFFF) << 42);
+
+			auto found = cells.find(key);
+			if (found == cells.end())
+			{
+				found = cells.emplace(key, (unsigned int)simplified.positions.size()).first;
+				simplified.positions.push_back(glm::vec3(0.0f));
+				simplified.normals.push_back(glm::vec3(0.0f));
+				weights.push_back(0.0f);
+			}
+			unsigned int cluster = found->second;
+			simplified.positions[cluster] += source.positions[v];
+			simplified.normals[cluster] += source.normals[v];
+			weights[cluster] += 1.0f;
+			remap[v] = cluster;
+		}
+
+		for (size_t c = 0; c < simplified.positions.size(); ++c)
+		{
+			simplified.positions[c] /= weights[c];
+			float length = glm::length(simplified.normals[c]);
+			simplified.normals[c] = length > 0.0f ? simplified.normals[c] / length : glm::vec3(0.0f, 0.0f, 1.0f);
+		}
+
+		float error = 0.0f;
+		for (size_t v = 0; v < source.positions.size(); ++v)
+			error = std::max(error, glm::length(source.positions[v] - simplified.positions[remap[v]]));
+
+		// triangles collapsing into a cell disappear
+		for (size_t i = 0; i + 2 < source.indices.size(); i += 3)
+		{
+			unsigned int a = remap[source.indices[i]];
+			unsigned int b = remap[source.indices[i + 1]];
+			unsigned int c = remap[source.indices[i + 2]];
+			if (a == b || b == c || a == c)
+				continue;
+			simplified.indices.push_back(a);
+			simplified.indices.push_back(b);
+			simplified.indices.push_back(c);
+		}
+		return error;
+	}
+
+	void StoreLod(const ChunkGeometry& geometry, std::vector<char>& blob)
+	{
+		size_t vertexBytes = geometry.positions.size() * sizeof(glm::vec3);
+		size_t indexBytes = geometry.indices.size() * sizeof(unsigned int);
+		blob.resize(vertexBytes * 2 + indexBytes);
+		if (vertexBytes > 0)
+		{
+			memcpy(blob.data(), geometry.positions.data(), vertexBytes);
+			memcpy(blob.data() + vertexBytes, geometry.normals.data(), vertexBytes);
+		}
+		if (indexBytes > 0)
+			memcpy(blob.data() + vertexBytes * 2, geometry.indices.data(), indexBytes);
+	}
+
+	void BuildChunk(const Mesh& mesh, const unsigned int* triangles, size_t count,
+		const ChunkedMesh::Options& options, BuiltChunk& built)
+	{
+		ChunkGeometry levels[ChunkedMesh::MAX_LODS];
+		ExtractChunk(mesh, triangles, count, levels[0]);
+
+		ChunkedMesh::ChunkRecord& record = built.record;
+		memset(&record, 0, sizeof(record));
+		record.boundsMin = glm::vec3(INFINITY);
+		record.boundsMax = glm::vec3(-INFINITY);
+		for (const glm::vec3& position : levels[0].positions)
+		{
+			record.boundsMin = glm::min(record.boundsMin, position);
+			record.boundsMax = glm::max(record.boundsMax, position);
+		}
+		record.triangleCount = (uint32_t)count;
+
+		unsigned int lodCount = std::max(1u, std::min(options.lodCount, ChunkedMesh::MAX_LODS));
+		float cellSize = glm::length(record.boundsMax - record.boundsMin) * options.firstLodCell;
+		record.lodCount = 1;
+		for (unsigned int lod = 1; lod < lodCount && cellSize > 0.0f; ++lod, cellSize *= 2.0f)
+		{
+			// always simplify the full resolution chunk so errors do not accumulate
+			float error = Simplify(levels[0], record.boundsMin, cellSize, levels[lod]);
+			if (levels[lod].indices.empty())
+				break;
+			record.lods[lod].error = error;
+			record.lodCount = lod + 1;
+		}
+
+		for (unsigned int lod = 0; lod < record.lodCount; ++lod)
+		{
+			record.lods[lod].vertexCount = (uint32_t)levels[lod].positions.size();
+			record.lods[lod].indexCount = (uint32_t)levels[lod].indices.size();
+			StoreLod(levels[lod], built.blobs[lod]);
+		}
+	}
+
+	/*!
+	 * Split a mesh into chunks and append their levels to the open TAG_CHUNK_DATA section
+	 *
+	 * \param dataOffset : size of the section so far, advanced by the levels written
+	 */
+	void WriteChunks(const Mesh& mesh, const ChunkedMesh::Options& options, MeshCacheWriter& writer,
+		std::vector<ChunkedMesh::ChunkRecord>& table, uint64_t& dataOffset)
+	{
+		size_t triangleCount = mesh.indices.size() / 3;
+		std::vector<unsigned int> triangles(triangleCount);
+		for (size_t t = 0; t < triangleCount; ++t)
+			triangles[t] = (unsigned int)t;
+
+		std::vector<std::pair<size_t, size_t>> ranges;
+		if (triangleCount > 0)
+			SplitTriangles(mesh, triangles, 0, triangleCount, std::max(1u, options.trianglesPerChunk), ranges);
+
+		JobSystem& jobs = JobSystem::instance();
+		std::vector<BuiltChunk> batch;
+		for (size_t first = 0; first < ranges.size(); first += BATCH_CHUNKS)
+		{
+			size_t count = std::min(BATCH_CHUNKS, ranges.size() - first);
+			batch.clear();
+			batch.resize(count);
+			jobs.parallelFor(count, 1, [&](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; ++i)
+				{
+					const std::pair<size_t, size_t>& range = ranges[first + i];
+					BuildChunk(mesh, triangles.data() + range.first, range.second - range.first, options, batch[i]);
+				}
+			});
+
+			for (BuiltChunk& built : batch)
+			{
+				for (unsigned int lod = 0; lod < built.record.lodCount; ++lod)
+				{
+					built.record.lods[lod].offset = dataOffset;
+					writer.appendSection(built.blobs[lod].data(), built.blobs[lod].size());
+					dataOffset += built.blobs[lod].size();
+				}
+				table.push_back(built.record);
+			}
+		}
+	}
+
+	struct SoupTriangle
+	{
+		glm::vec3 corners[3];
+	};
+
+	unsigned int GridCell(const glm::vec3& position, const glm::vec3& boundsMin, float size, unsigned int resolution)
+	{
+		glm::vec3 cell = (position - boundsMin) / size * (float)resolution;
+		unsigned int x = (unsigned int)glm::clamp((int)cell.x, 0, (int)resolution - 1);
+		unsigned int y = (unsigned int)glm::clamp((int)cell.y, 0, (int)resolution - 1);
+		unsigned int z = (unsigned int)glm::clamp((int)cell.z, 0, (int)resolution - 1);
+		return (z * resolution + y) * resolution + x;
+	}
+
+	/*!
+	 * Corners of a batch of triangles from the temporary vertex file
+	 *
+	 * The used indices are sorted and read in runs, neighbouring vertices
+	 * come with one read.
+	 *
+	 * \param triangles : three vertex indices per triangle
+	 * \param used : scratch, sorted used indices
+	 * \param positions : scratch, positions of the used indices
+	 * \param run : scratch, vertices of one read
+	 * \param soup : filled with one SoupTriangle per triangle
+	 * \return : false(bool) on read failure
+	 */
+	bool GatherCorners(std::ifstream& vertices, const std::vector<uint64_t>& triangles, std::vector<uint64_t>& used,
+		std::vector<glm::vec3>& positions, std::vector<glm::vec3>& run, std::vector<SoupTriangle>& soup)
+	{
+		used.assign(triangles.begin(), triangles.end());
+		std::sort(used.begin(), used.end());
+		used.erase(std::unique(used.begin(), used.end()), used.end());
+
+		positions.resize(used.size());
+		for (size_t first = 0; first < used.size();)
+		{
+			size_t last = first;
+			while (last + 1 < used.size() && used[last + 1] - used[last] <= MAX_READ_GAP)
+				++last;
+
+			run.resize((size_t)(used[last] - used[first] + 1));
+			vertices.seekg((std::streamoff)(used[first] * sizeof(glm::vec3)));
+			vertices.read((char*)run.data(), (std::streamsize)(run.size() * sizeof(glm::vec3)));
+			if (!vertices)
+				return false;
+			for (size_t i = first; i <= last; ++i)
+				positions[i] = run[(size_t)(used[i] - used[first])];
+			first = last + 1;
+		}
+
+		soup.resize(triangles.size() / 3);
+		for (size_t i = 0; i < triangles.size(); ++i)
+		{
+			size_t found = std::lower_bound(used.begin(), used.end(), triangles[i]) - used.begin();
+			soup[i / 3].corners[i % 3] = positions[found];
+		}
+		return true;
+	}
+}
+
+
+bool ChunkedMesh::Build(const Mesh& mesh, const std::string& path, const Options& options)
+{
+	MeshCacheWriter writer;
+	if (!writer.open(path))
+		return false;
+
+	std::vector<ChunkRecord> table;
+	uint64_t dataOffset = 0;
+	writer.beginSection(MeshCache::TAG_CHUNK_DATA);
+	WriteChunks(mesh, options, writer, table, dataOffset);
+	writer.endSection();
+	writer.addSection(MeshCache::TAG_CHUNK_TABLE, table.data(), table.size() * sizeof(ChunkRecord));
+
+	if (!writer.close())
+		return false;
+
+	std::cout << "CHUNKED MESH::" << table.size() << " CHUNKS, " << dataOffset / (1024 * 1024) << " MB WRITTEN TO " << path << std::endl;
+	return true;
+}
+
+
+bool ChunkedMesh::BuildFromFile(const std::string& input, const std::string& output, const Options& options)
+{
+	auto start = std::chrono::steady_clock::now();
+	ObjReader reader;
+	if (!reader.open(input))
+		return false;
+	size_t batchTriangles = std::max<size_t>(1, options.batchTriangles);
+
+	// pass 1 : vertices to a temporary file, bounds
+	std::string vertexPath = output + ".vertices.tmp";
+	std::string soupPath = output + ".soup.tmp";
+	std::string cellPath = output + ".cells.tmp";
+	auto removeTemporaries = [&]()
+	{
+		std::remove(vertexPath.c_str());
+		std::remove(soupPath.c_str());
+		std::remove(cellPath.c_str());
+	};
+
+	std::vector<glm::vec3> positions;
+	std::vector<uint64_t> triangles;
+	glm::vec3 low(INFINITY), high(-INFINITY);
+	uint64_t triangleCount = 0;
+	{
+		std::ofstream vertices(vertexPath, std::ios::binary | std::ios::trunc);
+		if (!vertices.is_open())
+		{
+			std::cout << "ERROR::CHUNKED MESH::UNABLE TO CREATE FILE: " << vertexPath << std::endl;
+			return false;
+		}
+		while (reader.read(positions, triangles, batchTriangles))
+		{
+			for (const glm::vec3& position : positions)
+			{
+				low = glm::min(low, position);
+				high = glm::max(high, position);
+			}
+			vertices.write((const char*)positions.data(), (std::streamsize)(positions.size() * sizeof(glm::vec3)));
+			triangleCount += triangles.size() / 3;
+		}
+		if (!vertices.good())
+		{
+			std::cout << "ERROR::CHUNKED MESH::FAILED TO WRITE FILE: " << vertexPath << std::endl;
+			removeTemporaries();
+			return false;
+		}
+	}
+	if (triangleCount == 0)
+	{
+		std::cout << "ERROR::CHUNKED MESH::NO TRIANGLES IN: " << input << std::endl;
+		removeTemporaries();
+		return false;
+	}
+	glm::vec3 extent = high - low;
+	float size = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f)) * 1.0001f;
+	unsigned int resolution = 1u << std::min(options.gridLevels, 8u);
+	size_t cellCount = (size_t)resolution * resolution * resolution;
+
+	// pass 2 : triangles with their corners in file order, triangles per cell of their centroid
+	std::vector<uint64_t> cellStart(cellCount + 1, 0);
+	std::vector<uint64_t> used;
+	std::vector<glm::vec3> gathered, run;
+	std::vector<SoupTriangle> soup;
+	{
+		std::ifstream vertices(vertexPath, std::ios::binary);
+		std::ofstream soupFile(soupPath, std::ios::binary | std::ios::trunc);
+		if (!soupFile.is_open())
+		{
+			std::cout << "ERROR::CHUNKED MESH::UNABLE TO CREATE FILE: " << soupPath << std::endl;
+			removeTemporaries();
+			return false;
+		}
+		reader.rewind();
+		while (reader.read(positions, triangles, batchTriangles))
+		{
+			if (!GatherCorners(vertices, triangles, used, gathered, run, soup))
+			{
+				std::cout << "ERROR::CHUNKED MESH::FAILED TO READ FILE: " << vertexPath << std::endl;
+				removeTemporaries();
+				return false;
+			}
+			for (const SoupTriangle& triangle : soup)
+			{
+				glm::vec3 centroid = (triangle.corners[0] + triangle.corners[1] + triangle.corners[2]) / 3.0f;
+				++cellStart[GridCell(centroid, low, size, resolution) + 1];
+			}
+			soupFile.write((const char*)soup.data(), (std::streamsize)(soup.size() * sizeof(SoupTriangle)));
+		}
+		if (!soupFile.good())
+		{
+			std::cout << "ERROR::CHUNKED MESH::FAILED TO WRITE FILE: " << soupPath << std::endl;
+			removeTemporaries();
+			return false;
+		}
+	}
+	std::remove(vertexPath.c_str());
+	for (size_t cell = 0; cell < cellCount; ++cell)
+		cellStart[cell + 1] += cellStart[cell];
+
+	// pass 3 : partition the triangles, each cell contiguous
+	{
+		std::ifstream soupFile(soupPath, std::ios::binary);
+		std::ofstream cells(cellPath, std::ios::binary | std::ios::trunc);
+		if (!cells.is_open())
+		{
+			std::cout << "ERROR::CHUNKED MESH::UNABLE TO CREATE FILE: " << cellPath << std::endl;
+			removeTemporaries();
+			return false;
+		}
+
+		std::vector<uint64_t> cursor(cellStart.begin(), cellStart.end() - 1);
+		std::vector<unsigned int> cellOf;
+		std::vector<SoupTriangle> sorted;
+		std::vector<uint32_t> batchStart(cellCount + 1);
+		soup.resize(batchTriangles);
+		while (soupFile.read((char*)soup.data(), (std::streamsize)(soup.size() * sizeof(SoupTriangle))) || soupFile.gcount() > 0)
+		{
+			size_t count = (size_t)soupFile.gcount() / sizeof(SoupTriangle);
+
+			// counting sort of the batch so each cell is written with one seek
+			cellOf.resize(count);
+			std::fill(batchStart.begin(), batchStart.end(), 0);
+			for (size_t i = 0; i < count; ++i)
+			{
+				const SoupTriangle& triangle = soup[i];
+				cellOf[i] = GridCell((triangle.corners[0] + triangle.corners[1] + triangle.corners[2]) / 3.0f, low, size, resolution);
+				++batchStart[cellOf[i] + 1];
+			}
+			for (size_t cell = 0; cell < cellCount; ++cell)
+				batchStart[cell + 1] += batchStart[cell];
+
+			sorted.resize(count);
+			std::vector<uint32_t> fill(batchStart.begin(), batchStart.end() - 1);
+			for (size_t i = 0; i < count; ++i)
+				sorted[fill[cellOf[i]]++] = soup[i];
+
+			for (size_t cell = 0; cell < cellCount; ++cell)
+			{
+				uint32_t cellTriangles = batchStart[cell + 1] - batchStart[cell];
+				if (cellTriangles == 0)
+					continue;
+				cells.seekp((std::streamoff)(cursor[cell] * sizeof(SoupTriangle)));
+				cells.write((const char*)(sorted.data() + batchStart[cell]), cellTriangles * sizeof(SoupTriangle));
+				cursor[cell] += cellTriangles;
+			}
+		}
+		if (!cells.good())
+		{
+			std::cout << "ERROR::CHUNKED MESH::FAILED TO WRITE FILE: " << cellPath << std::endl;
+			removeTemporaries();
+			return false;
+		}
+	}
+	std::remove(soupPath.c_str());
+
+	// cells welded and chunked one at a time
+	MeshCacheWriter writer;
+	if (!writer.open(output))
+	{
+		removeTemporaries();
+		return false;
+	}
+	std::vector<ChunkRecord> table;
+	uint64_t dataOffset = 0;
+	writer.beginSection(MeshCache::TAG_CHUNK_DATA);
+
+	std::ifstream cells(cellPath, std::ios::binary);
+	Mesh mesh;
+	for (size_t cell = 0; cell < cellCount; ++cell)
+	{
+		uint64_t cellTriangles = cellStart[cell + 1] - cellStart[cell];
+		if (cellTriangles == 0)
+			continue;
+
+		soup.resize((size_t)cellTriangles);
+		cells.seekg((std::streamoff)(cellStart[cell] * sizeof(SoupTriangle)));
+		cells.read((char*)soup.data(), (std::streamsize)(soup.size() * sizeof(SoupTriangle)));
+		if (!cells)
+		{
+			std::cout << "ERROR::CHUNKED MESH::FAILED TO READ FILE: " << cellPath << std::endl;
+			writer.close();
+			removeTemporaries();
+			return false;
+		}
+
+		mesh.positions.assign(&soup.front().corners[0], &soup.front().corners[0] + soup.size() * 3);
+		mesh.normals.clear();
+		mesh.indices.clear();
+		WeldVertices(mesh);
+		ComputeNormals(mesh);
+		WriteChunks(mesh, options, writer, table, dataOffset);
+	}
+	cells.close();
+	std::remove(cellPath.c_str());
+
+	writer.endSection();
+	writer.addSection(MeshCache::TAG_CHUNK_TABLE, table.data(), table.size() * sizeof(ChunkRecord));
+	if (!writer.close())
+		return false;
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "CHUNKED MESH::" << triangleCount << " TRIANGLES, " << table.size() << " CHUNKS, "
+		<< dataOffset / (1024 * 1024) << " MB WRITTEN TO " << output << " IN " << seconds << " s" << std::endl;
+	return true;
+}
@@ -0,0 +1,90 @@
+#ifndef CHUNKED_MESH_H
+#define CHUNKED_MESH_H
+
+#include <cstdint>
+#include <string>
+#include <glm.hpp>
+#include "mesh.h"
+
+/*!
+ * Spatially chunked cache layout used for out of core streaming
+ *
+ * The mesh is split into chunks of neighbouring triangles, each chunk is
+ * stored at several levels of detail in the TAG_CHUNK_DATA section and
+ * described by a ChunkRecord in the TAG_CHUNK_TABLE section. A level is one
+ * contiguous blob: positions, normals, then indices local to the chunk, so
+ * it can be read with a single pread and uploaded as is.
+ */
+namespace ChunkedMesh
+{
+	const unsigned int MAX_LODS = 4;
+
+	struct ChunkLod
+	{
+		uint64_t offset;        // from the start of the TAG_CHUNK_DATA payload
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		float error;            // largest vertex displacement against level 0
+		uint32_t padding;
+	};
+
+	struct ChunkRecord
+	{
+		glm::vec3 boundsMin;
+		uint32_t lodCount;
+		glm::vec3 boundsMax;
+		uint32_t triangleCount; // at level 0
+		ChunkLod lods[MAX_LODS];
+	};
+
+	/*!
+	 * Byte size of a level blob
+	 *
+	 */
+	inline uint64_t LodBytes(const ChunkLod& lod)
+	{
+		return (uint64_t)lod.vertexCount * 2 * sizeof(glm::vec3) + (uint64_t)lod.indexCount * sizeof(unsigned int);
+	}
+
+	struct Options
+	{
+		unsigned int trianglesPerChunk = 65536;
+		unsigned int lodCount = MAX_LODS;
+		// vertex clustering cell of level 1 relative to the chunk diagonal, doubled per level
+		float firstLodCell = 1.0f / 128.0f;
+		// BuildFromFile: the bounds are split in (2^gridLevels)^3 cells welded and chunked in memory one at a time
+		unsigned int gridLevels = 3;
+		size_t batchTriangles = 1 << 20;
+	};
+
+	/*!
+	 * Split a mesh into chunks with levels of detail and write a streaming cache
+	 *
+	 * Chunks are built in parallel on the job system and written in batches,
+	 * so only a batch of chunk blobs is held in memory besides the source mesh.
+	 *
+	 * \param mesh : source mesh, triangle list
+	 * \param path : path of the cache file
+	 * \param options : chunk size and levels
+	 * \return : false(bool) on write failure
+	 */
+	bool Build(const Mesh& mesh, const std::string& path, const Options& options = Options());
+
+	/*!
+	 * Write the streaming cache of a mesh file out of core
+	 *
+	 * The input is read twice in batches: vertices go to a temporary file,
+	 * then the triangles get their corners from it, sorted by index so the
+	 * reads follow the file, and are partitioned by grid cell into a second
+	 * temporary file. Each cell is then welded and chunked like Build does,
+	 * so memory holds one cell and a batch of chunk blobs. Normals are
+	 * computed per cell, vertices on cell borders are not shared across them.
+	 *
+	 * \param input : .obj file read with ObjReader
+	 * \param output : path of the cache file, .tmp files are used next to it
+	 * \param options : chunk size, levels, grid and batch sizes
+	 * \return : false(bool) if the input can not be read or the output written
+	 */
+	bool BuildFromFile(const std::string& input, const std::string& output, const Options& options = Options());
+}
+#endif
@@ -0,0 +1,376 @@
+#include "clustered_lighting.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <gtc/matrix_transform.hpp>
+#include "gl_state_cache.h"
+#include "job_system.h"
+
+
+ClusteredLighting::ClusteredLighting()
+	: ClusteredLighting(Options())
+{
+}
+
+ClusteredLighting::ClusteredLighting(const Options& options)
+	: m_Options(options), m_FovY(0.0f), m_Aspect(0.0f), m_Near(0.0f), m_Far(0.0f), m_SliceFar(0.0f), m_Viewport(0), m_TileSize(1.0f), m_LightsDirty(true)
+{
+	m_Options.grid = glm::max(m_Options.grid, glm::uvec3(1));
+	m_Options.maxClusterLights = std::max(m_Options.maxClusterLights, 1u);
+	unsigned int clusters = m_Options.grid.x * m_Options.grid.y * m_Options.grid.z;
+	m_Boxes.resize(clusters);
+	m_SliceLights.resize(m_Options.grid.z);
+	m_Scratch.resize((size_t)clusters * m_Options.maxClusterLights);
+	m_Counts.resize(clusters);
+	m_Clusters.resize(clusters);
+	m_Stats.clusters = clusters;
+
+	GpuResources& resources = GpuResources::instance();
+	m_LightBuffer = resources.createBuffer(GL_SHADER_STORAGE_BUFFER, sizeof(Light), nullptr, GL_DYNAMIC_DRAW);
+	m_ClusterBuffer = resources.createBuffer(GL_SHADER_STORAGE_BUFFER, clusters * sizeof(glm::uvec2), nullptr, GL_STREAM_DRAW);
+	m_IndexBuffer = resources.createBuffer(GL_SHADER_STORAGE_BUFFER, sizeof(uint32_t), nullptr, GL_STREAM_DRAW);
+}
+
+ClusteredLighting::~ClusteredLighting()
+{
+	GpuResources& resources = GpuResources::instance();
+	resources.release(m_LightBuffer);
+	resources.release(m_ClusterBuffer);
+	resources.release(m_IndexBuffer);
+}
+
+
+void ClusteredLighting::setLights(const std::vector<Light>& lights)
+{
+	m_Lights = lights;
+	m_LightsDirty = true;
+}
+
+
+std::vector<Light>& ClusteredLighting::lights()
+{
+	m_LightsDirty = true;
+	return m_Lights;
+}
+
+
+void ClusteredLighting::update(const glm::mat4& view, float fovY, float aspect, float nearPlane, float farPlane, const glm::uvec2& viewport,
+	LinearArena& arena)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (fovY != m_FovY || aspect != m_Aspect || nearPlane != m_Near || farPlane != m_Far || viewport != m_Viewport)
+	{
+		m_FovY = fovY;
+		m_Aspect = aspect;
+		m_Near = nearPlane;
+		m_Far = farPlane;
+		m_SliceFar = m_Options.sliceFar > nearPlane ? std::min(m_Options.sliceFar, farPlane) : farPlane;
+		m_Viewport = glm::max(viewport, glm::uvec2(1));
+		BuildClusterBoxes();
+	}
+
+	// lights to view space with the froxel range of their bounding sphere
+	m_Bounds.resize(m_Lights.size());
+	JobSystem& jobs = JobSystem::instance();
+	jobs.parallelFor(m_Lights.size(), 256, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			const Light& light = m_Lights[i];
+			LightBounds& bounds = m_Bounds[i];
+			bounds.position = glm::vec3(view * glm::vec4(light.position, 1.0f));
+			bounds.range = light.range;
+			bounds.direction = glm::vec3(view * glm::vec4(light.direction, 0.0f));
+			bool spot = light.spotCosOuter > -1.0f;
+			bounds.spotCos = spot ? light.spotCosOuter : -1.0f;
+			bounds.spotSin = spot ? std::sqrt(std::max(0.0f, 1.0f - light.spotCosOuter * light.spotCosOuter)) : 0.0f;
+			ComputeBounds(bounds);
+		}
+	});
+
+	for (std::vector<uint32_t>& slice : m_SliceLights)
+		slice.clear();
+	m_Stats.visibleLights = 0;
+	for (uint32_t i = 0; i < (uint32_t)m_Bounds.size(); ++i)
+	{
+		if (!m_Bounds[i].visible)
+			continue;
+		++m_Stats.visibleLights;
+		for (unsigned int z = m_Bounds[i].first.z; z <= m_Bounds[i].last.z; ++z)
+			m_SliceLights[z].push_back(i);
+	}
+
+	// one job per depth slice, every slice owns the scratch lists of its froxels
+	std::atomic<unsigned int> overflows(0);
+	glm::uvec3 grid = m_Options.grid;
+	unsigned int capacity = m_Options.maxClusterLights;
+	jobs.parallelFor(grid.z, 1, [&](size_t begin, size_t end)
+	{
+		for (size_t z = begin; z < end; ++z)
+		{
+			unsigned int sliceFirst = (unsigned int)z * grid.x * grid.y;
+			std::fill(m_Counts.begin() + sliceFirst, m_Counts.begin() + sliceFirst + grid.x * grid.y, 0u);
+			unsigned int dropped = 0;
+			for (uint32_t index : m_SliceLights[z])
+			{
+				const LightBounds& bounds = m_Bounds[index];
+				for (unsigned int y = bounds.first.y; y <= bounds.last.y; ++y)
+				{
+					for (unsigned int x = bounds.first.x; x <= bounds.last.x; ++x)
+					{
+						unsigned int cluster = sliceFirst + y * grid.x + x;
+						const ClusterBox& box = m_Boxes[cluster];
+						glm::vec3 closest = glm::clamp(bounds.position, box.boundsMin, box.boundsMax);
+						glm::vec3 offset = closest - bounds.position;
+						if (glm::dot(offset, offset) > bounds.range * bounds.range)
+							continue;
+
+						if (bounds.spotSin > 0.0f)
+						{
+							// cone against the bounding sphere of the froxel
+							glm::vec3 center = (box.boundsMin + box.boundsMax) * 0.5f;
+							float radius = glm::length(box.boundsMax - box.boundsMin) * 0.5f;
+							glm::vec3 toCenter = center - bounds.position;
+							float along = glm::dot(toCenter, bounds.direction);
+							float across = std::sqrt(std::max(0.0f, glm::dot(toCenter, toCenter) - along * along));
+							if (bounds.spotCos * across - along * bounds.spotSin > radius || along < -radius)
+								continue;
+						}
+
+						uint32_t& count = m_Counts[cluster];
+						if (count < capacity)
+							m_Scratch[(size_t)cluster * capacity + count++] = index;
+						else
+							++dropped;
+					}
+				}
+			}
+			overflows += dropped;
+		}
+	});
+
+	// compact the lists into one index buffer, it only lives until the upload
+	size_t indexCount = 0;
+	for (uint32_t count : m_Counts)
+		indexCount += count;
+	uint32_t* indices = arena.allocateArray<uint32_t>(std::max<size_t>(indexCount, 1));
+	indices[0] = 0;
+	size_t offset = 0;
+	m_Stats.occupiedClusters = 0;
+	m_Stats.maxClusterLights = 0;
+	for (size_t cluster = 0; cluster < m_Clusters.size(); ++cluster)
+	{
+		uint32_t count = m_Counts[cluster];
+		m_Clusters[cluster] = glm::uvec2((unsigned int)offset, count);
+		std::copy(m_Scratch.data() + cluster * capacity, m_Scratch.data() + cluster * capacity + count, indices + offset);
+		offset += count;
+		m_Stats.occupiedClusters += count > 0 ? 1 : 0;
+		m_Stats.maxClusterLights = std::max(m_Stats.maxClusterLights, count);
+	}
+	m_Stats.lights = (unsigned int)m_Lights.size();
+	m_Stats.lightIndices = indexCount;
+	m_Stats.overflows = overflows;
+
+	GpuResources& resources = GpuResources::instance();
+	if (m_LightsDirty)
+	{
+		resources.setBufferData(m_LightBuffer, GL_SHADER_STORAGE_BUFFER, std::max<size_t>(m_Lights.size(), 1) * sizeof(Light),
+			m_Lights.empty() ? nullptr : m_Lights.data(), GL_DYNAMIC_DRAW);
+		m_LightsDirty = false;
+	}
+	resources.setBufferData(m_ClusterBuffer, GL_SHADER_STORAGE_BUFFER, m_Clusters.size() * sizeof(glm::uvec2), m_Clusters.data(), GL_STREAM_DRAW);
+	resources.setBufferData(m_IndexBuffer, GL_SHADER_STORAGE_BUFFER, std::max<size_t>(indexCount, 1) * sizeof(uint32_t), indices, GL_STREAM_DRAW);
+
+	m_Stats.assignMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+void ClusteredLighting::bind(Shader& shader) const
+{
+	GpuResources& resources = GpuResources::instance();
+	GLStateCache& state = GLStateCache::instance();
+	state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_BINDING, resources.name(m_LightBuffer));
+	state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_BINDING, resources.name(m_ClusterBuffer));
+	state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, INDEX_BINDING, resources.name(m_IndexBuffer));
+
+	// slice = log(depth) * scale - bias, the inverse of the exponential split of BuildClusterBoxes
+	float logRatio = std::log(m_SliceFar / m_Near);
+	shader.setVec3("clusterGrid", glm::vec3(m_Options.grid));
+	shader.setVec2("clusterTileSize", m_TileSize);
+	shader.setFloat("clusterSliceScale", (float)m_Options.grid.z / logRatio);
+	shader.setFloat("clusterSliceBias", (float)m_Options.grid.z * std::log(m_Near) / logRatio);
+}
+
+
+const ClusteredLightingStats& ClusteredLighting::stats() const
+{
+	return m_Stats;
+}
+
+
+void ClusteredLighting::reportTo(Profiler& profiler) const
+{
+	profiler.addCounter("LIGHTS VISIBLE", m_Stats.visibleLights);
+	profiler.addCounter("LIGHT CLUSTERS OCCUPIED", m_Stats.occupiedClusters);
+	profiler.addCounter("LIGHT CLUSTER MAX LIGHTS", m_Stats.maxClusterLights);
+	profiler.addCounter("LIGHT CLUSTER OVERFLOWS", m_Stats.overflows);
+	profiler.addCounter("LIGHT ASSIGN MS", m_Stats.assignMs);
+}
+
+
+void ClusteredLighting::BuildClusterBoxes()
+{
+	glm::uvec3 grid = m_Options.grid;
+	m_TileSize = glm::ceil(glm::vec2(m_Viewport) / glm::vec2(grid.x, grid.y));
+	float tanY = std::tan(m_FovY * 0.5f);
+	float tanX = tanY * m_Aspect;
+
+	for (unsigned int z = 0; z < grid.z; ++z)
+	{
+		float depthNear = m_Near * std::pow(m_SliceFar / m_Near, (float)z / grid.z);
+		float depthFar = z + 1 < grid.z ? m_Near * std::pow(m_SliceFar / m_Near, (float)(z + 1) / grid.z) : m_Far;
+		for (unsigned int y = 0; y < grid.y; ++y)
+		{
+			for (unsigned int x = 0; x < grid.x; ++x)
+			{
+				glm::vec2 ndcMin = glm::vec2(x, y) * m_TileSize / glm::vec2(m_Viewport) * 2.0f - 1.0f;
+				glm::vec2 ndcMax = glm::vec2(x + 1, y + 1) * m_TileSize / glm::vec2(m_Viewport) * 2.0f - 1.0f;
+				ClusterBox& box = m_Boxes[(z * grid.y + y) * grid.x + x];
+				box.boundsMin = glm::vec3(INFINITY);
+				box.boundsMax = glm::vec3(-INFINITY);
+				for (float depth : { depthNear, depthFar })
+				{
+					for (int corner = 0; corner < 4; ++corner)
+					{
+						glm::vec2 ndc((corner & 1) ? ndcMax.x : ndcMin.x, (corner & 2) ? ndcMax.y : ndcMin.y);
+						glm::vec3 point(ndc.x * tanX * depth, ndc.y * tanY * depth, -depth);
+						box.boundsMin = glm::min(box.boundsMin, point);
+						box.boundsMax = glm::max(box.boundsMax, point);
+					}
+				}
+			}
+		}
+	}
+}
+
+
+void ClusteredLighting::ComputeBounds(LightBounds& bounds) const
+{
+	glm::uvec3 grid = m_Options.grid;
+	float depth = -bounds.position.z;
+	float depthMin = depth - bounds.range;
+	float depthMax = depth + bounds.range;
+	bounds.visible = depthMax > m_Near && depthMin < m_Far ? 1 : 0;
+	if (!bounds.visible)
+		return;
+
+	// corners of the bounding box, pulled onto the near plane when in front of it
+	float tanY = std::tan(m_FovY * 0.5f);
+	float tanX = tanY * m_Aspect;
+	glm::vec2 ndcMin(INFINITY), ndcMax(-INFINITY);
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		glm::vec3 point = bounds.position + bounds.range * glm::vec3((corner & 1) ? 1.0f : -1.0f, (corner & 2) ? 1.0f : -1.0f, (corner & 4) ? 1.0f : -1.0f);
+		float pointDepth = std::max(-point.z, m_Near);
+		glm::vec2 ndc(point.x / (pointDepth * tanX), point.y / (pointDepth * tanY));
+		ndcMin = glm::min(ndcMin, ndc);
+		ndcMax = glm::max(ndcMax, ndc);
+	}
+	if (ndcMax.x < -1.0f || ndcMax.y < -1.0f || ndcMin.x > 1.0f || ndcMin.y > 1.0f)
+	{
+		bounds.visible = 0;
+		return;
+	}
+
+	glm::vec2 pixelMin = (glm::clamp(ndcMin, -1.0f, 1.0f) * 0.5f + 0.5f) * glm::vec2(m_Viewport);
+	glm::vec2 pixelMax = (glm::clamp(ndcMax, -1.0f, 1.0f) * 0.5f + 0.5f) * glm::vec2(m_Viewport);
+	glm::uvec2 tileMin = glm::min(glm::uvec2(pixelMin / m_TileSize), glm::uvec2(grid.x - 1, grid.y - 1));
+	glm::uvec2 tileMax = glm::min(glm::uvec2(pixelMax / m_TileSize), glm::uvec2(grid.x - 1, grid.y - 1));
+	bounds.first = glm::uvec3(tileMin, Slice(std::max(depthMin, m_Near)));
+	bounds.last = glm::uvec3(tileMax, Slice(std::min(depthMax, m_Far)));
+}
+
+
+unsigned int ClusteredLighting::Slice(float depth) const
+{
+	float slice = std::log(std::max(depth, m_Near) / m_Near) / std::log(m_SliceFar / m_Near) * m_Options.grid.z;
+	return std::min((unsigned int)std::max(slice, 0.0f), m_Options.grid.z - 1);
+}
+
+
+std::vector<Light> LightBenchmark::GenerateLights(unsigned int count, float spotFraction, const glm::vec3& boundsMin,
+	const glm::vec3& boundsMax, float minRange, float maxRange, unsigned int seed)
+{
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<Light> lights(count);
+	for (Light& light : lights)
+	{
+		light.position = boundsMin + (boundsMax - boundsMin) * glm::vec3(unit(random), unit(random), unit(random));
+		light.range = minRange + (maxRange - minRange) * unit(random);
+
+		// saturated colors, one channel low
+		glm::vec3 color(unit(random), unit(random), unit(random));
+		color[random() % 3] *= 0.2f;
+		light.color = color / std::max(std::max(color.r, color.g), std::max(color.b, 1e-3f));
+
+		light.direction = glm::vec3(0.0f, -1.0f, 0.0f);
+		light.spotCosInner = -1.0f;
+		light.spotCosOuter = -1.0f;
+		if (unit(random) < spotFraction)
+		{
+			float outer = glm::radians(20.0f + 30.0f * unit(random));
+			light.direction = glm::normalize(glm::vec3(unit(random) - 0.5f, -1.0f, unit(random) - 0.5f));
+			light.spotCosOuter = std::cos(outer);
+			light.spotCosInner = std::cos(outer * 0.7f);
+		}
+	}
+	return lights;
+}
+
+
+void LightBenchmark::MakeCube(Mesh& mesh)
+{
+	mesh = Mesh();
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		for (float side : { -1.0f, 1.0f })
+		{
+			glm::vec3 normal(0.0f);
+			normal[axis] = side;
+			glm::vec3 u(0.0f), v(0.0f);
+			u[(axis + 1) % 3] = 0.5f;
+			v[(axis + 2) % 3] = 0.5f * side;
+
+			// u x v points along the normal, the quad is counter clock wise seen from outside
+			unsigned int first = (unsigned int)mesh.positions.size();
+			glm::vec3 center = normal * 0.5f;
+			mesh.positions.insert(mesh.positions.end(), { center - u - v, center + u - v, center + u + v, center - u + v });
+			mesh.normals.insert(mesh.normals.end(), 4, normal);
+			mesh.indices.insert(mesh.indices.end(), { first, first + 1, first + 2, first, first + 2, first + 3 });
+		}
+	}
+}
+
+
+std::vector<glm::mat4> LightBenchmark::GenerateBoxes(unsigned int countPerAxis, float size, unsigned int seed)
+{
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> height(0.05f, 1.0f);
+	std::vector<glm::mat4> boxes;
+	boxes.reserve((size_t)countPerAxis * countPerAxis);
+	float cell = size / std::max(countPerAxis, 1u);
+	for (unsigned int z = 0; z < countPerAxis; ++z)
+	{
+		for (unsigned int x = 0; x < countPerAxis; ++x)
+		{
+			float boxHeight = height(random) * cell * 3.0f;
+			glm::vec3 center(-0.5f * size + (x + 0.5f) * cell, 0.5f * boxHeight, -0.5f * size + (z + 0.5f) * cell);
+			glm::mat4 model = glm::translate(glm::mat4(1.0f), center);
+			boxes.push_back(glm::scale(model, glm::vec3(cell * 0.8f, boxHeight, cell * 0.8f)));
+		}
+	}
+	return boxes;
+}
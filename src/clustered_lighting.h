@@ -0,0 +1,202 @@
+#ifndef CLUSTERED_LIGHTING_H
+#define CLUSTERED_LIGHTING_H
+
+#include <cstdint>
+#include <vector>
+#include <glm.hpp>
+#include "frame_arena.h"
+#include "gpu_resources.h"
+#include "mesh.h"
+#include "profiler.h"
+#include "shader.h"
+
+/*!
+ * Point or spot light, layout of the Lights buffer of res/clustered_lighting.glsl
+ *
+ * Must match the std430 layout of the shader, do not reorder members.
+ */
+struct Light
+{
+	glm::vec3 position;
+	float range;            // no contribution beyond
+	glm::vec3 color;
+	float spotCosInner;     // full intensity inside this cone
+	glm::vec3 direction;    // spot axis, normalized
+	float spotCosOuter;     // -1 for point lights
+};
+
+/*!
+ * Counters of ClusteredLighting
+ *
+ */
+struct ClusteredLightingStats
+{
+	unsigned int lights = 0;
+	unsigned int visibleLights = 0;         // in front of the camera and inside the depth range
+	unsigned int clusters = 0;
+	unsigned int occupiedClusters = 0;
+	unsigned int maxClusterLights = 0;
+	uint64_t lightIndices = 0;              // sum of the list lengths
+	unsigned int overflows = 0;             // lights dropped from full clusters
+	double assignMs = 0.0;
+};
+
+/*!
+ * Clustered forward shading
+ *
+ * The view frustum is split into a grid of froxels, screen tiles along x
+ * and y and exponential slices along the depth. Every frame the lights are
+ * assigned to the froxels they touch on the job system and the lists are
+ * uploaded to shader storage buffers. The fragment shader of the
+ * CLUSTERED_LIGHTS variant of res/fragment.glsl finds its froxel from
+ * gl_FragCoord and its depth and only loops over that list, capped to
+ * maxClusterLights, so the per pixel cost stays bounded with any light count.
+ */
+class ClusteredLighting
+{
+public:
+	// shader storage bindings used by res/clustered_lighting.glsl
+	static const unsigned int LIGHT_BINDING = 2;
+	static const unsigned int CLUSTER_BINDING = 3;
+	static const unsigned int INDEX_BINDING = 4;
+
+	struct Options
+	{
+		glm::uvec3 grid = glm::uvec3(16, 9, 32);
+		unsigned int maxClusterLights = 128;
+		// depth where the exponential slicing stops, the last slice reaches the far plane; 0 for the far plane
+		float sliceFar = 0.0f;
+	};
+
+	ClusteredLighting();
+	explicit ClusteredLighting(const Options& options);
+	~ClusteredLighting();
+
+	ClusteredLighting(const ClusteredLighting&) = delete;
+	ClusteredLighting& operator=(const ClusteredLighting&) = delete;
+
+	/*!
+	 * Replace the lights, in world space
+	 *
+	 */
+	void setLights(const std::vector<Light>& lights);
+
+	std::vector<Light>& lights();
+
+	/*!
+	 * Assign the lights to the froxels and upload the lists, call once per frame
+	 *
+	 * \param view : world to view matrix
+	 * \param fovY : vertical field of view of the projection, radians
+	 * \param aspect : width / height of the projection
+	 * \param nearPlane : near plane distance of the projection
+	 * \param farPlane : far plane distance of the projection
+	 * \param viewport : size of the framebuffer in pixels
+	 * \param arena : frame memory holding the index list until it is uploaded
+	 */
+	void update(const glm::mat4& view, float fovY, float aspect, float nearPlane, float farPlane, const glm::uvec2& viewport,
+		LinearArena& arena);
+
+	/*!
+	 * Bind the buffers and set the cluster uniforms, the shader has to be in use
+	 *
+	 * \param shader : program including res/clustered_lighting.glsl
+	 */
+	void bind(Shader& shader) const;
+
+	const ClusteredLightingStats& stats() const;
+
+	void reportTo(Profiler& profiler) const;
+
+private:
+
+	// light in view space with the froxels it may touch
+	struct LightBounds
+	{
+		glm::vec3 position;
+		float range;
+		glm::vec3 direction;
+		float spotSin;      // sin of the outer angle, 0 for point lights
+		glm::uvec3 first;
+		uint32_t visible;
+		glm::uvec3 last;
+		float spotCos;
+	};
+
+	struct ClusterBox
+	{
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+	};
+
+	Options m_Options;
+	std::vector<Light> m_Lights;
+	std::vector<LightBounds> m_Bounds;
+	std::vector<ClusterBox> m_Boxes;
+	std::vector<std::vector<uint32_t>> m_SliceLights;   // lights touching every depth slice
+	std::vector<uint32_t> m_Scratch;                    // maxClusterLights slots per cluster
+	std::vector<uint32_t> m_Counts;
+	std::vector<glm::uvec2> m_Clusters;                 // offset and count in the index buffer
+
+	float m_FovY, m_Aspect, m_Near, m_Far;
+	float m_SliceFar;
+	glm::uvec2 m_Viewport;
+	glm::vec2 m_TileSize;                               // pixels
+	bool m_LightsDirty;
+	ClusteredLightingStats m_Stats;
+
+	GpuHandle m_LightBuffer;
+	GpuHandle m_ClusterBuffer;
+	GpuHandle m_IndexBuffer;
+
+	/*!
+	 * View space boxes of the froxels, when the projection or the viewport changes
+	 *
+	 */
+	void BuildClusterBoxes();
+
+	/*!
+	 * Froxel range touched by the bounding sphere of a light
+	 *
+	 */
+	void ComputeBounds(LightBounds& bounds) const;
+
+	unsigned int Slice(float depth) const;
+};
+
+/*!
+ * Scene to measure the cost of many lights
+ *
+ */
+namespace LightBenchmark
+{
+	/*!
+	 * Random point and spot lights filling a box
+	 *
+	 * \param count : number of lights
+	 * \param spotFraction : part of them turned into spot lights pointing down
+	 * \param boundsMin : minimum corner of the box
+	 * \param boundsMax : maximum corner of the box
+	 * \param minRange : smallest light range
+	 * \param maxRange : largest light range
+	 * \param seed : same seed, same lights
+	 */
+	std::vector<Light> GenerateLights(unsigned int count, float spotFraction, const glm::vec3& boundsMin,
+		const glm::vec3& boundsMax, float minRange, float maxRange, unsigned int seed);
+
+	/*!
+	 * Unit cube centered on the origin with flat normals
+	 *
+	 */
+	void MakeCube(Mesh& mesh);
+
+	/*!
+	 * Model matrices of a grid of boxes of random heights on the y = 0 plane
+	 *
+	 * \param countPerAxis : boxes along x and z
+	 * \param size : side of the square covered by the grid
+	 * \param seed : same seed, same heights
+	 */
+	std::vector<glm::mat4> GenerateBoxes(unsigned int countPerAxis, float size, unsigned int seed);
+}
+#endif
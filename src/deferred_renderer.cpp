@@ -0,0 +1,185 @@
+#include "deferred_renderer.h"
+#include <algorithm>
+#include <iostream>
+#include "gl_state_cache.h"
+
+
+DeferredRenderer::DeferredRenderer()
+	: m_Materials(MAX_MATERIALS, glm::vec4(0.8f, 0.8f, 0.8f, 1.0f)), m_LightsDirty(true), m_MaterialsDirty(true), m_Size(0)
+{
+	GpuResources& resources = GpuResources::instance();
+	m_LightBuffer = resources.createBuffer(GL_SHADER_STORAGE_BUFFER, sizeof(Light), nullptr, GL_DYNAMIC_DRAW);
+	m_MaterialBuffer = resources.createBuffer(GL_SHADER_STORAGE_BUFFER, MAX_MATERIALS * sizeof(glm::vec4), nullptr, GL_DYNAMIC_DRAW);
+}
+
+DeferredRenderer::~DeferredRenderer()
+{
+	ReleaseTargets();
+	GpuResources& resources = GpuResources::instance();
+	resources.release(m_LightBuffer);
+	resources.release(m_MaterialBuffer);
+}
+
+
+void DeferredRenderer::setLights(const std::vector<Light>& lights)
+{
+	m_Lights = lights;
+	m_LightsDirty = true;
+}
+
+
+void DeferredRenderer::setMaterial(unsigned int id, const glm::vec3& albedo)
+{
+	if (id >= MAX_MATERIALS)
+		return;
+	m_Materials[id] = glm::vec4(albedo, 1.0f);
+	m_MaterialsDirty = true;
+}
+
+
+void DeferredRenderer::beginGeometry(const glm::uvec2& viewport)
+{
+	glm::uvec2 size = glm::max(viewport, glm::uvec2(1));
+	if (size != m_Size)
+		Resize(size);
+
+	GLStateCache& state = GLStateCache::instance();
+	state.bindFramebuffer(GL_FRAMEBUFFER, GpuResources::instance().name(m_GeometryFramebuffer));
+	state.viewport(0, 0, (GLsizei)m_Size.x, (GLsizei)m_Size.y);
+	state.depthMask(GL_TRUE);
+
+	// 0 is an empty pixel, the lighting pass tells them apart with the depth anyway
+	GLuint clearPacked[4] = { 0, 0, 0, 0 };
+	glClearBufferuiv(GL_COLOR, 0, clearPacked);
+	glClearBufferfi(GL_DEPTH_STENCIL, 0, 1.0f, 0);
+}
+
+
+void DeferredRenderer::shade(Shader& shader, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& lightColor, GLuint target)
+{
+	GpuResources& resources = GpuResources::instance();
+	GLStateCache& state = GLStateCache::instance();
+	if (m_LightsDirty)
+	{
+		// never empty, a zero sized buffer can not be bound
+		if (m_Lights.empty())
+			resources.setBufferData(m_LightBuffer, GL_SHADER_STORAGE_BUFFER, sizeof(Light), nullptr, GL_DYNAMIC_DRAW);
+		else
+			resources.setBufferData(m_LightBuffer, GL_SHADER_STORAGE_BUFFER, m_Lights.size() * sizeof(Light), m_Lights.data(), GL_DYNAMIC_DRAW);
+		m_LightsDirty = false;
+	}
+	if (m_MaterialsDirty)
+	{
+		resources.setBufferData(m_MaterialBuffer, GL_SHADER_STORAGE_BUFFER, m_Materials.size() * sizeof(glm::vec4), m_Materials.data(), GL_DYNAMIC_DRAW);
+		m_MaterialsDirty = false;
+	}
+
+	shader.use();
+	shader.setMat4("view", view);
+	shader.setMat4("projection", projection);
+	shader.setMat4("inverseViewProjection", glm::inverse(projection * view));
+	shader.setVec2("viewportSize", glm::vec2(m_Size));
+	shader.setVec3("lightColor", lightColor);
+	shader.setInt("lightCount", (int)m_Lights.size());
+	shader.setInt("gbuffer", 0);
+	shader.setInt("depthBuffer", 1);
+	state.bindTexture(0, GL_TEXTURE_2D, resources.name(m_GBuffer));
+	state.bindTexture(1, GL_TEXTURE_2D, resources.name(m_Depth));
+	state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_BINDING, resources.name(m_LightBuffer));
+	state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_BINDING, resources.name(m_MaterialBuffer));
+	glBindImageTexture(0, resources.name(m_Output), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+	glm::uvec2 tiles = (m_Size + glm::uvec2(TILE_SIZE - 1)) / TILE_SIZE;
+	glDispatchCompute(tiles.x, tiles.y, 1);
+	glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT);
+
+	// lit colors and depth to the target, what is drawn next is depth tested against the scene
+	GLint width = (GLint)m_Size.x, height = (GLint)m_Size.y;
+	state.bindFramebuffer(GL_READ_FRAMEBUFFER, resources.name(m_OutputFramebuffer));
+	state.bindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	state.bindFramebuffer(GL_READ_FRAMEBUFFER, resources.name(m_GeometryFramebuffer));
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	state.bindFramebuffer(GL_FRAMEBUFFER, target);
+
+	m_Stats.lights = (unsigned int)m_Lights.size();
+	m_Stats.tiles = tiles.x * tiles.y;
+}
+
+
+const DeferredStats& DeferredRenderer::stats() const
+{
+	return m_Stats;
+}
+
+
+void DeferredRenderer::reportTo(Profiler& profiler) const
+{
+	profiler.addCounter("DEFERRED LIGHTS", (double)m_Stats.lights);
+	profiler.addCounter("DEFERRED TILES", (double)m_Stats.tiles);
+	profiler.addCounter("DEFERRED G-BUFFER MB", (double)m_Stats.gbufferBytes / (1024.0 * 1024.0));
+}
+
+
+void DeferredRenderer::Resize(const glm::uvec2& size)
+{
+	ReleaseTargets();
+	m_Size = size;
+
+	GpuResources& resources = GpuResources::instance();
+	GLStateCache& state = GLStateCache::instance();
+	GLsizei width = (GLsizei)size.x, height = (GLsizei)size.y;
+	uint64_t pixels = (uint64_t)size.x * size.y;
+
+	struct Target
+	{
+		GpuHandle* handle;
+		GLenum format;
+		uint64_t bytes;     // per pixel
+	};
+	Target targets[] = {
+		{ &m_GBuffer, GL_R32UI, 4 },
+		{ &m_Depth, GL_DEPTH24_STENCIL8, 4 },
+		{ &m_Output, GL_RGBA8, 4 } };
+	for (const Target& target : targets)
+	{
+		*target.handle = resources.createTexture(GL_TEXTURE_2D);
+		glTexStorage2D(GL_TEXTURE_2D, 1, target.format, width, height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		resources.setTextureBytes(*target.handle, pixels * target.bytes);
+	}
+	m_Stats.gbufferBytes = pixels * 8;
+
+	m_GeometryFramebuffer = resources.createFramebuffer();
+	state.bindFramebuffer(GL_FRAMEBUFFER, resources.name(m_GeometryFramebuffer));
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, resources.name(m_GBuffer), 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, resources.name(m_Depth), 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "ERROR::DEFERRED RENDERER::INCOMPLETE G-BUFFER" << std::endl;
+
+	m_OutputFramebuffer = resources.createFramebuffer();
+	state.bindFramebuffer(GL_FRAMEBUFFER, resources.name(m_OutputFramebuffer));
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, resources.name(m_Output), 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "ERROR::DEFERRED RENDERER::INCOMPLETE OUTPUT FRAMEBUFFER" << std::endl;
+	state.bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+
+void DeferredRenderer::ReleaseTargets()
+{
+	GpuResources& resources = GpuResources::instance();
+	resources.release(m_GeometryFramebuffer);
+	resources.release(m_OutputFramebuffer);
+	resources.release(m_GBuffer);
+	resources.release(m_Depth);
+	resources.release(m_Output);
+	m_GeometryFramebuffer = GpuHandle();
+	m_OutputFramebuffer = GpuHandle();
+	m_GBuffer = GpuHandle();
+	m_Depth = GpuHandle();
+	m_Output = GpuHandle();
+}
@@ -0,0 +1,117 @@
+#ifndef DEFERRED_RENDERER_H
+#define DEFERRED_RENDERER_H
+
+#include <vector>
+#include <glm.hpp>
+#include <glew.h>
+#include "clustered_lighting.h"
+#include "gpu_resources.h"
+#include "profiler.h"
+#include "shader.h"
+
+/*!
+ * Counters of DeferredRenderer, for the last frame
+ *
+ */
+struct DeferredStats
+{
+	unsigned int lights = 0;
+	unsigned int tiles = 0;
+	uint64_t gbufferBytes = 0;      // G-buffer and depth
+};
+
+/*!
+ * Deferred shading with a compact G-buffer and tiled light accumulation
+ *
+ * The geometry pass writes 32 bits per pixel next to the depth: an
+ * octahedral normal on 2x12 bits and an 8 bits material id, see
+ * res/fragment_gbuffer.glsl. Positions are rebuilt from the depth. The
+ * lighting pass is a compute shader, res/deferred_lighting_compute.glsl,
+ * run on 16x16 pixel tiles: each tile bounds its depth, culls the lights
+ * against its frustum into a shared list and shades its pixels with that
+ * list only. The result and the depth are copied to the target
+ * framebuffer so forward passes can draw over it.
+ *
+ * Lights use the layout of ClusteredLighting so both paths can be run
+ * over the same scene and lights.
+ */
+class DeferredRenderer
+{
+public:
+	static const unsigned int TILE_SIZE = 16;           // local size of the lighting shader
+	static const unsigned int MAX_MATERIALS = 256;
+	// shader storage bindings used by res/deferred_lighting_compute.glsl
+	static const unsigned int LIGHT_BINDING = 2;
+	static const unsigned int MATERIAL_BINDING = 5;
+
+	DeferredRenderer();
+	~DeferredRenderer();
+
+	DeferredRenderer(const DeferredRenderer&) = delete;
+	DeferredRenderer& operator=(const DeferredRenderer&) = delete;
+
+	/*!
+	 * Replace the lights, in world space
+	 *
+	 */
+	void setLights(const std::vector<Light>& lights);
+
+	/*!
+	 * Color of a material id, the id written by the geometry pass
+	 *
+	 * \param id : below MAX_MATERIALS
+	 * \param albedo : diffuse color
+	 */
+	void setMaterial(unsigned int id, const glm::vec3& albedo);
+
+	/*!
+	 * Bind and clear the G-buffer, the geometry drawn next fills it
+	 *
+	 * The targets follow the viewport size. Geometry is drawn with a program
+	 * using res/fragment_gbuffer.glsl with its materialId uniform set.
+	 *
+	 * \param viewport : framebuffer size in pixels
+	 */
+	void beginGeometry(const glm::uvec2& viewport);
+
+	/*!
+	 * Light the G-buffer and copy the result and the depth to a framebuffer
+	 *
+	 * \param shader : program of res/deferred_lighting_compute.glsl, cascade uniforms already set for the SHADOWS variant
+	 * \param view : world to view matrix the geometry was drawn with
+	 * \param projection : projection the geometry was drawn with
+	 * \param lightColor : ambient and sun color
+	 * \param target : framebuffer receiving the result, 0 for the window, bound after
+	 */
+	void shade(Shader& shader, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& lightColor, GLuint target = 0);
+
+	const DeferredStats& stats() const;
+
+	void reportTo(Profiler& profiler) const;
+
+private:
+
+	std::vector<Light> m_Lights;
+	std::vector<glm::vec4> m_Materials;
+	bool m_LightsDirty;
+	bool m_MaterialsDirty;
+	glm::uvec2 m_Size;
+	DeferredStats m_Stats;
+
+	GpuHandle m_LightBuffer;
+	GpuHandle m_MaterialBuffer;
+	GpuHandle m_GBuffer;            // R32UI, packed normal and material
+	GpuHandle m_Depth;              // DEPTH24_STENCIL8, the format of the default framebuffer
+	GpuHandle m_Output;             // RGBA8, written by the lighting pass
+	GpuHandle m_GeometryFramebuffer;
+	GpuHandle m_OutputFramebuffer;
+
+	/*!
+	 * Create the targets for a new size
+	 *
+	 */
+	void Resize(const glm::uvec2& size);
+
+	void ReleaseTargets();
+};
+#endif
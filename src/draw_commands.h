@@ -0,0 +1,29 @@
+#ifndef DRAW_COMMANDS_H
+#define DRAW_COMMANDS_H
+
+/*!
+ * Command layout consumed by glMultiDrawElementsIndirect
+ *
+ * Must match the layout expected by OpenGL, do not reorder members.
+ */
+struct DrawElementsIndirectCommand
+{
+	unsigned int count;
+	unsigned int instanceCount;
+	unsigned int firstIndex;
+	int baseVertex;
+	unsigned int baseInstance;
+};
+
+/*!
+ * Command layout consumed by glMultiDrawArraysIndirect
+ *
+ */
+struct DrawArraysIndirectCommand
+{
+	unsigned int count;
+	unsigned int instanceCount;
+	unsigned int first;
+	unsigned int baseInstance;
+};
+#endif
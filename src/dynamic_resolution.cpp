@@ -0,0 +1,175 @@
+#include "dynamic_resolution.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include "gl_state_cache.h"
+
+
+DynamicResolution::DynamicResolution()
+	: DynamicResolution(Options())
+{
+}
+
+DynamicResolution::DynamicResolution(const Options& options)
+	: m_Options(options), m_Samples(0), m_Outside(0), m_Side(0), m_WindowSize(0), m_TargetSize(0)
+{
+	m_Options.maxScale = std::max(m_Options.maxScale, 0.1f);
+	m_Options.minScale = glm::clamp(m_Options.minScale, 0.1f, m_Options.maxScale);
+	m_Options.targetMs = std::max(m_Options.targetMs, 0.1f);
+	m_Scale = m_Options.maxScale;
+	m_Stats.scale = m_Scale;
+}
+
+DynamicResolution::~DynamicResolution()
+{
+	ReleaseTarget();
+}
+
+
+glm::uvec2 DynamicResolution::beginFrame(const glm::uvec2& windowSize)
+{
+	if (m_Timer.sampleCount() != m_Samples)
+	{
+		m_Samples = m_Timer.sampleCount();
+		Control(m_Timer.milliseconds());
+	}
+
+	m_WindowSize = glm::max(windowSize, glm::uvec2(1));
+	glm::uvec2 targetSize = glm::max(glm::uvec2(glm::vec2(m_WindowSize) * m_Options.maxScale + 0.5f), glm::uvec2(1));
+	if (targetSize != m_TargetSize)
+		Resize(targetSize);
+
+	glm::uvec2 renderSize = glm::clamp(glm::uvec2(glm::vec2(m_WindowSize) * m_Scale + 0.5f), glm::uvec2(1), m_TargetSize);
+	m_Stats.renderSize = renderSize;
+
+	GLStateCache& state = GLStateCache::instance();
+	state.bindFramebuffer(GL_FRAMEBUFFER, GpuResources::instance().name(m_Framebuffer));
+	state.viewport(0, 0, (GLsizei)renderSize.x, (GLsizei)renderSize.y);
+	state.depthMask(GL_TRUE);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	m_Timer.begin();
+	return renderSize;
+}
+
+
+void DynamicResolution::endFrame()
+{
+	m_Timer.end();
+
+	// bilinear upscale of the used corner to the whole window
+	GLStateCache& state = GLStateCache::instance();
+	state.bindFramebuffer(GL_READ_FRAMEBUFFER, GpuResources::instance().name(m_Framebuffer));
+	state.bindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, (GLint)m_Stats.renderSize.x, (GLint)m_Stats.renderSize.y,
+		0, 0, (GLint)m_WindowSize.x, (GLint)m_WindowSize.y, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	state.bindFramebuffer(GL_FRAMEBUFFER, 0);
+	state.viewport(0, 0, (GLsizei)m_WindowSize.x, (GLsizei)m_WindowSize.y);
+}
+
+
+GLuint DynamicResolution::framebuffer() const
+{
+	return GpuResources::instance().name(m_Framebuffer);
+}
+
+
+float DynamicResolution::scale() const
+{
+	return m_Scale;
+}
+
+
+const DynamicResolutionStats& DynamicResolution::stats() const
+{
+	return m_Stats;
+}
+
+
+void DynamicResolution::reportTo(Profiler& profiler) const
+{
+	profiler.addCounter("RESOLUTION SCALE", m_Stats.scale);
+	profiler.addCounter("RENDER WIDTH", (double)m_Stats.renderSize.x);
+	profiler.addCounter("RENDER HEIGHT", (double)m_Stats.renderSize.y);
+	profiler.addCounter("FRAME GPU MS", m_Stats.gpuMs);
+	profiler.addCounter("RESOLUTION CHANGES", (double)m_Stats.changes);
+}
+
+
+void DynamicResolution::Control(double milliseconds)
+{
+	m_Stats.gpuMs = milliseconds;
+	m_Stats.smoothedMs = m_Samples <= 1 ? milliseconds : m_Stats.smoothedMs + 0.25 * (milliseconds - m_Stats.smoothedMs);
+
+	double target = m_Options.targetMs;
+	int side = 0;
+	if (m_Stats.smoothedMs > target * (1.0 + m_Options.band))
+		side = 1;
+	else if (m_Stats.smoothedMs < target * (1.0 - m_Options.band))
+		side = -1;
+	if (side != m_Side || side == 0)
+	{
+		m_Side = side;
+		m_Outside = 0;
+		if (side == 0)
+			return;
+	}
+
+	// the timer lags a few frames, settleFrames has to cover it or the scale overshoots
+	if (++m_Outside < m_Options.settleFrames)
+		return;
+	m_Outside = 0;
+
+	// cost goes with the pixel count, the square of the scale
+	float desired = m_Scale * (float)std::sqrt(target / std::max(m_Stats.smoothedMs, 0.01));
+	desired = glm::clamp(desired, m_Scale - m_Options.maxStep, m_Scale + m_Options.maxStep);
+	desired = glm::clamp(desired, m_Options.minScale, m_Options.maxScale);
+	if (desired == m_Scale)
+		return;
+
+	m_Scale = desired;
+	m_Stats.scale = desired;
+	++m_Stats.changes;
+}
+
+
+void DynamicResolution::Resize(const glm::uvec2& size)
+{
+	ReleaseTarget();
+	m_TargetSize = size;
+
+	GpuResources& resources = GpuResources::instance();
+	GLStateCache& state = GLStateCache::instance();
+	GLenum formats[] = { GL_RGBA8, GL_DEPTH24_STENCIL8 };
+	GpuHandle* textures[] = { &m_Color, &m_Depth };
+	for (int i = 0; i < 2; ++i)
+	{
+		*textures[i] = resources.createTexture(GL_TEXTURE_2D);
+		glTexStorage2D(GL_TEXTURE_2D, 1, formats[i], (GLsizei)size.x, (GLsizei)size.y);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		resources.setTextureBytes(*textures[i], (uint64_t)size.x * size.y * 4);
+	}
+
+	m_Framebuffer = resources.createFramebuffer();
+	state.bindFramebuffer(GL_FRAMEBUFFER, resources.name(m_Framebuffer));
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, resources.name(m_Color), 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, resources.name(m_Depth), 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "ERROR::DYNAMIC RESOLUTION::INCOMPLETE FRAMEBUFFER" << std::endl;
+	state.bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+
+void DynamicResolution::ReleaseTarget()
+{
+	GpuResources& resources = GpuResources::instance();
+	resources.release(m_Framebuffer);
+	resources.release(m_Color);
+	resources.release(m_Depth);
+	m_Framebuffer = GpuHandle();
+	m_Color = GpuHandle();
+	m_Depth = GpuHandle();
+}
@@ -0,0 +1,111 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <glm.hpp>
+#include <glew.h>
+#include "gpu_resources.h"
+#include "gpu_timer.h"
+#include "profiler.h"
+
+/*!
+ * Counters of DynamicResolution
+ *
+ */
+struct DynamicResolutionStats
+{
+	float scale = 1.0f;             // render size over window size, per axis
+	glm::uvec2 renderSize = glm::uvec2(0);
+	double gpuMs = 0.0;             // latest measured frame
+	double smoothedMs = 0.0;
+	unsigned int changes = 0;       // scale changes since the start
+};
+
+/*!
+ * Render resolution adjusted to hold a GPU frame time
+ *
+ * The scene is drawn into an offscreen target sized for the largest scale,
+ * only a corner of it is used at lower scales so changing the scale never
+ * reallocates. The GPU time of the frame comes from a GpuTimer, read a few
+ * frames late, and is smoothed. The scale only moves once the smoothed
+ * time has stayed outside a band around the target for some frames, and
+ * then by a bounded step towards the scale that should hit the target,
+ * the cost being about proportional to the pixel count. The frame ends
+ * with a bilinear upscale to the window.
+ */
+class DynamicResolution
+{
+public:
+	struct Options
+	{
+		float targetMs = 16.6f;
+		float minScale = 0.5f;
+		float maxScale = 1.0f;
+		float band = 0.1f;              // no change while within target * (1 +- band)
+		unsigned int settleFrames = 8;  // samples outside the band before a change
+		float maxStep = 0.1f;           // largest scale change at once
+	};
+
+	DynamicResolution();
+	explicit DynamicResolution(const Options& options);
+	~DynamicResolution();
+
+	DynamicResolution(const DynamicResolution&) = delete;
+	DynamicResolution& operator=(const DynamicResolution&) = delete;
+
+	/*!
+	 * Update the scale, bind and clear the offscreen target and start timing
+	 *
+	 * \param windowSize : framebuffer size of the window in pixels
+	 * \return : size to render at, the viewport is set to it
+	 */
+	glm::uvec2 beginFrame(const glm::uvec2& windowSize);
+
+	/*!
+	 * Stop timing and upscale to the window, the default framebuffer is bound after
+	 *
+	 */
+	void endFrame();
+
+	/*!
+	 * Offscreen framebuffer, for passes that copy into the current target
+	 *
+	 */
+	GLuint framebuffer() const;
+
+	float scale() const;
+
+	const DynamicResolutionStats& stats() const;
+
+	void reportTo(Profiler& profiler) const;
+
+private:
+
+	Options m_Options;
+	GpuTimer m_Timer;
+	unsigned int m_Samples;         // GpuTimer samples already used
+	unsigned int m_Outside;         // consecutive samples outside the band on the same side
+	int m_Side;                     // 1 over budget, -1 under, 0 inside
+	float m_Scale;
+	glm::uvec2 m_WindowSize;
+	glm::uvec2 m_TargetSize;        // allocated size
+	DynamicResolutionStats m_Stats;
+
+	GpuHandle m_Color;
+	GpuHandle m_Depth;
+	GpuHandle m_Framebuffer;
+
+	/*!
+	 * Feed a new GPU time to the controller
+	 *
+	 */
+	void Control(double milliseconds);
+
+	/*!
+	 * Create the offscreen target for a new window size
+	 *
+	 */
+	void Resize(const glm::uvec2& size);
+
+	void ReleaseTarget();
+};
+#endif
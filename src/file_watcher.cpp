@@ -0,0 +1,147 @@
+#include "file_watcher.h"
+#include <algorithm>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#endif
+
+namespace
+{
+	// stat polling interval of the portable fallback
+	const std::chrono::milliseconds POLL_INTERVAL(250);
+}
+
+
+FileWatcher::FileWatcher()
+	: m_LastPoll(std::chrono::steady_clock::now())
+{
+#ifdef __linux__
+	m_Inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+	if (m_Inotify >= 0)
+		close(m_Inotify);
+#endif
+}
+
+
+void FileWatcher::watchFile(const std::string& path)
+{
+	for (const WatchedFile& file : m_Files)
+	{
+		if (file.path == path)
+			return;
+	}
+
+	WatchedFile file;
+	file.path = path;
+	file.modified = ModificationTime(path);
+	m_Files.push_back(file);
+
+#ifdef __linux__
+	if (m_Inotify < 0)
+		return;
+
+	std::string directory, name;
+	SplitPath(path, directory, name);
+	if (m_WatchOfDirectory.count(directory))
+		return;
+
+	int watch = inotify_add_watch(m_Inotify, directory.empty() ? "." : directory.c_str(),
+		IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+	if (watch >= 0)
+	{
+		m_WatchOfDirectory[directory] = watch;
+		m_DirectoryOfWatch[watch] = directory;
+	}
+#endif
+}
+
+
+bool FileWatcher::poll(std::vector<std::string>& changed)
+{
+	changed.clear();
+
+#ifdef __linux__
+	if (m_Inotify >= 0)
+	{
+		alignas(inotify_event) char buffer[4096];
+		for (;;)
+		{
+			ssize_t length = read(m_Inotify, buffer, sizeof(buffer));
+			if (length <= 0)
+				break;
+
+			for (char* cursor = buffer; cursor < buffer + length; )
+			{
+				const inotify_event* event = (const inotify_event*)cursor;
+				cursor += sizeof(inotify_event) + event->len;
+				if (event->len == 0)
+					continue;
+
+				auto directory = m_DirectoryOfWatch.find(event->wd);
+				if (directory == m_DirectoryOfWatch.end())
+					continue;
+
+				std::string path = directory->second + event->name;
+				for (const WatchedFile& file : m_Files)
+				{
+					if (file.path == path && std::find(changed.begin(), changed.end(), path) == changed.end())
+						changed.push_back(path);
+				}
+			}
+		}
+		return !changed.empty();
+	}
+#endif
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (now - m_LastPoll < POLL_INTERVAL)
+		return false;
+	m_LastPoll = now;
+
+	for (WatchedFile& file : m_Files)
+	{
+		long long modified = ModificationTime(file.path);
+		if (modified != file.modified)
+		{
+			file.modified = modified;
+			changed.push_back(file.path);
+		}
+	}
+	return !changed.empty();
+}
+
+
+long long FileWatcher::ModificationTime(const std::string& path)
+{
+	struct stat status;
+	if (stat(path.c_str(), &status) != 0)
+		return -1;
+	return (long long)status.st_mtime;
+}
+
+
+void FileWatcher::SplitPath(const std::string& path, std::string& directory, std::string& name)
+{
+	size_t slash = path.find_last_of("/\\");
+	if (slash == std::string::npos)
+	{
+		directory.clear();
+		name = path;
+	}
+	else
+	{
+		// directory keeps its trailing slash so directory + name gives the path back
+		directory = path.substr(0, slash + 1);
+		name = path.substr(slash + 1);
+	}
+}
@@ -0,0 +1,60 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*!
+ * Reports edits of a set of files
+ *
+ * Uses inotify on Linux, watching the parent directories so editors that
+ * save through a rename are caught too. Elsewhere the modification times are
+ * polled a few times per second. poll never blocks.
+ */
+class FileWatcher
+{
+public:
+	FileWatcher();
+	~FileWatcher();
+
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	/*!
+	 * Start watching a file
+	 *
+	 * \param path : path of the file, reported back exactly as given
+	 */
+	void watchFile(const std::string& path);
+
+	/*!
+	 * Collect the watched files changed since the last call
+	 *
+	 * \param changed : cleared and filled with paths as given to watchFile
+	 * \return : true(bool) if any file changed
+	 */
+	bool poll(std::vector<std::string>& changed);
+
+private:
+
+	struct WatchedFile
+	{
+		std::string path;
+		long long modified;
+	};
+
+	std::vector<WatchedFile> m_Files;
+	std::chrono::steady_clock::time_point m_LastPoll;
+
+#ifdef __linux__
+	int m_Inotify;
+	std::unordered_map<int, std::string> m_DirectoryOfWatch;
+	std::unordered_map<std::string, int> m_WatchOfDirectory;
+#endif
+
+	static long long ModificationTime(const std::string& path);
+	static void SplitPath(const std::string& path, std::string& directory, std::string& name);
+};
+#endif
@@ -0,0 +1,72 @@
+#include "fragment_counter.h"
+
+
+FragmentCounter::FragmentCounter()
+	: m_Next(0), m_Running(false), m_Count(0)
+{
+	m_Target = GLEW_ARB_pipeline_statistics_query ? GL_FRAGMENT_SHADER_INVOCATIONS_ARB : GL_SAMPLES_PASSED;
+	glGenQueries(QUERY_COUNT, m_Queries);
+	for (bool& pending : m_Pending)
+		pending = false;
+}
+
+FragmentCounter::~FragmentCounter()
+{
+	glDeleteQueries(QUERY_COUNT, m_Queries);
+}
+
+
+void FragmentCounter::begin()
+{
+	Collect();
+	if (m_Pending[m_Next])
+		return;
+
+	glBeginQuery(m_Target, m_Queries[m_Next]);
+	m_Running = true;
+}
+
+
+void FragmentCounter::end()
+{
+	if (!m_Running)
+		return;
+
+	glEndQuery(m_Target);
+	m_Pending[m_Next] = true;
+	m_Next = (m_Next + 1) % QUERY_COUNT;
+	m_Running = false;
+}
+
+
+uint64_t FragmentCounter::count() const
+{
+	return m_Count;
+}
+
+
+const char* FragmentCounter::label() const
+{
+	return m_Target == GL_SAMPLES_PASSED ? "SHADED SAMPLES PASSED" : "SHADED FRAGMENT INVOCATIONS";
+}
+
+
+void FragmentCounter::Collect()
+{
+	for (unsigned int i = 0; i < QUERY_COUNT; ++i)
+	{
+		unsigned int query = (m_Next + i) % QUERY_COUNT;
+		if (!m_Pending[query])
+			continue;
+
+		GLint available = 0;
+		glGetQueryObjectiv(m_Queries[query], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			break;
+
+		GLuint64 count = 0;
+		glGetQueryObjectui64v(m_Queries[query], GL_QUERY_RESULT, &count);
+		m_Pending[query] = false;
+		m_Count = count;
+	}
+}
@@ -0,0 +1,57 @@
+#ifndef FRAGMENT_COUNTER_H
+#define FRAGMENT_COUNTER_H
+
+#include <cstdint>
+#include <glew.h>
+
+/*!
+ * Fragments shaded by a span of draws
+ *
+ * Counts fragment shader invocations when the driver exposes
+ * ARB_pipeline_statistics_query, samples passing the depth test otherwise.
+ * Queries go round a small ring and are read back once available, as with
+ * GpuTimer. Only one counter can be running at a time.
+ */
+class FragmentCounter
+{
+public:
+	FragmentCounter();
+	~FragmentCounter();
+
+	FragmentCounter(const FragmentCounter&) = delete;
+	FragmentCounter& operator=(const FragmentCounter&) = delete;
+
+	/*!
+	 * Start counting, skipped when every query of the ring is still in flight
+	 *
+	 */
+	void begin();
+
+	void end();
+
+	/*!
+	 * Latest available count, 0 until the first query comes back
+	 *
+	 */
+	uint64_t count() const;
+
+	/*!
+	 * Profiler counter name matching what is counted
+	 *
+	 */
+	const char* label() const;
+
+private:
+
+	static const unsigned int QUERY_COUNT = 4;
+
+	GLenum m_Target;
+	GLuint m_Queries[QUERY_COUNT];
+	bool m_Pending[QUERY_COUNT];
+	unsigned int m_Next;
+	bool m_Running;
+	uint64_t m_Count;
+
+	void Collect();
+};
+#endif
@@ -0,0 +1,133 @@
+#include "frame_arena.h"
+#include <cstdlib>
+#include "job_system.h"
+
+
+LinearArena::LinearArena(size_t capacity)
+	: m_Block(nullptr), m_Capacity(capacity), m_Used(0), m_Peak(0), m_OverflowCount(0)
+{
+	if (capacity > 0)
+		m_Block = (char*)std::malloc(capacity);
+	if (!m_Block)
+		m_Capacity = 0;
+	// room for overflow pointers up front, so a small overflow does not allocate twice
+	m_Overflow.reserve(16);
+}
+
+LinearArena::~LinearArena()
+{
+	reset();
+	std::free(m_Block);
+}
+
+
+void* LinearArena::allocate(size_t size, size_t alignment)
+{
+	size_t start = (m_Used + alignment - 1) & ~(alignment - 1);
+	if (start + size <= m_Capacity)
+	{
+		m_Used = start + size;
+		if (m_Used > m_Peak)
+			m_Peak = m_Used;
+		return m_Block + start;
+	}
+
+	// does not fit, keep going on the heap until reset
+	++m_OverflowCount;
+	void* memory = nullptr;
+	size_t rounded = (size + alignment - 1) & ~(alignment - 1);
+#ifdef _WIN32
+	memory = _aligned_malloc(rounded, alignment);
+#else
+	if (posix_memalign(&memory, alignment < sizeof(void*) ? sizeof(void*) : alignment, rounded) != 0)
+		memory = nullptr;
+#endif
+	m_Overflow.push_back(memory);
+	return memory;
+}
+
+
+void LinearArena::reset()
+{
+	for (void* memory : m_Overflow)
+	{
+#ifdef _WIN32
+		_aligned_free(memory);
+#else
+		std::free(memory);
+#endif
+	}
+	m_Overflow.clear();
+	m_Used = 0;
+	m_OverflowCount = 0;
+}
+
+
+size_t LinearArena::used() const
+{
+	return m_Used;
+}
+
+
+size_t LinearArena::capacity() const
+{
+	return m_Capacity;
+}
+
+
+size_t LinearArena::peak() const
+{
+	return m_Peak;
+}
+
+
+unsigned int LinearArena::overflows() const
+{
+	return m_OverflowCount;
+}
+
+
+FrameArena::FrameArena(size_t bytesPerThread, unsigned int framesInFlight, unsigned int threadCount)
+	: m_FramesInFlight(framesInFlight ? framesInFlight : 1), m_ThreadCount(threadCount ? threadCount : 1), m_Frame(0)
+{
+	for (unsigned int i = 0; i < m_FramesInFlight * m_ThreadCount; ++i)
+		m_Arenas.emplace_back(new LinearArena(bytesPerThread));
+}
+
+
+void FrameArena::beginFrame()
+{
+	m_Frame = (m_Frame + 1) % m_FramesInFlight;
+	for (unsigned int thread = 0; thread < m_ThreadCount; ++thread)
+		m_Arenas[m_Frame * m_ThreadCount + thread]->reset();
+}
+
+
+LinearArena& FrameArena::threadArena()
+{
+	unsigned int thread = JobSystem::threadIndex();
+	if (thread >= m_ThreadCount)
+		thread = 0;
+	return *m_Arenas[m_Frame * m_ThreadCount + thread];
+}
+
+
+void* FrameArena::allocate(size_t size, size_t alignment)
+{
+	return threadArena().allocate(size, alignment);
+}
+
+
+void FrameArena::reportTo(Profiler& profiler) const
+{
+	size_t used = 0;
+	unsigned int overflows = 0;
+	for (unsigned int thread = 0; thread < m_ThreadCount; ++thread)
+	{
+		const LinearArena& arena = *m_Arenas[m_Frame * m_ThreadCount + thread];
+		used += arena.used();
+		overflows += arena.overflows();
+	}
+	profiler.addCounter("FRAME ARENA BYTES", (double)used);
+	profiler.addCounter("FRAME ARENA OVERFLOWS", overflows);
+}
@@ -0,0 +1,167 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "profiler.h"
+
+/*!
+ * Bump allocator over one fixed block
+ *
+ * Allocation moves a cursor, reset frees everything at once. Requests that
+ * do not fit go to the heap and are released on reset, they are counted as
+ * overflows so the block size can be tuned.
+ */
+class LinearArena
+{
+public:
+	explicit LinearArena(size_t capacity = 0);
+	~LinearArena();
+
+	LinearArena(const LinearArena&) = delete;
+	LinearArena& operator=(const LinearArena&) = delete;
+
+	/*!
+	 * Allocate raw memory
+	 *
+	 * \param size : bytes to allocate
+	 * \param alignment : power of two
+	 * \return : memory valid until the next reset
+	 */
+	void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+	/*!
+	 * Typed array allocation, elements are not constructed
+	 *
+	 */
+	template <typename T>
+	T* allocateArray(size_t count)
+	{
+		return (T*)allocate(count * sizeof(T), alignof(T));
+	}
+
+	/*!
+	 * Release everything allocated since the last reset
+	 *
+	 */
+	void reset();
+
+	size_t used() const;
+	size_t capacity() const;
+	size_t peak() const;
+	unsigned int overflows() const;
+
+private:
+
+	char* m_Block;
+	size_t m_Capacity;
+	size_t m_Used;
+	size_t m_Peak;
+	std::vector<void*> m_Overflow;
+	unsigned int m_OverflowCount;
+};
+
+/*!
+ * Arena memory for data living one frame
+ *
+ * One LinearArena per frame in flight, so data handed to the GPU during a
+ * frame stays valid until that frame slot comes back, and inside each frame
+ * one sub-arena per JobSystem thread so jobs allocate without locking.
+ */
+class FrameArena
+{
+public:
+	/*!
+	 * \param bytesPerThread : block size of each sub-arena
+	 * \param framesInFlight : 2 or 3 to match how many frames the GPU lags behind
+	 * \param threadCount : JobSystem::concurrency() of the pool used by jobs
+	 */
+	FrameArena(size_t bytesPerThread, unsigned int framesInFlight, unsigned int threadCount);
+
+	/*!
+	 * Move to the next frame slot and reset it, call once at the start of a frame
+	 *
+	 */
+	void beginFrame();
+
+	/*!
+	 * Sub-arena of the calling thread for the current frame
+	 *
+	 */
+	LinearArena& threadArena();
+
+	/*!
+	 * Allocate from the sub-arena of the calling thread
+	 *
+	 */
+	void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+	/*!
+	 * Bytes used and overflows of the current frame
+	 *
+	 */
+	void reportTo(Profiler& profiler) const;
+
+private:
+
+	unsigned int m_FramesInFlight;
+	unsigned int m_ThreadCount;
+	unsigned int m_Frame;
+	std::vector<std::unique_ptr<LinearArena>> m_Arenas; // frame major, thread minor
+};
+
+/*!
+ * Standard allocator drawing from a LinearArena, deallocate is a no-op
+ *
+ */
+template <typename T>
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+
+	explicit ArenaAllocator(LinearArena& arena) : m_Arena(&arena) {}
+
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : m_Arena(other.arena()) {}
+
+	T* allocate(size_t count)
+	{
+		return m_Arena->allocateArray<T>(count);
+	}
+
+	void deallocate(T*, size_t)
+	{
+	}
+
+	LinearArena* arena() const
+	{
+		return m_Arena;
+	}
+
+	template <typename U>
+	bool operator==(const ArenaAllocator<U>& other) const
+	{
+		return m_Arena == other.arena();
+	}
+
+	template <typename U>
+	bool operator!=(const ArenaAllocator<U>& other) const
+	{
+		return m_Arena != other.arena();
+	}
+
+private:
+
+	LinearArena* m_Arena;
+};
+
+/*!
+ * Vector living in a frame arena, build it with FrameVector<T>(ArenaAllocator<T>(arena))
+ *
+ */
+template <typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T>>;
+#endif
@@ -0,0 +1,399 @@
+#include "frame_capture.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include "gl_state_cache.h"
+
+#define STB_IMAGE_WRITE_STATIC
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+namespace
+{
+	bool FileExists(const std::string& path)
+	{
+		return std::ifstream(path).is_open();
+	}
+
+	std::string PngPath(const std::string& prefix, unsigned int frame)
+	{
+		std::string number = std::to_string(frame);
+		return prefix + std::string(number.size() < 6 ? 6 - number.size() : 0, '0') + number + ".png";
+	}
+}
+
+
+FrameCapture::FrameCapture()
+	: FrameCapture(Options())
+{
+}
+
+FrameCapture::FrameCapture(const Options& options)
+	: m_Options(options), m_FirstFrame(0), m_NextFrame(0), m_Video(false), m_Capturing(false), m_VideoSize(0), m_EncodedCount(0), m_Stop(false), m_HeaderWritten(false)
+{
+	m_Options.ringSize = std::max(2u, m_Options.ringSize);
+}
+
+FrameCapture::~FrameCapture()
+{
+	stop();
+}
+
+
+bool FrameCapture::start(const std::string& path)
+{
+	stop();
+
+	m_Video = path.size() >= 4 && path.compare(path.size() - 4, 4, ".y4m") == 0;
+	if (m_Video)
+	{
+		// never truncated, a restarted recording goes to a new file
+		m_Path = FreeVideoPath(path);
+		m_VideoFile.open(m_Path, std::ios::binary | std::ios::trunc);
+		if (!m_VideoFile)
+		{
+			std::cout << "ERROR::FRAME CAPTURE::UNABLE TO CREATE: " << m_Path << std::endl;
+			return false;
+		}
+	}
+	else
+	{
+		// numbers go on from the last recording with this prefix, and past files left by other runs
+		m_FirstFrame = FreeFrameNumber(path, path == m_Path ? m_NextFrame : 0);
+		m_Path = path;
+	}
+
+	GpuResources& resources = GpuResources::instance();
+	m_Slots.resize(m_Options.ringSize);
+	for (Slot& slot : m_Slots)
+	{
+		// sized by the first frame read into it
+		slot = Slot();
+		slot.buffer = resources.createBuffer(GL_PIXEL_PACK_BUFFER, 0, nullptr, GL_STREAM_READ);
+	}
+	GLStateCache::instance().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	m_VideoSize = glm::uvec2(0);
+	m_HeaderWritten = false;
+	m_EncodedCount = 0;
+	m_Stop = false;
+	unsigned int threadCount = m_Video ? 1 : std::max(1u, m_Options.encoderThreads);
+	for (unsigned int i = 0; i < threadCount; ++i)
+		m_Threads.emplace_back(&FrameCapture::EncoderLoop, this);
+
+	m_Stats = CaptureStats();
+	m_Stats.capturing = true;
+	m_Capturing = true;
+	std::cout << "CAPTURE::STARTED: " << (m_Video ? m_Path : PngPath(m_Path, m_FirstFrame)) << std::endl;
+	return true;
+}
+
+
+void FrameCapture::stop()
+{
+	if (!m_Capturing)
+		return;
+
+	// the only place allowed to wait, the recording ends with the frames already read back
+	Collect(1000000000);
+	for (unsigned int index : m_Reading)
+	{
+		glDeleteSync(m_Slots[index].fence);
+		m_Slots[index].state = SLOT_FREE;
+		++m_Stats.dropped;
+	}
+	m_Reading.clear();
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stop = true;
+	}
+	m_Wake.notify_all();
+	for (std::thread& thread : m_Threads)
+		thread.join();
+	m_Threads.clear();
+	Recycle();
+
+	GpuResources& resources = GpuResources::instance();
+	for (Slot& slot : m_Slots)
+		resources.release(slot.buffer);
+	m_Slots.clear();
+	if (m_VideoFile.is_open())
+		m_VideoFile.close();
+
+	// dropped frames leave a gap, their numbers are not given out again
+	m_NextFrame = m_FirstFrame + m_Stats.captured;
+	m_Capturing = false;
+	m_Stats.capturing = false;
+	m_Stats.inFlight = 0;
+	std::cout << "CAPTURE::STOPPED: " << m_Stats.encoded << " FRAMES, " << m_Stats.dropped << " DROPPED" << std::endl;
+}
+
+
+bool FrameCapture::isCapturing() const
+{
+	return m_Capturing;
+}
+
+
+void FrameCapture::capture(const glm::uvec2& windowSize)
+{
+	if (!m_Capturing)
+		return;
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	Recycle();
+	Collect(0);
+
+	glm::uvec2 size = glm::max(windowSize, glm::uvec2(1));
+	if (m_Video && m_VideoSize == glm::uvec2(0))
+		m_VideoSize = size;
+
+	Slot* slot = nullptr;
+	unsigned int index = 0;
+	for (; index < m_Slots.size(); ++index)
+	{
+		if (m_Slots[index].state == SLOT_FREE)
+		{
+			slot = &m_Slots[index];
+			break;
+		}
+	}
+
+	// a video keeps the size of its first frame, resized frames are left out
+	if (!slot || (m_Video && size != m_VideoSize))
+		++m_Stats.dropped;
+	else
+	{
+		GpuResources& resources = GpuResources::instance();
+		GLStateCache& state = GLStateCache::instance();
+		if (slot->size != size)
+		{
+			resources.setBufferData(slot->buffer, GL_PIXEL_PACK_BUFFER, (GLsizeiptr)size.x * size.y * 4, nullptr, GL_STREAM_READ);
+			slot->size = size;
+		}
+		else
+			state.bindBuffer(GL_PIXEL_PACK_BUFFER, resources.name(slot->buffer));
+
+		// RGBA rows are 4 bytes aligned, the default pack alignment holds
+		state.bindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+		glReadPixels(0, 0, (GLsizei)size.x, (GLsizei)size.y, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		// a pack buffer left bound would receive every later read back
+		state.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		slot->frame = m_FirstFrame + m_Stats.captured++;
+		slot->state = SLOT_READING;
+		m_Reading.push_back(index);
+	}
+
+	m_Stats.inFlight = 0;
+	for (const Slot& other : m_Slots)
+		m_Stats.inFlight += other.state != SLOT_FREE ? 1 : 0;
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	m_Stats.captureMs = elapsed.count();
+}
+
+
+const CaptureStats& FrameCapture::stats() const
+{
+	return m_Stats;
+}
+
+
+void FrameCapture::reportTo(Profiler& profiler) const
+{
+	profiler.addCounter("CAPTURE CPU MS", m_Stats.captureMs);
+	profiler.addCounter("CAPTURE FRAMES", (double)m_Stats.captured);
+	profiler.addCounter("CAPTURE DROPPED", (double)m_Stats.dropped);
+	profiler.addCounter("CAPTURE IN FLIGHT", (double)m_Stats.inFlight);
+}
+
+
+void FrameCapture::Collect(GLuint64 timeout)
+{
+	GpuResources& resources = GpuResources::instance();
+	GLStateCache& state = GLStateCache::instance();
+	std::vector<Job> jobs;
+
+	// copies complete in order, the first one still running ends the scan
+	size_t done = 0;
+	for (; done < m_Reading.size(); ++done)
+	{
+		Slot& slot = m_Slots[m_Reading[done]];
+		GLenum status = glClientWaitSync(slot.fence, timeout > 0 ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, timeout);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			break;
+		glDeleteSync(slot.fence);
+		slot.fence = nullptr;
+
+		// stays mapped while encoded, nothing else uses the buffer meanwhile
+		state.bindBuffer(GL_PIXEL_PACK_BUFFER, resources.name(slot.buffer));
+		void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)slot.size.x * slot.size.y * 4, GL_MAP_READ_BIT);
+		if (!pixels)
+		{
+			std::cout << "ERROR::FRAME CAPTURE::UNABLE TO MAP FRAME " << slot.frame << std::endl;
+			slot.state = SLOT_FREE;
+			++m_Stats.dropped;
+			continue;
+		}
+		slot.state = SLOT_ENCODING;
+		jobs.push_back({ m_Reading[done], (const unsigned char*)pixels, slot.size, slot.frame });
+	}
+	if (done > 0)
+		state.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	m_Reading.erase(m_Reading.begin(), m_Reading.begin() + done);
+
+	if (jobs.empty())
+		return;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Queue.insert(m_Queue.end(), jobs.begin(), jobs.end());
+	}
+	m_Wake.notify_all();
+}
+
+
+void FrameCapture::Recycle()
+{
+	std::vector<unsigned int> encoded;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		encoded.swap(m_Encoded);
+		m_Stats.encoded = m_EncodedCount;
+	}
+	if (encoded.empty())
+		return;
+
+	GpuResources& resources = GpuResources::instance();
+	GLStateCache& state = GLStateCache::instance();
+	for (unsigned int index : encoded)
+	{
+		state.bindBuffer(GL_PIXEL_PACK_BUFFER, resources.name(m_Slots[index].buffer));
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		m_Slots[index].state = SLOT_FREE;
+	}
+	state.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+
+std::string FrameCapture::FreeVideoPath(const std::string& path)
+{
+	std::string stem = path.substr(0, path.size() - 4);
+	std::string candidate = path;
+	for (unsigned int suffix = 1; FileExists(candidate); ++suffix)
+		candidate = stem + "_" + std::to_string(suffix) + ".y4m";
+	return candidate;
+}
+
+
+unsigned int FrameCapture::FreeFrameNumber(const std::string& prefix, unsigned int first)
+{
+	while (FileExists(PngPath(prefix, first)))
+		++first;
+	return first;
+}
+
+
+void FrameCapture::EncoderLoop()
+{
+	std::vector<unsigned char> scratch;
+	for (;;)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_Wake.wait(lock, [this] { return m_Stop || !m_Queue.empty(); });
+			if (m_Queue.empty())
+				return;
+			job = m_Queue.front();
+			m_Queue.pop_front();
+		}
+
+		if (m_Video)
+			WriteVideoFrame(job, scratch);
+		else
+			WritePng(job, scratch);
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Encoded.push_back(job.slot);
+		++m_EncodedCount;
+	}
+}
+
+
+void FrameCapture::WritePng(const Job& job, std::vector<unsigned char>& scratch)
+{
+	// top row first and no alpha, the window alpha is whatever the last pass wrote
+	size_t width = job.size.x, height = job.size.y;
+	scratch.resize(width * height * 3);
+	for (size_t y = 0; y < height; ++y)
+	{
+		const unsigned char* source = job.pixels + (height - 1 - y) * width * 4;
+		unsigned char* destination = scratch.data() + y * width * 3;
+		for (size_t x = 0; x < width; ++x)
+		{
+			destination[x * 3 + 0] = source[x * 4 + 0];
+			destination[x * 3 + 1] = source[x * 4 + 1];
+			destination[x * 3 + 2] = source[x * 4 + 2];
+		}
+	}
+
+	std::string path = PngPath(m_Path, job.frame);
+	if (!stbi_write_png(path.c_str(), (int)width, (int)height, 3, scratch.data(), (int)(width * 3)))
+		std::cout << "ERROR::FRAME CAPTURE::UNABLE TO WRITE: " << path << std::endl;
+}
+
+
+void FrameCapture::WriteVideoFrame(const Job& job, std::vector<unsigned char>& scratch)
+{
+	size_t width = job.size.x, height = job.size.y;
+	size_t chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+	if (!m_HeaderWritten)
+	{
+		// full range BT.601 with centered chroma samples
+		m_VideoFile << "YUV4MPEG2 W" << width << " H" << height << " F" << m_Options.framesPerSecond << ":1 Ip A1:1 C420jpeg\n";
+		m_HeaderWritten = true;
+	}
+
+	scratch.resize(width * height + 2 * chromaWidth * chromaHeight);
+	unsigned char* luma = scratch.data();
+	unsigned char* blue = luma + width * height;
+	unsigned char* red = blue + chromaWidth * chromaHeight;
+	for (size_t y = 0; y < height; ++y)
+	{
+		const unsigned char* source = job.pixels + (height - 1 - y) * width * 4;
+		for (size_t x = 0; x < width; ++x)
+		{
+			int r = source[x * 4 + 0], g = source[x * 4 + 1], b = source[x * 4 + 2];
+			luma[y * width + x] = (unsigned char)((77 * r + 150 * g + 29 * b + 128) >> 8);
+		}
+	}
+	for (size_t cy = 0; cy < chromaHeight; ++cy)
+	{
+		// source rows of the 2x2 block, the last one repeated on odd sizes
+		size_t y0 = cy * 2, y1 = std::min(y0 + 1, height - 1);
+		const unsigned char* rows[2] = {
+			job.pixels + (height - 1 - y0) * width * 4,
+			job.pixels + (height - 1 - y1) * width * 4 };
+		for (size_t cx = 0; cx < chromaWidth; ++cx)
+		{
+			size_t x0 = cx * 2, x1 = std::min(x0 + 1, width - 1);
+			int r = 0, g = 0, b = 0;
+			for (const unsigned char* row : rows)
+			{
+				r += row[x0 * 4 + 0] + row[x1 * 4 + 0];
+				g += row[x0 * 4 + 1] + row[x1 * 4 + 1];
+				b += row[x0 * 4 + 2] + row[x1 * 4 + 2];
+			}
+			// sums of 4 samples, the offsets keep the shifted values positive
+			blue[cy * chromaWidth + cx] = (unsigned char)std::min(255, (-43 * r - 85 * g + 128 * b + 4 * 32768 + 512) >> 10);
+			red[cy * chromaWidth + cx] = (unsigned char)std::min(255, (128 * r - 107 * g - 21 * b + 4 * 32768 + 512) >> 10);
+		}
+	}
+
+	m_VideoFile << "FRAME\n";
+	m_VideoFile.write((const char*)scratch.data(), (std::streamsize)scratch.size());
+	if (!m_VideoFile)
+		std::cout << "ERROR::FRAME CAPTURE::WRITE FAILED AT FRAME " << job.frame << std::endl;
+}
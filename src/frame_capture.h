@@ -0,0 +1,173 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glm.hpp>
+#include <glew.h>
+#include "gpu_resources.h"
+#include "profiler.h"
+
+/*!
+ * Counters of FrameCapture
+ *
+ */
+struct CaptureStats
+{
+	bool capturing = false;
+	unsigned int captured = 0;      // frames read back since the start
+	unsigned int dropped = 0;       // frames skipped with every buffer of the ring busy
+	unsigned int encoded = 0;       // frames written out
+	unsigned int inFlight = 0;      // frames read back and not written yet
+	double captureMs = 0.0;         // render thread time of the latest capture call
+};
+
+/*!
+ * Recording of the window into a PNG sequence or a Y4M video
+ *
+ * Each frame is read back into a pixel buffer object of a small ring and a
+ * fence is put behind it, glReadPixels then returns without waiting for the
+ * GPU. Later frames poll the fences without waiting, a buffer whose copy is
+ * done is mapped and its memory handed as is to the encoder threads, which
+ * flip the rows, convert and write the file. The buffer goes back to the
+ * ring, unmapped by the render thread, once encoded. When the encoders
+ * fall behind, the ring runs out and frames are dropped rather than waited
+ * for, the render thread only issues commands and maps ready buffers.
+ *
+ * A path ending in .y4m records raw 4:2:0 video, written in order by a
+ * single thread, of the size of the first frame. Any other path is the
+ * prefix of numbered PNG files, encoded on several threads. Nothing
+ * recorded before is overwritten: a video that exists gets a numbered
+ * suffix, PNG numbers go on after the files of earlier recordings.
+ */
+class FrameCapture
+{
+public:
+	struct Options
+	{
+		unsigned int ringSize = 6;          // pixel buffers, frames read back or being encoded
+		unsigned int encoderThreads = 2;    // PNG only, a video has one writer
+		unsigned int framesPerSecond = 60;  // rate written in the video header
+	};
+
+	FrameCapture();
+	explicit FrameCapture(const Options& options);
+	~FrameCapture();
+
+	FrameCapture(const FrameCapture&) = delete;
+	FrameCapture& operator=(const FrameCapture&) = delete;
+
+	/*!
+	 * Start recording, a recording in progress is stopped first
+	 *
+	 * \param path : video file ending in .y4m, or prefix of the PNG files, see the class for existing files
+	 * \return : false(bool) if the video file can not be created
+	 */
+	bool start(const std::string& path);
+
+	/*!
+	 * Finish the frames in flight, waiting for them, and stop the encoders
+	 *
+	 */
+	void stop();
+
+	bool isCapturing() const;
+
+	/*!
+	 * Read back the window and pass on the frames whose copy is done
+	 *
+	 * Called once the frame is complete in the default framebuffer, before the buffers are swapped.
+	 *
+	 * \param windowSize : framebuffer size of the window in pixels
+	 */
+	void capture(const glm::uvec2& windowSize);
+
+	const CaptureStats& stats() const;
+
+	void reportTo(Profiler& profiler) const;
+
+private:
+
+	enum SlotState
+	{
+		SLOT_FREE,
+		SLOT_READING,       // glReadPixels issued, fence not signaled yet
+		SLOT_ENCODING       // mapped, owned by the encoders until the render thread unmaps it
+	};
+
+	struct Slot
+	{
+		GpuHandle buffer;
+		GLsync fence = nullptr;
+		glm::uvec2 size = glm::uvec2(0);
+		unsigned int frame = 0;     // number in the sequence
+		SlotState state = SLOT_FREE;
+	};
+
+	struct Job
+	{
+		unsigned int slot;
+		const unsigned char* pixels;    // RGBA rows, bottom to top
+		glm::uvec2 size;
+		unsigned int frame;
+	};
+
+	Options m_Options;
+	std::vector<Slot> m_Slots;
+	std::vector<unsigned int> m_Reading;    // slots in the order of their read back
+	std::string m_Path;                 // video file actually written, or the PNG prefix
+	unsigned int m_FirstFrame;          // number of the first PNG of the recording
+	unsigned int m_NextFrame;           // first number free after the last recording with m_Path
+	bool m_Video;
+	bool m_Capturing;
+	glm::uvec2 m_VideoSize;             // size of the first frame, every frame of a video has it
+	CaptureStats m_Stats;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_Wake;
+	std::deque<Job> m_Queue;
+	std::vector<unsigned int> m_Encoded;    // slots to unmap
+	std::vector<std::thread> m_Threads;
+	unsigned int m_EncodedCount;
+	bool m_Stop;                        // encoders finish the queue, then return
+	std::ofstream m_VideoFile;
+	bool m_HeaderWritten;               // touched by the video writer only
+
+	/*!
+	 * Map the slots whose fence signaled and queue them for encoding
+	 *
+	 * \param timeout : nanoseconds to wait for the oldest fence, 0 to only poll
+	 */
+	void Collect(GLuint64 timeout);
+
+	/*!
+	 * Unmap the slots the encoders are done with
+	 *
+	 */
+	void Recycle();
+
+	/*!
+	 * Path of the video for a requested one, with a suffix when a file is in the way
+	 *
+	 */
+	static std::string FreeVideoPath(const std::string& path);
+
+	/*!
+	 * Pick the first PNG number of a recording, after the ones already on disk
+	 *
+	 * \param prefix : prefix of the PNG files
+	 * \param first : number to start looking from
+	 */
+	static unsigned int FreeFrameNumber(const std::string& prefix, unsigned int first);
+
+	void EncoderLoop();
+	void WritePng(const Job& job, std::vector<unsigned char>& scratch);
+	void WriteVideoFrame(const Job& job, std::vector<unsigned char>& scratch);
+};
+#endif
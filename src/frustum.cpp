@@ -0,0 +1,66 @@
+#include "frustum.h"
+
+
+Frustum::Frustum()
+{
+	for (int i = 0; i < 6; ++i)
+		m_Planes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+
+Frustum::Frustum(const glm::mat4& viewProjection)
+{
+	// Gribb/Hartmann extraction, glm matrices are column major
+	glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+	glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+	glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+	glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+	m_Planes[0] = row3 + row0;
+	m_Planes[1] = row3 - row0;
+	m_Planes[2] = row3 + row1;
+	m_Planes[3] = row3 - row1;
+	m_Planes[4] = row3 + row2;
+	m_Planes[5] = row3 - row2;
+
+	for (int i = 0; i < 6; ++i)
+	{
+		float length = glm::length(glm::vec3(m_Planes[i]));
+		if (length > 0.0f)
+			m_Planes[i] /= length;
+	}
+}
+
+
+bool Frustum::isSphereVisible(const glm::vec3& center, float radius) const
+{
+	for (int i = 0; i < 6; ++i)
+	{
+		if (glm::dot(glm::vec3(m_Planes[i]), center) + m_Planes[i].w < -radius)
+			return false;
+	}
+	return true;
+}
+
+
+bool Frustum::isBoxVisible(const glm::vec3& boxMin, const glm::vec3& boxMax) const
+{
+	for (int i = 0; i < 6; ++i)
+	{
+		// corner of the box furthest along the plane normal
+		glm::vec3 positive(
+			m_Planes[i].x >= 0.0f ? boxMax.x : boxMin.x,
+			m_Planes[i].y >= 0.0f ? boxMax.y : boxMin.y,
+			m_Planes[i].z >= 0.0f ? boxMax.z : boxMin.z);
+
+		if (glm::dot(glm::vec3(m_Planes[i]), positive) + m_Planes[i].w < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+
+const glm::vec4* Frustum::planes() const
+{
+	return m_Planes;
+}
@@ -0,0 +1,47 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm.hpp>
+
+class Frustum
+{
+public:
+	Frustum();
+
+	/*!
+	 * Extract the six clip planes from a combined matrix
+	 *
+	 * \param viewProjection : projection * view (* model to get planes in model space)
+	 */
+	Frustum(const glm::mat4& viewProjection);
+
+	/*!
+	 * Test a sphere against the frustum
+	 *
+	 * \param center : center of the sphere
+	 * \param radius : radius of the sphere
+	 * \return : false(bool) if the sphere is completely outside of one plane
+	 */
+	bool isSphereVisible(const glm::vec3& center, float radius) const;
+
+	/*!
+	 * Test an axis aligned box against the frustum
+	 *
+	 * \param boxMin : minimum corner of the box
+	 * \param boxMax : maximum corner of the box
+	 * \return : false(bool) if the box is completely outside of one plane
+	 */
+	bool isBoxVisible(const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+
+	/*!
+	 * Planes as (normal, distance), normals pointing inside.
+	 * order is left, right, bottom, top, near, far
+	 *
+	 */
+	const glm::vec4* planes() const;
+
+private:
+
+	glm::vec4 m_Planes[6];
+};
+#endif
@@ -0,0 +1,350 @@
+#include "gl_state_cache.h"
+
+namespace
+{
+	const GLuint UNKNOWN = ~0u;
+}
+
+
+GLStateCache::GLStateCache()
+	: m_Issued(0), m_Avoided(0)
+{
+	invalidate();
+}
+
+
+void GLStateCache::useProgram(GLuint program)
+{
+	if (Changed(m_Program, program))
+		glUseProgram(program);
+}
+
+
+void GLStateCache::bindVertexArray(GLuint vao)
+{
+	if (Changed(m_Vao, vao))
+		glBindVertexArray(vao);
+}
+
+
+void GLStateCache::bindBuffer(GLenum target, GLuint buffer)
+{
+	int slot = BufferSlotOf(target);
+	if (slot < 0)
+	{
+		++m_Issued;
+		glBindBuffer(target, buffer);
+		return;
+	}
+	if (Changed(m_Buffers[slot], buffer))
+		glBindBuffer(target, buffer);
+}
+
+
+void GLStateCache::bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	GLuint* indices = nullptr;
+	if (target == GL_SHADER_STORAGE_BUFFER)
+		indices = m_StorageIndices;
+	else if (target == GL_UNIFORM_BUFFER)
+		indices = m_UniformIndices;
+
+	if (!indices || index >= MAX_BUFFER_INDICES)
+	{
+		++m_Issued;
+		glBindBufferBase(target, index, buffer);
+		return;
+	}
+
+	if (Changed(indices[index], buffer))
+	{
+		glBindBufferBase(target, index, buffer);
+		// binding an index also binds the generic target
+		m_Buffers[BufferSlotOf(target)] = buffer;
+	}
+}
+
+
+void GLStateCache::bindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+	int slot = TextureSlotOf(target);
+	if (slot < 0 || unit >= MAX_TEXTURE_UNITS)
+	{
+		m_ActiveUnit = UNKNOWN;
+		m_Issued += 2;
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(target, texture);
+		return;
+	}
+
+	if (m_Textures[unit][slot] == texture)
+	{
+		++m_Avoided;
+		return;
+	}
+	if (Changed(m_ActiveUnit, unit))
+		glActiveTexture(GL_TEXTURE0 + unit);
+	m_Textures[unit][slot] = texture;
+	++m_Issued;
+	glBindTexture(target, texture);
+}
+
+
+void GLStateCache::bindFramebuffer(GLenum target, GLuint framebuffer)
+{
+	if (target == GL_FRAMEBUFFER)
+	{
+		if (m_DrawFramebuffer == framebuffer && m_ReadFramebuffer == framebuffer)
+		{
+			++m_Avoided;
+			return;
+		}
+		m_DrawFramebuffer = framebuffer;
+		m_ReadFramebuffer = framebuffer;
+		++m_Issued;
+		glBindFramebuffer(target, framebuffer);
+	}
+	else if (target == GL_DRAW_FRAMEBUFFER)
+	{
+		if (Changed(m_DrawFramebuffer, framebuffer))
+			glBindFramebuffer(target, framebuffer);
+	}
+	else if (Changed(m_ReadFramebuffer, framebuffer))
+	{
+		glBindFramebuffer(target, framebuffer);
+	}
+}
+
+
+void GLStateCache::setEnabled(GLenum capability, bool enabled)
+{
+	int slot = CapabilitySlotOf(capability);
+	if (slot < 0 || Changed(m_Capabilities[slot], enabled ? 1 : 0))
+	{
+		if (slot < 0)
+			++m_Issued;
+		if (enabled)
+			glEnable(capability);
+		else
+			glDisable(capability);
+	}
+}
+
+
+void GLStateCache::blendFunc(GLenum source, GLenum destination)
+{
+	if (m_BlendSource == source && m_BlendDestination == destination)
+	{
+		++m_Avoided;
+		return;
+	}
+	m_BlendSource = source;
+	m_BlendDestination = destination;
+	++m_Issued;
+	glBlendFunc(source, destination);
+}
+
+
+void GLStateCache::depthFunc(GLenum function)
+{
+	if (Changed(m_DepthFunc, function))
+		glDepthFunc(function);
+}
+
+
+void GLStateCache::depthMask(GLboolean mask)
+{
+	if (Changed(m_DepthMask, mask ? 1 : 0))
+		glDepthMask(mask);
+}
+
+
+void GLStateCache::colorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha)
+{
+	int mask = (red ? 1 : 0) | (green ? 2 : 0) | (blue ? 4 : 0) | (alpha ? 8 : 0);
+	if (Changed(m_ColorMask, mask))
+		glColorMask(red, green, blue, alpha);
+}
+
+
+void GLStateCache::cullFace(GLenum mode)
+{
+	if (Changed(m_CullFace, mode))
+		glCullFace(mode);
+}
+
+
+void GLStateCache::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	if (m_Viewport[0] == x && m_Viewport[1] == y && m_Viewport[2] == width && m_Viewport[3] == height)
+	{
+		++m_Avoided;
+		return;
+	}
+	m_Viewport[0] = x;
+	m_Viewport[1] = y;
+	m_Viewport[2] = width;
+	m_Viewport[3] = height;
+	++m_Issued;
+	glViewport(x, y, width, height);
+}
+
+
+void GLStateCache::forgetProgram(GLuint program)
+{
+	// a deleted program stays in use until another one is bound
+	if (m_Program == program)
+		m_Program = UNKNOWN;
+}
+
+
+void GLStateCache::forgetVertexArray(GLuint vao)
+{
+	if (m_Vao == vao)
+		m_Vao = 0;
+}
+
+
+void GLStateCache::forgetBuffer(GLuint buffer)
+{
+	for (GLuint& bound : m_Buffers)
+	{
+		if (bound == buffer)
+			bound = 0;
+	}
+	for (unsigned int i = 0; i < MAX_BUFFER_INDICES; ++i)
+	{
+		if (m_StorageIndices[i] == buffer)
+			m_StorageIndices[i] = 0;
+		if (m_UniformIndices[i] == buffer)
+			m_UniformIndices[i] = 0;
+	}
+}
+
+
+void GLStateCache::forgetTexture(GLuint texture)
+{
+	for (unsigned int unit = 0; unit < MAX_TEXTURE_UNITS; ++unit)
+	{
+		for (int slot = 0; slot < TEXTURE_SLOT_COUNT; ++slot)
+		{
+			if (m_Textures[unit][slot] == texture)
+				m_Textures[unit][slot] = 0;
+		}
+	}
+}
+
+
+void GLStateCache::forgetFramebuffer(GLuint framebuffer)
+{
+	if (m_DrawFramebuffer == framebuffer)
+		m_DrawFramebuffer = 0;
+	if (m_ReadFramebuffer == framebuffer)
+		m_ReadFramebuffer = 0;
+}
+
+
+void GLStateCache::invalidate()
+{
+	m_Program = UNKNOWN;
+	m_Vao = UNKNOWN;
+	for (GLuint& bound : m_Buffers)
+		bound = UNKNOWN;
+	for (unsigned int i = 0; i < MAX_BUFFER_INDICES; ++i)
+	{
+		m_StorageIndices[i] = UNKNOWN;
+		m_UniformIndices[i] = UNKNOWN;
+	}
+	for (unsigned int unit = 0; unit < MAX_TEXTURE_UNITS; ++unit)
+	{
+		for (int slot = 0; slot < TEXTURE_SLOT_COUNT; ++slot)
+			m_Textures[unit][slot] = UNKNOWN;
+	}
+	m_ActiveUnit = UNKNOWN;
+	m_DrawFramebuffer = UNKNOWN;
+	m_ReadFramebuffer = UNKNOWN;
+	for (int& capability : m_Capabilities)
+		capability = -1;
+	m_BlendSource = UNKNOWN;
+	m_BlendDestination = UNKNOWN;
+	m_DepthFunc = UNKNOWN;
+	m_DepthMask = -1;
+	m_ColorMask = -1;
+	m_CullFace = UNKNOWN;
+	for (GLint& value : m_Viewport)
+		value = -1;
+}
+
+
+unsigned int GLStateCache::callsIssued() const
+{
+	return m_Issued;
+}
+
+
+unsigned int GLStateCache::callsAvoided() const
+{
+	return m_Avoided;
+}
+
+
+void GLStateCache::reportTo(Profiler& profiler)
+{
+	profiler.addCounter("GL STATE CALLS ISSUED", m_Issued);
+	profiler.addCounter("GL STATE CALLS AVOIDED", m_Avoided);
+	m_Issued = 0;
+	m_Avoided = 0;
+}
+
+
+GLStateCache& GLStateCache::instance()
+{
+	static GLStateCache cache;
+	return cache;
+}
+
+
+int GLStateCache::BufferSlotOf(GLenum target)
+{
+	switch (target)
+	{
+	case GL_ARRAY_BUFFER: return SLOT_ARRAY;
+	case GL_DRAW_INDIRECT_BUFFER: return SLOT_DRAW_INDIRECT;
+	case GL_DISPATCH_INDIRECT_BUFFER: return SLOT_DISPATCH_INDIRECT;
+	case GL_SHADER_STORAGE_BUFFER: return SLOT_SHADER_STORAGE;
+	case GL_UNIFORM_BUFFER: return SLOT_UNIFORM;
+	case GL_PIXEL_PACK_BUFFER: return SLOT_PIXEL_PACK;
+	case GL_PIXEL_UNPACK_BUFFER: return SLOT_PIXEL_UNPACK;
+	case GL_COPY_READ_BUFFER: return SLOT_COPY_READ;
+	case GL_COPY_WRITE_BUFFER: return SLOT_COPY_WRITE;
+	}
+	return -1;
+}
+
+
+int GLStateCache::TextureSlotOf(GLenum target)
+{
+	switch (target)
+	{
+	case GL_TEXTURE_2D: return TEXTURE_2D;
+	case GL_TEXTURE_3D: return TEXTURE_3D;
+	case GL_TEXTURE_2D_ARRAY: return TEXTURE_2D_ARRAY;
+	case GL_TEXTURE_CUBE_MAP: return TEXTURE_CUBE_MAP;
+	}
+	return -1;
+}
+
+
+int GLStateCache::CapabilitySlotOf(GLenum capability)
+{
+	switch (capability)
+	{
+	case GL_BLEND: return CAP_BLEND;
+	case GL_DEPTH_TEST: return CAP_DEPTH_TEST;
+	case GL_CULL_FACE: return CAP_CULL_FACE;
+	case GL_SCISSOR_TEST: return CAP_SCISSOR_TEST;
+	case GL_STENCIL_TEST: return CAP_STENCIL_TEST;
+	case GL_PROGRAM_POINT_SIZE: return CAP_PROGRAM_POINT_SIZE;
+	}
+	return -1;
+}
@@ -0,0 +1,175 @@
+#ifndef GL_STATE_CACHE_H
+#define GL_STATE_CACHE_H
+
+#include <glew.h>
+#include "profiler.h"
+
+/*!
+ * Thin layer over OpenGL state changes
+ *
+ * Remembers the last value set for program, vertex array, buffer, texture,
+ * blend, depth, cull and viewport state and drops calls that would set the
+ * same value again. Code changing state behind its back has to call
+ * invalidate so the next calls reach the driver.
+ * The element array binding belongs to the vertex array and is not cached.
+ */
+class GLStateCache
+{
+public:
+	static const unsigned int MAX_TEXTURE_UNITS = 32;
+	static const unsigned int MAX_BUFFER_INDICES = 16;
+
+	GLStateCache();
+
+	void useProgram(GLuint program);
+	void bindVertexArray(GLuint vao);
+
+	/*!
+	 * Bind a buffer to a generic target, GL_ELEMENT_ARRAY_BUFFER always goes through
+	 *
+	 */
+	void bindBuffer(GLenum target, GLuint buffer);
+
+	/*!
+	 * Bind a buffer to an indexed target (shader storage / uniform)
+	 *
+	 */
+	void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+
+	/*!
+	 * Bind a texture to a texture unit, activating the unit if needed
+	 *
+	 * \param unit : texture unit index, 0 for GL_TEXTURE0
+	 * \param target : GL_TEXTURE_2D, GL_TEXTURE_3D, GL_TEXTURE_2D_ARRAY or GL_TEXTURE_CUBE_MAP
+	 * \param texture : texture name
+	 */
+	void bindTexture(GLuint unit, GLenum target, GLuint texture);
+
+	void bindFramebuffer(GLenum target, GLuint framebuffer);
+
+	/*!
+	 * glEnable/glDisable of GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE, GL_SCISSOR_TEST,
+	 * GL_STENCIL_TEST and GL_PROGRAM_POINT_SIZE, other capabilities go through
+	 *
+	 */
+	void setEnabled(GLenum capability, bool enabled);
+
+	void blendFunc(GLenum source, GLenum destination);
+	void depthFunc(GLenum function);
+	void depthMask(GLboolean mask);
+	void colorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha);
+	void cullFace(GLenum mode);
+	void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+	/*!
+	 * Names deleted while bound fall back to 0 in OpenGL, keep the cache in line
+	 *
+	 */
+	void forgetProgram(GLuint program);
+	void forgetVertexArray(GLuint vao);
+	void forgetBuffer(GLuint buffer);
+	void forgetTexture(GLuint texture);
+	void forgetFramebuffer(GLuint framebuffer);
+
+	/*!
+	 * Forget everything, the next call of each kind reaches the driver
+	 *
+	 */
+	void invalidate();
+
+	unsigned int callsIssued() const;
+	unsigned int callsAvoided() const;
+
+	/*!
+	 * Add the call counters to the profiler frame and restart counting
+	 *
+	 */
+	void reportTo(Profiler& profiler);
+
+	/*!
+	 * Cache of the current context
+	 *
+	 */
+	static GLStateCache& instance();
+
+private:
+
+	enum BufferSlot
+	{
+		SLOT_ARRAY,
+		SLOT_DRAW_INDIRECT,
+		SLOT_DISPATCH_INDIRECT,
+		SLOT_SHADER_STORAGE,
+		SLOT_UNIFORM,
+		SLOT_PIXEL_PACK,
+		SLOT_PIXEL_UNPACK,
+		SLOT_COPY_READ,
+		SLOT_COPY_WRITE,
+		SLOT_COUNT
+	};
+
+	enum TextureSlot
+	{
+		TEXTURE_2D,
+		TEXTURE_3D,
+		TEXTURE_2D_ARRAY,
+		TEXTURE_CUBE_MAP,
+		TEXTURE_SLOT_COUNT
+	};
+
+	enum CapabilitySlot
+	{
+		CAP_BLEND,
+		CAP_DEPTH_TEST,
+		CAP_CULL_FACE,
+		CAP_SCISSOR_TEST,
+		CAP_STENCIL_TEST,
+		CAP_PROGRAM_POINT_SIZE,
+		CAP_COUNT
+	};
+
+	// ~0u marks a value unknown to the cache
+	GLuint m_Program;
+	GLuint m_Vao;
+	GLuint m_Buffers[SLOT_COUNT];
+	GLuint m_StorageIndices[MAX_BUFFER_INDICES];
+	GLuint m_UniformIndices[MAX_BUFFER_INDICES];
+	GLuint m_Textures[MAX_TEXTURE_UNITS][TEXTURE_SLOT_COUNT];
+	GLuint m_ActiveUnit;
+	GLuint m_DrawFramebuffer;
+	GLuint m_ReadFramebuffer;
+	int m_Capabilities[CAP_COUNT];
+	GLenum m_BlendSource;
+	GLenum m_BlendDestination;
+	GLenum m_DepthFunc;
+	int m_DepthMask;
+	int m_ColorMask;
+	GLenum m_CullFace;
+	GLint m_Viewport[4];
+
+	unsigned int m_Issued;
+	unsigned int m_Avoided;
+
+	/*!
+	 * Compare and update one cached value
+	 *
+	 * \return : true(bool) if the call has to reach the driver
+	 */
+	template <typename T>
+	bool Changed(T& cached, T value)
+	{
+		if (cached == value)
+		{
+			++m_Avoided;
+			return false;
+		}
+		cached = value;
+		++m_Issued;
+		return true;
+	}
+
+	static int BufferSlotOf(GLenum target);
+	static int TextureSlotOf(GLenum target);
+	static int CapabilitySlotOf(GLenum capability);
+};
+#endif
@@ -0,0 +1,367 @@
+#include "gpu_resources.h"
+#include <algorithm>
+#include <iostream>
+#include "gl_state_cache.h"
+
+
+GpuResources::GpuResources()
+	: m_Budget(0), m_Frame(1), m_EvictedBytes(0), m_FrameEvictions(0)
+{
+	// slot 0 stands for the null handle
+	m_Slots.resize(1);
+	for (int type = 0; type < GPU_RESOURCE_TYPE_COUNT; ++type)
+	{
+		m_Bytes[type] = 0;
+		m_Counts[type] = 0;
+	}
+}
+
+GpuResources::~GpuResources()
+{
+	// the context is usually gone by now, objects are freed by releaseAll
+}
+
+
+GpuHandle GpuResources::createBuffer(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+{
+	GLuint buffer = 0;
+	glGenBuffers(1, &buffer);
+	GpuHandle handle = Allocate(GPU_BUFFER, buffer);
+	setBufferData(handle, target, size, data, usage);
+	return handle;
+}
+
+
+bool GpuResources::setBufferData(GpuHandle handle, GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+{
+	Slot* slot = Resolve(handle);
+	if (!slot || slot->type != GPU_BUFFER)
+		return false;
+
+	GLStateCache::instance().bindBuffer(target, slot->name);
+	glBufferData(target, size, data, usage);
+	SetBytes(*slot, (uint64_t)size);
+	return true;
+}
+
+
+GpuHandle GpuResources::createTexture(GLenum target)
+{
+	if (target != GL_TEXTURE_2D && target != GL_TEXTURE_3D && target != GL_TEXTURE_2D_ARRAY && target != GL_TEXTURE_CUBE_MAP)
+	{
+		std::cout << "ERROR::GPU RESOURCES::UNSUPPORTED TEXTURE TARGET: " << target << std::endl;
+		return GpuHandle();
+	}
+
+	GLuint texture = 0;
+	glGenTextures(1, &texture);
+	GLStateCache::instance().bindTexture(0, target, texture);
+	return Allocate(GPU_TEXTURE, texture);
+}
+
+
+void GpuResources::setTextureBytes(GpuHandle handle, uint64_t bytes)
+{
+	Slot* slot = Resolve(handle);
+	if (slot && slot->type == GPU_TEXTURE)
+		SetBytes(*slot, bytes);
+}
+
+
+GpuHandle GpuResources::createVertexArray()
+{
+	GLuint vao = 0;
+	glGenVertexArrays(1, &vao);
+	return Allocate(GPU_VERTEX_ARRAY, vao);
+}
+
+
+GpuHandle GpuResources::createFramebuffer()
+{
+	GLuint framebuffer = 0;
+	glGenFramebuffers(1, &framebuffer);
+	return Allocate(GPU_FRAMEBUFFER, framebuffer);
+}
+
+
+GpuHandle GpuResources::adoptProgram(GLuint program)
+{
+	if (program == 0)
+		return GpuHandle();
+	return Allocate(GPU_PROGRAM, program);
+}
+
+
+void GpuResources::release(GpuHandle handle)
+{
+	if (!Resolve(handle))
+		return;
+
+	int group = m_Slots[handle.index].group;
+	if (group >= 0)
+	{
+		std::vector<uint32_t>& slots = m_Groups[group].slots;
+		slots.erase(std::remove(slots.begin(), slots.end(), handle.index), slots.end());
+	}
+	Destroy(handle.index);
+}
+
+
+void GpuResources::releaseAll()
+{
+	for (uint32_t index = 1; index < m_Slots.size(); ++index)
+	{
+		if (m_Slots[index].alive)
+			Destroy(index);
+	}
+	for (Group& group : m_Groups)
+		group.slots.clear();
+}
+
+
+GLuint GpuResources::name(GpuHandle handle) const
+{
+	const Slot* slot = Resolve(handle);
+	return slot ? slot->name : 0;
+}
+
+
+bool GpuResources::isValid(GpuHandle handle) const
+{
+	return Resolve(handle) != nullptr;
+}
+
+
+unsigned int GpuResources::createGroup(const std::function<void()>& onEvict)
+{
+	Group group;
+	group.onEvict = onEvict;
+	group.lastUsedFrame = m_Frame;
+	m_Groups.push_back(group);
+	return (unsigned int)m_Groups.size() - 1;
+}
+
+
+void GpuResources::addToGroup(GpuHandle handle, unsigned int group)
+{
+	Slot* slot = Resolve(handle);
+	if (!slot || group >= m_Groups.size() || slot->group == (int)group)
+		return;
+
+	if (slot->group >= 0)
+	{
+		std::vector<uint32_t>& previous = m_Groups[slot->group].slots;
+		previous.erase(std::remove(previous.begin(), previous.end(), handle.index), previous.end());
+	}
+	slot->group = (int)group;
+	m_Groups[group].slots.push_back(handle.index);
+}
+
+
+void GpuResources::touchGroup(unsigned int group)
+{
+	if (group < m_Groups.size())
+		m_Groups[group].lastUsedFrame = m_Frame;
+}
+
+
+bool GpuResources::isGroupResident(unsigned int group) const
+{
+	return group < m_Groups.size() && !m_Groups[group].slots.empty();
+}
+
+
+void GpuResources::setBudget(uint64_t bytes)
+{
+	m_Budget = bytes;
+}
+
+
+void GpuResources::beginFrame()
+{
+	++m_Frame;
+	m_FrameEvictions = 0;
+}
+
+
+unsigned int GpuResources::enforceBudget()
+{
+	uint64_t total = TotalBytes();
+	if (m_Budget == 0 || total <= m_Budget)
+		return 0;
+
+	// resident groups not used by this frame, least recently used first
+	std::vector<unsigned int> candidates;
+	for (unsigned int group = 0; group < m_Groups.size(); ++group)
+	{
+		if (!m_Groups[group].slots.empty() && m_Groups[group].lastUsedFrame < m_Frame)
+			candidates.push_back(group);
+	}
+	std::sort(candidates.begin(), candidates.end(), [this](unsigned int a, unsigned int b)
+	{
+		return m_Groups[a].lastUsedFrame < m_Groups[b].lastUsedFrame;
+	});
+
+	unsigned int evicted = 0;
+	for (unsigned int group : candidates)
+	{
+		if (total <= m_Budget)
+			break;
+
+		Group& victim = m_Groups[group];
+		for (uint32_t index : victim.slots)
+		{
+			total -= m_Slots[index].bytes;
+			m_EvictedBytes += m_Slots[index].bytes;
+			Destroy(index);
+		}
+		victim.slots.clear();
+		++evicted;
+
+		if (victim.onEvict)
+			victim.onEvict();
+	}
+	m_FrameEvictions += evicted;
+	return evicted;
+}
+
+
+GpuResourceStats GpuResources::stats() const
+{
+	GpuResourceStats stats;
+	for (int type = 0; type < GPU_RESOURCE_TYPE_COUNT; ++type)
+	{
+		stats.count[type] = m_Counts[type];
+		stats.bytes[type] = m_Bytes[type];
+		stats.totalBytes += m_Bytes[type];
+	}
+	stats.budget = m_Budget;
+	for (const Group& group : m_Groups)
+	{
+		if (group.slots.empty())
+			++stats.evictedGroups;
+		else
+			++stats.residentGroups;
+	}
+	stats.evictedBytes = m_EvictedBytes;
+	return stats;
+}
+
+
+void GpuResources::reportTo(Profiler& profiler) const
+{
+	const double MB = 1.0 / (1024.0 * 1024.0);
+	profiler.addCounter("GPU BUFFER MB", m_Bytes[GPU_BUFFER] * MB);
+	profiler.addCounter("GPU TEXTURE MB", m_Bytes[GPU_TEXTURE] * MB);
+	profiler.addCounter("GPU OBJECTS", (double)(m_Counts[GPU_BUFFER] + m_Counts[GPU_TEXTURE] +
+		m_Counts[GPU_VERTEX_ARRAY] + m_Counts[GPU_PROGRAM] + m_Counts[GPU_FRAMEBUFFER]));
+	profiler.addCounter("GPU EVICTIONS", m_FrameEvictions);
+}
+
+
+GpuResources& GpuResources::instance()
+{
+	static GpuResources resources;
+	return resources;
+}
+
+
+GpuHandle GpuResources::Allocate(GpuResourceType type, GLuint name)
+{
+	uint32_t index;
+	if (!m_FreeSlots.empty())
+	{
+		index = m_FreeSlots.back();
+		m_FreeSlots.pop_back();
+	}
+	else
+	{
+		index = (uint32_t)m_Slots.size();
+		m_Slots.push_back(Slot());
+	}
+
+	Slot& slot = m_Slots[index];
+	slot.name = name;
+	slot.type = type;
+	slot.bytes = 0;
+	slot.group = -1;
+	slot.alive = true;
+	++m_Counts[type];
+
+	GpuHandle handle;
+	handle.index = index;
+	handle.generation = slot.generation;
+	return handle;
+}
+
+
+GpuResources::Slot* GpuResources::Resolve(GpuHandle handle)
+{
+	if (handle.index == 0 || handle.index >= m_Slots.size())
+		return nullptr;
+	Slot& slot = m_Slots[handle.index];
+	return slot.alive && slot.generation == handle.generation ? &slot : nullptr;
+}
+
+
+const GpuResources::Slot* GpuResources::Resolve(GpuHandle handle) const
+{
+	return const_cast<GpuResources*>(this)->Resolve(handle);
+}
+
+
+void GpuResources::SetBytes(Slot& slot, uint64_t bytes)
+{
+	m_Bytes[slot.type] -= slot.bytes;
+	m_Bytes[slot.type] += bytes;
+	slot.bytes = bytes;
+}
+
+
+void GpuResources::Destroy(uint32_t index)
+{
+	Slot& slot = m_Slots[index];
+	GLStateCache& state = GLStateCache::instance();
+	switch (slot.type)
+	{
+	case GPU_BUFFER:
+		state.forgetBuffer(slot.name);
+		glDeleteBuffers(1, &slot.name);
+		break;
+	case GPU_TEXTURE:
+		state.forgetTexture(slot.name);
+		glDeleteTextures(1, &slot.name);
+		break;
+	case GPU_VERTEX_ARRAY:
+		state.forgetVertexArray(slot.name);
+		glDeleteVertexArrays(1, &slot.name);
+		break;
+	case GPU_PROGRAM:
+		state.forgetProgram(slot.name);
+		glDeleteProgram(slot.name);
+		break;
+	case GPU_FRAMEBUFFER:
+		state.forgetFramebuffer(slot.name);
+		glDeleteFramebuffers(1, &slot.name);
+		break;
+	default:
+		break;
+	}
+
+	SetBytes(slot, 0);
+	--m_Counts[slot.type];
+	slot.name = 0;
+	slot.group = -1;
+	slot.alive = false;
+	++slot.generation;
+	m_FreeSlots.push_back(index);
+}
+
+
+uint64_t GpuResources::TotalBytes() const
+{
+	uint64_t total = 0;
+	for (int type = 0; type < GPU_RESOURCE_TYPE_COUNT; ++type)
+		total += m_Bytes[type];
+	return total;
+}
@@ -0,0 +1,239 @@
+#ifndef GPU_RESOURCES_H
+#define GPU_RESOURCES_H
+
+#include <glew.h>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "profiler.h"
+
+enum GpuResourceType
+{
+	GPU_BUFFER,
+	GPU_TEXTURE,
+	GPU_VERTEX_ARRAY,
+	GPU_PROGRAM,
+	GPU_FRAMEBUFFER,
+	GPU_RESOURCE_TYPE_COUNT
+};
+
+/*!
+ * Reference to a GL object owned by GpuResources
+ *
+ * The generation is bumped every time a slot is released, so a handle kept
+ * after its object was released or evicted resolves to 0 instead of to
+ * whatever object reuses the slot.
+ */
+struct GpuHandle
+{
+	uint32_t index = 0;      // 0 is the null handle
+	uint32_t generation = 0;
+
+	bool isNull() const
+	{
+		return index == 0;
+	}
+};
+
+/*!
+ * Live numbers of GpuResources
+ *
+ */
+struct GpuResourceStats
+{
+	unsigned int count[GPU_RESOURCE_TYPE_COUNT] = {};
+	uint64_t bytes[GPU_RESOURCE_TYPE_COUNT] = {};
+	uint64_t totalBytes = 0;
+	uint64_t budget = 0;          // 0 when unlimited
+	unsigned int residentGroups = 0;
+	unsigned int evictedGroups = 0;
+	uint64_t evictedBytes = 0;    // since start up
+};
+
+/*!
+ * Owner of the GL objects of the viewer
+ *
+ * Objects are created through the manager and referred to by generational
+ * handles. Byte sizes are tracked per category so a memory budget can be
+ * enforced: resources are put into residency groups (usually one per mesh),
+ * groups are touched when visible and the least recently used groups are
+ * evicted once the budget is exceeded. The owner of an evicted group is told
+ * through its callback and can upload it again when it becomes visible.
+ */
+class GpuResources
+{
+public:
+	GpuResources();
+	~GpuResources();
+
+	GpuResources(const GpuResources&) = delete;
+	GpuResources& operator=(const GpuResources&) = delete;
+
+	/*!
+	 * Create a buffer and fill it
+	 *
+	 * \param target : binding point used for the upload, e.g. GL_ARRAY_BUFFER
+	 * \param size : size in bytes
+	 * \param data : initial content, can be nullptr
+	 * \param usage : usage hint of glBufferData
+	 */
+	GpuHandle createBuffer(GLenum target, GLsizeiptr size, const void* data, GLenum usage);
+
+	/*!
+	 * Reallocate the storage of a buffer, its tracked size follows
+	 *
+	 * \return : false(bool) if the handle is stale
+	 */
+	bool setBufferData(GpuHandle handle, GLenum target, GLsizeiptr size, const void* data, GLenum usage);
+
+	/*!
+	 * Create an empty texture bound to unit 0, storage is allocated by the caller
+	 *
+	 * The first bind fixes the type of the texture, so the name is ready for
+	 * glTexStorage* on target once this returns.
+	 *
+	 * \param target : GL_TEXTURE_2D, GL_TEXTURE_3D, GL_TEXTURE_2D_ARRAY or GL_TEXTURE_CUBE_MAP
+	 * \return : null handle if target is not one of those
+	 */
+	GpuHandle createTexture(GLenum target);
+
+	/*!
+	 * Declare the storage size of a texture once allocated
+	 *
+	 */
+	void setTextureBytes(GpuHandle handle, uint64_t bytes);
+
+	GpuHandle createVertexArray();
+
+	/*!
+	 * Create a framebuffer, attachments are set by the caller
+	 *
+	 */
+	GpuHandle createFramebuffer();
+
+	/*!
+	 * Take ownership of a linked program
+	 *
+	 */
+	GpuHandle adoptProgram(GLuint program);
+
+	/*!
+	 * Delete the GL object, the handle and all its copies become stale
+	 *
+	 */
+	void release(GpuHandle handle);
+
+	/*!
+	 * Delete every object, call while the context is still current
+	 *
+	 */
+	void releaseAll();
+
+	/*!
+	 * GL name of a handle
+	 *
+	 * \return : 0 if the handle is null, released or evicted
+	 */
+	GLuint name(GpuHandle handle) const;
+
+	bool isValid(GpuHandle handle) const;
+
+	/*!
+	 * Create a residency group
+	 *
+	 * \param onEvict : called after the resources of the group were released
+	 * \return : id of the group, groups live as long as the manager
+	 */
+	unsigned int createGroup(const std::function<void()>& onEvict);
+
+	/*!
+	 * Put a resource into a group, it is then released with the group
+	 *
+	 */
+	void addToGroup(GpuHandle handle, unsigned int group);
+
+	/*!
+	 * Mark a group as used by the current frame, it will not be evicted this frame
+	 *
+	 */
+	void touchGroup(unsigned int group);
+
+	/*!
+	 * Check if the resources of a group are on the GPU
+	 *
+	 * \return : false(bool) once evicted, true again after new resources are added
+	 */
+	bool isGroupResident(unsigned int group) const;
+
+	/*!
+	 * Set the memory budget
+	 *
+	 * \param bytes : budget over all categories, 0 for unlimited
+	 */
+	void setBudget(uint64_t bytes);
+
+	/*!
+	 * Start a new frame for the LRU bookkeeping
+	 *
+	 */
+	void beginFrame();
+
+	/*!
+	 * Evict least recently used groups not touched this frame until the total
+	 * fits the budget, call after the visible groups were touched
+	 *
+	 * \return : number of evicted groups
+	 */
+	unsigned int enforceBudget();
+
+	GpuResourceStats stats() const;
+
+	/*!
+	 * Bytes per category, counts and evictions
+	 *
+	 */
+	void reportTo(Profiler& profiler) const;
+
+	/*!
+	 * Manager of the current GL context
+	 *
+	 */
+	static GpuResources& instance();
+
+private:
+
+	struct Slot
+	{
+		GLuint name = 0;
+		uint32_t generation = 1;
+		GpuResourceType type = GPU_BUFFER;
+		uint64_t bytes = 0;
+		int group = -1;
+		bool alive = false;
+	};
+
+	struct Group
+	{
+		std::function<void()> onEvict;
+		std::vector<uint32_t> slots;
+		uint64_t lastUsedFrame = 0;
+	};
+
+	std::vector<Slot> m_Slots;
+	std::vector<uint32_t> m_FreeSlots;
+	std::vector<Group> m_Groups;
+	uint64_t m_Bytes[GPU_RESOURCE_TYPE_COUNT];
+	unsigned int m_Counts[GPU_RESOURCE_TYPE_COUNT];
+	uint64_t m_Budget;
+	uint64_t m_Frame;
+	uint64_t m_EvictedBytes;
+	unsigned int m_FrameEvictions;
+
+	GpuHandle Allocate(GpuResourceType type, GLuint name);
+	Slot* Resolve(GpuHandle handle);
+	const Slot* Resolve(GpuHandle handle) const;
+	void SetBytes(Slot& slot, uint64_t bytes);
+	void Destroy(uint32_t index);
+	uint64_t TotalBytes() const;
+};
+#endif
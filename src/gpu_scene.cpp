@@ -0,0 +1,204 @@
+#include "gpu_scene.h"
+#include "frustum.h"
+#include "draw_commands.h"
+#include "gl_state_cache.h"
+
+
+GpuScene::GpuScene()
+	: m_PlanesLocation(-1), m_ObjectCountLocation(-1)
+{
+}
+
+GpuScene::~GpuScene()
+{
+	Release();
+}
+
+
+unsigned int GpuScene::addMesh(const Mesh& mesh)
+{
+	MeshRange range;
+	range.indexCount = (unsigned int)mesh.indices.size();
+	range.firstIndex = (unsigned int)m_Indices.size();
+	range.baseVertex = (int)(m_Vertices.size() / 6);
+
+	// interleaved position + normal, same layout as the single object path
+	std::vector<float> vertices = InterleavePositionsNormals(mesh);
+	m_Vertices.insert(m_Vertices.end(), vertices.begin(), vertices.end());
+	m_Indices.insert(m_Indices.end(), mesh.indices.begin(), mesh.indices.end());
+	range.sphere = ComputeBoundingSphere(mesh);
+
+	m_Meshes.push_back(range);
+	return (unsigned int)m_Meshes.size() - 1;
+}
+
+
+unsigned int GpuScene::addObject(unsigned int meshIndex, const glm::mat4& model)
+{
+	const MeshRange& range = m_Meshes[meshIndex];
+
+	ObjectData object;
+	object.model = model;
+	object.sphere = range.sphere;
+	object.indexCount = range.indexCount;
+	object.firstIndex = range.firstIndex;
+	object.baseVertex = range.baseVertex;
+	object.padding = 0;
+	m_Objects.push_back(object);
+	return (unsigned int)m_Objects.size() - 1;
+}
+
+
+void GpuScene::setObjectTransform(unsigned int objectIndex, const glm::mat4& model)
+{
+	m_Objects[objectIndex].model = model;
+	GLuint objectBuffer = GpuResources::instance().name(m_ObjectBuffer);
+	if (objectBuffer)
+	{
+		GLStateCache::instance().bindBuffer(GL_SHADER_STORAGE_BUFFER, objectBuffer);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, objectIndex * sizeof(ObjectData), sizeof(glm::mat4), &model[0][0]);
+	}
+}
+
+
+void GpuScene::upload(const std::string& resourceDir, const std::vector<std::string>& keywords)
+{
+	Release();
+	GpuResources& resources = GpuResources::instance();
+	GLStateCache& state = GLStateCache::instance();
+
+	// object id attribute, one value per instance picked through baseInstance
+	std::vector<unsigned int> objectIds(m_Objects.size());
+	for (size_t i = 0; i < objectIds.size(); ++i)
+		objectIds[i] = (unsigned int)i;
+
+	// no vertex array bound, the element buffer would attach to it
+	state.bindVertexArray(0);
+	m_VertexBuffer = resources.createBuffer(GL_ARRAY_BUFFER, m_Vertices.size() * sizeof(float), m_Vertices.data(), GL_STATIC_DRAW);
+	m_ObjectIdBuffer = resources.createBuffer(GL_ARRAY_BUFFER, objectIds.size() * sizeof(unsigned int), objectIds.data(), GL_STATIC_DRAW);
+	m_IndexBuffer = resources.createBuffer(GL_ELEMENT_ARRAY_BUFFER, m_Indices.size() * sizeof(unsigned int), m_Indices.data(), GL_STATIC_DRAW);
+	m_ObjectBuffer = resources.createBuffer(GL_SHADER_STORAGE_BUFFER, m_Objects.size() * sizeof(ObjectData), m_Objects.data(), GL_DYNAMIC_DRAW);
+	m_CommandBuffer = resources.createBuffer(GL_SHADER_STORAGE_BUFFER, m_Objects.size() * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_COPY);
+
+	m_Vao = CreateVertexArray(true);
+	m_DepthVao = CreateVertexArray(false);
+
+	m_CullShader.reset(new Shader((resourceDir + "cull_compute.glsl").c_str()));
+	m_DrawShader.reset(new Shader(ShaderPreprocessor::Load(resourceDir + "vertex_indirect.glsl", resourceDir + "fragment.glsl", keywords)));
+	m_DepthShader.reset(new Shader(ShaderPreprocessor::Load(resourceDir + "vertex_indirect.glsl", resourceDir + "fragment_shadow.glsl", { "NO_NORMALS" })));
+	m_PlanesLocation = glGetUniformLocation(m_CullShader->id(), "frustumPlanes");
+	m_ObjectCountLocation = glGetUniformLocation(m_CullShader->id(), "objectCount");
+}
+
+
+void GpuScene::cull(const glm::mat4& viewProjection)
+{
+	if (m_Objects.empty())
+		return;
+
+	Frustum frustum(viewProjection);
+
+	m_CullShader->use();
+	glUniform4fv(m_PlanesLocation, 6, &frustum.planes()[0][0]);
+	glUniform1i(m_ObjectCountLocation, (int)m_Objects.size());
+
+	GpuResources& resources = GpuResources::instance();
+	GLStateCache& state = GLStateCache::instance();
+	state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, resources.name(m_ObjectBuffer));
+	state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, resources.name(m_CommandBuffer));
+	glDispatchCompute(((unsigned int)m_Objects.size() + 63) / 64, 1, 1);
+
+	// commands are read by the indirect draw, objects by the vertex shader
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+
+void GpuScene::draw() const
+{
+	if (m_Objects.empty())
+		return;
+
+	const GpuResources& resources = GpuResources::instance();
+	GLStateCache& state = GLStateCache::instance();
+	state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, resources.name(m_ObjectBuffer));
+	state.bindVertexArray(resources.name(m_Vao));
+	state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, resources.name(m_CommandBuffer));
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, (GLsizei)m_Objects.size(), 0);
+}
+
+
+void GpuScene::drawDepth() const
+{
+	if (m_Objects.empty())
+		return;
+
+	const GpuResources& resources = GpuResources::instance();
+	GLStateCache& state = GLStateCache::instance();
+	state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, resources.name(m_ObjectBuffer));
+	state.bindVertexArray(resources.name(m_DepthVao));
+	state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, resources.name(m_CommandBuffer));
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, (GLsizei)m_Objects.size(), 0);
+}
+
+
+Shader& GpuScene::drawShader()
+{
+	return *m_DrawShader;
+}
+
+
+Shader& GpuScene::depthShader()
+{
+	return *m_DepthShader;
+}
+
+
+unsigned int GpuScene::objectCount() const
+{
+	return (unsigned int)m_Objects.size();
+}
+
+
+void GpuScene::Release()
+{
+	GpuResources& resources = GpuResources::instance();
+	for (GpuHandle* handle : { &m_Vao, &m_DepthVao, &m_VertexBuffer, &m_IndexBuffer, &m_ObjectIdBuffer, &m_ObjectBuffer, &m_CommandBuffer })
+	{
+		resources.release(*handle);
+		*handle = GpuHandle();
+	}
+	m_CullShader.reset();
+	m_DrawShader.reset();
+	m_DepthShader.reset();
+	m_PlanesLocation = -1;
+	m_ObjectCountLocation = -1;
+}
+
+
+GpuHandle GpuScene::CreateVertexArray(bool normals) const
+{
+	GpuResources& resources = GpuResources::instance();
+	GLStateCache& state = GLStateCache::instance();
+	GpuHandle vao = resources.createVertexArray();
+	state.bindVertexArray(resources.name(vao));
+
+	// position attribute
+	state.bindBuffer(GL_ARRAY_BUFFER, resources.name(m_VertexBuffer));
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+	// normal attribute
+	if (normals)
+	{
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+		glEnableVertexAttribArray(1);
+	}
+
+	state.bindBuffer(GL_ARRAY_BUFFER, resources.name(m_ObjectIdBuffer));
+	glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, sizeof(unsigned int), (void*)0);
+	glVertexAttribDivisor(2, 1);
+	glEnableVertexAttribArray(2);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, resources.name(m_IndexBuffer));
+	state.bindVertexArray(0);
+	return vao;
+}
@@ -0,0 +1,154 @@
+#ifndef GPU_SCENE_H
+#define GPU_SCENE_H
+
+#include <memory>
+#include <vector>
+#include <glm.hpp>
+#include "mesh.h"
+#include "shader.h"
+#include "gpu_resources.h"
+
+/*!
+ * GPU driven scene
+ *
+ * Every mesh lives in one shared vertex/index buffer and every object in a
+ * shader storage buffer. A compute shader culls the objects against the
+ * frustum and writes the indirect command buffer, the whole scene is then
+ * submitted with a single glMultiDrawElementsIndirect, so the CPU cost of a
+ * frame does not depend on the number of objects.
+ */
+class GpuScene
+{
+public:
+	GpuScene();
+	~GpuScene();
+
+	GpuScene(const GpuScene&) = delete;
+	GpuScene& operator=(const GpuScene&) = delete;
+
+	/*!
+	 * Append a mesh to the mega buffers, must be called before upload
+	 *
+	 * \param mesh : mesh with positions, normals and indices
+	 * \return : mesh index to use with addObject
+	 */
+	unsigned int addMesh(const Mesh& mesh);
+
+	/*!
+	 * Place an instance of a mesh in the scene
+	 *
+	 * \param meshIndex : as returned by addMesh
+	 * \param model : model matrix of the object
+	 * \return : object index
+	 */
+	unsigned int addObject(unsigned int meshIndex, const glm::mat4& model);
+
+	/*!
+	 * Move an object, the storage buffer is patched if already uploaded
+	 *
+	 */
+	void setObjectTransform(unsigned int objectIndex, const glm::mat4& model);
+
+	/*!
+	 * Create the GPU buffers and load the culling and draw shaders.
+	 * Calling it again releases the previous objects and uploads the scene anew.
+	 *
+	 * \param resourceDir : directory holding the glsl files, with trailing slash
+	 * \param keywords : defines of the draw shader, see res/fragment.glsl
+	 */
+	void upload(const std::string& resourceDir, const std::vector<std::string>& keywords = std::vector<std::string>());
+
+	/*!
+	 * Run the culling compute shader, fills the indirect command buffer
+	 *
+	 * \param viewProjection : projection * view of the camera
+	 */
+	void cull(const glm::mat4& viewProjection);
+
+	/*!
+	 * Submit the whole scene with one indirect multi draw.
+	 * The draw shader has to be in use with view and projection set.
+	 *
+	 */
+	void draw() const;
+
+	/*!
+	 * Submit the positions of the whole scene for a depth pre-pass.
+	 * The depth shader has to be in use with view and projection set.
+	 *
+	 */
+	void drawDepth() const;
+
+	/*!
+	 * Program to draw the scene with, res/vertex_indirect.glsl + res/fragment.glsl
+	 *
+	 */
+	Shader& drawShader();
+
+	/*!
+	 * Depth only program, res/vertex_indirect.glsl without normals + res/fragment_shadow.glsl
+	 *
+	 */
+	Shader& depthShader();
+
+	unsigned int objectCount() const;
+
+private:
+
+	/*!
+	 * Per object record, std430 layout shared with res/cull_compute.glsl
+	 *
+	 */
+	struct ObjectData
+	{
+		glm::mat4 model;
+		glm::vec4 sphere;
+		unsigned int indexCount;
+		unsigned int firstIndex;
+		int baseVertex;
+		unsigned int padding;
+	};
+
+	struct MeshRange
+	{
+		unsigned int indexCount;
+		unsigned int firstIndex;
+		int baseVertex;
+		glm::vec4 sphere;
+	};
+
+	// kept after upload so the scene can be uploaded again
+	std::vector<float> m_Vertices;
+	std::vector<unsigned int> m_Indices;
+	std::vector<MeshRange> m_Meshes;
+	std::vector<ObjectData> m_Objects;
+
+	GpuHandle m_Vao;
+	GpuHandle m_DepthVao;       // positions and object ids only
+	GpuHandle m_VertexBuffer;
+	GpuHandle m_IndexBuffer;
+	GpuHandle m_ObjectIdBuffer;
+	GpuHandle m_ObjectBuffer;
+	GpuHandle m_CommandBuffer;
+
+	std::unique_ptr<Shader> m_CullShader;
+	std::unique_ptr<Shader> m_DrawShader;
+	std::unique_ptr<Shader> m_DepthShader;
+	// looked up once per upload, the culling shader is not hot reloaded
+	GLint m_PlanesLocation;
+	GLint m_ObjectCountLocation;
+
+	/*!
+	 * Release the GL objects of the last upload
+	 *
+	 */
+	void Release();
+
+	/*!
+	 * Create a vertex array over the shared buffers
+	 *
+	 * \param normals : whether the normal attribute is fetched
+	 */
+	GpuHandle CreateVertexArray(bool normals) const;
+};
+#endif
@@ -0,0 +1,77 @@
+#include "gpu_timer.h"
+
+
+GpuTimer::GpuTimer()
+	: m_Next(0), m_Running(false), m_Milliseconds(0.0), m_SampleCount(0)
+{
+	glGenQueries(QUERY_COUNT, m_Starts);
+	glGenQueries(QUERY_COUNT, m_Ends);
+	for (bool& pending : m_Pending)
+		pending = false;
+}
+
+GpuTimer::~GpuTimer()
+{
+	glDeleteQueries(QUERY_COUNT, m_Starts);
+	glDeleteQueries(QUERY_COUNT, m_Ends);
+}
+
+
+void GpuTimer::begin()
+{
+	Collect();
+	if (m_Pending[m_Next])
+		return;
+
+	glQueryCounter(m_Starts[m_Next], GL_TIMESTAMP);
+	m_Running = true;
+}
+
+
+void GpuTimer::end()
+{
+	if (!m_Running)
+		return;
+
+	glQueryCounter(m_Ends[m_Next], GL_TIMESTAMP);
+	m_Pending[m_Next] = true;
+	m_Next = (m_Next + 1) % QUERY_COUNT;
+	m_Running = false;
+}
+
+
+double GpuTimer::milliseconds() const
+{
+	return m_Milliseconds;
+}
+
+
+unsigned int GpuTimer::sampleCount() const
+{
+	return m_SampleCount;
+}
+
+
+void GpuTimer::Collect()
+{
+	// the oldest query in flight is the one right after the last issued
+	for (unsigned int i = 0; i < QUERY_COUNT; ++i)
+	{
+		unsigned int query = (m_Next + i) % QUERY_COUNT;
+		if (!m_Pending[query])
+			continue;
+
+		// the end stamp lands after the start one
+		GLint available = 0;
+		glGetQueryObjectiv(m_Ends[query], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			break;
+
+		GLuint64 start = 0, end = 0;
+		glGetQueryObjectui64v(m_Starts[query], GL_QUERY_RESULT, &start);
+		glGetQueryObjectui64v(m_Ends[query], GL_QUERY_RESULT, &end);
+		m_Pending[query] = false;
+		m_Milliseconds = end > start ? (double)(end - start) * 1e-6 : 0.0;
+		++m_SampleCount;
+	}
+}
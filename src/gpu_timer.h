@@ -0,0 +1,62 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glew.h>
+
+/*!
+ * GPU duration of a span of commands
+ *
+ * Pairs of GL_TIMESTAMP queries go round a small ring and are read back
+ * once available, a few frames later, so measuring never stalls the CPU.
+ * Timestamps, unlike GL_TIME_ELAPSED queries, let timers run inside each
+ * other.
+ */
+class GpuTimer
+{
+public:
+	GpuTimer();
+	~GpuTimer();
+
+	GpuTimer(const GpuTimer&) = delete;
+	GpuTimer& operator=(const GpuTimer&) = delete;
+
+	/*!
+	 * Start measuring, skipped when every query of the ring is still in flight
+	 *
+	 */
+	void begin();
+
+	void end();
+
+	/*!
+	 * Latest available measure
+	 *
+	 * \return : milliseconds, 0 until the first query comes back
+	 */
+	double milliseconds() const;
+
+	/*!
+	 * Number of measures read back so far, to tell a new measure from an old one
+	 *
+	 */
+	unsigned int sampleCount() const;
+
+private:
+
+	static const unsigned int QUERY_COUNT = 4;
+
+	GLuint m_Starts[QUERY_COUNT];
+	GLuint m_Ends[QUERY_COUNT];
+	bool m_Pending[QUERY_COUNT];
+	unsigned int m_Next;
+	bool m_Running;
+	double m_Milliseconds;
+	unsigned int m_SampleCount;
+
+	/*!
+	 * Read the queries that completed, oldest first
+	 *
+	 */
+	void Collect();
+};
+#endif
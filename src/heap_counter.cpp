@@ -0,0 +1,83 @@
+#include "heap_counter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifndef NDEBUG
+
+static std::atomic<uint64_t> ALLOCATION_COUNT(0);
+
+static void* CountedAllocate(std::size_t size)
+{
+	ALLOCATION_COUNT.fetch_add(1, std::memory_order_relaxed);
+	void* memory = std::malloc(size ? size : 1);
+	if (!memory)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new(std::size_t size)
+{
+	return CountedAllocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+	return CountedAllocate(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	ALLOCATION_COUNT.fetch_add(1, std::memory_order_relaxed);
+	return std::malloc(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	ALLOCATION_COUNT.fetch_add(1, std::memory_order_relaxed);
+	return std::malloc(size ? size : 1);
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+uint64_t HeapCounter::AllocationCount()
+{
+	return ALLOCATION_COUNT.load(std::memory_order_relaxed);
+}
+
+bool HeapCounter::IsEnabled()
+{
+	return true;
+}
+
+#else
+
+uint64_t HeapCounter::AllocationCount()
+{
+	return 0;
+}
+
+bool HeapCounter::IsEnabled()
+{
+	return false;
+}
+
+#endif
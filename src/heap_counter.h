@@ -0,0 +1,25 @@
+#ifndef HEAP_COUNTER_H
+#define HEAP_COUNTER_H
+
+#include <cstdint>
+
+/*!
+ * Count of global operator new calls since start up
+ *
+ * Debug builds replace the global operator new to count every heap
+ * allocation, the difference between two frames tells if the hot path still
+ * allocates. Release builds do not count and always return 0.
+ */
+namespace HeapCounter
+{
+	/*!
+	 * \return : number of allocations made through operator new
+	 */
+	uint64_t AllocationCount();
+
+	/*!
+	 * \return : false(bool) if the counter is compiled out
+	 */
+	bool IsEnabled();
+}
+#endif
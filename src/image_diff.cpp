@@ -0,0 +1,165 @@
+#include "image_diff.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+
+namespace
+{
+	bool ReadPpmValue(std::istream& file, unsigned int& value)
+	{
+		int c = file.get();
+		while (file && (isspace(c) || c == '#'))
+		{
+			if (c == '#')
+			{
+				while (file && c != '\n')
+					c = file.get();
+			}
+			c = file.get();
+		}
+		if (!file || !isdigit(c))
+			return false;
+
+		value = 0;
+		while (file && isdigit(c))
+		{
+			value = value * 10 + (unsigned int)(c - '0');
+			c = file.get();
+		}
+		// the single whitespace after the last value is part of the header
+		return (bool)file;
+	}
+
+	// sRGB to CIELAB under D65
+	void ToLab(const RgbImage& image, std::vector<glm::vec3>& lab)
+	{
+		float linear[256];
+		for (int i = 0; i < 256; ++i)
+		{
+			float c = (float)i / 255.0f;
+			linear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+		auto f = [](float t)
+		{
+			return t > 0.008856f ? std::cbrt(t) : 7.787f * t + 16.0f / 116.0f;
+		};
+
+		size_t count = (size_t)image.size.x * image.size.y;
+		lab.resize(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			float r = linear[image.pixels[i * 3 + 0]], g = linear[image.pixels[i * 3 + 1]], b = linear[image.pixels[i * 3 + 2]];
+			float x = f((0.4124f * r + 0.3576f * g + 0.1805f * b) / 0.95047f);
+			float y = f(0.2126f * r + 0.7152f * g + 0.0722f * b);
+			float z = f((0.0193f * r + 0.1192f * g + 0.9505f * b) / 1.08883f);
+			lab[i] = glm::vec3(116.0f * y - 16.0f, 500.0f * (x - y), 200.0f * (y - z));
+		}
+	}
+
+	// whether a color is within the threshold of a pixel of the 3x3 block around (x, y)
+	bool CloseAround(const glm::vec3& color, const std::vector<glm::vec3>& lab, const glm::uvec2& size, unsigned int x, unsigned int y, float threshold)
+	{
+		unsigned int x0 = x > 0 ? x - 1 : 0, x1 = std::min(x + 1, size.x - 1);
+		unsigned int y0 = y > 0 ? y - 1 : 0, y1 = std::min(y + 1, size.y - 1);
+		for (unsigned int ny = y0; ny <= y1; ++ny)
+		{
+			for (unsigned int nx = x0; nx <= x1; ++nx)
+			{
+				if (glm::length(color - lab[(size_t)ny * size.x + nx]) <= threshold)
+					return true;
+			}
+		}
+		return false;
+	}
+}
+
+
+bool ImageDiff::ReadPpm(const std::string& path, RgbImage& image)
+{
+	std::ifstream file(path, std::ios::binary);
+	char magic[2] = { 0, 0 };
+	unsigned int maxValue = 0;
+	image = RgbImage();
+	if (!file.read(magic, 2) || magic[0] != 'P' || magic[1] != '6' ||
+		!ReadPpmValue(file, image.size.x) || !ReadPpmValue(file, image.size.y) || !ReadPpmValue(file, maxValue) ||
+		image.size.x == 0 || image.size.y == 0 || maxValue != 255)
+		return false;
+
+	image.pixels.resize((size_t)image.size.x * image.size.y * 3);
+	if (!file.read((char*)image.pixels.data(), (std::streamsize)image.pixels.size()))
+	{
+		std::cout << "ERROR::IMAGE DIFF::TRUNCATED PPM: " << path << std::endl;
+		image = RgbImage();
+		return false;
+	}
+	return true;
+}
+
+
+bool ImageDiff::WritePpm(const std::string& path, const RgbImage& image)
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file << "P6\n" << image.size.x << " " << image.size.y << "\n255\n";
+	file.write((const char*)image.pixels.data(), (std::streamsize)image.pixels.size());
+	if (!file)
+	{
+		std::cout << "ERROR::IMAGE DIFF::UNABLE TO WRITE: " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+
+ImageDiffResult ImageDiff::Compare(const RgbImage& image, const RgbImage& reference, float threshold, RgbImage* heatmap)
+{
+	ImageDiffResult result;
+	result.sameSize = image.size == reference.size && image.size.x > 0 && image.size.y > 0;
+	if (!result.sameSize)
+		return result;
+
+	std::vector<glm::vec3> labImage;
+	std::vector<glm::vec3> labReference;
+	ToLab(image, labImage);
+	ToLab(reference, labReference);
+
+	glm::uvec2 size = image.size;
+	if (heatmap)
+	{
+		heatmap->size = size;
+		heatmap->pixels.resize(reference.pixels.size());
+	}
+
+	double sum = 0.0;
+	for (unsigned int y = 0; y < size.y; ++y)
+	{
+		for (unsigned int x = 0; x < size.x; ++x)
+		{
+			size_t i = (size_t)y * size.x + x;
+			float deltaE = glm::length(labImage[i] - labReference[i]);
+			sum += deltaE;
+			result.maxDeltaE = std::max(result.maxDeltaE, deltaE);
+
+			// a shifted edge finds its color next door in both images, a missing one does not
+			bool different = deltaE > threshold &&
+				(!CloseAround(labImage[i], labReference, size, x, y, threshold) || !CloseAround(labReference[i], labImage, size, x, y, threshold));
+			if (different)
+				++result.differentPixels;
+
+			if (heatmap)
+			{
+				unsigned char gray = (unsigned char)(glm::clamp(labReference[i].x, 0.0f, 100.0f) * 0.85f);
+				heatmap->pixels[i * 3 + 0] = different ? 255 : gray;
+				heatmap->pixels[i * 3 + 1] = different ? 0 : gray;
+				heatmap->pixels[i * 3 + 2] = different ? 0 : gray;
+			}
+		}
+	}
+
+	double count = (double)size.x * size.y;
+	result.differentFraction = (float)(result.differentPixels / count);
+	result.meanDeltaE = (float)(sum / count);
+	return result;
+}
@@ -0,0 +1,67 @@
+#ifndef IMAGE_DIFF_H
+#define IMAGE_DIFF_H
+
+#include <string>
+#include <vector>
+#include <glm.hpp>
+
+/*!
+ * 8 bits RGB image, rows from top to bottom
+ *
+ */
+struct RgbImage
+{
+	glm::uvec2 size = glm::uvec2(0);
+	std::vector<unsigned char> pixels;
+};
+
+/*!
+ * Outcome of ImageDiff::Compare
+ *
+ */
+struct ImageDiffResult
+{
+	bool sameSize = false;
+	unsigned int differentPixels = 0;   // over the threshold, anti-aliasing shifts excluded
+	float differentFraction = 0.0f;
+	float meanDeltaE = 0.0f;            // over all pixels
+	float maxDeltaE = 0.0f;
+};
+
+/*!
+ * Tolerant comparison of rendered images against references
+ *
+ * Colors are compared in CIELAB, where a distance (delta E) around 2.3 is
+ * the smallest difference an observer notices, so small shading drifts
+ * pass while visible changes do not. A pixel only counts as different
+ * when one of the images has no close color within a pixel of it in the
+ * other, so a triangle edge moved by a pixel or anti-aliased a bit
+ * differently is not a regression while a missing thin line is.
+ */
+namespace ImageDiff
+{
+	/*!
+	 * Read a binary PPM (P6) with 8 bits samples
+	 *
+	 * \return : false(bool) if the file is missing or is not a binary PPM
+	 */
+	bool ReadPpm(const std::string& path, RgbImage& image);
+
+	/*!
+	 * Write a binary PPM (P6)
+	 *
+	 * \return : false(bool) if the file can not be written
+	 */
+	bool WritePpm(const std::string& path, const RgbImage& image);
+
+	/*!
+	 * Compare an image with its reference
+	 *
+	 * \param image : rendered image
+	 * \param reference : expected image
+	 * \param threshold : delta E above which pixels differ
+	 * \param heatmap : optional, receives the reference in gray with differing pixels in red
+	 */
+	ImageDiffResult Compare(const RgbImage& image, const RgbImage& reference, float threshold, RgbImage* heatmap = nullptr);
+}
+#endif
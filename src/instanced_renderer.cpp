@@ -0,0 +1,207 @@
+#include "instanced_renderer.h"
+#include <cstring>
+#include <limits>
+#include "gl_state_cache.h"
+
+
+InstancedRenderer::InstancedRenderer()
+	: m_GpuBytes(0)
+{
+}
+
+InstancedRenderer::~InstancedRenderer()
+{
+	GpuResources& resources = GpuResources::instance();
+	for (Batch& batch : m_Batches)
+		resources.release(batch.instanceBuffer);
+}
+
+
+unsigned int InstancedRenderer::addPlacement(const Mesh* mesh, const glm::mat4& model)
+{
+	unsigned int batchIndex;
+	auto found = m_BatchOfMesh.find(mesh);
+	if (found == m_BatchOfMesh.end())
+	{
+		Batch batch = {};
+		batch.mesh = mesh;
+		batch.meshMin = glm::vec3(std::numeric_limits<float>::max());
+		batch.meshMax = glm::vec3(-std::numeric_limits<float>::max());
+		for (const glm::vec3& position : mesh->positions)
+		{
+			batch.meshMin = glm::min(batch.meshMin, position);
+			batch.meshMax = glm::max(batch.meshMax, position);
+		}
+		batch.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+		batch.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+		batchIndex = (unsigned int)m_Batches.size();
+		m_Batches.push_back(std::move(batch));
+		m_BatchOfMesh[mesh] = batchIndex;
+	}
+	else
+	{
+		batchIndex = found->second;
+	}
+
+	Batch& batch = m_Batches[batchIndex];
+	Placement placement;
+	placement.batch = batchIndex;
+	placement.instance = (unsigned int)batch.transforms.size();
+	batch.slots.push_back(placement.instance);
+	batch.transforms.push_back(model);
+	ExpandBounds(batch, model);
+	m_Placements.push_back(placement);
+	return (unsigned int)m_Placements.size() - 1;
+}
+
+
+void InstancedRenderer::setTransform(unsigned int placement, const glm::mat4& model)
+{
+	const Placement& location = m_Placements[placement];
+	Batch& batch = m_Batches[location.batch];
+	batch.transforms[location.instance] = model;
+	ExpandBounds(batch, model);
+	GpuResources& resources = GpuResources::instance();
+	if (resources.isValid(batch.instanceBuffer))
+	{
+		GLStateCache::instance().bindBuffer(GL_ARRAY_BUFFER, resources.name(batch.instanceBuffer));
+		glBufferSubData(GL_ARRAY_BUFFER, batch.slots[location.instance] * sizeof(glm::mat4), sizeof(glm::mat4), &model[0][0]);
+	}
+}
+
+
+void InstancedRenderer::upload()
+{
+	GpuResources& resources = GpuResources::instance();
+	m_GpuBytes = 0;
+	for (Batch& batch : m_Batches)
+	{
+		if (!batch.streams)
+			batch.group = resources.createGroup(nullptr);
+		UploadBatch(batch);
+		m_GpuBytes += batch.streams->gpuBytes() + batch.transforms.size() * sizeof(glm::mat4);
+	}
+}
+
+
+void InstancedRenderer::sortFrontToBack(const glm::mat4& view)
+{
+	GLStateCache& state = GLStateCache::instance();
+	glm::vec4 depthRow(view[0][2], view[1][2], view[2][2], view[3][2]);
+	for (Batch& batch : m_Batches)
+	{
+		// view depths are positive in front, their float bits sort like the floats
+		m_SortEntries.resize(batch.transforms.size());
+		for (size_t i = 0; i < batch.transforms.size(); ++i)
+		{
+			float depth = glm::max(-glm::dot(depthRow, batch.transforms[i][3]), 0.0f);
+			uint32_t bits;
+			memcpy(&bits, &depth, sizeof(bits));
+			m_SortEntries[i].key = bits;
+			m_SortEntries[i].index = (uint32_t)i;
+		}
+		RadixSort(m_SortEntries, m_SortScratch, JobSystem::instance());
+
+		bool changed = false;
+		for (size_t slot = 0; slot < m_SortEntries.size(); ++slot)
+		{
+			unsigned int& current = batch.slots[m_SortEntries[slot].index];
+			changed |= current != slot;
+			current = (unsigned int)slot;
+		}
+		GLuint instanceBuffer = GpuResources::instance().name(batch.instanceBuffer);
+		if (!changed || !instanceBuffer)
+			continue;
+
+		m_SortedTransforms.resize(batch.transforms.size());
+		for (size_t slot = 0; slot < m_SortEntries.size(); ++slot)
+			m_SortedTransforms[slot] = batch.transforms[m_SortEntries[slot].index];
+		state.bindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, m_SortedTransforms.size() * sizeof(glm::mat4), m_SortedTransforms.data());
+	}
+}
+
+
+void InstancedRenderer::draw(const Frustum* frustum)
+{
+	for (Batch& batch : m_Batches)
+	{
+		if (frustum && !frustum->isBoxVisible(batch.boundsMin, batch.boundsMax))
+			continue;
+		MakeResident(batch);
+		batch.streams->bind();
+		glDrawElementsInstanced(GL_TRIANGLES, batch.streams->indexCount(), GL_UNSIGNED_INT, (void*)0, (GLsizei)batch.transforms.size());
+	}
+}
+
+
+void InstancedRenderer::drawDepth()
+{
+	for (Batch& batch : m_Batches)
+	{
+		MakeResident(batch);
+		batch.streams->bindDepth();
+		glDrawElementsInstanced(GL_TRIANGLES, batch.streams->indexCount(), GL_UNSIGNED_INT, (void*)0, (GLsizei)batch.transforms.size());
+	}
+}
+
+
+unsigned int InstancedRenderer::drawCount() const
+{
+	return (unsigned int)m_Batches.size();
+}
+
+
+unsigned int InstancedRenderer::placementCount() const
+{
+	return (unsigned int)m_Placements.size();
+}
+
+
+size_t InstancedRenderer::gpuBytes() const
+{
+	return m_GpuBytes;
+}
+
+
+void InstancedRenderer::UploadBatch(Batch& batch)
+{
+	// positions apart from the other attributes, depth passes read nothing else
+	GpuResources& resources = GpuResources::instance();
+	batch.streams.reset(new VertexStreams());
+	batch.streams->upload(*batch.mesh);
+
+	// instances in the order of the last sort
+	m_SortedTransforms.resize(batch.transforms.size());
+	for (size_t i = 0; i < batch.transforms.size(); ++i)
+		m_SortedTransforms[batch.slots[i]] = batch.transforms[i];
+	resources.release(batch.instanceBuffer);
+	batch.instanceBuffer = resources.createBuffer(GL_ARRAY_BUFFER, m_SortedTransforms.size() * sizeof(glm::mat4),
+		m_SortedTransforms.data(), GL_DYNAMIC_DRAW);
+	batch.streams->setInstanceBuffer(resources.name(batch.instanceBuffer));
+
+	batch.streams->addToGroup(batch.group);
+	resources.addToGroup(batch.instanceBuffer, batch.group);
+}
+
+
+void InstancedRenderer::MakeResident(Batch& batch)
+{
+	GpuResources& resources = GpuResources::instance();
+	if (!resources.isGroupResident(batch.group))
+		UploadBatch(batch);
+	resources.touchGroup(batch.group);
+}
+
+
+void InstancedRenderer::ExpandBounds(Batch& batch, const glm::mat4& model)
+{
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		glm::vec3 local(corner & 1 ? batch.meshMax.x : batch.meshMin.x, corner & 2 ? batch.meshMax.y : batch.meshMin.y,
+			corner & 4 ? batch.meshMax.z : batch.meshMin.z);
+		glm::vec3 world = glm::vec3(model * glm::vec4(local, 1.0f));
+		batch.boundsMin = glm::min(batch.boundsMin, world);
+		batch.boundsMax = glm::max(batch.boundsMax, world);
+	}
+}
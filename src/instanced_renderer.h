@@ -0,0 +1,139 @@
+#ifndef INSTANCED_RENDERER_H
+#define INSTANCED_RENDERER_H
+
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <glm.hpp>
+#include "frustum.h"
+#include "gpu_resources.h"
+#include "mesh.h"
+#include "radix_sort.h"
+#include "vertex_streams.h"
+
+/*!
+ * Hardware instancing of repeated parts
+ *
+ * Placements are grouped by mesh identity, each unique mesh is uploaded once
+ * together with a buffer of per instance model matrices and drawn with a
+ * single glDrawElementsInstanced. Memory and draw count follow the number of
+ * unique meshes instead of the number of placements.
+ * Positions and normals are separate streams so depth only passes fetch
+ * positions alone through drawDepth.
+ * Every batch is a GpuResources residency group touched when it is drawn,
+ * an evicted batch is uploaded again the next time it is drawn.
+ * Draw with res/vertex.glsl + res/fragment.glsl and the INSTANCED keyword,
+ * adding NO_NORMALS for drawDepth.
+ */
+class InstancedRenderer
+{
+public:
+	InstancedRenderer();
+	~InstancedRenderer();
+
+	InstancedRenderer(const InstancedRenderer&) = delete;
+	InstancedRenderer& operator=(const InstancedRenderer&) = delete;
+
+	/*!
+	 * Place a mesh in the scene
+	 *
+	 * \param mesh : placements sharing the same mesh object become instances of one draw,
+	 * the mesh has to stay alive as long as the renderer, evicted batches are uploaded from it again
+	 * \param model : model matrix of the placement
+	 * \return : placement index, used with setTransform
+	 */
+	unsigned int addPlacement(const Mesh* mesh, const glm::mat4& model);
+
+	/*!
+	 * Move a placement, the instance buffer is patched if already uploaded
+	 *
+	 */
+	void setTransform(unsigned int placement, const glm::mat4& model);
+
+	/*!
+	 * Create one VAO, vertex/index buffer and instance buffer per unique mesh
+	 *
+	 */
+	void upload();
+
+	/*!
+	 * Order the instances of every batch front to back, for early depth rejection
+	 *
+	 * The instance buffers are rewritten only when the order changed.
+	 *
+	 * \param view : world to view matrix, instances are sorted on the view depth of their origin
+	 */
+	void sortFrontToBack(const glm::mat4& view);
+
+	/*!
+	 * One instanced draw per unique mesh, the draw shader has to be in use
+	 *
+	 * \param frustum : batches whose placements are all outside are skipped and not touched,
+	 * nullptr to draw every batch
+	 */
+	void draw(const Frustum* frustum = nullptr);
+
+	/*!
+	 * Same draws reading the position stream only, for depth only passes
+	 *
+	 */
+	void drawDepth();
+
+	unsigned int drawCount() const;
+	unsigned int placementCount() const;
+
+	/*!
+	 * Bytes held in GPU buffers for geometry and instance data
+	 *
+	 */
+	size_t gpuBytes() const;
+
+private:
+
+	struct Batch
+	{
+		const Mesh* mesh;
+		std::vector<glm::mat4> transforms;      // in placement order
+		std::vector<unsigned int> slots;        // instance buffer slot of each transform
+		std::unique_ptr<VertexStreams> streams;
+		GpuHandle instanceBuffer;
+		unsigned int group;
+		glm::vec3 meshMin, meshMax;             // bounds of the mesh
+		glm::vec3 boundsMin, boundsMax;         // world bounds of the placements, only grow
+	};
+
+	/*!
+	 * Where a placement lives, batch and instance slot
+	 *
+	 */
+	struct Placement
+	{
+		unsigned int batch;
+		unsigned int instance;
+	};
+
+	std::vector<Batch> m_Batches;
+	std::vector<Placement> m_Placements;
+	std::unordered_map<const Mesh*, unsigned int> m_BatchOfMesh;
+	size_t m_GpuBytes;
+
+	// sortFrontToBack storage, kept between frames
+	std::vector<SortEntry> m_SortEntries;
+	std::vector<SortEntry> m_SortScratch;
+	std::vector<glm::mat4> m_SortedTransforms;
+
+	/*!
+	 * Create the streams and instance buffer of a batch in its group
+	 *
+	 */
+	void UploadBatch(Batch& batch);
+
+	/*!
+	 * Upload the batch again if it was evicted and touch its group
+	 *
+	 */
+	void MakeResident(Batch& batch);
+
+	static void ExpandBounds(Batch& batch, const glm::mat4& model);
+};
+#endif
@@ -0,0 +1,146 @@
+#include "job_system.h"
+
+namespace
+{
+	thread_local unsigned int THREAD_INDEX = 0;
+}
+
+
+JobSystem::JobSystem(unsigned int threadCount)
+	: m_Quit(false)
+{
+	// nested calls add a task each, a few slots cover any realistic depth
+	m_Tasks.reserve(16);
+	if (threadCount == 0)
+	{
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+	}
+
+	for (unsigned int i = 0; i < threadCount; ++i)
+		m_Workers.emplace_back(&JobSystem::WorkerLoop, this, i + 1);
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Quit = true;
+	}
+	m_WakeUp.notify_all();
+	for (std::thread& worker : m_Workers)
+		worker.join();
+}
+
+
+void JobSystem::Run(size_t count, size_t grainSize, RangeFunction function, const void* context)
+{
+	if (count == 0)
+		return;
+	if (grainSize == 0)
+		grainSize = 1;
+
+	size_t rangeCount = (count + grainSize - 1) / grainSize;
+	if (rangeCount == 1 || m_Workers.empty())
+	{
+		function(context, 0, count);
+		return;
+	}
+
+	Task task;
+	task.function = function;
+	task.context = context;
+	task.count = count;
+	task.grainSize = grainSize;
+	task.next = 0;
+	task.remaining.store(rangeCount, std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Tasks.push_back(&task);
+	}
+	m_WakeUp.notify_all();
+
+	// help instead of blocking, ranges of other callers are fine to run too
+	while (task.remaining.load(std::memory_order_acquire) != 0)
+	{
+		if (!RunOne())
+			std::this_thread::yield();
+	}
+}
+
+
+unsigned int JobSystem::concurrency() const
+{
+	return (unsigned int)m_Workers.size() + 1;
+}
+
+
+unsigned int JobSystem::threadIndex()
+{
+	return THREAD_INDEX;
+}
+
+
+JobSystem& JobSystem::instance()
+{
+	static JobSystem jobSystem;
+	return jobSystem;
+}
+
+
+void JobSystem::WorkerLoop(unsigned int index)
+{
+	THREAD_INDEX = index;
+	for (;;)
+	{
+		Task* task;
+		size_t begin, end;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_WakeUp.wait(lock, [this]() { return m_Quit || !m_Tasks.empty(); });
+			if (m_Quit && m_Tasks.empty())
+				return;
+			task = TakeRange(begin, end);
+		}
+		if (task)
+			RunRange(task, begin, end);
+	}
+}
+
+
+JobSystem::Task* JobSystem::TakeRange(size_t& begin, size_t& end)
+{
+	if (m_Tasks.empty())
+		return nullptr;
+
+	// the newest first, a nested parallelFor finishes before its parent goes on
+	Task* task = m_Tasks.back();
+	begin = task->next;
+	end = begin + task->grainSize < task->count ? begin + task->grainSize : task->count;
+	task->next = end;
+	if (end == task->count)
+		m_Tasks.pop_back();
+	return task;
+}
+
+
+void JobSystem::RunRange(Task* task, size_t begin, size_t end)
+{
+	task->function(task->context, begin, end);
+	task->remaining.fetch_sub(1, std::memory_order_release);
+}
+
+
+bool JobSystem::RunOne()
+{
+	Task* task;
+	size_t begin, end;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		task = TakeRange(begin, end);
+	}
+	if (!task)
+		return false;
+	RunRange(task, begin, end);
+	return true;
+}
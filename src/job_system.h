@@ -0,0 +1,113 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*!
+ * Small pool of worker threads for data parallel CPU work
+ *
+ * The calling thread helps executing jobs while it waits, so a parallelFor
+ * issued from inside a job does not dead lock.
+ */
+class JobSystem
+{
+public:
+	/*!
+	 * Start the workers
+	 *
+	 * \param threadCount : number of worker threads, 0 to use one per hardware thread minus the caller
+	 */
+	explicit JobSystem(unsigned int threadCount = 0);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	/*!
+	 * Run job over [0, count) split in ranges of grainSize, returns once every range is done
+	 *
+	 * The job is called through a plain pointer and the ranges are handed out
+	 * from one counter, so a call does not allocate.
+	 *
+	 * \param count : number of items
+	 * \param grainSize : items per job, at least 1
+	 * \param job : callable taking (begin, end) of a range, called from any thread
+	 */
+	template <typename Job>
+	void parallelFor(size_t count, size_t grainSize, const Job& job)
+	{
+		Run(count, grainSize, [](const void* context, size_t begin, size_t end)
+		{
+			(*(const Job*)context)(begin, end);
+		}, &job);
+	}
+
+	/*!
+	 * Workers plus the calling thread
+	 *
+	 */
+	unsigned int concurrency() const;
+
+	/*!
+	 * Index of the current thread, 0 for threads outside of the pool and 1..N for workers.
+	 * Useful to pick per thread scratch data.
+	 *
+	 */
+	static unsigned int threadIndex();
+
+	/*!
+	 * Process wide pool, created on first use
+	 *
+	 */
+	static JobSystem& instance();
+
+private:
+
+	typedef void (*RangeFunction)(const void* context, size_t begin, size_t end);
+
+	// one parallelFor in flight, lives on the stack of its caller
+	struct Task
+	{
+		RangeFunction function;
+		const void* context;
+		size_t count;
+		size_t grainSize;
+		size_t next;                    // first item not handed out yet, guarded by m_Mutex
+		std::atomic<size_t> remaining;  // ranges not finished yet
+	};
+
+	std::vector<std::thread> m_Workers;
+	std::vector<Task*> m_Tasks;         // tasks with ranges left, the newest at the back
+	std::mutex m_Mutex;
+	std::condition_variable m_WakeUp;
+	bool m_Quit;
+
+	void Run(size_t count, size_t grainSize, RangeFunction function, const void* context);
+
+	void WorkerLoop(unsigned int index);
+
+	/*!
+	 * Take the next range of the newest task, m_Mutex has to be locked
+	 *
+	 * \return : task owning [begin, end), nullptr if no range is left
+	 */
+	Task* TakeRange(size_t& begin, size_t& end);
+
+	/*!
+	 * Run one range and mark it finished, the task may be gone once this returns
+	 *
+	 */
+	static void RunRange(Task* task, size_t begin, size_t end);
+
+	/*!
+	 * Take and run one range of any task
+	 *
+	 * \return : false(bool) if no range was left
+	 */
+	bool RunOne();
+};
+#endif
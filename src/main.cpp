@@ -2,6 +2,43 @@
 #include <glfw3.h>
 #include <iostream>
 #include "shader.h"
+#include "gl_state_cache.h"
+#include "profiler.h"
+#include "resources.h"
+#include "shader_reloader.h"
+#include "frame_arena.h"
+#include "heap_counter.h"
+#include "job_system.h"
+#include "gpu_resources.h"
+#include "mesh_streamer.h"
+#include "point_cloud_renderer.h"
+#include "volume_renderer.h"
+#include "terrain_renderer.h"
+#include "clustered_lighting.h"
+#include "shadow_cascades.h"
+#include "deferred_renderer.h"
+#include "gpu_timer.h"
+#include "fragment_counter.h"
+#include "dynamic_resolution.h"
+#include "progressive_refinement.h"
+#include "frame_capture.h"
+#include "regression_suite.h"
+#include "instanced_renderer.h"
+#include "gpu_scene.h"
+#include "mesh_io.h"
+#include "mesh_dedup.h"
+#include "render_queue.h"
+#include "vertex_streams.h"
+#include "shader_preprocessor.h"
+#include "shader_variants.h"
+#include "shader_batch.h"
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+#include <limits>
 #include <glm.hpp>
 #include <gtc/matrix_transform.hpp>
 
@@ -12,17 +49,44 @@ const unsigned int SCR_HEIGHT = 600;
 float X_LAST,Y_LAST;
 float YAW,PITCH;
 bool WAS_ML_BUTTON_DOWN;
+bool DEFERRED_SHADING;
+bool DEPTH_PREPASS;
+bool CAPTURE;
+double LAST_CAMERA_MOVE;
 
-static void exit_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
 	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, GLFW_TRUE);
+
+	// dump per frame averages since the last dump
+	if (key == GLFW_KEY_P && action == GLFW_PRESS)
+		Profiler::instance().report(std::cout);
+
+	// forward or deferred shading of the box city
+	if (key == GLFW_KEY_F && action == GLFW_PRESS)
+	{
+		DEFERRED_SHADING = !DEFERRED_SHADING;
+		std::cout << (DEFERRED_SHADING ? "SHADING::DEFERRED" : "SHADING::FORWARD") << std::endl;
+	}
+
+	// depth pre-pass before forward shading
+	if (key == GLFW_KEY_Z && action == GLFW_PRESS)
+	{
+		DEPTH_PREPASS = !DEPTH_PREPASS;
+		std::cout << (DEPTH_PREPASS ? "DEPTH PREPASS::ON" : "DEPTH PREPASS::OFF") << std::endl;
+	}
+
+	// start or stop recording the window
+	if (key == GLFW_KEY_C && action == GLFW_PRESS)
+		CAPTURE = !CAPTURE;
 }
 
 static void cursor_position_callback(GLFWwindow* window, double xpos, double ypos)
 {
 	if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_RELEASE)
 		return;
+	LAST_CAMERA_MOVE = glfwGetTime();
 
 	if (WAS_ML_BUTTON_DOWN)
 	{
@@ -46,8 +110,59 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 		WAS_ML_BUTTON_DOWN = true;
 }
 
+// --shader-batch-bench : the same permutations built one program at a time, then as one ShaderBatch
+static int shader_batch_bench()
+{
+	const unsigned int VARIANT_COUNT = 50;
+	const char* keywords[] = { "INSTANCED", "NO_NORMALS", "QUANTIZED_POSITIONS", "CLUSTERED_LIGHTS", "SHADOWS" };
+
+	// every source gets a tag unique to the run, so no shader cache of the driver serves one run from the other
+	std::string nonce = std::to_string(std::chrono::high_resolution_clock::now().time_since_epoch().count());
+	double milliseconds[2] = { 0.0, 0.0 };
+	unsigned int failures = 0;
+	for (int batched = 0; batched < 2; ++batched)
+	{
+		std::vector<ShaderSources> sources;
+		for (unsigned int i = 0; i < VARIANT_COUNT; ++i)
+		{
+			std::vector<std::string> defines;
+			for (unsigned int k = 0; k < 5; ++k)
+			{
+				if (i & (1u << k))
+					defines.push_back(keywords[k]);
+			}
+			sources.push_back(ShaderPreprocessor::Load(ResourcePath("vertex.glsl"), ResourcePath("fragment.glsl"), defines));
+			std::string tag = "\n// shader batch bench " + nonce + " " + std::to_string(batched) + " " + std::to_string(i) + "\n";
+			sources.back().vertexCode += tag;
+			sources.back().fragmentCode += tag;
+		}
+
+		std::vector<std::unique_ptr<Shader>> shaders;
+		ShaderBatch batch;
+		for (const ShaderSources& variant : sources)
+		{
+			shaders.emplace_back(new Shader());
+			batch.add(shaders.back().get(), variant);
+			if (!batched)
+			{
+				failures += batch.build();
+				milliseconds[0] += batch.lastBuildMilliseconds();
+			}
+		}
+		if (batched)
+		{
+			failures += batch.build();
+			milliseconds[1] = batch.lastBuildMilliseconds();
+		}
+	}
+
+	std::cout << "SHADER BATCH::" << VARIANT_COUNT << " VARIANTS, SERIAL " << milliseconds[0] << " ms, BATCHED " << milliseconds[1]
+		<< " ms, PARALLEL COMPILE " << (GLEW_KHR_parallel_shader_compile ? "ON" : "OFF") << ", " << failures << " FAILED" << std::endl;
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 
-int main(void)
+int main(int argc, char** argv)
 {
 	GLFWwindow* window;
 
@@ -58,6 +173,11 @@ int main(void)
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
+	// golden image run, the scenes are drawn offscreen so the window stays hidden
+	const char* regressionDirectory = std::getenv("OPENGLVIEWER_REGRESSION");
+	if (regressionDirectory)
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
 	window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "OpenGL Viewer", NULL, NULL);
 	if (!window)
 	{
@@ -69,15 +189,32 @@ int main(void)
 	if (glewInit() != GLEW_OK)
 		std::cout << "GLEW Initialization Failed!" << std::endl;
 	std::cout << glGetString(GL_VERSION) << std::endl;
+	// timings of the regression run are not held to the display rate
+	if (regressionDirectory)
+		glfwSwapInterval(0);
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::string(argv[i]) == "--shader-batch-bench")
+		{
+			int status = shader_batch_bench();
+			GpuResources::instance().releaseAll();
+			glfwDestroyWindow(window);
+			glfwTerminate();
+			exit(status);
+		}
+	}
 
 	// setting up callbacks
-	glfwSetKeyCallback(window, exit_callback);
+	glfwSetKeyCallback(window, key_callback);
 	glfwSetCursorPosCallback(window, cursor_position_callback);
 	glfwSetMouseButtonCallback(window, mouse_button_callback);
 
-	// configure global opengl state
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
+	// configure global opengl state, every change goes through the cache
+	GLStateCache& state = GLStateCache::instance();
+	Profiler& profiler = Profiler::instance();
+	state.setEnabled(GL_DEPTH_TEST, true);
+	state.setEnabled(GL_CULL_FACE, true);
 
 	float vertices[] = {
 		-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
@@ -123,29 +260,316 @@ int main(void)
 		-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f
 	};
 
-	unsigned int vao;
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
+	// GL objects are owned by the resource manager, the cube and every instancing batch are residency groups
+	// touched only when they are drawn, so the least recently drawn one is evicted first
+	GpuResources& resources = GpuResources::instance();
+	unsigned int cubeGroup = resources.createGroup(nullptr);
+	if (const char* budget = std::getenv("OPENGLVIEWER_GPU_BUDGET_MB"))
+		resources.setBudget((uint64_t)std::atoll(budget) * 1024 * 1024);
 
-	unsigned int buffer;
-	glGenBuffers(1, &buffer);
-	glBindBuffer(GL_ARRAY_BUFFER, buffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	// position and normal streams in their own buffers, depth passes only bind the positions
+	Mesh cubeMesh;
+	for (size_t i = 0; i < sizeof(vertices) / sizeof(float); i += 6)
+	{
+		cubeMesh.positions.push_back(glm::vec3(vertices[i], vertices[i + 1], vertices[i + 2]));
+		cubeMesh.normals.push_back(glm::vec3(vertices[i + 3], vertices[i + 4], vertices[i + 5]));
+	}
+	VertexStreams cube;
+	cube.upload(cubeMesh);
+	cube.addToGroup(cubeGroup);
+
+	Shader theShader(ResourcePath("vertex.glsl").c_str(), ResourcePath("fragment.glsl").c_str());
+
+	// edited shaders are rebuilt in the background and swapped in once linked
+	std::unique_ptr<ShaderReloader> reloader(new ShaderReloader(window));
+	reloader->watch(&theShader);
+
+	// permutations of the modes below, requested while setting up and built as one batch before the first frame
+	ShaderVariants variants;
+	uint64_t instanced = variants.keyword("INSTANCED");
+	uint64_t noNormals = variants.keyword("NO_NORMALS");
+	uint64_t clusteredLights = variants.keyword("CLUSTERED_LIGHTS");
+	uint64_t shadowed = variants.keyword("SHADOWS");
+
+	// out of core mode, OBJ files are turned into a chunk cache next to them on first use
+	std::unique_ptr<MeshStreamer> streamer;
+	if (const char* streamPath = std::getenv("OPENGLVIEWER_STREAM"))
+	{
+		std::string chunkPath = streamPath;
+		if (chunkPath.size() < 5 || chunkPath.compare(chunkPath.size() - 5, 5, ".ogvc") != 0)
+		{
+			chunkPath += ".ogvc";
+			if (!std::ifstream(chunkPath).good() && !ChunkedMesh::BuildFromFile(streamPath, chunkPath))
+				chunkPath.clear();
+		}
+
+		streamer.reset(new MeshStreamer());
+		if (chunkPath.empty() || !streamer->open(chunkPath, MeshStreamer::Options()))
+			streamer.reset();
+	}
 
-	// position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	// normal attribute
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
+	// point cloud mode, scans are turned into an octree cache next to them on first use
+	std::unique_ptr<PointCloudRenderer> pointCloud;
+	Shader* pointShader = nullptr;
+	if (const char* pointsPath = std::getenv("OPENGLVIEWER_POINTS"))
+	{
+		std::string octreePath = pointsPath;
+		if (octreePath.size() < 5 || octreePath.compare(octreePath.size() - 5, 5, ".ogvc") != 0)
+		{
+			octreePath += ".ogvc";
+			if (!std::ifstream(octreePath).good() && !PointOctree::Build(pointsPath, octreePath))
+				octreePath.clear();
+		}
+
+		pointCloud.reset(new PointCloudRenderer());
+		if (octreePath.empty() || !pointCloud->open(octreePath, PointCloudRenderer::Options()))
+			pointCloud.reset();
+		else
+		{
+			pointShader = &variants.request(ResourcePath("vertex_points.glsl"), ResourcePath("fragment_points.glsl"), 0);
+		}
+	}
 
-	Shader theShader("../res/vertex.glsl", "../res/fragment.glsl");
+	// mesh mode, the parts of an OBJ export are collapsed into instances of the unique ones
+	MeshDedup::Result meshParts;
+	std::unique_ptr<InstancedRenderer> partScene;
+	Shader* partShader = nullptr;
+	if (const char* meshPath = std::getenv("OPENGLVIEWER_MESH"))
+	{
+		std::vector<Mesh> parts;
+		if (MeshIO::ReadObjParts(meshPath, parts))
+		{
+			meshParts = MeshDedup::Deduplicate(parts, MeshDedup::Options(), JobSystem::instance());
+			MeshDedup::PrintReport(meshParts, parts.size());
+
+			// the whole model fits the unit cube, the camera orbits 5 units away
+			glm::vec3 low(std::numeric_limits<float>::max()), high(-std::numeric_limits<float>::max());
+			for (const Mesh& part : parts)
+			{
+				for (const glm::vec3& position : part.positions)
+				{
+					low = glm::min(low, position);
+					high = glm::max(high, position);
+				}
+			}
+			float size = std::max(std::max(high.x - low.x, high.y - low.y), std::max(high.z - low.z, 1e-6f));
+			glm::mat4 fit = glm::translate(glm::scale(glm::mat4(1.0f), glm::vec3(1.0f / size)), -(low + high) * 0.5f);
+
+			partScene.reset(new InstancedRenderer());
+			for (const MeshDedup::Instance& instance : meshParts.instances)
+				partScene->addPlacement(&meshParts.uniqueMeshes[instance.uniqueMesh], fit * instance.transform);
+			partScene->upload();
+			partShader = &variants.request(ResourcePath("vertex.glsl"), ResourcePath("fragment.glsl"), instanced);
+		}
+	}
 
-	// Unbind everything
-	glUseProgram(0);
-	glBindVertexArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	//glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	// draw call stress, OPENGLVIEWER_DRAW_QUEUE boxes drawn one by one through the sorted render queue
+	// with two programs, two meshes and 32 materials, see the QUEUE counters of the profiler
+	std::unique_ptr<RenderQueue> drawQueue;
+	Shader* queueShaders[2] = {};
+	VertexStreams queueMeshes[2];
+	std::vector<glm::vec3> queuePositions;
+	float queueScale = 1.0f;
+	if (const char* queueCount = std::getenv("OPENGLVIEWER_DRAW_QUEUE"))
+	{
+		// a closed box and the same box without its top
+		Mesh box;
+		LightBenchmark::MakeCube(box);
+		queueMeshes[0].upload(box);
+		box.indices.resize(box.indices.size() - 6);
+		queueMeshes[1].upload(box);
+
+		queueShaders[0] = &variants.request(ResourcePath("vertex.glsl"), ResourcePath("fragment.glsl"), 0);
+		queueShaders[1] = &variants.request(ResourcePath("vertex.glsl"), ResourcePath("fragment.glsl"), noNormals);
+		drawQueue.reset(new RenderQueue());
+		for (Shader* shader : queueShaders)
+			drawQueue->addShader(shader);
+		for (const VertexStreams& mesh : queueMeshes)
+			drawQueue->addMesh(mesh.vertexArray(), mesh.indexCount(), 0);
+		for (unsigned int i = 0; i < 32; ++i)
+			drawQueue->addMaterial(glm::vec3(0.3f + 0.02f * i, 0.8f - 0.015f * i, 0.5f));
+
+		// boxes on a lattice filling the unit cube
+		unsigned int count = (unsigned int)std::max(1, std::atoi(queueCount));
+		unsigned int side = (unsigned int)std::ceil(std::cbrt((double)count));
+		queueScale = 0.5f / side;
+		for (unsigned int i = 0; i < count; ++i)
+			queuePositions.push_back((glm::vec3(i % side, i / side % side, i / (side * side)) + 0.5f) / (float)side - 0.5f);
+	}
+
+	// box city benchmark, lit by OPENGLVIEWER_LIGHTS point and spot lights and, with OPENGLVIEWER_SHADOWS,
+	// by a sun with cached cascaded shadows and a few moving boxes as dynamic casters.
+	// F switches between forward and deferred shading, OPENGLVIEWER_DEFERRED starts deferred.
+	// Z toggles a depth pre-pass of forward shading, OPENGLVIEWER_DEPTH_PREPASS starts with it.
+	// OPENGLVIEWER_GPU_SCENE culls and draws the city of forward shading on the GPU, one indirect multi draw
+	std::unique_ptr<ClusteredLighting> lighting;
+	std::unique_ptr<ShadowCascades> shadows;
+	std::unique_ptr<InstancedRenderer> boxScene;
+	std::unique_ptr<InstancedRenderer> movingBoxes;
+	Shader* boxShader = nullptr;
+	Shader* shadowShader = nullptr;
+	std::unique_ptr<DeferredRenderer> deferred;
+	Shader* gbufferShader = nullptr;
+	std::unique_ptr<Shader> deferredShader;
+	std::unique_ptr<GpuTimer> boxTimer;
+	std::unique_ptr<FragmentCounter> boxFragments;
+	Shader* depthShader = nullptr;
+	std::unique_ptr<GpuScene> gpuScene;
+	Mesh boxMesh;
+	const char* lightCount = std::getenv("OPENGLVIEWER_LIGHTS");
+	const char* shadowsEnabled = std::getenv("OPENGLVIEWER_SHADOWS");
+	// the regression scenes view the box city, lit and shadowed unless the environment picks otherwise
+	if (regressionDirectory && !lightCount && !shadowsEnabled)
+	{
+		lightCount = "64";
+		shadowsEnabled = "1";
+	}
+	if (lightCount || shadowsEnabled)
+	{
+		LightBenchmark::MakeCube(boxMesh);
+		std::vector<glm::mat4> city = LightBenchmark::GenerateBoxes(40, 4.0f, 1);
+		city.insert(city.begin(), glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.01f, 0.0f)), glm::vec3(4.0f, 0.02f, 4.0f)));
+		boxScene.reset(new InstancedRenderer());
+		for (const glm::mat4& box : city)
+			boxScene->addPlacement(&boxMesh, box);
+		boxScene->upload();
+
+		uint64_t boxKeywords = instanced;
+		deferred.reset(new DeferredRenderer());
+		deferred->setMaterial(1, glm::vec3(0.8f, 0.8f, 0.8f));
+		deferred->setMaterial(2, glm::vec3(0.8f, 0.4f, 0.2f));
+		if (lightCount)
+		{
+			// slices stop past the scene, the camera orbits 5 units away
+			ClusteredLighting::Options options;
+			options.sliceFar = 15.0f;
+			lighting.reset(new ClusteredLighting(options));
+			lighting->setLights(LightBenchmark::GenerateLights((unsigned int)std::atoi(lightCount), 0.3f,
+				glm::vec3(-2.0f, 0.05f, -2.0f), glm::vec3(2.0f, 0.6f, 2.0f), 0.04f, 0.15f, 1));
+			deferred->setLights(lighting->lights());
+			boxKeywords |= clusteredLights;
+		}
+		if (shadowsEnabled)
+		{
+			shadows.reset(new ShadowCascades());
+			movingBoxes.reset(new InstancedRenderer());
+			for (int i = 0; i < 6; ++i)
+				movingBoxes->addPlacement(&boxMesh, glm::mat4(1.0f));
+			movingBoxes->upload();
+			shadowShader = &variants.request(ResourcePath("vertex_shadow.glsl"), ResourcePath("fragment_shadow.glsl"), instanced);
+			boxKeywords |= shadowed;
+		}
+
+		if (std::getenv("OPENGLVIEWER_GPU_SCENE"))
+		{
+			// same lighting as the instanced path, the model matrices come from the object buffer
+			gpuScene.reset(new GpuScene());
+			unsigned int boxIndex = gpuScene->addMesh(boxMesh);
+			for (const glm::mat4& box : city)
+				gpuScene->addObject(boxIndex, box);
+			gpuScene->upload(ResourceDirectory(), variants.defines(boxKeywords & ~instanced));
+		}
+		boxShader = &variants.request(ResourcePath("vertex.glsl"), ResourcePath("fragment.glsl"), boxKeywords);
+		gbufferShader = &variants.request(ResourcePath("vertex.glsl"), ResourcePath("fragment_gbuffer.glsl"), instanced);
+		deferredShader.reset(new Shader(ShaderPreprocessor::LoadCompute(ResourcePath("deferred_lighting_compute.glsl"), variants.defines(boxKeywords & shadowed))));
+		reloader->watch(deferredShader.get());
+		depthShader = &variants.request(ResourcePath("vertex.glsl"), ResourcePath("fragment_shadow.glsl"), instanced | noNormals);
+		boxTimer.reset(new GpuTimer());
+		boxFragments.reset(new FragmentCounter());
+		DEFERRED_SHADING = std::getenv("OPENGLVIEWER_DEFERRED") != nullptr;
+		DEPTH_PREPASS = std::getenv("OPENGLVIEWER_DEPTH_PREPASS") != nullptr;
+	}
+
+	// terrain mode, heightmaps are cut into a tile pyramid next to them on first use
+	std::unique_ptr<TerrainRenderer> terrain;
+	Shader* terrainShader = nullptr;
+	if (const char* terrainPath = std::getenv("OPENGLVIEWER_TERRAIN"))
+	{
+		std::string tilePath = terrainPath;
+		if (tilePath.size() < 5 || tilePath.compare(tilePath.size() - 5, 5, ".ogvc") != 0)
+		{
+			tilePath += ".ogvc";
+			HeightmapInfo info;
+			if (!std::ifstream(tilePath).good() && (!HeightmapIO::ReadInfo(terrainPath, info) || !TerrainTiles::Build(info, tilePath)))
+				tilePath.clear();
+		}
+
+		terrain.reset(new TerrainRenderer());
+		if (tilePath.empty() || !terrain->open(tilePath, TerrainRenderer::Options()))
+			terrain.reset();
+		else
+		{
+			terrainShader = &variants.request(ResourcePath("vertex_terrain.glsl"), ResourcePath("fragment.glsl"), 0);
+		}
+	}
+
+	// volume mode, scalar fields are bricked into a cache next to them on first use
+	std::unique_ptr<VolumeRenderer> volume;
+	Shader* volumeShader = nullptr;
+	if (const char* volumePath = std::getenv("OPENGLVIEWER_VOLUME"))
+	{
+		std::string brickPath = volumePath;
+		if (brickPath.size() < 5 || brickPath.compare(brickPath.size() - 5, 5, ".ogvc") != 0)
+		{
+			brickPath += ".ogvc";
+			VolumeInfo info;
+			if (!std::ifstream(brickPath).good() && (!VolumeIO::ReadInfo(volumePath, info) || !VolumeBricks::Build(info, brickPath)))
+				brickPath.clear();
+		}
+
+		volume.reset(new VolumeRenderer());
+		if (brickPath.empty() || !volume->open(brickPath, VolumeRenderer::Options()))
+			volume.reset();
+		else
+		{
+			volumeShader = &variants.request(ResourcePath("vertex_volume.glsl"), ResourcePath("fragment_volume.glsl"), 0);
+		}
+	}
+
+	// reduced frames while dragging, refined over the next frames once still, then no more drawing
+	std::unique_ptr<ProgressiveRefinement> progressive;
+	Shader* accumulateShader = nullptr;
+	if (std::getenv("OPENGLVIEWER_PROGRESSIVE") && !regressionDirectory)
+	{
+		progressive.reset(new ProgressiveRefinement());
+		accumulateShader = &variants.request(ResourcePath("vertex_fullscreen.glsl"), ResourcePath("fragment_accumulate.glsl"), 0);
+	}
+
+	// render scale follows the GPU time to hold a frame budget, in milliseconds, unless refining progressively
+	std::unique_ptr<DynamicResolution> dynamicResolution;
+	const char* frameBudget = std::getenv("OPENGLVIEWER_FRAME_BUDGET_MS");
+	if (frameBudget && !progressive && !regressionDirectory)
+	{
+		DynamicResolution::Options options;
+		options.targetMs = (float)std::atof(frameBudget);
+		dynamicResolution.reset(new DynamicResolution(options));
+	}
+
+	// reference scenes compared with the images of OPENGLVIEWER_REGRESSION, the viewer exits after,
+	// OPENGLVIEWER_REGRESSION_RECORD writes new references instead. The timing baseline, the results and
+	// the failing images go to OPENGLVIEWER_REGRESSION_OUTPUT, next to the references without it
+	std::unique_ptr<RegressionSuite> regression;
+	if (regressionDirectory)
+	{
+		RegressionSuite::Options options;
+		options.record = std::getenv("OPENGLVIEWER_REGRESSION_RECORD") != nullptr;
+		if (const char* tolerance = std::getenv("OPENGLVIEWER_REGRESSION_TOLERANCE"))
+			options.timingTolerance = std::atof(tolerance);
+		if (const char* output = std::getenv("OPENGLVIEWER_REGRESSION_OUTPUT"))
+			options.outputDirectory = output;
+		regression.reset(new RegressionSuite(regressionDirectory, RegressionSuite::DefaultScenes(), options));
+	}
+
+	// recording of the window, a path ending in .y4m is a video, anything else the prefix of a PNG sequence
+	FrameCapture frameCapture;
+	const char* capturePath = std::getenv("OPENGLVIEWER_CAPTURE");
+	std::string capturePrefix = capturePath ? capturePath : "capture_";
+	CAPTURE = capturePath != nullptr;
+
+	// every variant requested above, compiled in parallel by the driver when it can
+	variants.prewarm();
+	for (Shader* shader : variants.programs())
+		reloader->watch(shader);
 
 	// Extra variables
 	//----------------
@@ -160,9 +584,70 @@ int main(void)
 
 	//----------------
 
+	// transient per frame data, one slot per frame the GPU can lag behind
+	FrameArena frameArena(256 * 1024, 3, JobSystem::instance().concurrency());
+	uint64_t heapAllocations = HeapCounter::AllocationCount();
+
 	while (!glfwWindowShouldClose(window))
 	{	
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		profiler.beginFrame();
+		frameArena.beginFrame();
+		resources.beginFrame();
+		reloader->update();
+		if (CAPTURE != frameCapture.isCapturing())
+		{
+			if (CAPTURE)
+				CAPTURE = frameCapture.start(capturePrefix);
+			else
+				frameCapture.stop();
+		}
+
+		// scene into a scaled offscreen target, or straight to the window
+		int width = 0, height = 0;
+		glfwGetFramebufferSize(window, &width, &height);
+		glm::uvec2 renderSize(width, height);
+		GLuint sceneFramebuffer = 0;
+		float lodScale = 1.0f;
+		if (progressive)
+		{
+			progressive->interact(LAST_CAMERA_MOVE);
+			if (!progressive->beginFrame(renderSize, glfwGetTime()))
+			{
+				// the image is complete, sleep until some input comes
+				progressive->reportTo(profiler);
+				if (CAPTURE)
+				{
+					frameCapture.capture(renderSize);
+					frameCapture.reportTo(profiler);
+				}
+				profiler.endFrame();
+				glfwSwapBuffers(window);
+				glfwWaitEventsTimeout(0.25);
+				continue;
+			}
+			renderSize = progressive->renderSize();
+			sceneFramebuffer = progressive->framebuffer();
+			lodScale = progressive->lodScale();
+		}
+		else if (dynamicResolution)
+		{
+			renderSize = dynamicResolution->beginFrame(renderSize);
+			sceneFramebuffer = dynamicResolution->framebuffer();
+			lodScale = dynamicResolution->scale();
+		}
+		else if (regression)
+		{
+			// fixed view and shading path of the scene
+			const RegressionScene& scene = regression->scene();
+			YAW = scene.yaw;
+			PITCH = scene.pitch;
+			DEFERRED_SHADING = scene.deferred;
+			DEPTH_PREPASS = scene.depthPrepass;
+			renderSize = regression->beginFrame();
+			sceneFramebuffer = regression->framebuffer();
+		}
+		else
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		// Activating shader and related uniforms
 		theShader.use();
@@ -172,6 +657,8 @@ int main(void)
 
 		// PROJECTION
 		glm::mat4 projection = glm::perspective(glm::radians(45.0F), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+		if (progressive)
+			projection = progressive->jitter(projection);
 		
 		// VIEW
 		glm::mat4 view = glm::lookAt(position, position + front, up);
@@ -189,16 +676,312 @@ int main(void)
 		theShader.setMat4("model", model);
 
 		//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-		glCullFace(GL_FRONT);
-		// render the cube
-		glBindVertexArray(vao);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
+		state.cullFace(GL_FRONT);
+		// render the cube, or the streamed mesh
+		if (streamer)
+		{
+			glm::mat4 modelView = view * model;
+			glm::vec3 cameraPosition = glm::vec3(glm::inverse(modelView) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+			streamer->update(projection * modelView, cameraPosition, frameArena.threadArena());
+			streamer->upload();
+			streamer->draw();
+			streamer->reportTo(profiler);
+		}
+		else if (!boxScene && !partScene && !drawQueue)
+		{
+			if (!resources.isGroupResident(cubeGroup))
+			{
+				cube.upload(cubeMesh);
+				cube.addToGroup(cubeGroup);
+			}
+			resources.touchGroup(cubeGroup);
+			cube.bind();
+			glDrawArrays(GL_TRIANGLES, 0, 36);
+		}
+
+		if (drawQueue)
+		{
+			// the orbit is folded into the view, the state the queue does not set is set once per frame
+			glm::mat4 sceneView = view * model;
+			for (Shader* shader : queueShaders)
+			{
+				shader->use();
+				shader->setVec3("lightColor", 1.0f, 1.0f, 1.0f);
+				shader->setVec3("lightPos", lightPos);
+			}
+			drawQueue->clear();
+			for (unsigned int i = 0; i < (unsigned int)queuePositions.size(); ++i)
+			{
+				glm::mat4 box = glm::scale(glm::translate(glm::mat4(1.0f), queuePositions[i]), glm::vec3(queueScale));
+				float viewDepth = -(sceneView * glm::vec4(queuePositions[i], 1.0f)).z;
+				drawQueue->push(PASS_OPAQUE, i % 2, i * 7 % 32, i / 2 % 2, box, viewDepth);
+			}
+			drawQueue->sort(JobSystem::instance());
+			state.cullFace(GL_BACK);
+			drawQueue->submit(sceneView, projection);
+			drawQueue->reportTo(profiler);
+		}
+
+		if (partScene)
+		{
+			partShader->use();
+			partShader->setVec3("objectColor", 0.5f, 0.5f, 0.5f);
+			partShader->setVec3("lightColor", 1.0f, 1.0f, 1.0f);
+			partShader->setVec3("lightPos", lightPos);
+			partShader->setMat4("projection", projection);
+			partShader->setMat4("view", view * model);
+			state.cullFace(GL_BACK);
+			Frustum partFrustum(projection * view * model);
+			partScene->draw(&partFrustum);
+		}
+
+		if (boxScene)
+		{
+			// the orbit is folded into the view, instances carry their own model matrix
+			glm::mat4 sceneView = view * model;
+			float aspect = (float)SCR_WIDTH / (float)SCR_HEIGHT;
+			if (lighting && !DEFERRED_SHADING)
+				lighting->update(sceneView, glm::radians(45.0F), aspect, 0.1f, 100.0f, renderSize, frameArena.threadArena());
+
+			if (shadows)
+			{
+				float time = regression ? regression->scene().time : (float)glfwGetTime();
+				for (unsigned int i = 0; i < movingBoxes->placementCount(); ++i)
+				{
+					float angle = time * 0.3f + i * glm::two_pi<float>() / movingBoxes->placementCount();
+					glm::mat4 box = glm::translate(glm::mat4(1.0f), glm::vec3(1.2f * std::cos(angle), 0.6f + 0.2f * std::sin(time + i), 1.2f * std::sin(angle)));
+					movingBoxes->setTransform(i, glm::scale(glm::rotate(box, time, glm::vec3(0.0f, 1.0f, 0.0f)), glm::vec3(0.2f)));
+				}
+
+				// back faces into the shadow map, the city only when its cascades moved
+				shadows->update(sceneView, glm::radians(45.0F), aspect, 0.1f, glm::vec3(-0.4f, -1.0f, -0.3f), renderSize, sceneFramebuffer);
+				shadowShader->use();
+				state.cullFace(GL_FRONT);
+				shadows->render([&](const glm::mat4& lightViewProjection)
+				{
+					shadowShader->setMat4("lightViewProjection", lightViewProjection);
+					boxScene->drawDepth();
+				}, [&](const glm::mat4& lightViewProjection)
+				{
+					shadowShader->setMat4("lightViewProjection", lightViewProjection);
+					movingBoxes->drawDepth();
+				});
+				shadows->reportTo(profiler);
+			}
+
+			// shading of either path is timed on the GPU to compare them over the same lights,
+			// front to back so hidden fragments fail the depth test before shading
+			if (!gpuScene)
+				boxScene->sortFrontToBack(sceneView);
+			if (movingBoxes)
+				movingBoxes->sortFrontToBack(sceneView);
+			boxTimer->begin();
+			state.cullFace(GL_BACK);
+			if (DEFERRED_SHADING)
+			{
+				deferred->beginGeometry(renderSize);
+				gbufferShader->use();
+				gbufferShader->setMat4("projection", projection);
+				gbufferShader->setMat4("view", sceneView);
+				gbufferShader->setInt("materialId", 1);
+				boxScene->draw();
+				if (movingBoxes)
+				{
+					gbufferShader->setInt("materialId", 2);
+					movingBoxes->draw();
+				}
+
+				deferredShader->use();
+				if (shadows)
+					shadows->bind(*deferredShader, 3);
+				deferred->shade(*deferredShader, sceneView, projection, glm::vec3(1.0f), sceneFramebuffer);
+				deferred->reportTo(profiler);
+			}
+			else
+			{
+				// the city through the GPU scene, culled once for the pre-pass and the shading pass
+				if (gpuScene)
+				{
+					gpuScene->cull(projection * sceneView);
+					gpuScene->drawShader().use();
+					gpuScene->drawShader().setMat4("projection", projection);
+					gpuScene->drawShader().setMat4("view", sceneView);
+				}
+
+				// depth of the nearest surfaces first, then only they are shaded
+				if (DEPTH_PREPASS)
+				{
+					state.colorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+					if (gpuScene)
+					{
+						// positions only, the invariant gl_Position of both programs keeps GL_EQUAL exact
+						gpuScene->depthShader().use();
+						gpuScene->depthShader().setMat4("projection", projection);
+						gpuScene->depthShader().setMat4("view", sceneView);
+						gpuScene->drawDepth();
+					}
+					depthShader->use();
+					depthShader->setMat4("projection", projection);
+					depthShader->setMat4("view", sceneView);
+					if (!gpuScene)
+						boxScene->drawDepth();
+					if (movingBoxes)
+						movingBoxes->drawDepth();
+					state.colorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+					state.depthFunc(GL_EQUAL);
+					state.depthMask(GL_FALSE);
+				}
+
+				auto useForwardShader = [&](Shader& shader)
+				{
+					shader.use();
+					shader.setVec3("objectColor", 0.8f, 0.8f, 0.8f);
+					shader.setVec3("lightColor", 1.0f, 1.0f, 1.0f);
+					shader.setMat4("projection", projection);
+					shader.setMat4("view", sceneView);
+					if (lighting)
+						lighting->bind(shader);
+					if (shadows)
+						shadows->bind(shader, 3);
+				};
+				if (lighting)
+					lighting->reportTo(profiler);
+				boxFragments->begin();
+				if (gpuScene)
+				{
+					useForwardShader(gpuScene->drawShader());
+					gpuScene->draw();
+				}
+				useForwardShader(*boxShader);
+				if (!gpuScene)
+					boxScene->draw();
+				if (movingBoxes)
+					movingBoxes->draw();
+				boxFragments->end();
+				profiler.addCounter(boxFragments->label(), (double)boxFragments->count());
+
+				state.depthFunc(GL_LESS);
+				state.depthMask(GL_TRUE);
+			}
+			boxTimer->end();
+			profiler.addCounter(DEFERRED_SHADING ? "DEFERRED SHADING GPU MS" : "FORWARD SHADING GPU MS", boxTimer->milliseconds());
+		}
+
+		if (pointCloud)
+		{
+			// pixels per unit at distance 1 for the 45 degrees field of view, scaled with the render quality
+			float screenScale = lodScale * (float)SCR_HEIGHT / (2.0f * std::tan(glm::radians(45.0F) * 0.5f));
+			glm::mat4 modelView = view * model;
+			glm::vec3 cameraPosition = glm::vec3(glm::inverse(modelView) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+			pointShader->use();
+			pointShader->setMat4("projection", projection);
+			pointShader->setMat4("view", view);
+			pointShader->setMat4("model", model);
+			pointCloud->update(projection * modelView, cameraPosition, screenScale, frameArena.threadArena());
+			pointCloud->upload();
+			pointCloud->draw(*pointShader, screenScale);
+			pointCloud->reportTo(profiler);
+		}
+
+		if (terrain)
+		{
+			float screenScale = lodScale * (float)SCR_HEIGHT / (2.0f * std::tan(glm::radians(45.0F) * 0.5f));
+			glm::mat4 terrainModel = model * terrain->terrainTransform();
+			glm::mat4 modelView = view * terrainModel;
+			glm::vec3 cameraPosition = glm::vec3(glm::inverse(modelView) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+			terrainShader->use();
+			terrainShader->setVec3("objectColor", 0.45f, 0.5f, 0.35f);
+			terrainShader->setVec3("lightColor", 1.0f, 1.0f, 1.0f);
+			terrainShader->setVec3("lightPos", lightPos);
+			terrainShader->setMat4("projection", projection);
+			terrainShader->setMat4("view", view);
+			terrainShader->setMat4("model", terrainModel);
+			terrain->update(projection * modelView, cameraPosition, screenScale, frameArena.threadArena());
+			terrain->upload();
+			state.cullFace(GL_BACK);
+			terrain->draw(*terrainShader);
+			terrain->reportTo(profiler);
+		}
+
+		if (volume)
+		{
+			glm::mat4 volumeModel = model * volume->volumeTransform();
+			glm::mat4 modelView = view * volumeModel;
+			glm::vec3 cameraPosition = glm::vec3(glm::inverse(modelView) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+			volume->update(projection * modelView, cameraPosition, frameArena.threadArena());
+			volume->upload();
+			volume->draw(*volumeShader, volumeModel, view, projection, cameraPosition);
+			volume->reportTo(profiler);
+		}
+		unsigned int pendingReads = (streamer ? streamer->stats().pendingReads : 0) + (pointCloud ? pointCloud->stats().pendingReads : 0) +
+			(terrain ? terrain->stats().pendingReads : 0) + (volume ? volume->stats().pendingReads : 0);
+		if (progressive)
+		{
+			// streamed data on its way or moving casters outdate what was accumulated
+			if (pendingReads > 0 || movingBoxes)
+				progressive->contentChanged();
+			progressive->endFrame(*accumulateShader, 0.1f, 100.0f);
+			progressive->reportTo(profiler);
+		}
+		else if (dynamicResolution)
+		{
+			dynamicResolution->endFrame();
+			dynamicResolution->reportTo(profiler);
+		}
+		else if (regression && !regression->endFrame(pendingReads == 0))
+			glfwSetWindowShouldClose(window, GLFW_TRUE);
+		if (CAPTURE)
+		{
+			frameCapture.capture(glm::uvec2(width, height));
+			frameCapture.reportTo(profiler);
+		}
+		resources.enforceBudget();
+
+		state.reportTo(profiler);
+		resources.reportTo(profiler);
+		frameArena.reportTo(profiler);
+		if (HeapCounter::IsEnabled())
+		{
+			uint64_t allocations = HeapCounter::AllocationCount();
+			profiler.addCounter("HEAP ALLOCATIONS", (double)(allocations - heapAllocations));
+			heapAllocations = allocations;
+		}
+		profiler.endFrame();
 
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 	}
 
+	bool passed = true;
+	if (regression)
+	{
+		regression->report(std::cout);
+		passed = regression->passed();
+	}
+
+	// the compile context has to go before the window it shares with
+	reloader.reset();
+	streamer.reset();
+	pointCloud.reset();
+	volume.reset();
+	terrain.reset();
+	partScene.reset();
+	drawQueue.reset();
+	boxScene.reset();
+	movingBoxes.reset();
+	gpuScene.reset();
+	lighting.reset();
+	shadows.reset();
+	deferred.reset();
+	boxTimer.reset();
+	boxFragments.reset();
+	dynamicResolution.reset();
+	progressive.reset();
+	regression.reset();
+	frameCapture.stop();
+	resources.releaseAll();
+
 	glfwDestroyWindow(window);
 	glfwTerminate();
-	exit(EXIT_SUCCESS);
+	exit(passed ? EXIT_SUCCESS : EXIT_FAILURE);
 }
\ No newline at end of file
@@ -0,0 +1,124 @@
+#include "mesh.h"
+#include <cstdint>
+#include <cstring>
+
+
+std::vector<float> InterleavePositionsNormals(const Mesh& mesh)
+{
+	std::vector<float> vertices;
+	vertices.reserve(mesh.positions.size() * 6);
+	for (size_t i = 0; i < mesh.positions.size(); ++i)
+	{
+		const glm::vec3& position = mesh.positions[i];
+		glm::vec3 normal = i < mesh.normals.size() ? mesh.normals[i] : glm::vec3(0.0f, 0.0f, 1.0f);
+		vertices.insert(vertices.end(), { position.x, position.y, position.z, normal.x, normal.y, normal.z });
+	}
+	return vertices;
+}
+
+
+glm::vec4 ComputeBoundingSphere(const Mesh& mesh)
+{
+	if (mesh.positions.empty())
+		return glm::vec4(0.0f);
+
+	glm::vec3 boxMin = mesh.positions[0];
+	glm::vec3 boxMax = mesh.positions[0];
+	for (const glm::vec3& position : mesh.positions)
+	{
+		boxMin = glm::min(boxMin, position);
+		boxMax = glm::max(boxMax, position);
+	}
+
+	glm::vec3 center = (boxMin + boxMax) * 0.5f;
+	float radius = 0.0f;
+	for (const glm::vec3& position : mesh.positions)
+		radius = glm::max(radius, glm::length(position - center));
+	return glm::vec4(center, radius);
+}
+
+
+void ComputeNormals(Mesh& mesh)
+{
+	// the cross product length is twice the triangle area, larger faces weigh more
+	mesh.normals.assign(mesh.positions.size(), glm::vec3(0.0f));
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+	{
+		unsigned int a = mesh.indices[i], b = mesh.indices[i + 1], c = mesh.indices[i + 2];
+		glm::vec3 normal = glm::cross(mesh.positions[b] - mesh.positions[a], mesh.positions[c] - mesh.positions[a]);
+		mesh.normals[a] += normal;
+		mesh.normals[b] += normal;
+		mesh.normals[c] += normal;
+	}
+
+	for (glm::vec3& normal : mesh.normals)
+	{
+		float length = glm::length(normal);
+		normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+	}
+}
+
+
+size_t WeldVertices(Mesh& mesh)
+{
+	size_t count = mesh.positions.size();
+	if (mesh.indices.empty())
+	{
+		mesh.indices.resize(count);
+		for (size_t i = 0; i < count; ++i)
+			mesh.indices[i] = (unsigned int)i;
+	}
+	bool hasNormals = mesh.normals.size() == count;
+
+	// open addressing over the float bits, -0 is folded into +0 so equal values hash alike
+	auto bits = [](float value)
+	{
+		float folded = value + 0.0f;
+		uint32_t word;
+		memcpy(&word, &folded, sizeof(word));
+		return word;
+	};
+	size_t tableSize = 1;
+	while (tableSize < count * 2)
+		tableSize <<= 1;
+	std::vector<unsigned int> table(tableSize, ~0u);
+	std::vector<unsigned int> remap(count);
+
+	unsigned int kept = 0;
+	for (size_t v = 0; v < count; ++v)
+	{
+		const glm::vec3& position = mesh.positions[v];
+		glm::vec3 normal = hasNormals ? mesh.normals[v] : glm::vec3(0.0f);
+		uint64_t hash = 0xcbf29ce484222325ull;
+		for (float value : { position.x, position.y, position.z, normal.x, normal.y, normal.z })
+			hash = (hash ^ bits(value)) * 0x100000001b3ull;
+
+		size_t slot = (size_t)(hash ^ (hash >> 32)) & (tableSize - 1);
+		for (;; slot = (slot + 1) & (tableSize - 1))
+		{
+			unsigned int other = table[slot];
+			if (other == ~0u)
+			{
+				// first occurrence, moved down to its welded place
+				table[slot] = kept;
+				mesh.positions[kept] = position;
+				if (hasNormals)
+					mesh.normals[kept] = normal;
+				remap[v] = kept++;
+				break;
+			}
+			if (mesh.positions[other] == position && (!hasNormals || mesh.normals[other] == normal))
+			{
+				remap[v] = other;
+				break;
+			}
+		}
+	}
+
+	for (unsigned int& index : mesh.indices)
+		index = remap[index];
+	mesh.positions.resize(kept);
+	if (hasNormals)
+		mesh.normals.resize(kept);
+	return count - kept;
+}
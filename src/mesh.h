@@ -0,0 +1,52 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <vector>
+#include <glm.hpp>
+
+/*!
+ * Indexed triangle mesh as kept on the CPU side
+ *
+ * positions and normals are parallel arrays, indices are triangle lists
+ * with counter clock wise winding for front faces.
+ */
+struct Mesh
+{
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> normals;
+	std::vector<unsigned int> indices;
+};
+
+/*!
+ * Interleave positions and normals the way the vertex shaders expect them
+ *
+ * \param mesh : source mesh, missing normals are written as +Z
+ * \return : x, y, z, nx, ny, nz per vertex
+ */
+std::vector<float> InterleavePositionsNormals(const Mesh& mesh);
+
+/*!
+ * Bounding sphere centered on the bounding box of the mesh
+ *
+ * \param mesh : source mesh
+ * \return : xyz center, w radius
+ */
+glm::vec4 ComputeBoundingSphere(const Mesh& mesh);
+
+/*!
+ * Area weighted vertex normals of the triangles
+ *
+ * \param mesh : normals are replaced, vertices of no triangle get +Z
+ */
+void ComputeNormals(Mesh& mesh);
+
+/*!
+ * Merge vertices of equal position and normal and rewrite the indices
+ *
+ * A mesh without indices is taken as a triangle soup and gets indexed.
+ *
+ * \param mesh : welded in place, the remaining vertices keep their order
+ * \return : number of vertices removed
+ */
+size_t WeldVertices(Mesh& mesh);
+#endif
@@ -0,0 +1,204 @@
+#include "mesh_cache.h"
+#include <iostream>
+#include <cstddef>
+
+namespace
+{
+	const char MAGIC[4] = { 'O', 'G', 'V', 'C' };
+
+	struct FileHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t sectionCount;
+		uint32_t reserved;
+	};
+
+	struct SectionHeader
+	{
+		uint32_t tag;
+		uint32_t reserved;
+		uint64_t size;
+	};
+}
+
+
+bool MeshCacheWriter::open(const std::string& path)
+{
+	m_File.open(path, std::ios::binary | std::ios::trunc);
+	if (!m_File.is_open())
+	{
+		std::cout << "ERROR::MESH CACHE::UNABLE TO CREATE FILE: " << path << std::endl;
+		return false;
+	}
+
+	FileHeader header;
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = MeshCache::VERSION;
+	header.sectionCount = 0;
+	header.reserved = 0;
+	m_File.write((const char*)&header, sizeof(header));
+	m_SectionCount = 0;
+	return true;
+}
+
+
+void MeshCacheWriter::addSection(uint32_t tag, const void* data, uint64_t size)
+{
+	SectionHeader section;
+	section.tag = tag;
+	section.reserved = 0;
+	section.size = size;
+	m_File.write((const char*)&section, sizeof(section));
+	if (size > 0)
+		m_File.write((const char*)data, (std::streamsize)size);
+	++m_SectionCount;
+}
+
+
+void MeshCacheWriter::beginSection(uint32_t tag)
+{
+	SectionHeader section;
+	section.tag = tag;
+	section.reserved = 0;
+	section.size = 0;
+	m_OpenSection = (std::streamoff)m_File.tellp();
+	m_OpenSectionSize = 0;
+	m_File.write((const char*)&section, sizeof(section));
+	++m_SectionCount;
+}
+
+
+void MeshCacheWriter::appendSection(const void* data, uint64_t size)
+{
+	if (size > 0)
+		m_File.write((const char*)data, (std::streamsize)size);
+	m_OpenSectionSize += size;
+}
+
+
+void MeshCacheWriter::endSection()
+{
+	if (m_OpenSection < 0)
+		return;
+
+	std::streamoff end = (std::streamoff)m_File.tellp();
+	m_File.seekp(m_OpenSection + (std::streamoff)offsetof(SectionHeader, size));
+	m_File.write((const char*)&m_OpenSectionSize, sizeof(m_OpenSectionSize));
+	m_File.seekp(end);
+	m_OpenSection = -1;
+}
+
+
+void MeshCacheWriter::addMesh(const Mesh& mesh)
+{
+	addSection(MeshCache::TAG_POSITIONS, mesh.positions.data(), mesh.positions.size() * sizeof(glm::vec3));
+	addSection(MeshCache::TAG_NORMALS, mesh.normals.data(), mesh.normals.size() * sizeof(glm::vec3));
+	addSection(MeshCache::TAG_INDICES, mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+}
+
+
+bool MeshCacheWriter::close()
+{
+	// section count lives right after magic and version
+	m_File.seekp(offsetof(FileHeader, sectionCount));
+	m_File.write((const char*)&m_SectionCount, sizeof(m_SectionCount));
+
+	bool success = m_File.good();
+	m_File.close();
+	if (!success)
+		std::cout << "ERROR::MESH CACHE::FAILED TO WRITE FILE" << std::endl;
+	return success;
+}
+
+
+bool MeshCacheReader::open(const std::string& path)
+{
+	m_Sections.clear();
+	m_File.open(path, std::ios::binary);
+	if (!m_File.is_open())
+		return false;
+
+	FileHeader header;
+	m_File.read((char*)&header, sizeof(header));
+	if (!m_File || memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != MeshCache::VERSION)
+	{
+		std::cout << "ERROR::MESH CACHE::INVALID OR OUTDATED FILE: " << path << std::endl;
+		m_File.close();
+		return false;
+	}
+
+	for (uint32_t i = 0; i < header.sectionCount; ++i)
+	{
+		SectionHeader sectionHeader;
+		m_File.read((char*)&sectionHeader, sizeof(sectionHeader));
+		if (!m_File)
+		{
+			std::cout << "ERROR::MESH CACHE::TRUNCATED FILE: " << path << std::endl;
+			m_File.close();
+			return false;
+		}
+
+		Section section;
+		section.tag = sectionHeader.tag;
+		section.offset = (uint64_t)m_File.tellg();
+		section.size = sectionHeader.size;
+		m_Sections.push_back(section);
+
+		m_File.seekg((std::streamoff)sectionHeader.size, std::ios::cur);
+	}
+	return true;
+}
+
+
+bool MeshCacheReader::hasSection(uint32_t tag) const
+{
+	return FindSection(tag) != nullptr;
+}
+
+
+bool MeshCacheReader::sectionRange(uint32_t tag, uint64_t& offset, uint64_t& size) const
+{
+	const Section* section = FindSection(tag);
+	if (!section)
+		return false;
+	offset = section->offset;
+	size = section->size;
+	return true;
+}
+
+
+bool MeshCacheReader::readSection(uint32_t tag, std::vector<char>& data)
+{
+	const Section* section = FindSection(tag);
+	if (!section)
+		return false;
+
+	data.resize((size_t)section->size);
+	m_File.clear();
+	m_File.seekg((std::streamoff)section->offset);
+	if (section->size > 0)
+		m_File.read(data.data(), (std::streamsize)section->size);
+	return (bool)m_File;
+}
+
+
+bool MeshCacheReader::readMesh(Mesh& mesh)
+{
+	if (!readArray(MeshCache::TAG_POSITIONS, mesh.positions) || !readArray(MeshCache::TAG_INDICES, mesh.indices))
+		return false;
+	if (!readArray(MeshCache::TAG_NORMALS, mesh.normals))
+		mesh.normals.clear();
+	return true;
+}
+
+
+const MeshCacheReader::Section* MeshCacheReader::FindSection(uint32_t tag) const
+{
+	for (const Section& section : m_Sections)
+	{
+		if (section.tag == tag)
+			return &section;
+	}
+	return nullptr;
+}
@@ -0,0 +1,182 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include "mesh.h"
+
+/*!
+ * Native cache file of the viewer
+ *
+ * A small header followed by tagged sections, each section is
+ * (tag, reserved, byte size, payload). Unknown sections are skipped by
+ * readers so new data can be added without breaking older caches.
+ */
+namespace MeshCache
+{
+	const uint32_t VERSION = 1;
+
+	/*!
+	 * Build a section tag out of four characters
+	 *
+	 */
+	inline uint32_t MakeTag(char a, char b, char c, char d)
+	{
+		return (uint32_t)(unsigned char)a | ((uint32_t)(unsigned char)b << 8) |
+			((uint32_t)(unsigned char)c << 16) | ((uint32_t)(unsigned char)d << 24);
+	}
+
+	const uint32_t TAG_POSITIONS = MakeTag('P', 'O', 'S', 'N');
+	const uint32_t TAG_NORMALS = MakeTag('N', 'O', 'R', 'M');
+	const uint32_t TAG_INDICES = MakeTag('I', 'N', 'D', 'X');
+	const uint32_t TAG_MESHLETS = MakeTag('M', 'S', 'H', 'L');
+	const uint32_t TAG_MESHLET_INDICES = MakeTag('M', 'S', 'H', 'I');
+	const uint32_t TAG_CHUNK_TABLE = MakeTag('C', 'H', 'N', 'K');
+	const uint32_t TAG_CHUNK_DATA = MakeTag('C', 'H', 'K', 'D');
+	const uint32_t TAG_POINT_HEADER = MakeTag('P', 'C', 'H', 'D');
+	const uint32_t TAG_POINT_NODES = MakeTag('P', 'C', 'N', 'D');
+	const uint32_t TAG_POINTS = MakeTag('P', 'C', 'P', 'T');
+	const uint32_t TAG_VOLUME_HEADER = MakeTag('V', 'O', 'H', 'D');
+	const uint32_t TAG_VOLUME_BRICK_TABLE = MakeTag('V', 'O', 'B', 'T');
+	const uint32_t TAG_VOLUME_BRICKS = MakeTag('V', 'O', 'B', 'K');
+	const uint32_t TAG_TERRAIN_HEADER = MakeTag('T', 'R', 'H', 'D');
+	const uint32_t TAG_TERRAIN_TILE_TABLE = MakeTag('T', 'R', 'T', 'T');
+	const uint32_t TAG_TERRAIN_TILES = MakeTag('T', 'R', 'T', 'L');
+}
+
+class MeshCacheWriter
+{
+public:
+	/*!
+	 * Open a cache file for writing, any existing file is replaced
+	 *
+	 * \param path : path of the cache file
+	 * \return : false(bool) if the file can not be created
+	 */
+	bool open(const std::string& path);
+
+	/*!
+	 * Append a section
+	 *
+	 * \param tag : tag made with MeshCache::MakeTag
+	 * \param data : payload of the section
+	 * \param size : payload size in bytes
+	 */
+	void addSection(uint32_t tag, const void* data, uint64_t size);
+
+	/*!
+	 * Start a section written in pieces, for payloads too large to hold in memory
+	 *
+	 * \param tag : tag made with MeshCache::MakeTag
+	 */
+	void beginSection(uint32_t tag);
+
+	/*!
+	 * Append to the section opened with beginSection
+	 *
+	 */
+	void appendSection(const void* data, uint64_t size);
+
+	/*!
+	 * Patch the size of the section opened with beginSection
+	 *
+	 */
+	void endSection();
+
+	/*!
+	 * Append the positions, normals and indices of a mesh
+	 *
+	 */
+	void addMesh(const Mesh& mesh);
+
+	/*!
+	 * Patch the section count in the header and close the file
+	 *
+	 * \return : false(bool) if any write failed
+	 */
+	bool close();
+
+private:
+
+	std::ofstream m_File;
+	uint32_t m_SectionCount = 0;
+	std::streamoff m_OpenSection = -1;  // header position of the section being appended
+	uint64_t m_OpenSectionSize = 0;
+};
+
+class MeshCacheReader
+{
+public:
+	/*!
+	 * Open a cache file and index its sections
+	 *
+	 * \param path : path of the cache file
+	 * \return : false(bool) if the file is missing or is not a cache of this version
+	 */
+	bool open(const std::string& path);
+
+	/*!
+	 * Check for a section
+	 *
+	 */
+	bool hasSection(uint32_t tag) const;
+
+	/*!
+	 * Location of a section payload in the file, for readers doing their own I/O
+	 *
+	 * \param tag : tag of the section
+	 * \param offset : receives the absolute file offset of the payload
+	 * \param size : receives the payload size in bytes
+	 * \return : false(bool) if the section is missing
+	 */
+	bool sectionRange(uint32_t tag, uint64_t& offset, uint64_t& size) const;
+
+	/*!
+	 * Read the whole payload of a section
+	 *
+	 * \param tag : tag of the section
+	 * \param data : receives the payload
+	 * \return : false(bool) if the section is missing or can not be read
+	 */
+	bool readSection(uint32_t tag, std::vector<char>& data);
+
+	/*!
+	 * Read a section as an array of trivially copyable elements
+	 *
+	 */
+	template <typename T>
+	bool readArray(uint32_t tag, std::vector<T>& values)
+	{
+		std::vector<char> data;
+		if (!readSection(tag, data) || data.size() % sizeof(T) != 0)
+			return false;
+		values.resize(data.size() / sizeof(T));
+		if (!data.empty())
+			memcpy(values.data(), data.data(), data.size());
+		return true;
+	}
+
+	/*!
+	 * Read the positions, normals and indices of a mesh
+	 *
+	 */
+	bool readMesh(Mesh& mesh);
+
+private:
+
+	struct Section
+	{
+		uint32_t tag;
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	std::ifstream m_File;
+	std::vector<Section> m_Sections;
+
+	const Section* FindSection(uint32_t tag) const;
+};
+#endif
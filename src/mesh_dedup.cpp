@@ -0,0 +1,359 @@
+#include "mesh_dedup.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+#include <gtc/matrix_transform.hpp>
+
+namespace
+{
+	/*!
+	 * Frame the mesh is compared in, canonical space to mesh space
+	 *
+	 */
+	struct CanonicalFrame
+	{
+		glm::vec3 center;
+		glm::mat3 rotation;
+		float radius;
+		glm::vec3 extent;    // of the bounding box in canonical space
+		int radiusClass;     // ceil(log2(radius)), picks the cell size of the extents
+		uint64_t hash;       // exact data, or topology only for the tolerant modes
+	};
+
+	/*!
+	 * Eigen vectors of a symmetric 3x3 matrix with cyclic Jacobi rotations
+	 *
+	 * \param matrix : symmetric matrix, destroyed
+	 * \param vectors : receives eigen vectors as columns
+	 * \param values : receives eigen values
+	 */
+	void SymmetricEigen(glm::dmat3 matrix, glm::dmat3& vectors, glm::dvec3& values)
+	{
+		vectors = glm::dmat3(1.0);
+		for (int sweep = 0; sweep < 32; ++sweep)
+		{
+			double offDiagonal = std::fabs(matrix[0][1]) + std::fabs(matrix[0][2]) + std::fabs(matrix[1][2]);
+			if (offDiagonal < 1e-18)
+				break;
+
+			for (int p = 0; p < 2; ++p)
+			{
+				for (int q = p + 1; q < 3; ++q)
+				{
+					if (std::fabs(matrix[p][q]) < 1e-30)
+						continue;
+
+					double theta = (matrix[q][q] - matrix[p][p]) / (2.0 * matrix[p][q]);
+					double t = (theta >= 0.0 ? 1.0 : -1.0) / (std::fabs(theta) + std::sqrt(theta * theta + 1.0));
+					double c = 1.0 / std::sqrt(t * t + 1.0);
+					double s = t * c;
+
+					glm::dmat3 rotation(1.0);
+					rotation[p][p] = c;
+					rotation[q][q] = c;
+					rotation[q][p] = s;
+					rotation[p][q] = -s;
+
+					matrix = glm::transpose(rotation) * matrix * rotation;
+					vectors = vectors * rotation;
+				}
+			}
+		}
+		values = glm::dvec3(matrix[0][0], matrix[1][1], matrix[2][2]);
+	}
+
+	/*!
+	 * Principal axes of the vertices, signs fixed by the third moment
+	 *
+	 * \return : false(bool) if the axes are ambiguous (symmetric parts)
+	 */
+	bool PrincipalAxes(const Mesh& mesh, const glm::vec3& center, glm::mat3& rotation)
+	{
+		glm::dmat3 covariance(0.0);
+		for (const glm::vec3& position : mesh.positions)
+		{
+			glm::dvec3 d = glm::dvec3(position - center);
+			covariance += glm::outerProduct(d, d);
+		}
+
+		glm::dmat3 vectors;
+		glm::dvec3 values;
+		SymmetricEigen(covariance, vectors, values);
+
+		// sort by decreasing variance
+		int order[3] = { 0, 1, 2 };
+		for (int i = 0; i < 2; ++i)
+			for (int j = i + 1; j < 3; ++j)
+				if (values[order[j]] > values[order[i]])
+					std::swap(order[i], order[j]);
+
+		double largest = values[order[0]];
+		if (largest <= 0.0)
+			return false;
+		// equal variances leave the axes free to spin
+		if (values[order[0]] - values[order[1]] < 1e-3 * largest || values[order[1]] - values[order[2]] < 1e-3 * largest)
+			return false;
+
+		glm::dvec3 axes[3] = { vectors[order[0]], vectors[order[1]], vectors[order[2]] };
+		for (int k = 0; k < 2; ++k)
+		{
+			double skew = 0.0;
+			double scale = 0.0;
+			for (const glm::vec3& position : mesh.positions)
+			{
+				double x = glm::dot(glm::dvec3(position - center), axes[k]);
+				skew += x * x * x;
+				scale += std::fabs(x * x * x);
+			}
+			if (std::fabs(skew) < 1e-4 * scale)
+				return false;
+			if (skew < 0.0)
+				axes[k] = -axes[k];
+		}
+		// right handed so mirrored parts never match
+		axes[2] = glm::cross(axes[0], axes[1]);
+
+		rotation = glm::mat3(glm::vec3(axes[0]), glm::vec3(axes[1]), glm::vec3(axes[2]));
+		return true;
+	}
+
+	CanonicalFrame Canonicalize(const Mesh& mesh, const MeshDedup::Options& options)
+	{
+		CanonicalFrame frame;
+		frame.center = glm::vec3(0.0f);
+		frame.rotation = glm::mat3(1.0f);
+
+		if (options.mode != MeshDedup::MATCH_EXACT && !mesh.positions.empty())
+		{
+			glm::dvec3 sum(0.0);
+			for (const glm::vec3& position : mesh.positions)
+				sum += glm::dvec3(position);
+			frame.center = glm::vec3(sum / (double)mesh.positions.size());
+		}
+
+		if (options.mode == MeshDedup::MATCH_RIGID && !PrincipalAxes(mesh, frame.center, frame.rotation))
+			frame.rotation = glm::mat3(1.0f);
+
+		frame.radius = 0.0f;
+		glm::vec3 low(0.0f), high(0.0f);
+		glm::mat3 toCanonical = glm::transpose(frame.rotation);
+		for (const glm::vec3& position : mesh.positions)
+		{
+			glm::vec3 canonical = toCanonical * (position - frame.center);
+			low = glm::min(low, canonical);
+			high = glm::max(high, canonical);
+			frame.radius = std::fmax(frame.radius, glm::length(canonical));
+		}
+		frame.extent = high - low;
+		// points and empty meshes get the finest class, their cells stay above zero
+		frame.radiusClass = frame.radius > 0.0f ? std::max(-100, (int)std::ceil(std::log2(frame.radius))) : -100;
+
+		// counts and topology are exact whatever the mode, positions only when bit exact is asked
+		uint32_t counts[2] = { (uint32_t)mesh.positions.size(), (uint32_t)mesh.indices.size() };
+		uint64_t hash = MeshDedup::HashWords(counts, 2);
+		hash = MeshDedup::HashWords(mesh.indices.data(), mesh.indices.size(), hash);
+		if (options.mode == MeshDedup::MATCH_EXACT)
+		{
+			hash = MeshDedup::HashWords((const uint32_t*)mesh.positions.data(), mesh.positions.size() * 3, hash);
+			hash = MeshDedup::HashWords((const uint32_t*)mesh.normals.data(), mesh.normals.size() * 3, hash);
+		}
+		frame.hash = hash;
+		return frame;
+	}
+
+	bool SameTopology(const Mesh& a, const Mesh& b)
+	{
+		return a.positions.size() == b.positions.size() && a.normals.size() == b.normals.size() &&
+			a.indices == b.indices;
+	}
+
+	bool SameGeometry(const Mesh& a, const CanonicalFrame& frameA, const Mesh& b, const CanonicalFrame& frameB,
+		const MeshDedup::Options& options)
+	{
+		if (!SameTopology(a, b))
+			return false;
+
+		if (options.mode == MeshDedup::MATCH_EXACT)
+		{
+			return memcmp(a.positions.data(), b.positions.data(), a.positions.size() * sizeof(glm::vec3)) == 0 &&
+				memcmp(a.normals.data(), b.normals.data(), a.normals.size() * sizeof(glm::vec3)) == 0;
+		}
+
+		float tolerance = std::fmax(frameA.radius, frameB.radius) * options.tolerance;
+		if (std::fabs(frameA.radius - frameB.radius) > tolerance)
+			return false;
+
+		glm::mat3 toCanonicalA = glm::transpose(frameA.rotation);
+		glm::mat3 toCanonicalB = glm::transpose(frameB.rotation);
+		for (size_t i = 0; i < a.positions.size(); ++i)
+		{
+			glm::vec3 delta = toCanonicalA * (a.positions[i] - frameA.center) - toCanonicalB * (b.positions[i] - frameB.center);
+			if (std::fabs(delta.x) > tolerance || std::fabs(delta.y) > tolerance || std::fabs(delta.z) > tolerance)
+				return false;
+		}
+		for (size_t i = 0; i < a.normals.size(); ++i)
+		{
+			if (glm::dot(toCanonicalA * a.normals[i], toCanonicalB * b.normals[i]) < 0.999f)
+				return false;
+		}
+		return true;
+	}
+
+	/*!
+	 * Bucket of the tolerant modes, topology and extents quantized for a radius class
+	 *
+	 * Matching meshes move each vertex by at most radius * tolerance, so their
+	 * extents differ by twice that. Cells of 4 * tolerance * 2^radiusClass are
+	 * wider than this for both radius classes the pair can fall in, a match is
+	 * then in the same or a neighbouring cell of the class.
+	 *
+	 * \param offset : neighbouring cell, each component in -1..1
+	 */
+	uint64_t ToleranceKey(const CanonicalFrame& frame, int radiusClass, const glm::ivec3& offset, const MeshDedup::Options& options)
+	{
+		float cell = 4.0f * std::fmax(options.tolerance, 1e-7f) * std::ldexp(1.0f, radiusClass);
+		glm::ivec3 quantized = glm::ivec3(glm::floor(frame.extent / cell)) + offset;
+		uint32_t words[6] = { (uint32_t)(frame.hash >> 32), (uint32_t)frame.hash, (uint32_t)radiusClass,
+			(uint32_t)quantized.x, (uint32_t)quantized.y, (uint32_t)quantized.z };
+		return MeshDedup::HashWords(words, 6);
+	}
+
+	glm::mat4 FrameMatrix(const CanonicalFrame& frame)
+	{
+		return glm::translate(glm::mat4(1.0f), frame.center) * glm::mat4(frame.rotation);
+	}
+
+	size_t MeshBytes(const Mesh& mesh)
+	{
+		return (mesh.positions.size() + mesh.normals.size()) * sizeof(glm::vec3) + mesh.indices.size() * sizeof(unsigned int);
+	}
+}
+
+
+uint64_t MeshDedup::HashWords(const uint32_t* words, size_t count, uint64_t seed)
+{
+	const uint64_t PRIME_1 = 0x9E3779B185EBCA87ull;
+	const uint64_t PRIME_2 = 0xC2B2AE3D27D4EB4Full;
+
+	uint64_t lanes[4] = { seed + PRIME_1, seed ^ PRIME_2, seed - PRIME_1, ~seed };
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			lanes[lane] ^= words[i + lane];
+			lanes[lane] *= PRIME_1;
+			lanes[lane] ^= lanes[lane] >> 29;
+		}
+	}
+
+	uint64_t hash = (uint64_t)count * PRIME_2;
+	for (int lane = 0; lane < 4; ++lane)
+	{
+		hash ^= lanes[lane] + PRIME_2 + (hash << 6) + (hash >> 2);
+		hash *= PRIME_1;
+	}
+	for (; i < count; ++i)
+	{
+		hash ^= words[i];
+		hash *= PRIME_2;
+		hash ^= hash >> 31;
+	}
+	hash ^= hash >> 33;
+	hash *= PRIME_2;
+	hash ^= hash >> 29;
+	return hash;
+}
+
+
+MeshDedup::Result MeshDedup::Deduplicate(const std::vector<Mesh>& meshes, const Options& options, JobSystem& jobs)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	Result result;
+
+	Clock::time_point start = Clock::now();
+	std::vector<CanonicalFrame> frames(meshes.size());
+	jobs.parallelFor(meshes.size(), 16, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+			frames[i] = Canonicalize(meshes[i], options);
+	});
+	Clock::time_point hashed = Clock::now();
+
+	// input mesh index of the representative of each unique mesh
+	std::vector<size_t> representatives;
+	std::unordered_map<uint64_t, std::vector<unsigned int>> buckets;
+	result.instances.resize(meshes.size());
+
+	// representatives are stored in their own cell, meshes are looked up in the cells around theirs
+	bool tolerant = options.mode != MATCH_EXACT;
+	auto findIn = [&](uint64_t key, size_t i)
+	{
+		auto bucket = buckets.find(key);
+		if (bucket == buckets.end())
+			return ~0u;
+		for (unsigned int unique : bucket->second)
+		{
+			if (SameGeometry(meshes[representatives[unique]], frames[representatives[unique]], meshes[i], frames[i], options))
+				return unique;
+		}
+		return ~0u;
+	};
+
+	for (size_t i = 0; i < meshes.size(); ++i)
+	{
+		result.bytesBefore += MeshBytes(meshes[i]);
+
+		const CanonicalFrame& frame = frames[i];
+		unsigned int match = tolerant ? ~0u : findIn(frame.hash, i);
+		for (int radiusClass = frame.radiusClass - 1; tolerant && match == ~0u && radiusClass <= frame.radiusClass + 1; ++radiusClass)
+		{
+			for (int neighbour = 0; neighbour < 27 && match == ~0u; ++neighbour)
+			{
+				glm::ivec3 offset(neighbour % 3 - 1, neighbour / 3 % 3 - 1, neighbour / 9 - 1);
+				match = findIn(ToleranceKey(frame, radiusClass, offset, options), i);
+			}
+		}
+
+		if (match == ~0u)
+		{
+			match = (unsigned int)representatives.size();
+			representatives.push_back(i);
+			uint64_t key = tolerant ? ToleranceKey(frame, frame.radiusClass, glm::ivec3(0), options) : frame.hash;
+			buckets[key].push_back(match);
+		}
+
+		// mesh i = frame i * canonical = frame i * inverse(frame representative) * representative
+		Instance& instance = result.instances[i];
+		instance.uniqueMesh = match;
+		if (representatives[match] == i || options.mode == MATCH_EXACT)
+			instance.transform = glm::mat4(1.0f);
+		else
+			instance.transform = FrameMatrix(frames[i]) * glm::inverse(FrameMatrix(frames[representatives[match]]));
+	}
+
+	result.uniqueMeshes.reserve(representatives.size());
+	for (size_t representative : representatives)
+	{
+		result.uniqueMeshes.push_back(meshes[representative]);
+		result.bytesAfter += MeshBytes(meshes[representative]);
+	}
+	result.bytesAfter += result.instances.size() * sizeof(glm::mat4);
+
+	Clock::time_point matched = Clock::now();
+	result.hashMilliseconds = std::chrono::duration<double, std::milli>(hashed - start).count();
+	result.matchMilliseconds = std::chrono::duration<double, std::milli>(matched - hashed).count();
+	return result;
+}
+
+
+void MeshDedup::PrintReport(const Result& result, size_t inputMeshCount)
+{
+	double savedMegabytes = ((double)result.bytesBefore - (double)result.bytesAfter) / (1024.0 * 1024.0);
+	std::cout << "DEDUP::" << inputMeshCount << " MESHES -> " << result.uniqueMeshes.size() << " UNIQUE"
+		<< " | SAVED " << savedMegabytes << " MB (" << result.bytesBefore << " -> " << result.bytesAfter << " BYTES)"
+		<< " | HASH " << result.hashMilliseconds << " ms, MATCH " << result.matchMilliseconds << " ms" << std::endl;
+}
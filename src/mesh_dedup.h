@@ -0,0 +1,83 @@
+#ifndef MESH_DEDUP_H
+#define MESH_DEDUP_H
+
+#include <cstdint>
+#include <vector>
+#include <glm.hpp>
+#include "mesh.h"
+#include "job_system.h"
+
+/*!
+ * Import pass collapsing duplicated geometry into instances
+ *
+ * Every mesh is brought into a canonical form and hashed in parallel.
+ * Exact matching hashes the raw data. Tolerant matching hashes the topology
+ * with the extents of the canonical bounding box quantized on a grid a few
+ * tolerances wide, and looks a mesh up in the neighbouring cells too, so
+ * parts within tolerance of each other meet even across a cell border.
+ * Candidates are compared for real before being merged, so a hash collision
+ * never merges different parts. Vertex and index order have to match, which
+ * is the case for duplicated CAD exports.
+ */
+namespace MeshDedup
+{
+	enum MatchMode
+	{
+		MATCH_EXACT,       // same data at the same place
+		MATCH_TRANSLATION, // same data anywhere
+		MATCH_RIGID        // same data up to rotation and translation
+	};
+
+	struct Options
+	{
+		MatchMode mode = MATCH_TRANSLATION;
+		float tolerance = 1e-4f; // relative to the mesh radius
+	};
+
+	/*!
+	 * Placement of an input mesh as an instance of a unique mesh
+	 *
+	 */
+	struct Instance
+	{
+		unsigned int uniqueMesh;
+		glm::mat4 transform; // unique mesh space to the space of the input mesh
+	};
+
+	struct Result
+	{
+		std::vector<Mesh> uniqueMeshes;
+		std::vector<Instance> instances; // one per input mesh, same order
+		size_t bytesBefore = 0;
+		size_t bytesAfter = 0;           // unique geometry plus one matrix per instance
+		double hashMilliseconds = 0.0;
+		double matchMilliseconds = 0.0;
+	};
+
+	/*!
+	 * Deduplicate meshes
+	 *
+	 * \param meshes : imported meshes
+	 * \param options : matching mode and tolerance
+	 * \param jobs : pool used to canonicalize and hash the meshes
+	 * \return : unique meshes and one instance per input mesh
+	 */
+	Result Deduplicate(const std::vector<Mesh>& meshes, const Options& options, JobSystem& jobs);
+
+	/*!
+	 * Print memory saved and time spent
+	 *
+	 */
+	void PrintReport(const Result& result, size_t inputMeshCount);
+
+	/*!
+	 * 64 bit hash of 32 bit words using four independent lanes,
+	 * the lanes have no dependency on each other so the loop vectorizes.
+	 *
+	 * \param words : data to hash
+	 * \param count : number of words
+	 * \param seed : initial value, lets hashes be chained
+	 */
+	uint64_t HashWords(const uint32_t* words, size_t count, uint64_t seed = 0);
+}
+#endif
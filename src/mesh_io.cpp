@@ -0,0 +1,229 @@
+#include "mesh_io.h"
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+
+namespace
+{
+	/*!
+	 * Position and normal indices of a face corner, "v", "v/t", "v//n" or "v/t/n"
+	 *
+	 * \param positionCount : positions read so far, negative indices are relative to it
+	 * \param normalCount : normals read so far
+	 * \return : false(bool) if the position index is missing or out of range
+	 */
+	bool ParseCorner(const std::string& token, size_t positionCount, size_t normalCount, int& position, int& normal)
+	{
+		const char* text = token.c_str();
+		char* end = nullptr;
+		long value = std::strtol(text, &end, 10);
+		position = (int)(value < 0 ? (long)positionCount + value : value - 1);
+		normal = -1;
+		if (end == text || position < 0 || position >= (int)positionCount)
+			return false;
+
+		if (*end == '/')
+		{
+			// skip the texture coordinate
+			const char* next = end + 1;
+			while (*next && *next != '/')
+				++next;
+			if (*next == '/' && next[1])
+			{
+				value = std::strtol(next + 1, &end, 10);
+				normal = (int)(value < 0 ? (long)normalCount + value : value - 1);
+				if (normal < 0 || normal >= (int)normalCount)
+					normal = -1;
+			}
+		}
+		return true;
+	}
+
+	/*!
+	 * Position index of a face corner, what follows a '/' is ignored
+	 *
+	 * \param vertexCount : vertices read so far, negative indices are relative to it
+	 * \return : false(bool) if the index is missing or out of range
+	 */
+	bool ParsePosition(const std::string& token, uint64_t vertexCount, uint64_t& position)
+	{
+		const char* text = token.c_str();
+		char* end = nullptr;
+		long long value = std::strtoll(text, &end, 10);
+		long long index = value < 0 ? (long long)vertexCount + value : value - 1;
+		if (end == text || index < 0 || index >= (long long)vertexCount)
+			return false;
+		position = (uint64_t)index;
+		return true;
+	}
+
+	void FinishPart(Mesh& part, bool hasNormals, std::vector<Mesh>& parts)
+	{
+		if (part.indices.empty())
+			return;
+		if (!hasNormals)
+			ComputeNormals(part);
+		parts.push_back(std::move(part));
+	}
+}
+
+
+bool MeshIO::ReadObjParts(const std::string& path, std::vector<Mesh>& parts)
+{
+	parts.clear();
+	std::ifstream file(path);
+	if (!file.is_open())
+	{
+		std::cout << "ERROR::MESH::UNABLE TO OPEN FILE: " << path << std::endl;
+		return false;
+	}
+
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> normals;
+
+	// corners of the current part, position and normal indices of the file to part vertices
+	Mesh part;
+	bool partHasNormals = true;
+	std::unordered_map<uint64_t, unsigned int> vertices;
+	std::vector<unsigned int> polygon;
+
+	std::string line, keyword, token;
+	while (std::getline(file, line))
+	{
+		std::istringstream stream(line);
+		if (!(stream >> keyword))
+			continue;
+
+		if (keyword == "v")
+		{
+			glm::vec3 position(0.0f);
+			stream >> position.x >> position.y >> position.z;
+			positions.push_back(position);
+		}
+		else if (keyword == "vn")
+		{
+			glm::vec3 normal(0.0f);
+			stream >> normal.x >> normal.y >> normal.z;
+			normals.push_back(normal);
+		}
+		else if (keyword == "o" || keyword == "g")
+		{
+			FinishPart(part, partHasNormals, parts);
+			part = Mesh();
+			partHasNormals = true;
+			vertices.clear();
+		}
+		else if (keyword == "f")
+		{
+			polygon.clear();
+			while (stream >> token)
+			{
+				int position, normal;
+				if (!ParseCorner(token, positions.size(), normals.size(), position, normal))
+				{
+					std::cout << "ERROR::MESH::BAD FACE IN: " << path << " : " << line << std::endl;
+					polygon.clear();
+					break;
+				}
+				partHasNormals = partHasNormals && normal >= 0;
+
+				uint64_t key = ((uint64_t)(uint32_t)position << 32) | (uint32_t)normal;
+				auto found = vertices.find(key);
+				if (found == vertices.end())
+				{
+					found = vertices.emplace(key, (unsigned int)part.positions.size()).first;
+					part.positions.push_back(positions[position]);
+					part.normals.push_back(normal >= 0 ? glm::normalize(normals[normal]) : glm::vec3(0.0f, 0.0f, 1.0f));
+				}
+				polygon.push_back(found->second);
+			}
+			for (size_t i = 2; i < polygon.size(); ++i)
+				part.indices.insert(part.indices.end(), { polygon[0], polygon[i - 1], polygon[i] });
+		}
+	}
+	FinishPart(part, partHasNormals, parts);
+
+	if (parts.empty())
+		std::cout << "ERROR::MESH::NO FACE IN: " << path << std::endl;
+	return !parts.empty();
+}
+
+
+ObjReader::ObjReader()
+	: m_VertexCount(0)
+{
+}
+
+
+bool ObjReader::open(const std::string& path)
+{
+	m_File.close();
+	m_File.clear();
+	m_File.open(path);
+	m_Path = path;
+	m_VertexCount = 0;
+	if (!m_File.is_open())
+	{
+		std::cout << "ERROR::MESH::UNABLE TO OPEN FILE: " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+
+bool ObjReader::read(std::vector<glm::vec3>& positions, std::vector<uint64_t>& triangles, size_t maxTriangles)
+{
+	positions.clear();
+	triangles.clear();
+
+	std::string line, keyword, token;
+	while (triangles.size() < maxTriangles * 3 && std::getline(m_File, line))
+	{
+		std::istringstream stream(line);
+		if (!(stream >> keyword))
+			continue;
+
+		if (keyword == "v")
+		{
+			glm::vec3 position(0.0f);
+			stream >> position.x >> position.y >> position.z;
+			positions.push_back(position);
+			++m_VertexCount;
+		}
+		else if (keyword == "f")
+		{
+			m_Polygon.clear();
+			while (stream >> token)
+			{
+				uint64_t position;
+				if (!ParsePosition(token, m_VertexCount, position))
+				{
+					std::cout << "ERROR::MESH::BAD FACE IN: " << m_Path << " : " << line << std::endl;
+					m_Polygon.clear();
+					break;
+				}
+				m_Polygon.push_back(position);
+			}
+			for (size_t i = 2; i < m_Polygon.size(); ++i)
+				triangles.insert(triangles.end(), { m_Polygon[0], m_Polygon[i - 1], m_Polygon[i] });
+		}
+	}
+	return !positions.empty() || !triangles.empty();
+}
+
+
+void ObjReader::rewind()
+{
+	m_File.clear();
+	m_File.seekg(0);
+	m_VertexCount = 0;
+}
+
+
+uint64_t ObjReader::vertexCount() const
+{
+	return m_VertexCount;
+}
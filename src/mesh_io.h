@@ -0,0 +1,76 @@
+#ifndef MESH_IO_H
+#define MESH_IO_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "mesh.h"
+
+namespace MeshIO
+{
+	/*!
+	 * Read a Wavefront OBJ file, one mesh per object or group
+	 *
+	 * Polygons are cut into fans, texture coordinates are ignored. Vertices
+	 * are numbered in the order the faces first use them, so parts exported
+	 * several times come out with the same vertex and index order. Parts
+	 * without normals get area weighted ones.
+	 *
+	 * \param path : path of the .obj file
+	 * \param parts : cleared and filled with the parts holding faces
+	 * \return : false(bool) if the file can not be read or holds no face
+	 */
+	bool ReadObjParts(const std::string& path, std::vector<Mesh>& parts);
+}
+
+/*!
+ * Sequential reader of the vertices and triangles of a Wavefront OBJ file
+ *
+ * Lines are read in batches so files far larger than memory can be
+ * processed. Faces keep the indices of the file, the caller resolves them
+ * against the vertices it stored, normals and texture coordinates are
+ * ignored.
+ */
+class ObjReader
+{
+public:
+	ObjReader();
+
+	/*!
+	 * Open a file
+	 *
+	 * \param path : path of the .obj file
+	 * \return : false(bool) if the file can not be read
+	 */
+	bool open(const std::string& path);
+
+	/*!
+	 * Read the next lines
+	 *
+	 * \param positions : cleared and filled with the vertices of the lines read, they follow the ones of the previous calls
+	 * \param triangles : cleared and filled with the faces cut into fans, three vertex indices from 0 per triangle
+	 * \param maxTriangles : batch size, reading stops once it is reached
+	 * \return : false(bool) once the end of the file is reached and nothing was read
+	 */
+	bool read(std::vector<glm::vec3>& positions, std::vector<uint64_t>& triangles, size_t maxTriangles);
+
+	/*!
+	 * Go back to the first line
+	 *
+	 */
+	void rewind();
+
+	/*!
+	 * Vertices read since the file was opened or rewound
+	 *
+	 */
+	uint64_t vertexCount() const;
+
+private:
+	std::ifstream m_File;
+	std::string m_Path;
+	uint64_t m_VertexCount;
+	std::vector<uint64_t> m_Polygon;
+};
+#endif
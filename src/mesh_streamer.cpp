@@ -0,0 +1,329 @@
+#include "mesh_streamer.h"
+#include <algorithm>
+#include <iostream>
+#include "frustum.h"
+#include "gl_state_cache.h"
+#include "mesh_cache.h"
+
+
+MeshStreamer::MeshStreamer()
+	: m_DataOffset(0), m_Frame(0)
+{
+}
+
+MeshStreamer::~MeshStreamer()
+{
+	close();
+}
+
+
+bool MeshStreamer::open(const std::string& path, const Options& options)
+{
+	close();
+
+	MeshCacheReader reader;
+	std::vector<ChunkedMesh::ChunkRecord> table;
+	uint64_t dataSize = 0;
+	if (!reader.open(path) || !reader.readArray(MeshCache::TAG_CHUNK_TABLE, table) ||
+		!reader.sectionRange(MeshCache::TAG_CHUNK_DATA, m_DataOffset, dataSize))
+	{
+		std::cout << "ERROR::MESH STREAMER::NO CHUNK TABLE IN: " << path << std::endl;
+		return false;
+	}
+
+	if (!m_Reader.open(path, options.ioThreads))
+		return false;
+
+	m_Options = options;
+	m_Chunks.resize(table.size());
+	for (size_t i = 0; i < table.size(); ++i)
+		m_Chunks[i].record = table[i];
+
+	m_Stats = MeshStreamerStats();
+	m_Stats.chunks = (unsigned int)m_Chunks.size();
+	m_Stats.budget = options.residentBudget;
+	return true;
+}
+
+
+void MeshStreamer::close()
+{
+	m_Reader.close();
+	m_Uploads.clear();
+
+	for (Chunk& chunk : m_Chunks)
+	{
+		for (unsigned int lod = 0; lod < chunk.record.lodCount; ++lod)
+			Evict(chunk, lod);
+	}
+	m_Chunks.clear();
+}
+
+
+void MeshStreamer::update(const glm::mat4& modelViewProjection, const glm::vec3& cameraPosition, LinearArena& arena)
+{
+	++m_Frame;
+	m_Stats.visibleChunks = 0;
+	m_Stats.evictions = 0;
+
+	// levels wanted by this frame, drawn levels are protected from eviction
+	Frustum frustum(modelViewProjection);
+	for (Chunk& chunk : m_Chunks)
+	{
+		const ChunkedMesh::ChunkRecord& record = chunk.record;
+		chunk.wantedLod = -1;
+		if (!frustum.isBoxVisible(record.boundsMin, record.boundsMax))
+			continue;
+
+		glm::vec3 closest = glm::clamp(cameraPosition, record.boundsMin, record.boundsMax);
+		chunk.distance = glm::length(cameraPosition - closest);
+		float allowedError = chunk.distance * m_Options.errorPerDistance;
+		chunk.wantedLod = 0;
+		for (unsigned int lod = 1; lod < record.lodCount; ++lod)
+		{
+			if (record.lods[lod].error <= allowedError)
+				chunk.wantedLod = (int)lod;
+		}
+		++m_Stats.visibleChunks;
+
+		chunk.lods[chunk.wantedLod].lastUsedFrame = m_Frame;
+		int drawn = PickDrawnLod(chunk);
+		if (drawn >= 0)
+			chunk.lods[drawn].lastUsedFrame = m_Frame;
+	}
+
+	// reads not started yet are dropped, the queue is rebuilt for the new camera
+	FrameVector<AsyncFileReader::Request> none{ ArenaAllocator<AsyncFileReader::Request>(arena) };
+	FrameVector<uint64_t> dropped{ ArenaAllocator<uint64_t>(arena) };
+	m_Reader.replaceQueue(none, dropped);
+	for (uint64_t id : dropped)
+	{
+		Chunk& chunk = m_Chunks[id / ChunkedMesh::MAX_LODS];
+		unsigned int lod = id % ChunkedMesh::MAX_LODS;
+		chunk.lods[lod].state = LOD_UNLOADED;
+		m_Stats.residentBytes -= ChunkedMesh::LodBytes(chunk.record.lods[lod]);
+	}
+
+	unsigned int pending = 0;
+	// (last used frame, chunk * MAX_LODS + lod)
+	FrameVector<std::pair<uint64_t, unsigned int>> candidates{ ArenaAllocator<std::pair<uint64_t, unsigned int>>(arena) };
+	for (unsigned int c = 0; c < m_Chunks.size(); ++c)
+	{
+		const Chunk& chunk = m_Chunks[c];
+		for (unsigned int lod = 0; lod < chunk.record.lodCount; ++lod)
+		{
+			const LodSlot& slot = chunk.lods[lod];
+			if (slot.state == LOD_QUEUED || slot.state == LOD_LOADED)
+				++pending;
+			else if (slot.state == LOD_RESIDENT && slot.lastUsedFrame < m_Frame)
+				candidates.push_back(std::make_pair(slot.lastUsedFrame, c * ChunkedMesh::MAX_LODS + lod));
+		}
+	}
+	// oldest at the back
+	std::sort(candidates.begin(), candidates.end(), [](const std::pair<uint64_t, unsigned int>& a, const std::pair<uint64_t, unsigned int>& b)
+	{
+		return a.first > b.first;
+	});
+
+	FrameVector<AsyncFileReader::Request> requests{ ArenaAllocator<AsyncFileReader::Request>(arena) };
+	for (unsigned int c = 0; c < m_Chunks.size(); ++c)
+	{
+		const Chunk& chunk = m_Chunks[c];
+		if (chunk.wantedLod < 0)
+			continue;
+
+		float priority = 1.0f / (1.0f + chunk.distance);
+		if (chunk.lods[chunk.wantedLod].state == LOD_UNLOADED)
+			requests.push_back(AsyncFileReader::Request{ c * ChunkedMesh::MAX_LODS + chunk.wantedLod, 0, 0, priority });
+
+		// a chunk with nothing to show gets its coarsest level first, it is the cheapest to read
+		unsigned int coarsest = chunk.record.lodCount - 1;
+		if (PickDrawnLod(chunk) < 0 && (int)coarsest != chunk.wantedLod && chunk.lods[coarsest].state == LOD_UNLOADED)
+			requests.push_back(AsyncFileReader::Request{ c * ChunkedMesh::MAX_LODS + coarsest, 0, 0, priority + 1.0f });
+	}
+	std::sort(requests.begin(), requests.end(), [](const AsyncFileReader::Request& a, const AsyncFileReader::Request& b)
+	{
+		return a.priority > b.priority;
+	});
+
+	FrameVector<AsyncFileReader::Request> accepted{ ArenaAllocator<AsyncFileReader::Request>(arena) };
+	for (AsyncFileReader::Request& request : requests)
+	{
+		if (pending + accepted.size() >= m_Options.maxPendingReads)
+			break;
+
+		Chunk& chunk = m_Chunks[request.id / ChunkedMesh::MAX_LODS];
+		unsigned int lod = request.id % ChunkedMesh::MAX_LODS;
+		uint64_t bytes = ChunkedMesh::LodBytes(chunk.record.lods[lod]);
+		if (!MakeRoom(bytes, candidates))
+			break;
+
+		request.offset = m_DataOffset + chunk.record.lods[lod].offset;
+		request.size = bytes;
+		chunk.lods[lod].state = LOD_QUEUED;
+		m_Stats.residentBytes += bytes;
+		accepted.push_back(request);
+	}
+	m_Stats.peakResidentBytes = std::max(m_Stats.peakResidentBytes, m_Stats.residentBytes);
+	m_Stats.pendingReads = pending + (unsigned int)accepted.size();
+	m_Stats.budget = m_Options.residentBudget;
+
+	// only this thread fills the queue, nothing was queued since it was emptied
+	if (!accepted.empty())
+		m_Reader.replaceQueue(accepted, dropped);
+}
+
+
+void MeshStreamer::upload()
+{
+	size_t previous = m_Uploads.size();
+	m_Reader.takeCompleted(m_Uploads);
+	for (size_t i = previous; i < m_Uploads.size(); ++i)
+	{
+		unsigned int chunk = (unsigned int)(m_Uploads[i].id / ChunkedMesh::MAX_LODS);
+		m_Chunks[chunk].lods[m_Uploads[i].id % ChunkedMesh::MAX_LODS].state = LOD_LOADED;
+	}
+
+	GpuResources& resources = GpuResources::instance();
+	GLStateCache& state = GLStateCache::instance();
+	m_Stats.uploadedBytes = 0;
+
+	size_t done = 0;
+	for (; done < m_Uploads.size(); ++done)
+	{
+		AsyncFileReader::Result& completed = m_Uploads[done];
+		if (m_Stats.uploadedBytes > 0 && m_Stats.uploadedBytes + completed.data.size() > m_Options.uploadBytesPerFrame)
+			break;
+
+		Chunk& chunk = m_Chunks[completed.id / ChunkedMesh::MAX_LODS];
+		const ChunkedMesh::ChunkLod& lod = chunk.record.lods[completed.id % ChunkedMesh::MAX_LODS];
+		LodSlot& slot = chunk.lods[completed.id % ChunkedMesh::MAX_LODS];
+		if (completed.data.empty())
+		{
+			// failed read, give the space back and let the next update retry
+			slot.state = LOD_UNLOADED;
+			m_Stats.residentBytes -= ChunkedMesh::LodBytes(lod);
+			continue;
+		}
+
+		if (m_Options.uploadToGpu)
+		{
+			size_t vertexBytes = (size_t)lod.vertexCount * sizeof(glm::vec3);
+			slot.vao = resources.createVertexArray();
+			state.bindVertexArray(resources.name(slot.vao));
+			slot.vertexBuffer = resources.createBuffer(GL_ARRAY_BUFFER, vertexBytes * 2, completed.data.data(), GL_STATIC_DRAW);
+			slot.indexBuffer = resources.createBuffer(GL_ELEMENT_ARRAY_BUFFER, completed.data.size() - vertexBytes * 2,
+				completed.data.data() + vertexBytes * 2, GL_STATIC_DRAW);
+
+			// positions then normals, not interleaved
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)vertexBytes);
+			glEnableVertexAttribArray(1);
+		}
+
+		slot.state = LOD_RESIDENT;
+		m_Stats.uploadedBytes += completed.data.size();
+	}
+	m_Uploads.erase(m_Uploads.begin(), m_Uploads.begin() + done);
+}
+
+
+void MeshStreamer::draw()
+{
+	GpuResources& resources = GpuResources::instance();
+	GLStateCache& state = GLStateCache::instance();
+	m_Stats.drawnChunks = 0;
+	m_Stats.drawnTriangles = 0;
+	m_Stats.residentLods = 0;
+
+	for (Chunk& chunk : m_Chunks)
+	{
+		for (unsigned int lod = 0; lod < chunk.record.lodCount; ++lod)
+			m_Stats.residentLods += chunk.lods[lod].state == LOD_RESIDENT ? 1 : 0;
+
+		if (chunk.wantedLod < 0)
+			continue;
+		chunk.drawnLod = PickDrawnLod(chunk);
+		if (chunk.drawnLod < 0)
+			continue;
+
+		const LodSlot& slot = chunk.lods[chunk.drawnLod];
+		unsigned int indexCount = chunk.record.lods[chunk.drawnLod].indexCount;
+		state.bindVertexArray(resources.name(slot.vao));
+		glDrawElements(GL_TRIANGLES, (GLsizei)indexCount, GL_UNSIGNED_INT, (void*)0);
+		++m_Stats.drawnChunks;
+		m_Stats.drawnTriangles += indexCount / 3;
+	}
+}
+
+
+const MeshStreamerStats& MeshStreamer::stats() const
+{
+	return m_Stats;
+}
+
+
+void MeshStreamer::reportTo(Profiler& profiler) const
+{
+	const double MB = 1.0 / (1024.0 * 1024.0);
+	profiler.addCounter("STREAM RESIDENT MB", m_Stats.residentBytes * MB);
+	profiler.addCounter("STREAM UPLOADED MB", m_Stats.uploadedBytes * MB);
+	profiler.addCounter("STREAM PENDING READS", m_Stats.pendingReads);
+	profiler.addCounter("STREAM EVICTIONS", m_Stats.evictions);
+	profiler.addCounter("STREAM DRAWN CHUNKS", m_Stats.drawnChunks);
+}
+
+
+void MeshStreamer::Evict(Chunk& chunk, unsigned int lod)
+{
+	LodSlot& slot = chunk.lods[lod];
+	if (slot.state != LOD_RESIDENT)
+		return;
+
+	GpuResources& resources = GpuResources::instance();
+	resources.release(slot.vao);
+	resources.release(slot.vertexBuffer);
+	resources.release(slot.indexBuffer);
+	slot.vao = GpuHandle();
+	slot.vertexBuffer = GpuHandle();
+	slot.indexBuffer = GpuHandle();
+	slot.state = LOD_UNLOADED;
+	m_Stats.residentBytes -= ChunkedMesh::LodBytes(chunk.record.lods[lod]);
+	++m_Stats.evictions;
+}
+
+
+bool MeshStreamer::MakeRoom(uint64_t bytes, FrameVector<std::pair<uint64_t, unsigned int>>& candidates)
+{
+	while (m_Stats.residentBytes + bytes > m_Options.residentBudget)
+	{
+		if (candidates.empty())
+			return false;
+		unsigned int victim = candidates.back().second;
+		candidates.pop_back();
+		Evict(m_Chunks[victim / ChunkedMesh::MAX_LODS], victim % ChunkedMesh::MAX_LODS);
+	}
+	return true;
+}
+
+
+int MeshStreamer::PickDrawnLod(const Chunk& chunk) const
+{
+	if (chunk.wantedLod < 0)
+		return -1;
+	if (chunk.lods[chunk.wantedLod].state == LOD_RESIDENT)
+		return chunk.wantedLod;
+
+	// closest resident level, coarser first since it is the one usually already there
+	for (int distance = 1; distance < (int)ChunkedMesh::MAX_LODS; ++distance)
+	{
+		int coarser = chunk.wantedLod + distance;
+		int finer = chunk.wantedLod - distance;
+		if (coarser < (int)chunk.record.lodCount && chunk.lods[coarser].state == LOD_RESIDENT)
+			return coarser;
+		if (finer >= 0 && chunk.lods[finer].state == LOD_RESIDENT)
+			return finer;
+	}
+	return -1;
+}
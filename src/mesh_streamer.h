@@ -0,0 +1,143 @@
+#ifndef MESH_STREAMER_H
+#define MESH_STREAMER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm.hpp>
+#include "async_file_reader.h"
+#include "chunked_mesh.h"
+#include "gpu_resources.h"
+#include "profiler.h"
+
+/*!
+ * Counters of MeshStreamer, bytes are CPU buffers in flight plus GPU buffers
+ *
+ */
+struct MeshStreamerStats
+{
+	unsigned int chunks = 0;
+	unsigned int visibleChunks = 0;
+	unsigned int drawnChunks = 0;
+	unsigned int residentLods = 0;
+	unsigned int pendingReads = 0;
+	uint64_t residentBytes = 0;
+	uint64_t peakResidentBytes = 0;
+	uint64_t budget = 0;
+	uint64_t uploadedBytes = 0;   // this frame
+	unsigned int evictions = 0;   // this frame
+	uint64_t drawnTriangles = 0;
+};
+
+/*!
+ * Out of core renderer of a chunked mesh cache
+ *
+ * Only the chunk table stays in memory. Every frame the chunks are selected
+ * by visibility and by the screen error of their levels, missing levels are
+ * read by a pool of I/O threads with pread and uploaded under a per frame
+ * byte cap, and the least recently used levels are evicted so the resident
+ * set never exceeds the budget. Until the wanted level arrives the closest
+ * resident level of a chunk is drawn, the frame never waits on the disk.
+ */
+class MeshStreamer
+{
+public:
+	struct Options
+	{
+		uint64_t residentBudget = 512ull * 1024 * 1024;
+		uint64_t uploadBytesPerFrame = 16ull * 1024 * 1024;
+		unsigned int ioThreads = 2;
+		unsigned int maxPendingReads = 32;
+		// allowed level error divided by the distance to the camera, about a pixel at 1080p
+		float errorPerDistance = 0.001f;
+		// false marks read levels resident without GL objects, to run the residency without a context
+		bool uploadToGpu = true;
+	};
+
+	MeshStreamer();
+	~MeshStreamer();
+
+	MeshStreamer(const MeshStreamer&) = delete;
+	MeshStreamer& operator=(const MeshStreamer&) = delete;
+
+	/*!
+	 * Open a cache written by ChunkedMesh::Build and start the I/O threads
+	 *
+	 * \param path : path of the cache file
+	 * \param options : budgets and thread count
+	 * \return : false(bool) if the file has no chunk table
+	 */
+	bool open(const std::string& path, const Options& options);
+
+	/*!
+	 * Stop the I/O threads and release every resident level
+	 *
+	 */
+	void close();
+
+	/*!
+	 * Select levels, evict and queue reads, call once per frame
+	 *
+	 * \param modelViewProjection : to cull chunks, in the mesh space
+	 * \param cameraPosition : camera position in the mesh space
+	 * \param arena : frame memory for the lists built on the way, see FrameArena::threadArena
+	 */
+	void update(const glm::mat4& modelViewProjection, const glm::vec3& cameraPosition, LinearArena& arena);
+
+	/*!
+	 * Upload finished reads, at most uploadBytesPerFrame per call
+	 *
+	 */
+	void upload();
+
+	/*!
+	 * Draw the visible chunks with the bound program, positions at location 0 and normals at 1
+	 *
+	 */
+	void draw();
+
+	const MeshStreamerStats& stats() const;
+
+	void reportTo(Profiler& profiler) const;
+
+private:
+
+	enum LodState
+	{
+		LOD_UNLOADED,
+		LOD_QUEUED,     // waiting for or being read by an I/O thread
+		LOD_LOADED,     // read, waiting for upload
+		LOD_RESIDENT
+	};
+
+	struct LodSlot
+	{
+		LodState state = LOD_UNLOADED;
+		GpuHandle vao;
+		GpuHandle vertexBuffer;
+		GpuHandle indexBuffer;
+		uint64_t lastUsedFrame = 0;
+	};
+
+	struct Chunk
+	{
+		ChunkedMesh::ChunkRecord record;
+		LodSlot lods[ChunkedMesh::MAX_LODS];
+		int wantedLod = -1;   // -1 when not visible
+		int drawnLod = -1;
+		float distance = 0.0f;
+	};
+
+	Options m_Options;
+	std::vector<Chunk> m_Chunks;
+	uint64_t m_DataOffset;
+	uint64_t m_Frame;
+	MeshStreamerStats m_Stats;
+	AsyncFileReader m_Reader;
+	std::vector<AsyncFileReader::Result> m_Uploads;   // read, waiting for upload
+
+	void Evict(Chunk& chunk, unsigned int lod);
+	bool MakeRoom(uint64_t bytes, FrameVector<std::pair<uint64_t, unsigned int>>& candidates);
+	int PickDrawnLod(const Chunk& chunk) const;
+};
+#endif
@@ -0,0 +1,231 @@
+#include "meshlet.h"
+#include "mesh_cache.h"
+#include <cmath>
+
+
+void MeshletMesh::build(const Mesh& mesh)
+{
+	m_Meshlets.clear();
+	m_Indices.clear();
+	m_Indices.reserve(mesh.indices.size());
+
+	// id of the last meshlet that referenced a vertex, avoids clearing a set per meshlet
+	std::vector<unsigned int> vertexStamp(mesh.positions.size(), ~0u);
+	std::vector<unsigned int> localVertices;
+	localVertices.reserve(MAX_VERTICES);
+
+	Meshlet current = {};
+	unsigned int meshletId = 0;
+
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+	{
+		const unsigned int* triangle = &mesh.indices[i];
+
+		unsigned int newVertices = 0;
+		for (int k = 0; k < 3; ++k)
+		{
+			if (vertexStamp[triangle[k]] != meshletId)
+				++newVertices;
+		}
+
+		if (current.triangleCount == MAX_TRIANGLES || localVertices.size() + newVertices > MAX_VERTICES)
+		{
+			current.vertexCount = (unsigned int)localVertices.size();
+			ComputeBounds(current, mesh.positions, localVertices);
+			m_Meshlets.push_back(current);
+
+			current = Meshlet();
+			current.firstIndex = (unsigned int)m_Indices.size();
+			localVertices.clear();
+			++meshletId;
+		}
+
+		for (int k = 0; k < 3; ++k)
+		{
+			if (vertexStamp[triangle[k]] != meshletId)
+			{
+				vertexStamp[triangle[k]] = meshletId;
+				localVertices.push_back(triangle[k]);
+			}
+			m_Indices.push_back(triangle[k]);
+		}
+		++current.triangleCount;
+	}
+
+	if (current.triangleCount > 0)
+	{
+		current.vertexCount = (unsigned int)localVertices.size();
+		ComputeBounds(current, mesh.positions, localVertices);
+		m_Meshlets.push_back(current);
+	}
+}
+
+
+void MeshletMesh::ComputeBounds(Meshlet& meshlet, const std::vector<glm::vec3>& positions,
+	const std::vector<unsigned int>& localVertices) const
+{
+	// Ritter's bounding sphere
+	glm::vec3 first = positions[localVertices[0]];
+	glm::vec3 pointA = first;
+	float maxDistance = -1.0f;
+	for (unsigned int vertex : localVertices)
+	{
+		float distance = glm::dot(positions[vertex] - first, positions[vertex] - first);
+		if (distance > maxDistance)
+		{
+			maxDistance = distance;
+			pointA = positions[vertex];
+		}
+	}
+
+	glm::vec3 pointB = pointA;
+	maxDistance = -1.0f;
+	for (unsigned int vertex : localVertices)
+	{
+		float distance = glm::dot(positions[vertex] - pointA, positions[vertex] - pointA);
+		if (distance > maxDistance)
+		{
+			maxDistance = distance;
+			pointB = positions[vertex];
+		}
+	}
+
+	glm::vec3 center = (pointA + pointB) * 0.5f;
+	float radius = glm::length(pointB - pointA) * 0.5f;
+	for (unsigned int vertex : localVertices)
+	{
+		float distance = glm::length(positions[vertex] - center);
+		if (distance > radius)
+		{
+			float newRadius = (radius + distance) * 0.5f;
+			center += (positions[vertex] - center) * ((newRadius - radius) / distance);
+			radius = newRadius;
+		}
+	}
+	meshlet.center = center;
+	meshlet.radius = radius;
+
+	// normal cone out of the face normals
+	std::vector<glm::vec3> normals;
+	normals.reserve(meshlet.triangleCount);
+	glm::vec3 axis(0.0f);
+	for (unsigned int t = 0; t < meshlet.triangleCount; ++t)
+	{
+		const unsigned int* triangle = &m_Indices[meshlet.firstIndex + t * 3];
+		glm::vec3 normal = glm::cross(positions[triangle[1]] - positions[triangle[0]], positions[triangle[2]] - positions[triangle[0]]);
+		float length = glm::length(normal);
+		if (length <= 0.0f)
+			continue;
+		normal /= length;
+		normals.push_back(normal);
+		axis += normal;
+	}
+
+	meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+	meshlet.coneCutoff = 1.0f;
+	meshlet.padding = 0.0f;
+
+	float axisLength = glm::length(axis);
+	if (normals.empty() || axisLength <= 0.0f)
+		return;
+	axis /= axisLength;
+
+	float minDot = 1.0f;
+	for (const glm::vec3& normal : normals)
+		minDot = std::fmin(minDot, glm::dot(axis, normal));
+
+	meshlet.coneAxis = axis;
+	// a cone wider than ~84 degrees almost never culls, keep it disabled
+	if (minDot > 0.1f)
+		meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+
+unsigned int MeshletMesh::cull(const Frustum& frustum, const glm::vec3& cameraPosition,
+	std::vector<DrawElementsIndirectCommand>& commands, MeshletCullStats* stats) const
+{
+	MeshletCullStats counters;
+	commands.clear();
+
+	for (const Meshlet& meshlet : m_Meshlets)
+	{
+		if (!frustum.isSphereVisible(meshlet.center, meshlet.radius))
+		{
+			++counters.frustumCulled;
+			counters.culledTriangles += meshlet.triangleCount;
+			continue;
+		}
+
+		// every triangle faces away when the view direction stays inside the cone
+		glm::vec3 toCenter = meshlet.center - cameraPosition;
+		if (meshlet.coneCutoff < 1.0f &&
+			glm::dot(toCenter, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius)
+		{
+			++counters.backfaceCulled;
+			counters.culledTriangles += meshlet.triangleCount;
+			continue;
+		}
+
+		++counters.visibleMeshlets;
+		counters.visibleTriangles += meshlet.triangleCount;
+
+		unsigned int indexCount = meshlet.triangleCount * 3;
+		if (!commands.empty() && commands.back().firstIndex + commands.back().count == meshlet.firstIndex)
+		{
+			commands.back().count += indexCount;
+		}
+		else
+		{
+			DrawElementsIndirectCommand command;
+			command.count = indexCount;
+			command.instanceCount = 1;
+			command.firstIndex = meshlet.firstIndex;
+			command.baseVertex = 0;
+			command.baseInstance = 0;
+			commands.push_back(command);
+		}
+	}
+
+	counters.commands = (unsigned int)commands.size();
+	if (stats)
+		*stats = counters;
+	return counters.visibleTriangles;
+}
+
+
+bool MeshletMesh::save(const std::string& path) const
+{
+	MeshCacheWriter writer;
+	if (!writer.open(path))
+		return false;
+	writer.addSection(MeshCache::TAG_MESHLETS, m_Meshlets.data(), m_Meshlets.size() * sizeof(Meshlet));
+	writer.addSection(MeshCache::TAG_MESHLET_INDICES, m_Indices.data(), m_Indices.size() * sizeof(unsigned int));
+	return writer.close();
+}
+
+
+bool MeshletMesh::load(const std::string& path)
+{
+	MeshCacheReader reader;
+	if (!reader.open(path))
+		return false;
+	if (!reader.readArray(MeshCache::TAG_MESHLETS, m_Meshlets) || !reader.readArray(MeshCache::TAG_MESHLET_INDICES, m_Indices))
+	{
+		m_Meshlets.clear();
+		m_Indices.clear();
+		return false;
+	}
+	return !m_Meshlets.empty();
+}
+
+
+const std::vector<Meshlet>& MeshletMesh::meshlets() const
+{
+	return m_Meshlets;
+}
+
+
+const std::vector<unsigned int>& MeshletMesh::indices() const
+{
+	return m_Indices;
+}
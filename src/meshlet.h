@@ -0,0 +1,103 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <string>
+#include <vector>
+#include <glm.hpp>
+#include "mesh.h"
+#include "frustum.h"
+#include "draw_commands.h"
+
+/*!
+ * Cluster of neighbouring triangles with its culling data
+ *
+ */
+struct Meshlet
+{
+	unsigned int firstIndex;    // first index of the cluster in MeshletMesh::indices()
+	unsigned int triangleCount;
+	unsigned int vertexCount;   // unique vertices referenced by the cluster
+	float radius;
+	glm::vec3 center;           // bounding sphere
+	float coneCutoff;           // sin of the cone half angle, 1.0 when the cone is unusable
+	glm::vec3 coneAxis;         // average facing direction of the triangles
+	float padding;
+};
+
+/*!
+ * Counters filled by MeshletMesh::cull
+ *
+ */
+struct MeshletCullStats
+{
+	unsigned int visibleMeshlets = 0;
+	unsigned int frustumCulled = 0;
+	unsigned int backfaceCulled = 0;
+	unsigned int visibleTriangles = 0;
+	unsigned int culledTriangles = 0;
+	unsigned int commands = 0;
+};
+
+class MeshletMesh
+{
+public:
+	static const unsigned int MAX_VERTICES = 64;
+	static const unsigned int MAX_TRIANGLES = 124;
+
+	/*!
+	 * Split a mesh into meshlets
+	 *
+	 * Triangles are reordered so each meshlet owns a contiguous index range,
+	 * vertex indices still refer to the vertices of the source mesh.
+	 *
+	 * \param mesh : source mesh, triangle list
+	 */
+	void build(const Mesh& mesh);
+
+	/*!
+	 * Frustum and backface cone culling of every meshlet
+	 *
+	 * Neighbouring visible meshlets are merged so the emitted commands are
+	 * the compacted index ranges to feed glMultiDrawElementsIndirect.
+	 *
+	 * \param frustum : frustum in the mesh space (projection * view * model)
+	 * \param cameraPosition : camera position in the mesh space
+	 * \param commands : cleared and filled with one command per visible range
+	 * \param stats : optional counters, can be nullptr
+	 * \return : number of visible triangles
+	 */
+	unsigned int cull(const Frustum& frustum, const glm::vec3& cameraPosition,
+		std::vector<DrawElementsIndirectCommand>& commands, MeshletCullStats* stats = nullptr) const;
+
+	/*!
+	 * Store meshlets and reordered indices in the native cache format
+	 *
+	 * \param path : path of the cache file
+	 * \return : false(bool) on write failure
+	 */
+	bool save(const std::string& path) const;
+
+	/*!
+	 * Load meshlets previously stored with save
+	 *
+	 * \param path : path of the cache file
+	 * \return : false(bool) if the cache is missing or holds no meshlets
+	 */
+	bool load(const std::string& path);
+
+	const std::vector<Meshlet>& meshlets() const;
+	const std::vector<unsigned int>& indices() const;
+
+private:
+
+	std::vector<Meshlet> m_Meshlets;
+	std::vector<unsigned int> m_Indices;
+
+	/*!
+	 * Bounding sphere and normal cone of the last meshlet
+	 *
+	 */
+	void ComputeBounds(Meshlet& meshlet, const std::vector<glm::vec3>& positions,
+		const std::vector<unsigned int>& localVertices) const;
+};
+#endif
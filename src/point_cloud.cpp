@@ -0,0 +1,368 @@
+#include "point_cloud.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+	std::string Extension(const std::string& path)
+	{
+		size_t dot = path.find_last_of('.');
+		if (dot == std::string::npos)
+			return std::string();
+		std::string extension = path.substr(dot + 1);
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		return extension;
+	}
+
+	int PlyTypeSize(const std::string& type)
+	{
+		if (type == "char" || type == "uchar" || type == "int8" || type == "uint8")
+			return 1;
+		if (type == "short" || type == "ushort" || type == "int16" || type == "uint16")
+			return 2;
+		if (type == "int" || type == "uint" || type == "float" || type == "int32" || type == "uint32" || type == "float32")
+			return 4;
+		if (type == "double" || type == "float64")
+			return 8;
+		return 0;
+	}
+
+	// positions are decoded as float or double, integer coordinates would be read as garbage
+	bool IsPlyFloatType(const std::string& type)
+	{
+		return type == "float" || type == "float32" || type == "double" || type == "float64";
+	}
+
+	template <typename T>
+	T ReadValue(const char* data)
+	{
+		T value;
+		memcpy(&value, data, sizeof(T));
+		return value;
+	}
+}
+
+
+PointReader::PointReader()
+	: m_Format(FORMAT_NONE), m_PointCount(0), m_PointsRead(0), m_DataStart(0), m_Scale(1.0), m_Offset(0.0)
+{
+}
+
+
+bool PointReader::open(const std::string& path)
+{
+	m_File.close();
+	m_File.clear();
+	m_Format = FORMAT_NONE;
+	m_Record = Record();
+	m_PointCount = 0;
+	m_PointsRead = 0;
+
+	m_File.open(path, std::ios::binary);
+	if (!m_File.is_open())
+	{
+		std::cout << "ERROR::POINT CLOUD::UNABLE TO OPEN FILE: " << path << std::endl;
+		return false;
+	}
+
+	std::string extension = Extension(path);
+	bool success = false;
+	if (extension == "ply")
+	{
+		m_Format = FORMAT_PLY;
+		success = ParsePlyHeader();
+	}
+	else if (extension == "las")
+	{
+		m_Format = FORMAT_LAS;
+		success = ParseLasHeader();
+	}
+	else if (extension == "xyz" || extension == "txt")
+	{
+		m_Format = FORMAT_XYZ;
+		m_DataStart = 0;
+		success = true;
+	}
+	else
+		std::cout << "ERROR::POINT CLOUD::UNSUPPORTED FILE TYPE: " << path << std::endl;
+
+	if (!success)
+	{
+		m_Format = FORMAT_NONE;
+		m_File.close();
+		return false;
+	}
+	rewind();
+	return true;
+}
+
+
+bool PointReader::read(std::vector<Point>& points, size_t maxPoints)
+{
+	points.clear();
+	if (m_Format == FORMAT_NONE || maxPoints == 0)
+		return false;
+
+	if (m_Format == FORMAT_XYZ)
+	{
+		std::string line;
+		while (points.size() < maxPoints && std::getline(m_File, line))
+		{
+			const char* cursor = line.c_str();
+			char* end = nullptr;
+			double values[6];
+			int count = 0;
+			while (count < 6)
+			{
+				values[count] = std::strtod(cursor, &end);
+				if (end == cursor)
+					break;
+				cursor = end;
+				// values can be separated by commas too
+				while (*cursor == ',' || *cursor == ';')
+					++cursor;
+				++count;
+			}
+			if (count < 3)
+				continue;
+
+			Point point;
+			point.position = glm::vec3((float)values[0], (float)values[1], (float)values[2]);
+			point.color = count >= 6 ? PackColor((unsigned int)values[3], (unsigned int)values[4], (unsigned int)values[5]) : 0xFFFFFFFFu;
+			points.push_back(point);
+		}
+		m_PointsRead += points.size();
+		return !points.empty();
+	}
+
+	uint64_t remaining = m_PointCount - m_PointsRead;
+	size_t count = (size_t)std::min<uint64_t>(remaining, maxPoints);
+	if (count == 0)
+		return false;
+
+	m_Buffer.resize(count * m_Record.size);
+	m_File.read(m_Buffer.data(), (std::streamsize)m_Buffer.size());
+	count = (size_t)(m_File.gcount() / m_Record.size);
+
+	points.resize(count);
+	for (size_t i = 0; i < count; ++i)
+		DecodeRecord(m_Buffer.data() + i * m_Record.size, points[i]);
+	m_PointsRead += count;
+	return count > 0;
+}
+
+
+void PointReader::rewind()
+{
+	m_File.clear();
+	m_File.seekg(m_DataStart);
+	m_PointsRead = 0;
+}
+
+
+uint64_t PointReader::pointCount() const
+{
+	return m_PointCount;
+}
+
+
+glm::dvec3 PointReader::origin() const
+{
+	return m_Format == FORMAT_LAS ? m_Offset : glm::dvec3(0.0);
+}
+
+
+bool PointReader::ParsePlyHeader()
+{
+	std::string line;
+	if (!std::getline(m_File, line) || line.compare(0, 3, "ply") != 0)
+	{
+		std::cout << "ERROR::POINT CLOUD::NOT A PLY FILE" << std::endl;
+		return false;
+	}
+
+	bool binary = false;
+	bool inVertex = false;
+	bool vertexSeen = false;
+	int redOffset = -1, greenOffset = -1, blueOffset = -1;
+	std::string positionType[3];
+	while (std::getline(m_File, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		std::istringstream words(line);
+		std::string keyword;
+		words >> keyword;
+
+		if (keyword == "format")
+		{
+			std::string format;
+			words >> format;
+			binary = format == "binary_little_endian";
+		}
+		else if (keyword == "element")
+		{
+			std::string name;
+			uint64_t count = 0;
+			words >> name >> count;
+			if (name == "vertex")
+			{
+				m_PointCount = count;
+				vertexSeen = true;
+			}
+			inVertex = name == "vertex";
+			if (!vertexSeen && count > 0)
+			{
+				std::cout << "ERROR::POINT CLOUD::PLY VERTEX ELEMENT MUST COME FIRST" << std::endl;
+				return false;
+			}
+		}
+		else if (keyword == "property" && inVertex)
+		{
+			std::string type, name;
+			words >> type >> name;
+			int size = PlyTypeSize(type);
+			if (size == 0)
+			{
+				std::cout << "ERROR::POINT CLOUD::UNSUPPORTED PLY PROPERTY: " << line << std::endl;
+				return false;
+			}
+
+			int axis = name == "x" ? 0 : (name == "y" ? 1 : (name == "z" ? 2 : -1));
+			if (axis >= 0)
+			{
+				m_Record.position[axis] = (int)m_Record.size;
+				positionType[axis] = type;
+			}
+			else if (name == "red" && size == 1)
+				redOffset = (int)m_Record.size;
+			else if (name == "green" && size == 1)
+				greenOffset = (int)m_Record.size;
+			else if (name == "blue" && size == 1)
+				blueOffset = (int)m_Record.size;
+			m_Record.size += size;
+		}
+		else if (keyword == "end_header")
+			break;
+	}
+
+	if (!binary)
+	{
+		std::cout << "ERROR::POINT CLOUD::ONLY BINARY LITTLE ENDIAN PLY IS SUPPORTED" << std::endl;
+		return false;
+	}
+	if (m_Record.position[0] < 0 || m_Record.position[1] < 0 || m_Record.position[2] < 0)
+	{
+		std::cout << "ERROR::POINT CLOUD::PLY NEEDS FLOAT OR DOUBLE X Y Z" << std::endl;
+		return false;
+	}
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		if (!IsPlyFloatType(positionType[axis]) || PlyTypeSize(positionType[axis]) != PlyTypeSize(positionType[0]))
+		{
+			std::cout << "ERROR::POINT CLOUD::UNSUPPORTED POSITION TYPE: " << positionType[axis] << " " << "xyz"[axis] << std::endl;
+			return false;
+		}
+	}
+	m_Record.doublePosition = PlyTypeSize(positionType[0]) == 8;
+	if (redOffset >= 0 && greenOffset == redOffset + 1 && blueOffset == redOffset + 2)
+		m_Record.color = redOffset;
+
+	m_DataStart = (std::streamoff)m_File.tellg();
+	return true;
+}
+
+
+bool PointReader::ParseLasHeader()
+{
+	char header[375];
+	memset(header, 0, sizeof(header));
+	m_File.read(header, sizeof(header));
+	if (m_File.gcount() < 227 || memcmp(header, "LASF", 4) != 0)
+	{
+		std::cout << "ERROR::POINT CLOUD::NOT A LAS FILE" << std::endl;
+		return false;
+	}
+
+	uint16_t headerSize = ReadValue<uint16_t>(header + 94);
+	uint32_t pointOffset = ReadValue<uint32_t>(header + 96);
+	uint8_t format = (uint8_t)header[104];
+	uint16_t recordLength = ReadValue<uint16_t>(header + 105);
+	if (format & 0x80)
+	{
+		std::cout << "ERROR::POINT CLOUD::COMPRESSED LAZ IS NOT SUPPORTED" << std::endl;
+		return false;
+	}
+	format &= 0x3F;
+
+	m_PointCount = ReadValue<uint32_t>(header + 107);
+	if (m_PointCount == 0 && headerSize >= 255)
+		m_PointCount = ReadValue<uint64_t>(header + 247);
+
+	m_Scale = glm::dvec3(ReadValue<double>(header + 131), ReadValue<double>(header + 139), ReadValue<double>(header + 147));
+	m_Offset = glm::dvec3(ReadValue<double>(header + 155), ReadValue<double>(header + 163), ReadValue<double>(header + 171));
+
+	m_Record.size = recordLength;
+	m_Record.position[0] = 0;
+	m_Record.position[1] = 4;
+	m_Record.position[2] = 8;
+	m_Record.wideColor = true;
+	switch (format)
+	{
+	case 2: m_Record.color = 20; break;
+	case 3: case 5: m_Record.color = 28; break;
+	case 7: case 8: case 10: m_Record.color = 30; break;
+	default: m_Record.color = -1; break;
+	}
+	if (recordLength < 12 || (m_Record.color >= 0 && (unsigned int)m_Record.color + 6 > recordLength))
+	{
+		std::cout << "ERROR::POINT CLOUD::INVALID LAS RECORD LENGTH" << std::endl;
+		return false;
+	}
+
+	m_DataStart = (std::streamoff)pointOffset;
+	return true;
+}
+
+
+void PointReader::DecodeRecord(const char* record, Point& point) const
+{
+	if (m_Format == FORMAT_LAS)
+	{
+		// kept relative to the header offset, georeferenced coordinates do not fit a float
+		point.position = glm::vec3(
+			(float)(ReadValue<int32_t>(record) * m_Scale.x),
+			(float)(ReadValue<int32_t>(record + 4) * m_Scale.y),
+			(float)(ReadValue<int32_t>(record + 8) * m_Scale.z));
+	}
+	else if (m_Record.doublePosition)
+	{
+		point.position = glm::vec3(
+			(float)ReadValue<double>(record + m_Record.position[0]),
+			(float)ReadValue<double>(record + m_Record.position[1]),
+			(float)ReadValue<double>(record + m_Record.position[2]));
+	}
+	else
+	{
+		point.position = glm::vec3(
+			ReadValue<float>(record + m_Record.position[0]),
+			ReadValue<float>(record + m_Record.position[1]),
+			ReadValue<float>(record + m_Record.position[2]));
+	}
+
+	if (m_Record.color < 0)
+		point.color = 0xFFFFFFFFu;
+	else if (m_Record.wideColor)
+	{
+		const char* color = record + m_Record.color;
+		point.color = PackColor(ReadValue<uint16_t>(color) >> 8, ReadValue<uint16_t>(color + 2) >> 8, ReadValue<uint16_t>(color + 4) >> 8);
+	}
+	else
+	{
+		const unsigned char* color = (const unsigned char*)record + m_Record.color;
+		point.color = PackColor(color[0], color[1], color[2]);
+	}
+}
@@ -0,0 +1,113 @@
+#ifndef POINT_CLOUD_H
+#define POINT_CLOUD_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <glm.hpp>
+
+/*!
+ * Point of a scan, color packed as RGBA8
+ *
+ */
+struct Point
+{
+	glm::vec3 position;
+	uint32_t color;
+};
+
+/*!
+ * Sequential reader of point cloud files
+ *
+ * Points are read in batches so files far larger than memory can be
+ * processed. Supported inputs, picked by extension:
+ *  .ply : binary little endian, float or double x/y/z, optional uchar red/green/blue
+ *  .xyz : text, "x y z" optionally followed by "r g b" in 0-255
+ *  .las : formats 0 to 10, RGB is read for the formats that carry it
+ */
+class PointReader
+{
+public:
+	PointReader();
+
+	/*!
+	 * Open a file and parse its header
+	 *
+	 * \param path : path of the point cloud
+	 * \return : false(bool) if the file is missing or of an unsupported kind
+	 */
+	bool open(const std::string& path);
+
+	/*!
+	 * Read the next points
+	 *
+	 * \param points : cleared and filled with up to maxPoints points
+	 * \param maxPoints : batch size
+	 * \return : false(bool) once the end of the file is reached and nothing was read
+	 */
+	bool read(std::vector<Point>& points, size_t maxPoints);
+
+	/*!
+	 * Go back to the first point
+	 *
+	 */
+	void rewind();
+
+	/*!
+	 * Number of points announced by the header, 0 for text files
+	 *
+	 */
+	uint64_t pointCount() const;
+
+	/*!
+	 * Offset to add to the read positions to get the file coordinates,
+	 * LAS points are returned relative to the offset of their header
+	 *
+	 */
+	glm::dvec3 origin() const;
+
+private:
+
+	enum Format
+	{
+		FORMAT_NONE,
+		FORMAT_PLY,
+		FORMAT_XYZ,
+		FORMAT_LAS
+	};
+
+	// byte layout of a binary record, offsets are -1 for missing fields
+	struct Record
+	{
+		unsigned int size = 0;
+		int position[3] = { -1, -1, -1 };
+		bool doublePosition = false;
+		int color = -1;
+		bool wideColor = false;       // LAS stores 16 bit channels
+	};
+
+	std::ifstream m_File;
+	Format m_Format;
+	Record m_Record;
+	uint64_t m_PointCount;
+	uint64_t m_PointsRead;
+	std::streamoff m_DataStart;
+	glm::dvec3 m_Scale;             // LAS integer coordinates to meters
+	glm::dvec3 m_Offset;
+	std::vector<char> m_Buffer;
+
+	bool ParsePlyHeader();
+	bool ParseLasHeader();
+	void DecodeRecord(const char* record, Point& point) const;
+};
+
+/*!
+ * Pack a color the way Point stores it
+ *
+ */
+inline uint32_t PackColor(unsigned int red, unsigned int green, unsigned int blue)
+{
+	return (red & 0xFF) | ((green & 0xFF) << 8) | ((blue & 0xFF) << 16) | 0xFF000000u;
+}
+#endif
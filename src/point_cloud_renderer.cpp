@@ -0,0 +1,308 @@
+#include "point_cloud_renderer.h"
+#include <algorithm>
+#include <iostream>
+#include <queue>
+#include "frustum.h"
+#include "gl_state_cache.h"
+#include "mesh_cache.h"
+
+
+PointCloudRenderer::PointCloudRenderer()
+	: m_Newest(NO_NODE), m_Oldest(NO_NODE), m_PendingReads(0), m_DataOffset(0), m_Frame(0)
+{
+}
+
+PointCloudRenderer::~PointCloudRenderer()
+{
+	close();
+}
+
+
+bool PointCloudRenderer::open(const std::string& path, const Options& options)
+{
+	close();
+
+	MeshCacheReader reader;
+	std::vector<PointOctree::Header> header;
+	uint64_t dataSize = 0;
+	if (!reader.open(path) || !reader.readArray(MeshCache::TAG_POINT_HEADER, header) || header.size() != 1 ||
+		!reader.readArray(MeshCache::TAG_POINT_NODES, m_Nodes) || header[0].rootNode >= m_Nodes.size() ||
+		!reader.sectionRange(MeshCache::TAG_POINTS, m_DataOffset, dataSize))
+	{
+		std::cout << "ERROR::POINT CLOUD RENDERER::NO OCTREE IN: " << path << std::endl;
+		m_Nodes.clear();
+		return false;
+	}
+	if (!m_Reader.open(path, options.ioThreads))
+	{
+		m_Nodes.clear();
+		return false;
+	}
+
+	m_Header = header[0];
+	m_Options = options;
+	m_Slots.assign(m_Nodes.size(), NodeSlot());
+	m_Newest = NO_NODE;
+	m_Oldest = NO_NODE;
+	m_PendingReads = 0;
+	m_Stats = PointCloudStats();
+	m_Stats.nodes = (unsigned int)m_Nodes.size();
+	return true;
+}
+
+
+void PointCloudRenderer::close()
+{
+	m_Reader.close();
+	m_Uploads.clear();
+	for (uint32_t node = 0; node < m_Slots.size(); ++node)
+		Evict(node);
+	m_Slots.clear();
+	m_Nodes.clear();
+	m_DrawList.clear();
+	m_Newest = NO_NODE;
+	m_Oldest = NO_NODE;
+	m_PendingReads = 0;
+}
+
+
+void PointCloudRenderer::update(const glm::mat4& modelViewProjection, const glm::vec3& cameraPosition, float screenScale, LinearArena& arena)
+{
+	++m_Frame;
+	m_Stats.evictions = 0;
+	m_Stats.visitedNodes = 0;
+	m_DrawList.clear();
+	if (m_Nodes.empty())
+		return;
+
+	// reads not started yet are dropped, the queue is rebuilt for the new camera
+	FrameVector<AsyncFileReader::Request> none{ ArenaAllocator<AsyncFileReader::Request>(arena) };
+	FrameVector<uint64_t> dropped{ ArenaAllocator<uint64_t>(arena) };
+	m_Reader.replaceQueue(none, dropped);
+	for (uint64_t node : dropped)
+	{
+		m_Slots[node].state = NODE_UNLOADED;
+		m_Stats.residentBytes -= NodeBytes((uint32_t)node);
+		--m_PendingReads;
+	}
+
+	// largest nodes on screen first until the point budget is spent
+	Frustum frustum(modelViewProjection);
+	typedef std::pair<float, uint32_t> Candidate;
+	std::priority_queue<Candidate, FrameVector<Candidate>> candidates{ std::less<Candidate>(), FrameVector<Candidate>(ArenaAllocator<Candidate>(arena)) };
+	FrameVector<AsyncFileReader::Request> requests{ ArenaAllocator<AsyncFileReader::Request>(arena) };
+	candidates.push(Candidate(INFINITY, m_Header.rootNode));
+	uint64_t points = 0;
+	while (!candidates.empty())
+	{
+		Candidate candidate = candidates.top();
+		candidates.pop();
+		const PointOctree::Node& node = m_Nodes[candidate.second];
+		if (points + node.pointCount > m_Options.pointBudget)
+			break;
+		points += node.pointCount;
+		++m_Stats.visitedNodes;
+
+		NodeSlot& slot = m_Slots[candidate.second];
+		slot.lastUsedFrame = m_Frame;
+		if (slot.state != NODE_RESIDENT)
+		{
+			// children wait for their parent so the cloud fills in from coarse to fine
+			if (slot.state == NODE_UNLOADED)
+				requests.push_back(AsyncFileReader::Request{ candidate.second, 0, 0, candidate.first });
+			continue;
+		}
+		Touch(candidate.second);
+		m_DrawList.push_back(candidate.second);
+
+		for (int octant = 0; octant < 8; ++octant)
+		{
+			uint32_t child = node.children[octant];
+			if (child == PointOctree::NO_CHILD)
+				continue;
+
+			const PointOctree::Node& childNode = m_Nodes[child];
+			glm::vec3 boundsMax = childNode.boundsMin + glm::vec3(childNode.size);
+			if (!frustum.isBoxVisible(childNode.boundsMin, boundsMax))
+				continue;
+
+			glm::vec3 center = childNode.boundsMin + glm::vec3(childNode.size * 0.5f);
+			float distance = std::max(glm::length(center - cameraPosition) - childNode.size * 0.866f, 1e-3f);
+			float pixels = childNode.size * screenScale / distance;
+			if (pixels >= m_Options.minNodePixels)
+				candidates.push(Candidate(pixels, child));
+		}
+	}
+
+	std::sort(requests.begin(), requests.end(), [](const AsyncFileReader::Request& a, const AsyncFileReader::Request& b)
+	{
+		return a.priority > b.priority;
+	});
+	FrameVector<AsyncFileReader::Request> accepted{ ArenaAllocator<AsyncFileReader::Request>(arena) };
+	for (AsyncFileReader::Request& request : requests)
+	{
+		if (m_PendingReads >= m_Options.maxPendingReads)
+			break;
+
+		// the nodes of this frame were moved to the newest end, the oldest ones are not drawn
+		uint32_t node = (uint32_t)request.id;
+		uint64_t bytes = NodeBytes(node);
+		while (m_Stats.residentBytes + bytes > m_Options.gpuBudget && m_Oldest != NO_NODE && m_Slots[m_Oldest].lastUsedFrame < m_Frame)
+			Evict(m_Oldest);
+		if (m_Stats.residentBytes + bytes > m_Options.gpuBudget)
+			break;
+
+		request.offset = m_DataOffset + m_Nodes[node].firstPoint * sizeof(Point);
+		request.size = bytes;
+		m_Slots[node].state = NODE_QUEUED;
+		m_Stats.residentBytes += bytes;
+		++m_PendingReads;
+		accepted.push_back(request);
+	}
+	m_Stats.pendingReads = m_PendingReads;
+
+	if (!accepted.empty())
+		m_Reader.replaceQueue(accepted, dropped);
+}
+
+
+void PointCloudRenderer::upload()
+{
+	size_t previous = m_Uploads.size();
+	m_Reader.takeCompleted(m_Uploads);
+	for (size_t i = previous; i < m_Uploads.size(); ++i)
+		m_Slots[m_Uploads[i].id].state = NODE_LOADED;
+
+	GpuResources& resources = GpuResources::instance();
+	GLStateCache& state = GLStateCache::instance();
+	m_Stats.uploadedBytes = 0;
+
+	size_t done = 0;
+	for (; done < m_Uploads.size(); ++done)
+	{
+		AsyncFileReader::Result& completed = m_Uploads[done];
+		if (m_Stats.uploadedBytes > 0 && m_Stats.uploadedBytes + completed.data.size() > m_Options.uploadBytesPerFrame)
+			break;
+
+		NodeSlot& slot = m_Slots[completed.id];
+		if (completed.data.empty())
+		{
+			// failed read, give the space back and let the next update retry
+			slot.state = NODE_UNLOADED;
+			m_Stats.residentBytes -= NodeBytes((uint32_t)completed.id);
+			--m_PendingReads;
+			continue;
+		}
+
+		slot.vao = resources.createVertexArray();
+		state.bindVertexArray(resources.name(slot.vao));
+		slot.buffer = resources.createBuffer(GL_ARRAY_BUFFER, completed.data.size(), completed.data.data(), GL_STATIC_DRAW);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Point), (void*)offsetof(Point, position));
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Point), (void*)offsetof(Point, color));
+		glEnableVertexAttribArray(1);
+
+		slot.state = NODE_RESIDENT;
+		Touch((uint32_t)completed.id);
+		--m_PendingReads;
+		++m_Stats.residentNodes;
+		m_Stats.uploadedBytes += completed.data.size();
+	}
+	m_Uploads.erase(m_Uploads.begin(), m_Uploads.begin() + done);
+}
+
+
+void PointCloudRenderer::draw(Shader& shader, float screenScale)
+{
+	GpuResources& resources = GpuResources::instance();
+	GLStateCache& state = GLStateCache::instance();
+	state.setEnabled(GL_PROGRAM_POINT_SIZE, true);
+	shader.setFloat("screenScale", screenScale);
+
+	m_Stats.drawnNodes = 0;
+	m_Stats.drawnPoints = 0;
+	for (uint32_t node : m_DrawList)
+	{
+		const NodeSlot& slot = m_Slots[node];
+		if (slot.state != NODE_RESIDENT)
+			continue;
+		shader.setFloat("spacing", m_Nodes[node].spacing);
+		state.bindVertexArray(resources.name(slot.vao));
+		glDrawArrays(GL_POINTS, 0, (GLsizei)m_Nodes[node].pointCount);
+		++m_Stats.drawnNodes;
+		m_Stats.drawnPoints += m_Nodes[node].pointCount;
+	}
+}
+
+
+const PointCloudStats& PointCloudRenderer::stats() const
+{
+	return m_Stats;
+}
+
+
+void PointCloudRenderer::reportTo(Profiler& profiler) const
+{
+	const double MB = 1.0 / (1024.0 * 1024.0);
+	profiler.addCounter("POINTS DRAWN", (double)m_Stats.drawnPoints);
+	profiler.addCounter("POINT NODES DRAWN", m_Stats.drawnNodes);
+	profiler.addCounter("POINT RESIDENT MB", m_Stats.residentBytes * MB);
+	profiler.addCounter("POINT PENDING READS", m_Stats.pendingReads);
+}
+
+
+void PointCloudRenderer::Evict(uint32_t node)
+{
+	NodeSlot& slot = m_Slots[node];
+	if (slot.state != NODE_RESIDENT)
+		return;
+
+	GpuResources& resources = GpuResources::instance();
+	resources.release(slot.vao);
+	resources.release(slot.buffer);
+	slot.vao = GpuHandle();
+	slot.buffer = GpuHandle();
+	slot.state = NODE_UNLOADED;
+	Unlink(node);
+	m_Stats.residentBytes -= NodeBytes(node);
+	--m_Stats.residentNodes;
+	++m_Stats.evictions;
+}
+
+
+void PointCloudRenderer::Touch(uint32_t node)
+{
+	if (m_Newest == node)
+		return;
+	Unlink(node);
+
+	NodeSlot& slot = m_Slots[node];
+	slot.older = m_Newest;
+	if (m_Newest != NO_NODE)
+		m_Slots[m_Newest].newer = node;
+	m_Newest = node;
+	if (m_Oldest == NO_NODE)
+		m_Oldest = node;
+}
+
+
+void PointCloudRenderer::Unlink(uint32_t node)
+{
+	NodeSlot& slot = m_Slots[node];
+	if (slot.newer != NO_NODE)
+		m_Slots[slot.newer].older = slot.older;
+	else if (m_Newest == node)
+		m_Newest = slot.older;
+	if (slot.older != NO_NODE)
+		m_Slots[slot.older].newer = slot.newer;
+	else if (m_Oldest == node)
+		m_Oldest = slot.newer;
+	slot.newer = NO_NODE;
+	slot.older = NO_NODE;
+}
+
+
+uint64_t PointCloudRenderer::NodeBytes(uint32_t node) const
+{
+	return (uint64_t)m_Nodes[node].pointCount * sizeof(Point);
+}
@@ -0,0 +1,143 @@
+#ifndef POINT_CLOUD_RENDERER_H
+#define POINT_CLOUD_RENDERER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm.hpp>
+#include "async_file_reader.h"
+#include "gpu_resources.h"
+#include "point_octree.h"
+#include "profiler.h"
+#include "shader.h"
+
+/*!
+ * Counters of PointCloudRenderer
+ *
+ */
+struct PointCloudStats
+{
+	unsigned int nodes = 0;
+	unsigned int visitedNodes = 0;
+	unsigned int drawnNodes = 0;
+	uint64_t drawnPoints = 0;
+	unsigned int residentNodes = 0;
+	unsigned int pendingReads = 0;
+	uint64_t residentBytes = 0;
+	uint64_t uploadedBytes = 0;   // this frame
+	unsigned int evictions = 0;   // this frame
+};
+
+/*!
+ * Renderer of a point octree written by PointOctree::Build
+ *
+ * Nodes are visited by decreasing projected size until the point budget is
+ * spent, so the cost of a frame depends on the budget and not on the size
+ * of the cloud. Children of a node are only visited once the node itself is
+ * on the GPU, the cloud refines from coarse to fine while node points are
+ * read in the background. Points are drawn as GL_POINTS sized from the
+ * spacing of their node and their distance.
+ */
+class PointCloudRenderer
+{
+public:
+	struct Options
+	{
+		uint64_t pointBudget = 5000000;
+		uint64_t gpuBudget = 1024ull * 1024 * 1024;
+		uint64_t uploadBytesPerFrame = 16ull * 1024 * 1024;
+		unsigned int ioThreads = 2;
+		unsigned int maxPendingReads = 32;
+		// nodes smaller than this on screen are not refined
+		float minNodePixels = 100.0f;
+	};
+
+	PointCloudRenderer();
+	~PointCloudRenderer();
+
+	PointCloudRenderer(const PointCloudRenderer&) = delete;
+	PointCloudRenderer& operator=(const PointCloudRenderer&) = delete;
+
+	/*!
+	 * Open an octree and start the I/O threads
+	 *
+	 * \param path : cache file written by PointOctree::Build
+	 * \param options : budgets
+	 * \return : false(bool) if the file holds no octree
+	 */
+	bool open(const std::string& path, const Options& options);
+
+	void close();
+
+	/*!
+	 * Select the nodes to draw, evict and queue reads, call once per frame
+	 *
+	 * \param modelViewProjection : in the octree space
+	 * \param cameraPosition : camera position in the octree space
+	 * \param screenScale : viewport height / (2 tan(fovy / 2)), pixels per unit at distance 1
+	 * \param arena : frame memory for the lists built on the way, see FrameArena::threadArena
+	 */
+	void update(const glm::mat4& modelViewProjection, const glm::vec3& cameraPosition, float screenScale, LinearArena& arena);
+
+	/*!
+	 * Upload finished reads, at most uploadBytesPerFrame per call
+	 *
+	 */
+	void upload();
+
+	/*!
+	 * Draw the selected nodes with a program built from vertex_points.glsl
+	 *
+	 * \param shader : program in use, its model/view/projection are set by the caller
+	 * \param screenScale : as passed to update
+	 */
+	void draw(Shader& shader, float screenScale);
+
+	const PointCloudStats& stats() const;
+
+	void reportTo(Profiler& profiler) const;
+
+private:
+
+	enum NodeState
+	{
+		NODE_UNLOADED,
+		NODE_QUEUED,
+		NODE_LOADED,
+		NODE_RESIDENT
+	};
+
+	static const uint32_t NO_NODE = 0xFFFFFFFFu;
+
+	struct NodeSlot
+	{
+		NodeState state = NODE_UNLOADED;
+		GpuHandle vao;
+		GpuHandle buffer;
+		uint64_t lastUsedFrame = 0;
+		// neighbours in the list of resident nodes, NO_NODE at its ends
+		uint32_t newer = NO_NODE;
+		uint32_t older = NO_NODE;
+	};
+
+	Options m_Options;
+	PointOctree::Header m_Header;
+	std::vector<PointOctree::Node> m_Nodes;
+	std::vector<NodeSlot> m_Slots;
+	std::vector<uint32_t> m_DrawList;
+	// resident nodes by last use, evictions start from the oldest
+	uint32_t m_Newest;
+	uint32_t m_Oldest;
+	unsigned int m_PendingReads;   // queued or loaded, not uploaded yet
+	uint64_t m_DataOffset;
+	uint64_t m_Frame;
+	PointCloudStats m_Stats;
+	AsyncFileReader m_Reader;
+	std::vector<AsyncFileReader::Result> m_Uploads;
+
+	void Evict(uint32_t node);
+	void Touch(uint32_t node);
+	void Unlink(uint32_t node);
+	uint64_t NodeBytes(uint32_t node) const;
+};
+#endif
@@ -0,0 +1,378 @@
+#include "point_octree.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+#include "job_system.h"
+#include "mesh_cache.h"
+
+namespace
+{
+	// identical points can not be separated, such nodes stop splitting here
+	const unsigned int MAX_DEPTH = 24;
+
+	struct LocalNode
+	{
+		glm::vec3 boundsMin;
+		float size;
+		float spacing;
+		std::vector<Point> points;
+		int children[8];
+	};
+
+	struct CellTree
+	{
+		std::vector<LocalNode> nodes;   // nodes[0] is the root of the cell
+	};
+
+	uint64_t CellKey(const glm::vec3& position, const glm::vec3& boundsMin, float cellSize)
+	{
+		glm::vec3 cell = glm::floor((position - boundsMin) / cellSize);
+		return ((uint64_t)(uint32_t)(int)cell.x & 0x1FFFFF) |
+			(((uint64_t)(uint32_t)(int)cell.y & 0x1FFFFF) << 21) |
+			(((uint64_t)(uint32_t)(int)cell.z & 0x1FFFFF) << 42);
+	}
+
+	/*!
+	 * Keep one point per grid cell
+	 *
+	 * \param rest : optional, receives the points not kept
+	 */
+	void GridSample(const std::vector<Point>& points, const glm::vec3& boundsMin, float cellSize,
+		std::vector<Point>& kept, std::vector<Point>* rest)
+	{
+		std::unordered_map<uint64_t, bool> occupied;
+		occupied.reserve(points.size());
+		for (const Point& point : points)
+		{
+			if (occupied.emplace(CellKey(point.position, boundsMin, cellSize), true).second)
+				kept.push_back(point);
+			else if (rest)
+				rest->push_back(point);
+		}
+	}
+
+	unsigned int GridCell(const glm::vec3& position, const glm::vec3& boundsMin, float size, unsigned int resolution)
+	{
+		glm::vec3 cell = (position - boundsMin) / size * (float)resolution;
+		unsigned int x = (unsigned int)glm::clamp((int)cell.x, 0, (int)resolution - 1);
+		unsigned int y = (unsigned int)glm::clamp((int)cell.y, 0, (int)resolution - 1);
+		unsigned int z = (unsigned int)glm::clamp((int)cell.z, 0, (int)resolution - 1);
+		return (z * resolution + y) * resolution + x;
+	}
+
+	void BuildLocalNode(CellTree& tree, int index, std::vector<Point>& points, unsigned int depth,
+		const PointOctree::Options& options)
+	{
+		LocalNode& node = tree.nodes[index];
+		for (int child = 0; child < 8; ++child)
+			node.children[child] = -1;
+
+		if (points.size() <= options.maxLeafPoints || depth >= MAX_DEPTH)
+		{
+			// assume the points lie on surfaces
+			node.spacing = node.size / std::sqrt((float)std::max<size_t>(points.size(), 1));
+			node.points.swap(points);
+			return;
+		}
+
+		std::vector<Point> rest;
+		node.spacing = node.size / (float)options.sampleGrid;
+		GridSample(points, node.boundsMin, node.spacing, node.points, &rest);
+		std::vector<Point>().swap(points);
+
+		std::vector<Point> octants[8];
+		glm::vec3 center = node.boundsMin + glm::vec3(node.size * 0.5f);
+		for (const Point& point : rest)
+		{
+			int octant = (point.position.x >= center.x ? 1 : 0) | (point.position.y >= center.y ? 2 : 0) | (point.position.z >= center.z ? 4 : 0);
+			octants[octant].push_back(point);
+		}
+		std::vector<Point>().swap(rest);
+
+		glm::vec3 boundsMin = node.boundsMin;
+		float half = node.size * 0.5f;
+		for (int octant = 0; octant < 8; ++octant)
+		{
+			if (octants[octant].empty())
+				continue;
+
+			LocalNode child = LocalNode();
+			child.boundsMin = boundsMin + glm::vec3(octant & 1 ? half : 0.0f, octant & 2 ? half : 0.0f, octant & 4 ? half : 0.0f);
+			child.size = half;
+			int childIndex = (int)tree.nodes.size();
+			tree.nodes.push_back(child);
+			// node is invalidated by push_back
+			tree.nodes[index].children[octant] = childIndex;
+			BuildLocalNode(tree, childIndex, octants[octant], depth + 1, options);
+		}
+	}
+
+	class OctreeWriter
+	{
+	public:
+		MeshCacheWriter file;
+		std::vector<PointOctree::Node> nodes;
+		uint64_t pointCount = 0;
+
+		uint32_t addNode(const glm::vec3& boundsMin, float size, float spacing, const std::vector<Point>& points)
+		{
+			PointOctree::Node node;
+			node.boundsMin = boundsMin;
+			node.size = size;
+			node.spacing = spacing;
+			node.firstPoint = pointCount;
+			node.pointCount = (uint32_t)points.size();
+			for (int child = 0; child < 8; ++child)
+				node.children[child] = PointOctree::NO_CHILD;
+			file.appendSection(points.data(), points.size() * sizeof(Point));
+			pointCount += points.size();
+			nodes.push_back(node);
+			return (uint32_t)nodes.size() - 1;
+		}
+
+		uint32_t addTree(const CellTree& tree, int index)
+		{
+			const LocalNode& local = tree.nodes[index];
+			uint32_t global = addNode(local.boundsMin, local.size, local.spacing, local.points);
+			for (int child = 0; child < 8; ++child)
+			{
+				if (local.children[child] >= 0)
+				{
+					uint32_t childGlobal = addTree(tree, local.children[child]);
+					nodes[global].children[child] = childGlobal;
+				}
+			}
+			return global;
+		}
+	};
+}
+
+
+bool PointOctree::Build(const std::string& input, const std::string& output, const Options& options)
+{
+	auto start = std::chrono::steady_clock::now();
+	PointReader reader;
+	if (!reader.open(input))
+		return false;
+
+	// pass 1 : bounds
+	std::vector<Point> batch;
+	glm::vec3 low(INFINITY), high(-INFINITY);
+	uint64_t inputCount = 0;
+	while (reader.read(batch, options.batchPoints))
+	{
+		for (const Point& point : batch)
+		{
+			low = glm::min(low, point.position);
+			high = glm::max(high, point.position);
+		}
+		inputCount += batch.size();
+	}
+	if (inputCount == 0)
+	{
+		std::cout << "ERROR::POINT OCTREE::NO POINTS IN: " << input << std::endl;
+		return false;
+	}
+	glm::vec3 extent = high - low;
+	float size = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f)) * 1.0001f;
+
+	// pass 2 : points per cell
+	unsigned int resolution = 1u << std::min(options.gridLevels, 8u);
+	size_t cellCount = (size_t)resolution * resolution * resolution;
+	std::vector<uint64_t> cellStart(cellCount + 1, 0);
+	reader.rewind();
+	while (reader.read(batch, options.batchPoints))
+	{
+		for (const Point& point : batch)
+			++cellStart[GridCell(point.position, low, size, resolution) + 1];
+	}
+	for (size_t cell = 0; cell < cellCount; ++cell)
+		cellStart[cell + 1] += cellStart[cell];
+
+	// pass 3 : partition into a temporary file, each cell contiguous
+	std::string temporaryPath = output + ".tmp";
+	{
+		std::ofstream temporary(temporaryPath, std::ios::binary | std::ios::trunc);
+		if (!temporary.is_open())
+		{
+			std::cout << "ERROR::POINT OCTREE::UNABLE TO CREATE FILE: " << temporaryPath << std::endl;
+			return false;
+		}
+
+		std::vector<uint64_t> cursor(cellStart.begin(), cellStart.end() - 1);
+		std::vector<unsigned int> cells;
+		std::vector<Point> sorted;
+		std::vector<uint32_t> batchStart(cellCount + 1);
+		reader.rewind();
+		while (reader.read(batch, options.batchPoints))
+		{
+			// counting sort of the batch so each cell is written with one seek
+			cells.resize(batch.size());
+			std::fill(batchStart.begin(), batchStart.end(), 0);
+			for (size_t i = 0; i < batch.size(); ++i)
+			{
+				cells[i] = GridCell(batch[i].position, low, size, resolution);
+				++batchStart[cells[i] + 1];
+			}
+			for (size_t cell = 0; cell < cellCount; ++cell)
+				batchStart[cell + 1] += batchStart[cell];
+
+			sorted.resize(batch.size());
+			std::vector<uint32_t> fill(batchStart.begin(), batchStart.end() - 1);
+			for (size_t i = 0; i < batch.size(); ++i)
+				sorted[fill[cells[i]]++] = batch[i];
+
+			for (size_t cell = 0; cell < cellCount; ++cell)
+			{
+				uint32_t count = batchStart[cell + 1] - batchStart[cell];
+				if (count == 0)
+					continue;
+				temporary.seekp((std::streamoff)(cursor[cell] * sizeof(Point)));
+				temporary.write((const char*)(sorted.data() + batchStart[cell]), count * sizeof(Point));
+				cursor[cell] += count;
+			}
+		}
+		if (!temporary.good())
+		{
+			std::cout << "ERROR::POINT OCTREE::FAILED TO WRITE FILE: " << temporaryPath << std::endl;
+			return false;
+		}
+	}
+
+	// cells to subtrees, in parallel batches
+	OctreeWriter writer;
+	if (!writer.file.open(output))
+		return false;
+	writer.file.beginSection(MeshCache::TAG_POINTS);
+
+	// level gridLevels of the hierarchy: root of each cell and the subsample carried up to its parent
+	float cellSize = size / (float)resolution;
+	std::vector<uint32_t> levelNodes(cellCount, NO_CHILD);
+	std::vector<std::vector<Point>> carried(cellCount);
+
+	std::vector<size_t> occupied;
+	for (size_t cell = 0; cell < cellCount; ++cell)
+	{
+		if (cellStart[cell + 1] > cellStart[cell])
+			occupied.push_back(cell);
+	}
+
+	JobSystem& jobs = JobSystem::instance();
+	size_t batchCells = std::max<size_t>(1, jobs.concurrency() * 2);
+	std::vector<CellTree> trees;
+	std::atomic<bool> readFailed(false);
+	for (size_t first = 0; first < occupied.size(); first += batchCells)
+	{
+		size_t count = std::min(batchCells, occupied.size() - first);
+		trees.clear();
+		trees.resize(count);
+		jobs.parallelFor(count, 1, [&](size_t begin, size_t end)
+		{
+			std::ifstream temporary(temporaryPath, std::ios::binary);
+			for (size_t i = begin; i < end; ++i)
+			{
+				size_t cell = occupied[first + i];
+				std::vector<Point> points((size_t)(cellStart[cell + 1] - cellStart[cell]));
+				temporary.seekg((std::streamoff)(cellStart[cell] * sizeof(Point)));
+				temporary.read((char*)points.data(), (std::streamsize)(points.size() * sizeof(Point)));
+				if (!temporary)
+				{
+					readFailed = true;
+					return;
+				}
+
+				unsigned int x = (unsigned int)(cell % resolution);
+				unsigned int y = (unsigned int)((cell / resolution) % resolution);
+				unsigned int z = (unsigned int)(cell / ((size_t)resolution * resolution));
+				LocalNode root = LocalNode();
+				root.boundsMin = low + glm::vec3((float)x, (float)y, (float)z) * cellSize;
+				root.size = cellSize;
+				trees[i].nodes.push_back(root);
+				BuildLocalNode(trees[i], 0, points, 0, options);
+			}
+		});
+		if (readFailed)
+		{
+			std::cout << "ERROR::POINT OCTREE::FAILED TO READ FILE: " << temporaryPath << std::endl;
+			writer.file.close();
+			std::remove(temporaryPath.c_str());
+			return false;
+		}
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			size_t cell = occupied[first + i];
+			levelNodes[cell] = writer.addTree(trees[i], 0);
+			const LocalNode& root = trees[i].nodes[0];
+			GridSample(root.points, root.boundsMin, 2.0f * cellSize / (float)options.sampleGrid, carried[cell], nullptr);
+		}
+	}
+	std::remove(temporaryPath.c_str());
+
+	// levels above the cells, built from the subsamples carried up by their children
+	for (unsigned int levelResolution = resolution / 2; levelResolution >= 1; levelResolution /= 2)
+	{
+		unsigned int childResolution = levelResolution * 2;
+		float nodeSize = size / (float)levelResolution;
+		std::vector<uint32_t> parentNodes((size_t)levelResolution * levelResolution * levelResolution, NO_CHILD);
+		std::vector<std::vector<Point>> parentCarried(parentNodes.size());
+
+		for (size_t parent = 0; parent < parentNodes.size(); ++parent)
+		{
+			unsigned int x = (unsigned int)(parent % levelResolution);
+			unsigned int y = (unsigned int)((parent / levelResolution) % levelResolution);
+			unsigned int z = (unsigned int)(parent / ((size_t)levelResolution * levelResolution));
+
+			std::vector<Point> gathered;
+			uint32_t children[8];
+			bool any = false;
+			for (int octant = 0; octant < 8; ++octant)
+			{
+				size_t child = ((size_t)(z * 2 + (octant >> 2 & 1)) * childResolution + (y * 2 + (octant >> 1 & 1))) * childResolution + (x * 2 + (octant & 1));
+				children[octant] = levelNodes[child];
+				if (levelNodes[child] == NO_CHILD)
+					continue;
+				any = true;
+				gathered.insert(gathered.end(), carried[child].begin(), carried[child].end());
+				std::vector<Point>().swap(carried[child]);
+			}
+			if (!any)
+				continue;
+
+			glm::vec3 boundsMin = low + glm::vec3((float)x, (float)y, (float)z) * nodeSize;
+			float spacing = nodeSize / (float)options.sampleGrid;
+			std::vector<Point> kept;
+			GridSample(gathered, boundsMin, spacing, kept, nullptr);
+			uint32_t node = writer.addNode(boundsMin, nodeSize, spacing, kept);
+			for (int octant = 0; octant < 8; ++octant)
+				writer.nodes[node].children[octant] = children[octant];
+			parentNodes[parent] = node;
+			if (levelResolution > 1)
+				GridSample(kept, boundsMin, 2.0f * spacing, parentCarried[parent], nullptr);
+		}
+		levelNodes.swap(parentNodes);
+		carried.swap(parentCarried);
+	}
+	writer.file.endSection();
+
+	Header header;
+	header.rootNode = levelNodes[0];
+	header.nodeCount = (uint32_t)writer.nodes.size();
+	header.pointCount = writer.pointCount;
+	header.origin = reader.origin();
+	writer.file.addSection(MeshCache::TAG_POINT_HEADER, &header, sizeof(header));
+	writer.file.addSection(MeshCache::TAG_POINT_NODES, writer.nodes.data(), writer.nodes.size() * sizeof(Node));
+	if (!writer.file.close())
+		return false;
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "POINT OCTREE::" << inputCount << " POINTS, " << header.nodeCount << " NODES, "
+		<< header.pointCount << " STORED IN " << seconds << " s" << std::endl;
+	return true;
+}
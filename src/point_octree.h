@@ -0,0 +1,68 @@
+#ifndef POINT_OCTREE_H
+#define POINT_OCTREE_H
+
+#include <cstdint>
+#include <string>
+#include <glm.hpp>
+#include "point_cloud.h"
+
+/*!
+ * Hierarchical on disk layout of a point cloud
+ *
+ * Stored in the native cache format: a header, the node table and one
+ * section holding the points of every node back to back. Nodes are cubes,
+ * each keeps a grid subsample of its points and passes the rest to its
+ * children, so drawing a node and any subset of its descendants gives a
+ * denser version of the same cloud (additive levels of detail).
+ */
+namespace PointOctree
+{
+	const uint32_t NO_CHILD = 0xFFFFFFFFu;
+
+	struct Header
+	{
+		uint32_t rootNode;
+		uint32_t nodeCount;
+		uint64_t pointCount;   // stored points, a bit above the input count, see Build
+		glm::dvec3 origin;     // to add to positions to get the input coordinates
+	};
+
+	struct Node
+	{
+		glm::vec3 boundsMin;
+		float size;            // edge of the cube
+		uint64_t firstPoint;   // index in the TAG_POINTS section
+		uint32_t pointCount;
+		float spacing;         // distance between neighbouring points of the node
+		uint32_t children[8];  // NO_CHILD when empty
+	};
+
+	struct Options
+	{
+		// the cube is split in (2^gridLevels)^3 cells built independently in memory
+		unsigned int gridLevels = 4;
+		unsigned int maxLeafPoints = 20000;
+		// one point per cell of a sampleGrid^3 grid is kept by interior nodes
+		unsigned int sampleGrid = 128;
+		size_t batchPoints = 1 << 20;
+	};
+
+	/*!
+	 * Build the octree of a point cloud file out of core
+	 *
+	 * The input is read three times: bounds, counts per cell, then points are
+	 * partitioned by cell into a temporary file. Cells are turned into
+	 * subtrees in parallel on the job system, only a batch of cells is in
+	 * memory at a time. The levels above the cells are built from subsamples
+	 * of their children and duplicate those points, the extra storage depends
+	 * on the sample grid only and becomes small next to inputs of billions of
+	 * points, in exchange the cells are never revisited.
+	 *
+	 * \param input : .ply, .xyz or .las file read with PointReader
+	 * \param output : path of the cache file, a .tmp file is used next to it
+	 * \param options : cell and node sizes
+	 * \return : false(bool) if the input can not be read or the output written
+	 */
+	bool Build(const std::string& input, const std::string& output, const Options& options = Options());
+}
+#endif
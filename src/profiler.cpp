@@ -0,0 +1,109 @@
+#include "profiler.h"
+#include <cstring>
+#include <iomanip>
+
+
+Profiler::Profiler()
+	: m_WindowFrames(0), m_FrameCount(0)
+{
+}
+
+
+void Profiler::beginFrame()
+{
+	m_FrameStart = std::chrono::high_resolution_clock::now();
+}
+
+
+void Profiler::endFrame()
+{
+	std::chrono::duration<double, std::milli> frameTime = std::chrono::high_resolution_clock::now() - m_FrameStart;
+	addCounter("FRAME CPU ms", frameTime.count());
+
+	for (Counter& counter : m_Counters)
+	{
+		counter.last = counter.frame;
+		counter.window += counter.frame;
+		counter.frame = 0.0;
+	}
+	++m_WindowFrames;
+	++m_FrameCount;
+}
+
+
+void Profiler::addCounter(const char* name, double value)
+{
+	FindCounter(name).frame += value;
+}
+
+
+double Profiler::average(const char* name) const
+{
+	const Counter* counter = FindCounter(name);
+	if (!counter || m_WindowFrames == 0)
+		return 0.0;
+	return counter->window / m_WindowFrames;
+}
+
+
+double Profiler::last(const char* name) const
+{
+	const Counter* counter = FindCounter(name);
+	return counter ? counter->last : 0.0;
+}
+
+
+void Profiler::report(std::ostream& out)
+{
+	out << " -- PROFILER: AVERAGE OF " << m_WindowFrames << " FRAMES -- " << std::endl;
+	for (Counter& counter : m_Counters)
+	{
+		double value = m_WindowFrames ? counter.window / m_WindowFrames : 0.0;
+		out << std::setw(32) << std::left << counter.name << std::fixed << std::setprecision(3) << value << std::endl;
+		counter.window = 0.0;
+	}
+	m_WindowFrames = 0;
+}
+
+
+unsigned int Profiler::frameCount() const
+{
+	return m_FrameCount;
+}
+
+
+Profiler& Profiler::instance()
+{
+	static Profiler profiler;
+	return profiler;
+}
+
+
+Profiler::Counter& Profiler::FindCounter(const char* name)
+{
+	// a handful of counters, a linear scan beats hashing a temporary string
+	for (Counter& counter : m_Counters)
+	{
+		if (strcmp(counter.name.c_str(), name) == 0)
+			return counter;
+	}
+
+	Counter counter;
+	counter.name = name;
+	counter.frame = 0.0;
+	counter.last = 0.0;
+	counter.window = 0.0;
+	m_Counters.push_back(counter);
+	return m_Counters.back();
+}
+
+
+const Profiler::Counter* Profiler::FindCounter(const char* name) const
+{
+	for (const Counter& counter : m_Counters)
+	{
+		if (strcmp(counter.name.c_str(), name) == 0)
+			return &counter;
+	}
+	return nullptr;
+}
@@ -0,0 +1,86 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*!
+ * Per frame counters and timings
+ *
+ * Values added during a frame are summed, endFrame folds them into a window
+ * of frames so report prints per frame averages. Counters are looked up by
+ * name without allocating, so profiling itself stays off the heap.
+ */
+class Profiler
+{
+public:
+	Profiler();
+
+	/*!
+	 * Start timing a frame
+	 *
+	 */
+	void beginFrame();
+
+	/*!
+	 * Close the frame, its CPU time is recorded as "FRAME CPU ms"
+	 *
+	 */
+	void endFrame();
+
+	/*!
+	 * Add to a counter of the current frame
+	 *
+	 * \param name : counter name, created on first use
+	 * \param value : amount to add
+	 */
+	void addCounter(const char* name, double value);
+
+	/*!
+	 * Average per frame of a counter over the current window
+	 *
+	 * \return : 0 if the counter is unknown or no frame was recorded yet
+	 */
+	double average(const char* name) const;
+
+	/*!
+	 * Value of a counter in the last finished frame
+	 *
+	 */
+	double last(const char* name) const;
+
+	/*!
+	 * Print per frame averages and start a new window
+	 *
+	 */
+	void report(std::ostream& out);
+
+	unsigned int frameCount() const;
+
+	/*!
+	 * Process wide profiler
+	 *
+	 */
+	static Profiler& instance();
+
+private:
+
+	struct Counter
+	{
+		std::string name;
+		double frame;
+		double last;
+		double window;
+	};
+
+	std::vector<Counter> m_Counters;
+	unsigned int m_WindowFrames;
+	unsigned int m_FrameCount;
+	std::chrono::high_resolution_clock::time_point m_FrameStart;
+
+	Counter& FindCounter(const char* name);
+	const Counter* FindCounter(const char* name) const;
+};
+#endif
@@ -0,0 +1,250 @@
+#include "progressive_refinement.h"
+#include <algorithm>
+#include <iostream>
+#include "gl_state_cache.h"
+
+
+namespace
+{
+	// low discrepancy sequence for the subpixel offsets, index from 1
+	float Halton(unsigned int index, unsigned int base)
+	{
+		float result = 0.0f;
+		float fraction = 1.0f / (float)base;
+		while (index > 0)
+		{
+			result += (float)(index % base) * fraction;
+			index /= base;
+			fraction /= (float)base;
+		}
+		return result;
+	}
+}
+
+
+ProgressiveRefinement::ProgressiveRefinement()
+	: ProgressiveRefinement(Options())
+{
+}
+
+ProgressiveRefinement::ProgressiveRefinement(const Options& options)
+	: m_Options(options), m_LastInteraction(0.0), m_Restart(true), m_Frame(0), m_WindowSize(0), m_RenderSize(1)
+{
+	m_Options.movingScale = glm::clamp(m_Options.movingScale, 0.1f, 1.0f);
+	m_Options.maxSamples = std::max(m_Options.maxSamples, 1u);
+	m_Vao = GpuResources::instance().createVertexArray();
+}
+
+ProgressiveRefinement::~ProgressiveRefinement()
+{
+	ReleaseTargets();
+	GpuResources::instance().release(m_Vao);
+}
+
+
+void ProgressiveRefinement::interact(double time)
+{
+	m_LastInteraction = std::max(m_LastInteraction, time);
+}
+
+
+bool ProgressiveRefinement::beginFrame(const glm::uvec2& windowSize, double time)
+{
+	glm::uvec2 size = glm::max(windowSize, glm::uvec2(1));
+	if (size != m_WindowSize)
+	{
+		Resize(size);
+		m_Restart = true;
+	}
+
+	// the first still frame replaces the reduced ones
+	bool wasMoving = m_Stats.moving;
+	m_Stats.moving = time - m_LastInteraction < m_Options.idleDelay;
+	if (wasMoving && !m_Stats.moving)
+		m_Restart = true;
+	m_Stats.converged = !m_Stats.moving && !m_Restart && m_Stats.samples >= m_Options.maxSamples;
+	if (m_Stats.converged)
+	{
+		// nothing new to draw, the window still wants a frame
+		Present();
+		++m_Stats.skippedFrames;
+		return false;
+	}
+
+	m_RenderSize = m_Stats.moving ? glm::max(glm::uvec2(glm::vec2(m_WindowSize) * m_Options.movingScale + 0.5f), glm::uvec2(1)) : m_WindowSize;
+	GLStateCache& state = GLStateCache::instance();
+	state.bindFramebuffer(GL_FRAMEBUFFER, GpuResources::instance().name(m_SceneFramebuffer));
+	state.viewport(0, 0, (GLsizei)m_RenderSize.x, (GLsizei)m_RenderSize.y);
+	state.depthMask(GL_TRUE);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	++m_Frame;
+	return true;
+}
+
+
+void ProgressiveRefinement::contentChanged()
+{
+	m_Restart = true;
+}
+
+
+glm::mat4 ProgressiveRefinement::jitter(const glm::mat4& projection) const
+{
+	if (m_Stats.moving)
+		return projection;
+
+	// offset in pixels within [-0.5, 0.5], the first sample is the pixel center
+	unsigned int sample = m_Restart ? 0 : m_Stats.samples;
+	glm::vec2 offset(0.0f);
+	if (sample > 0)
+		offset = glm::vec2(Halton(sample, 2), Halton(sample, 3)) - 0.5f;
+
+	glm::mat4 jittered = projection;
+	jittered[2][0] += offset.x * 2.0f / (float)m_RenderSize.x;
+	jittered[2][1] += offset.y * 2.0f / (float)m_RenderSize.y;
+	return jittered;
+}
+
+
+float ProgressiveRefinement::lodScale() const
+{
+	return m_Stats.moving ? m_Options.movingLodScale : m_Options.idleLodScale;
+}
+
+
+glm::uvec2 ProgressiveRefinement::renderSize() const
+{
+	return m_RenderSize;
+}
+
+
+GLuint ProgressiveRefinement::framebuffer() const
+{
+	return GpuResources::instance().name(m_SceneFramebuffer);
+}
+
+
+void ProgressiveRefinement::endFrame(Shader& shader, float nearPlane, float farPlane)
+{
+	// a moving frame or a restart replaces the average, the others add to it
+	bool replace = m_Stats.moving || m_Restart;
+	unsigned int sample = replace ? 0 : m_Stats.samples;
+	if (replace && m_Stats.samples > 1)
+		++m_Stats.restarts;
+
+	GpuResources& resources = GpuResources::instance();
+	GLStateCache& state = GLStateCache::instance();
+	state.bindFramebuffer(GL_FRAMEBUFFER, resources.name(m_AccumulationFramebuffer));
+	state.viewport(0, 0, (GLsizei)m_WindowSize.x, (GLsizei)m_WindowSize.y);
+	state.setEnabled(GL_DEPTH_TEST, false);
+	state.setEnabled(GL_CULL_FACE, false);
+	state.setEnabled(GL_BLEND, true);
+	state.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	shader.use();
+	shader.setInt("sceneColor", 0);
+	shader.setInt("sceneDepth", 1);
+	shader.setVec2("sourceScale", glm::vec2(m_RenderSize) / glm::vec2(m_WindowSize));
+	shader.setVec2("sourceTexel", 1.0f / glm::vec2(m_WindowSize));
+	shader.setFloat("weight", 1.0f / (float)(sample + 1));
+	shader.setFloat("aoStrength", m_Stats.moving ? 0.0f : 1.0f);
+	shader.setInt("aoSamples", (int)m_Options.aoSamples);
+	shader.setFloat("aoRadius", m_Options.aoRadius);
+	shader.setFloat("aoAngle", (float)sample * 0.7548777f * 6.2831853f);
+	shader.setFloat("nearPlane", nearPlane);
+	shader.setFloat("farPlane", farPlane);
+	state.bindTexture(0, GL_TEXTURE_2D, resources.name(m_Color));
+	state.bindTexture(1, GL_TEXTURE_2D, resources.name(m_Depth));
+	state.bindVertexArray(resources.name(m_Vao));
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	state.setEnabled(GL_BLEND, false);
+	state.setEnabled(GL_CULL_FACE, true);
+	state.setEnabled(GL_DEPTH_TEST, true);
+
+	m_Stats.samples = sample + 1;
+	m_Restart = false;
+	Present();
+}
+
+
+const ProgressiveStats& ProgressiveRefinement::stats() const
+{
+	return m_Stats;
+}
+
+
+void ProgressiveRefinement::reportTo(Profiler& profiler) const
+{
+	profiler.addCounter("PROGRESSIVE MOVING", m_Stats.moving ? 1.0 : 0.0);
+	profiler.addCounter("PROGRESSIVE SAMPLES", (double)m_Stats.samples);
+	profiler.addCounter("PROGRESSIVE RESTARTS", (double)m_Stats.restarts);
+	profiler.addCounter("PROGRESSIVE SKIPPED FRAMES", (double)m_Stats.skippedFrames);
+}
+
+
+void ProgressiveRefinement::Present()
+{
+	GLStateCache& state = GLStateCache::instance();
+	state.bindFramebuffer(GL_READ_FRAMEBUFFER, GpuResources::instance().name(m_AccumulationFramebuffer));
+	state.bindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, (GLint)m_WindowSize.x, (GLint)m_WindowSize.y,
+		0, 0, (GLint)m_WindowSize.x, (GLint)m_WindowSize.y, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	state.bindFramebuffer(GL_FRAMEBUFFER, 0);
+	state.viewport(0, 0, (GLsizei)m_WindowSize.x, (GLsizei)m_WindowSize.y);
+}
+
+
+void ProgressiveRefinement::Resize(const glm::uvec2& size)
+{
+	ReleaseTargets();
+	m_WindowSize = size;
+
+	GpuResources& resources = GpuResources::instance();
+	GLStateCache& state = GLStateCache::instance();
+	GLenum formats[] = { GL_RGBA8, GL_DEPTH24_STENCIL8, GL_RGBA16F };
+	GpuHandle* textures[] = { &m_Color, &m_Depth, &m_Accumulation };
+	uint64_t bytes[] = { 4, 4, 8 };
+	for (int i = 0; i < 3; ++i)
+	{
+		// the depth is read texel by texel for the occlusion
+		GLint filter = i == 1 ? GL_NEAREST : GL_LINEAR;
+		*textures[i] = resources.createTexture(GL_TEXTURE_2D);
+		glTexStorage2D(GL_TEXTURE_2D, 1, formats[i], (GLsizei)size.x, (GLsizei)size.y);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		resources.setTextureBytes(*textures[i], (uint64_t)size.x * size.y * bytes[i]);
+	}
+
+	m_SceneFramebuffer = resources.createFramebuffer();
+	state.bindFramebuffer(GL_FRAMEBUFFER, resources.name(m_SceneFramebuffer));
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, resources.name(m_Color), 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, resources.name(m_Depth), 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "ERROR::PROGRESSIVE REFINEMENT::INCOMPLETE SCENE FRAMEBUFFER" << std::endl;
+
+	m_AccumulationFramebuffer = resources.createFramebuffer();
+	state.bindFramebuffer(GL_FRAMEBUFFER, resources.name(m_AccumulationFramebuffer));
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, resources.name(m_Accumulation), 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "ERROR::PROGRESSIVE REFINEMENT::INCOMPLETE ACCUMULATION FRAMEBUFFER" << std::endl;
+	state.bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+
+void ProgressiveRefinement::ReleaseTargets()
+{
+	GpuResources& resources = GpuResources::instance();
+	resources.release(m_SceneFramebuffer);
+	resources.release(m_AccumulationFramebuffer);
+	resources.release(m_Color);
+	resources.release(m_Depth);
+	resources.release(m_Accumulation);
+	m_SceneFramebuffer = GpuHandle();
+	m_AccumulationFramebuffer = GpuHandle();
+	m_Color = GpuHandle();
+	m_Depth = GpuHandle();
+	m_Accumulation = GpuHandle();
+}
@@ -0,0 +1,139 @@
+#ifndef PROGRESSIVE_REFINEMENT_H
+#define PROGRESSIVE_REFINEMENT_H
+
+#include <glm.hpp>
+#include <glew.h>
+#include "gpu_resources.h"
+#include "profiler.h"
+#include "shader.h"
+
+/*!
+ * Counters of ProgressiveRefinement
+ *
+ */
+struct ProgressiveStats
+{
+	bool moving = false;
+	bool converged = false;
+	unsigned int samples = 0;       // frames in the accumulated image
+	unsigned int restarts = 0;      // accumulations restarted since the start
+	unsigned int skippedFrames = 0; // converged frames that only presented the image
+};
+
+/*!
+ * Quality ladder following the camera interaction
+ *
+ * While the camera moves, frames are drawn at a reduced scale with coarse
+ * levels of detail and no ambient occlusion, then upscaled. Once it has
+ * been still for a moment, every frame is drawn at full resolution with
+ * finer levels of detail and a subpixel jitter of the projection, and is
+ * blended into a running average along with a few ambient occlusion
+ * samples rotated every frame. Anti-aliasing and occlusion thus converge
+ * together. After maxSamples frames the image is complete: the scene is
+ * no longer drawn and the average is only presented again. Any camera
+ * move or streamed data still on its way restarts the accumulation.
+ */
+class ProgressiveRefinement
+{
+public:
+	struct Options
+	{
+		double idleDelay = 0.15;        // seconds without interaction before refining
+		float movingScale = 0.5f;       // render scale while moving
+		float movingLodScale = 0.5f;    // pixel scale given to level of detail selection while moving
+		float idleLodScale = 2.0f;      // and while refining
+		unsigned int maxSamples = 16;
+		unsigned int aoSamples = 6;     // per frame
+		float aoRadius = 16.0f;         // pixels at full resolution
+	};
+
+	ProgressiveRefinement();
+	explicit ProgressiveRefinement(const Options& options);
+	~ProgressiveRefinement();
+
+	ProgressiveRefinement(const ProgressiveRefinement&) = delete;
+	ProgressiveRefinement& operator=(const ProgressiveRefinement&) = delete;
+
+	/*!
+	 * The camera moved, called from the input callbacks
+	 *
+	 * \param time : glfwGetTime of the interaction
+	 */
+	void interact(double time);
+
+	/*!
+	 * Pick the quality of the frame, bind and clear the scene target unless converged
+	 *
+	 * \param windowSize : framebuffer size of the window in pixels
+	 * \param time : glfwGetTime of the frame
+	 * \return : false(bool) if the image is complete and the scene does not need to be drawn
+	 */
+	bool beginFrame(const glm::uvec2& windowSize, double time);
+
+	/*!
+	 * Streamed data arrived or is on its way, what was accumulated is outdated
+	 *
+	 */
+	void contentChanged();
+
+	/*!
+	 * Projection with the subpixel offset of the frame, unchanged while moving
+	 *
+	 */
+	glm::mat4 jitter(const glm::mat4& projection) const;
+
+	/*!
+	 * Scale of the pixel sizes given to level of detail selection
+	 *
+	 */
+	float lodScale() const;
+
+	glm::uvec2 renderSize() const;
+
+	/*!
+	 * Scene framebuffer, for passes that copy into the current target
+	 *
+	 */
+	GLuint framebuffer() const;
+
+	/*!
+	 * Blend the frame into the accumulated image and present it, the default framebuffer is bound after
+	 *
+	 * \param shader : program of res/vertex_fullscreen.glsl and res/fragment_accumulate.glsl
+	 * \param nearPlane : near plane of the projection, to linearize the depth
+	 * \param farPlane : far plane of the projection
+	 */
+	void endFrame(Shader& shader, float nearPlane, float farPlane);
+
+	const ProgressiveStats& stats() const;
+
+	void reportTo(Profiler& profiler) const;
+
+private:
+
+	Options m_Options;
+	double m_LastInteraction;
+	bool m_Restart;
+	unsigned int m_Frame;           // frames since the start, seeds the jitter and the occlusion
+	glm::uvec2 m_WindowSize;
+	glm::uvec2 m_RenderSize;
+	ProgressiveStats m_Stats;
+
+	GpuHandle m_Color;
+	GpuHandle m_Depth;
+	GpuHandle m_Accumulation;       // RGBA16F running average
+	GpuHandle m_Vao;                // empty, the full screen triangle comes from gl_VertexID
+	GpuHandle m_SceneFramebuffer;
+	GpuHandle m_AccumulationFramebuffer;
+
+	/*!
+	 * Copy the accumulated image to the window
+	 *
+	 */
+	void Present();
+
+	void Resize(const glm::uvec2& size);
+
+	void ReleaseTargets();
+};
+#endif
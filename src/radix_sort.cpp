@@ -0,0 +1,75 @@
+#include "radix_sort.h"
+#include <algorithm>
+
+namespace
+{
+	const unsigned int RADIX = 256;
+
+	// below this the threading overhead is higher than the sort itself
+	const size_t MIN_ENTRIES_PER_JOB = 16384;
+
+	// the scatter is bound by memory bandwidth long before, and the histograms fit on the stack
+	const size_t MAX_JOBS = 16;
+}
+
+
+void RadixSort(std::vector<SortEntry>& entries, std::vector<SortEntry>& scratch, JobSystem& jobs)
+{
+	size_t count = entries.size();
+	if (count < 2)
+		return;
+	scratch.resize(count);
+
+	size_t jobCount = std::min<size_t>(std::min<size_t>(jobs.concurrency(), MAX_JOBS), (count + MIN_ENTRIES_PER_JOB - 1) / MIN_ENTRIES_PER_JOB);
+	if (jobCount == 0)
+		jobCount = 1;
+	size_t grainSize = (count + jobCount - 1) / jobCount;
+
+	size_t histograms[MAX_JOBS * RADIX];
+	SortEntry* source = entries.data();
+	SortEntry* destination = scratch.data();
+
+	for (unsigned int shift = 0; shift < 64; shift += 8)
+	{
+		std::fill(histograms, histograms + jobCount * RADIX, 0);
+		jobs.parallelFor(count, grainSize, [&](size_t begin, size_t end)
+		{
+			size_t* histogram = &histograms[(begin / grainSize) * RADIX];
+			for (size_t i = begin; i < end; ++i)
+				++histogram[(source[i].key >> shift) & (RADIX - 1)];
+		});
+
+		// every key shares this digit, nothing would move
+		size_t firstDigitCount = 0;
+		for (unsigned int digit = 0; digit < RADIX && firstDigitCount == 0; ++digit)
+		{
+			for (size_t job = 0; job < jobCount; ++job)
+				firstDigitCount += histograms[job * RADIX + digit];
+		}
+		if (firstDigitCount == count)
+			continue;
+
+		// offsets ordered by digit first, then by job to stay stable
+		size_t offset = 0;
+		for (unsigned int digit = 0; digit < RADIX; ++digit)
+		{
+			for (size_t job = 0; job < jobCount; ++job)
+			{
+				size_t digitCount = histograms[job * RADIX + digit];
+				histograms[job * RADIX + digit] = offset;
+				offset += digitCount;
+			}
+		}
+
+		jobs.parallelFor(count, grainSize, [&](size_t begin, size_t end)
+		{
+			size_t* offsets = &histograms[(begin / grainSize) * RADIX];
+			for (size_t i = begin; i < end; ++i)
+				destination[offsets[(source[i].key >> shift) & (RADIX - 1)]++] = source[i];
+		});
+		std::swap(source, destination);
+	}
+
+	if (source != entries.data())
+		entries.swap(scratch);
+}
@@ -0,0 +1,30 @@
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <cstdint>
+#include <vector>
+#include "job_system.h"
+
+/*!
+ * 64 bit key with the index of the item it sorts
+ *
+ */
+struct SortEntry
+{
+	uint64_t key;
+	uint32_t index;
+};
+
+/*!
+ * Stable LSD radix sort of entries by key, 8 bits per pass
+ *
+ * Each pass builds per job histograms in parallel, then scatters in parallel
+ * to offsets obtained by a prefix sum over jobs. Passes where every key has
+ * the same digit are skipped, so keys using few bits sort quickly.
+ *
+ * \param entries : sorted in place
+ * \param scratch : temporary storage, resized as needed, keep it around between calls
+ * \param jobs : pool running the passes
+ */
+void RadixSort(std::vector<SortEntry>& entries, std::vector<SortEntry>& scratch, JobSystem& jobs);
+#endif
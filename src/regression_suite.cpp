@@ -0,0 +1,364 @@
+#include "regression_suite.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include "gl_state_cache.h"
+
+namespace
+{
+	// value following "key": on a line written by WriteBaseline
+	bool FindField(const std::string& line, const std::string& key, std::string& value)
+	{
+		std::string pattern = "\"" + key + "\": ";
+		size_t start = line.find(pattern);
+		if (start == std::string::npos)
+			return false;
+		start += pattern.size();
+		if (start < line.size() && line[start] == '"')
+		{
+			size_t end = line.find('"', start + 1);
+			if (end == std::string::npos)
+				return false;
+			value = line.substr(start + 1, end - start - 1);
+			return true;
+		}
+		size_t end = line.find_first_of(",}", start);
+		value = line.substr(start, end == std::string::npos ? std::string::npos : end - start);
+		return true;
+	}
+
+	std::string WithSlash(const std::string& directory)
+	{
+		if (directory.empty() || directory.back() == '/' || directory.back() == '\\')
+			return directory;
+		return directory + '/';
+	}
+
+	void Fail(RegressionResult& result, const char* reason)
+	{
+		result.status = "FAILED";
+		result.reason += (result.reason.empty() ? "" : ", ") + std::string(reason);
+	}
+}
+
+
+std::vector<RegressionScene> RegressionSuite::DefaultScenes()
+{
+	// forward with and without the pre-pass and deferred share a view, their images should agree
+	return {
+		{ "city_forward", 30.0f, 25.0f, false, false, 2.0f },
+		{ "city_prepass", 30.0f, 25.0f, false, true, 2.0f },
+		{ "city_deferred", 30.0f, 25.0f, true, false, 2.0f },
+		{ "city_above", 120.0f, 70.0f, false, false, 5.0f },
+		{ "city_grazing", -60.0f, 8.0f, true, false, 8.0f } };
+}
+
+
+RegressionSuite::RegressionSuite(const std::string& directory, const std::vector<RegressionScene>& scenes)
+	: RegressionSuite(directory, scenes, Options())
+{
+}
+
+RegressionSuite::RegressionSuite(const std::string& directory, const std::vector<RegressionScene>& scenes, const Options& options)
+	: m_Directory(directory), m_Scenes(scenes), m_Options(options), m_Scene(0), m_Frame(0), m_Timed(0), m_GpuSamples(0),
+	m_CpuTotal(0.0), m_GpuTotal(0.0), m_GpuCount(0)
+{
+	m_Directory = WithSlash(m_Directory);
+	m_OutputDirectory = m_Options.outputDirectory.empty() ? m_Directory : WithSlash(m_Options.outputDirectory);
+	if (m_Scenes.empty())
+		m_Scenes = DefaultScenes();
+	m_Options.size = glm::max(m_Options.size, glm::uvec2(1));
+	m_Options.timedFrames = std::max(1u, m_Options.timedFrames);
+	if (!m_Options.record)
+		ReadBaseline();
+}
+
+RegressionSuite::~RegressionSuite()
+{
+	ReleaseTarget();
+}
+
+
+glm::uvec2 RegressionSuite::beginFrame()
+{
+	if (!GpuResources::instance().isValid(m_Framebuffer))
+		CreateTarget();
+
+	m_FrameStart = std::chrono::high_resolution_clock::now();
+	GLStateCache& state = GLStateCache::instance();
+	state.bindFramebuffer(GL_FRAMEBUFFER, GpuResources::instance().name(m_Framebuffer));
+	state.viewport(0, 0, (GLsizei)m_Options.size.x, (GLsizei)m_Options.size.y);
+	state.depthMask(GL_TRUE);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	m_Timer.begin();
+	return m_Options.size;
+}
+
+
+bool RegressionSuite::endFrame(bool settled)
+{
+	if (m_Scene >= m_Scenes.size())
+		return false;
+
+	m_Timer.end();
+	std::chrono::duration<double, std::milli> frameTime = std::chrono::high_resolution_clock::now() - m_FrameStart;
+	++m_Frame;
+
+	// timing starts once warm and settled, or after waiting too long for the streamed data
+	bool warm = m_Frame >= m_Options.warmupFrames && (settled || m_Frame >= m_Options.maxWarmupFrames);
+	if (m_Timed > 0 || warm)
+	{
+		if (m_Timed == 0)
+			m_GpuSamples = m_Timer.sampleCount();
+		else if (m_Timer.sampleCount() != m_GpuSamples)
+		{
+			// the timer lags a few frames, the first samples still come from the warm up of the same scene
+			m_GpuSamples = m_Timer.sampleCount();
+			m_GpuTotal += m_Timer.milliseconds();
+			++m_GpuCount;
+		}
+		++m_Timed;
+		m_CpuTotal += frameTime.count();
+		if (m_Results.size() <= m_Scene)
+			m_Results.resize(m_Scene + 1);
+		m_Results[m_Scene].maxCpuMs = std::max(m_Results[m_Scene].maxCpuMs, frameTime.count());
+	}
+
+	// the frame is still shown, the window may be visible
+	GLStateCache& state = GLStateCache::instance();
+	GLint width = (GLint)m_Options.size.x, height = (GLint)m_Options.size.y;
+	state.bindFramebuffer(GL_READ_FRAMEBUFFER, GpuResources::instance().name(m_Framebuffer));
+	state.bindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+	if (m_Timed >= m_Options.timedFrames)
+		FinishScene(settled);
+	state.bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (m_Scene < m_Scenes.size())
+		return true;
+	WriteResults();
+	if (m_Options.record)
+		WriteBaseline();
+	return false;
+}
+
+
+const RegressionScene& RegressionSuite::scene() const
+{
+	return m_Scenes[std::min(m_Scene, (unsigned int)m_Scenes.size() - 1)];
+}
+
+
+GLuint RegressionSuite::framebuffer() const
+{
+	return GpuResources::instance().name(m_Framebuffer);
+}
+
+
+bool RegressionSuite::passed() const
+{
+	for (const RegressionResult& result : m_Results)
+	{
+		if (result.status == "FAILED")
+			return false;
+	}
+	return true;
+}
+
+
+void RegressionSuite::report(std::ostream& out) const
+{
+	out << " -- REGRESSION: " << m_Results.size() << " SCENES AT " << m_Options.size.x << "x" << m_Options.size.y << " -- " << std::endl;
+	for (const RegressionResult& result : m_Results)
+	{
+		out << std::setw(20) << std::left << result.name << std::setw(10) << result.status << std::fixed << std::setprecision(3)
+			<< "DIFFERENT " << result.diff.differentFraction * 100.0f << "%  MEAN DE " << result.diff.meanDeltaE
+			<< "  CPU MS " << result.cpuMs << "  GPU MS " << result.gpuMs;
+		if (result.baselineCpuMs > 0.0)
+			out << "  BASELINE " << result.baselineCpuMs << " / " << result.baselineGpuMs;
+		out << (result.settled ? "" : "  NOT SETTLED") << (result.reason.empty() ? "" : "  " + result.reason) << std::endl;
+	}
+}
+
+
+void RegressionSuite::FinishScene(bool settled)
+{
+	const RegressionScene& scene = m_Scenes[m_Scene];
+	RegressionResult& result = m_Results[m_Scene];
+	result.name = scene.name;
+	result.settled = settled;
+	result.timedFrames = m_Timed;
+	result.cpuMs = m_CpuTotal / m_Timed;
+	result.gpuMs = m_GpuCount > 0 ? m_GpuTotal / m_GpuCount : 0.0;
+
+	// tightly packed rows, flipped to top first
+	RgbImage image;
+	image.size = m_Options.size;
+	image.pixels.resize((size_t)image.size.x * image.size.y * 3);
+	std::vector<unsigned char> rows(image.pixels.size());
+	GLStateCache::instance().bindFramebuffer(GL_READ_FRAMEBUFFER, GpuResources::instance().name(m_Framebuffer));
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, (GLsizei)image.size.x, (GLsizei)image.size.y, GL_RGB, GL_UNSIGNED_BYTE, rows.data());
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	size_t stride = (size_t)image.size.x * 3;
+	for (size_t y = 0; y < image.size.y; ++y)
+		std::copy(rows.begin() + (image.size.y - 1 - y) * stride, rows.begin() + (image.size.y - y) * stride, image.pixels.begin() + y * stride);
+
+	// a missing reference is a failure, references only come from a run in record mode
+	std::string referencePath = m_Directory + scene.name + ".ppm";
+	RgbImage reference;
+	result.status = "PASSED";
+	if (m_Options.record)
+	{
+		result.status = "RECORDED";
+		if (!ImageDiff::WritePpm(referencePath, image))
+			Fail(result, "UNABLE TO WRITE");
+	}
+	else if (!ImageDiff::ReadPpm(referencePath, reference))
+	{
+		std::cout << "ERROR::REGRESSION::NO REFERENCE: " << referencePath << ", RECORD ONE WITH OPENGLVIEWER_REGRESSION_RECORD" << std::endl;
+		Fail(result, "NO REFERENCE");
+	}
+	else
+	{
+		RgbImage heatmap;
+		result.diff = ImageDiff::Compare(image, reference, m_Options.threshold, &heatmap);
+		if (!result.diff.sameSize || result.diff.differentFraction > m_Options.maxDifferentFraction)
+		{
+			Fail(result, "IMAGE");
+			ImageDiff::WritePpm(m_OutputDirectory + scene.name + "_actual.ppm", image);
+			if (result.diff.sameSize)
+				ImageDiff::WritePpm(m_OutputDirectory + scene.name + "_diff.ppm", heatmap);
+		}
+	}
+	if (!m_Options.record)
+		CompareTimings(result);
+	std::cout << "REGRESSION::" << scene.name << "::" << result.status << std::endl;
+
+	++m_Scene;
+	m_Frame = 0;
+	m_Timed = 0;
+	m_CpuTotal = 0.0;
+	m_GpuTotal = 0.0;
+	m_GpuCount = 0;
+}
+
+
+void RegressionSuite::WriteResults() const
+{
+	std::ofstream file(m_OutputDirectory + "results.json", std::ios::trunc);
+	file << "{\n\t\"width\": " << m_Options.size.x << ",\n\t\"height\": " << m_Options.size.y << ",\n\t\"scenes\": [\n";
+	file << std::fixed << std::setprecision(4);
+	for (size_t i = 0; i < m_Results.size(); ++i)
+	{
+		const RegressionResult& result = m_Results[i];
+		file << "\t\t{ \"name\": \"" << result.name << "\", \"status\": \"" << result.status << "\", \"reason\": \"" << result.reason << "\", \"settled\": " << (result.settled ? "true" : "false")
+			<< ", \"differentFraction\": " << result.diff.differentFraction << ", \"meanDeltaE\": " << result.diff.meanDeltaE
+			<< ", \"maxDeltaE\": " << result.diff.maxDeltaE << ", \"frames\": " << result.timedFrames
+			<< ", \"cpuMs\": " << result.cpuMs << ", \"maxCpuMs\": " << result.maxCpuMs << ", \"gpuMs\": " << result.gpuMs
+			<< ", \"baselineCpuMs\": " << result.baselineCpuMs << ", \"baselineGpuMs\": " << result.baselineGpuMs << " }"
+			<< (i + 1 < m_Results.size() ? "," : "") << "\n";
+	}
+	file << "\t]\n}\n";
+	if (!file)
+		std::cout << "ERROR::REGRESSION::UNABLE TO WRITE: " << m_OutputDirectory << "results.json" << std::endl;
+}
+
+
+void RegressionSuite::CompareTimings(RegressionResult& result) const
+{
+	auto baseline = std::find_if(m_Baseline.begin(), m_Baseline.end(), [&result](const RegressionResult& scene)
+	{
+		return scene.name == result.name;
+	});
+	if (baseline == m_Baseline.end())
+	{
+		std::cout << "ERROR::REGRESSION::NO BASELINE: " << result.name << " IN " << m_OutputDirectory << "baseline.json" << std::endl;
+		Fail(result, "NO BASELINE");
+		return;
+	}
+
+	result.baselineCpuMs = baseline->cpuMs;
+	result.baselineGpuMs = baseline->gpuMs;
+	double scale = 1.0 + m_Options.timingTolerance;
+	if (result.cpuMs > baseline->cpuMs * scale + m_Options.timingSlackMs)
+		Fail(result, "CPU TIME");
+	// no GPU time when the timer queries never returned
+	if (result.gpuMs > 0.0 && baseline->gpuMs > 0.0 && result.gpuMs > baseline->gpuMs * scale + m_Options.timingSlackMs)
+		Fail(result, "GPU TIME");
+}
+
+
+void RegressionSuite::ReadBaseline()
+{
+	std::ifstream file(m_OutputDirectory + "baseline.json");
+	std::string line, value;
+	while (std::getline(file, line))
+	{
+		RegressionResult scene;
+		if (!FindField(line, "name", scene.name) || !FindField(line, "cpuMs", value))
+			continue;
+		scene.cpuMs = std::atof(value.c_str());
+		if (FindField(line, "gpuMs", value))
+			scene.gpuMs = std::atof(value.c_str());
+		m_Baseline.push_back(scene);
+	}
+}
+
+
+void RegressionSuite::WriteBaseline() const
+{
+	std::ofstream file(m_OutputDirectory + "baseline.json", std::ios::trunc);
+	file << "{\n\t\"width\": " << m_Options.size.x << ",\n\t\"height\": " << m_Options.size.y << ",\n\t\"scenes\": [\n";
+	file << std::fixed << std::setprecision(4);
+	for (size_t i = 0; i < m_Results.size(); ++i)
+	{
+		const RegressionResult& result = m_Results[i];
+		file << "\t\t{ \"name\": \"" << result.name << "\", \"cpuMs\": " << result.cpuMs << ", \"gpuMs\": " << result.gpuMs << " }"
+			<< (i + 1 < m_Results.size() ? "," : "") << "\n";
+	}
+	file << "\t]\n}\n";
+	if (!file)
+		std::cout << "ERROR::REGRESSION::UNABLE TO WRITE: " << m_OutputDirectory << "baseline.json" << std::endl;
+}
+
+
+void RegressionSuite::CreateTarget()
+{
+	GpuResources& resources = GpuResources::instance();
+	GLStateCache& state = GLStateCache::instance();
+	GLenum formats[] = { GL_RGBA8, GL_DEPTH24_STENCIL8 };
+	GpuHandle* textures[] = { &m_Color, &m_Depth };
+	for (int i = 0; i < 2; ++i)
+	{
+		*textures[i] = resources.createTexture(GL_TEXTURE_2D);
+		glTexStorage2D(GL_TEXTURE_2D, 1, formats[i], (GLsizei)m_Options.size.x, (GLsizei)m_Options.size.y);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		resources.setTextureBytes(*textures[i], (uint64_t)m_Options.size.x * m_Options.size.y * 4);
+	}
+
+	m_Framebuffer = resources.createFramebuffer();
+	state.bindFramebuffer(GL_FRAMEBUFFER, resources.name(m_Framebuffer));
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, resources.name(m_Color), 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, resources.name(m_Depth), 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "ERROR::REGRESSION::INCOMPLETE FRAMEBUFFER" << std::endl;
+	state.bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+
+void RegressionSuite::ReleaseTarget()
+{
+	GpuResources& resources = GpuResources::instance();
+	resources.release(m_Framebuffer);
+	resources.release(m_Color);
+	resources.release(m_Depth);
+	m_Framebuffer = GpuHandle();
+	m_Color = GpuHandle();
+	m_Depth = GpuHandle();
+}
@@ -0,0 +1,182 @@
+#ifndef REGRESSION_SUITE_H
+#define REGRESSION_SUITE_H
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <glm.hpp>
+#include <glew.h>
+#include "gpu_resources.h"
+#include "gpu_timer.h"
+#include "image_diff.h"
+
+/*!
+ * Reference view of the regression run, camera and shading path
+ *
+ */
+struct RegressionScene
+{
+	std::string name;       // file name of the reference image, without extension
+	float yaw;
+	float pitch;
+	bool deferred;
+	bool depthPrepass;
+	float time;             // seconds, poses the animated objects
+};
+
+/*!
+ * Outcome of a scene
+ *
+ */
+struct RegressionResult
+{
+	std::string name;
+	std::string status;                 // PASSED, FAILED, or RECORDED in record mode
+	std::string reason;                 // what failed: IMAGE, NO REFERENCE, NO BASELINE, CPU TIME, GPU TIME, UNABLE TO WRITE
+	bool settled = false;               // streamed data had all arrived before the image was taken
+	ImageDiffResult diff;
+	unsigned int timedFrames = 0;
+	double cpuMs = 0.0;                 // mean time from beginFrame to endFrame
+	double gpuMs = 0.0;                 // mean GPU time of the frames
+	double maxCpuMs = 0.0;
+	double baselineCpuMs = 0.0;         // from the baseline, 0 when there is none
+	double baselineGpuMs = 0.0;
+};
+
+/*!
+ * Golden image regression run over a fixed set of scenes
+ *
+ * Every scene is drawn into an offscreen target of a fixed size, so the
+ * result does not depend on the window, which may stay hidden. A scene
+ * first renders until the streamed data settles, then is timed over a
+ * number of frames on the CPU and the GPU, then its last frame is read
+ * back and compared with <directory>/<scene>.ppm by ImageDiff, and its
+ * mean CPU and GPU times with baseline.json of the output directory. A
+ * scene fails when its reference or baseline is missing, its image
+ * differs, or it got slower than the tolerance allows. Failing scenes
+ * leave the rendered image and a heatmap of the differences in the output
+ * directory. Record mode writes the references and the baseline instead
+ * of comparing. Timings and scores of every scene are written to
+ * results.json of the output directory.
+ *
+ * References are meant to be committed, timings only hold on one machine,
+ * so the output directory may live elsewhere, the build tree for instance.
+ *
+ * The references hold whatever the environment enables (lights, streamed
+ * data, ...), a directory per configuration keeps them apart.
+ */
+class RegressionSuite
+{
+public:
+	struct Options
+	{
+		glm::uvec2 size = glm::uvec2(800, 600);
+		unsigned int warmupFrames = 30;     // at least, more while streamed data is on its way
+		unsigned int maxWarmupFrames = 600; // the scene is taken unsettled after that
+		unsigned int timedFrames = 60;
+		float threshold = 3.0f;             // delta E above which pixels differ
+		float maxDifferentFraction = 0.001f; // of the pixels, above it the scene fails
+		bool record = false;                // write the references and the baseline instead of comparing
+		double timingTolerance = 0.25;      // allowed slowdown against the baseline, as a fraction
+		double timingSlackMs = 0.5;         // allowed on top, short frames are noisy
+		std::string outputDirectory;        // baseline, results and failing images, the reference directory when empty
+	};
+
+	/*!
+	 * Scenes over the box city, from several angles and through every shading path
+	 *
+	 */
+	static std::vector<RegressionScene> DefaultScenes();
+
+	RegressionSuite(const std::string& directory, const std::vector<RegressionScene>& scenes);
+	RegressionSuite(const std::string& directory, const std::vector<RegressionScene>& scenes, const Options& options);
+	~RegressionSuite();
+
+	RegressionSuite(const RegressionSuite&) = delete;
+	RegressionSuite& operator=(const RegressionSuite&) = delete;
+
+	/*!
+	 * Bind and clear the offscreen target and start timing
+	 *
+	 * \return : size to render at, the viewport is set to it
+	 */
+	glm::uvec2 beginFrame();
+
+	/*!
+	 * Stop timing, take the image at the end of the scene and copy the frame to the window
+	 *
+	 * \param settled : no streamed data is on its way
+	 * \return : false(bool) once every scene is done
+	 */
+	bool endFrame(bool settled);
+
+	/*!
+	 * Scene of the current frame
+	 *
+	 */
+	const RegressionScene& scene() const;
+
+	/*!
+	 * Offscreen framebuffer, for passes that copy into the current target
+	 *
+	 */
+	GLuint framebuffer() const;
+
+	/*!
+	 * Whether every scene done so far matched its reference and baseline, or recorded them
+	 *
+	 */
+	bool passed() const;
+
+	/*!
+	 * Table of the results
+	 *
+	 */
+	void report(std::ostream& out) const;
+
+private:
+
+	std::string m_Directory;
+	std::string m_OutputDirectory;
+	std::vector<RegressionScene> m_Scenes;
+	Options m_Options;
+	std::vector<RegressionResult> m_Results;
+	std::vector<RegressionResult> m_Baseline;   // names and times only
+	unsigned int m_Scene;
+	unsigned int m_Frame;               // frames of the current scene
+	unsigned int m_Timed;               // timed frames of the current scene
+	unsigned int m_GpuSamples;          // GpuTimer samples already used
+	double m_CpuTotal;
+	double m_GpuTotal;
+	unsigned int m_GpuCount;
+	std::chrono::high_resolution_clock::time_point m_FrameStart;
+	GpuTimer m_Timer;
+
+	GpuHandle m_Color;
+	GpuHandle m_Depth;
+	GpuHandle m_Framebuffer;
+
+	/*!
+	 * Read the target back and compare it with the reference
+	 *
+	 */
+	void FinishScene(bool settled);
+
+	/*!
+	 * Fail the scene if a time is over its baseline value plus the tolerance
+	 *
+	 */
+	void CompareTimings(RegressionResult& result) const;
+
+	void ReadBaseline();
+
+	void WriteResults() const;
+
+	void WriteBaseline() const;
+
+	void CreateTarget();
+
+	void ReleaseTarget();
+};
+#endif
@@ -0,0 +1,195 @@
+#include "render_queue.h"
+#include <chrono>
+#include "gl_state_cache.h"
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+}
+
+
+RenderQueue::RenderQueue()
+	: m_Near(0.1f), m_Far(100.0f)
+{
+}
+
+
+unsigned int RenderQueue::addShader(Shader* shader)
+{
+	ShaderSlot slot;
+	slot.shader = shader;
+	FindLocations(slot);
+	m_Shaders.push_back(slot);
+	return (unsigned int)m_Shaders.size() - 1;
+}
+
+
+unsigned int RenderQueue::addMaterial(const glm::vec3& color)
+{
+	m_Materials.push_back(color);
+	return (unsigned int)m_Materials.size() - 1;
+}
+
+
+unsigned int RenderQueue::addMesh(unsigned int vao, unsigned int indexCount, unsigned int firstIndex)
+{
+	MeshSlot slot;
+	slot.vao = vao;
+	slot.indexCount = indexCount;
+	slot.firstIndex = firstIndex;
+	m_Meshes.push_back(slot);
+	return (unsigned int)m_Meshes.size() - 1;
+}
+
+
+void RenderQueue::setDepthRange(float nearPlane, float farPlane)
+{
+	m_Near = nearPlane;
+	m_Far = farPlane;
+}
+
+
+void RenderQueue::clear()
+{
+	m_Items.clear();
+	m_Keys.clear();
+}
+
+
+void RenderQueue::push(RenderPass pass, unsigned int shader, unsigned int material, unsigned int mesh,
+	const glm::mat4& model, float viewDepth)
+{
+	SortEntry entry;
+	entry.key = MakeKey(pass, shader, material, mesh, QuantizeDepth(viewDepth));
+	entry.index = (uint32_t)m_Items.size();
+	m_Keys.push_back(entry);
+
+	DrawItem item;
+	item.model = model;
+	item.shader = shader;
+	item.material = material;
+	item.mesh = mesh;
+	m_Items.push_back(item);
+}
+
+
+void RenderQueue::sort(JobSystem& jobs)
+{
+	Clock::time_point start = Clock::now();
+	RadixSort(m_Keys, m_SortScratch, jobs);
+	m_Stats.sortMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+
+void RenderQueue::submit(const glm::mat4& view, const glm::mat4& projection)
+{
+	Clock::time_point start = Clock::now();
+
+	unsigned int currentShader = ~0u;
+	unsigned int currentMaterial = ~0u;
+	unsigned int currentVao = ~0u;
+	RenderQueueStats stats;
+	stats.sortMilliseconds = m_Stats.sortMilliseconds;
+
+	for (const SortEntry& entry : m_Keys)
+	{
+		const DrawItem& item = m_Items[entry.index];
+		ShaderSlot& shader = m_Shaders[item.shader];
+		const MeshSlot& mesh = m_Meshes[item.mesh];
+
+		if (item.shader != currentShader)
+		{
+			if (shader.shader->id() != shader.program)
+				FindLocations(shader);
+			shader.shader->use();
+			glUniformMatrix4fv(shader.viewLocation, 1, GL_FALSE, &view[0][0]);
+			glUniformMatrix4fv(shader.projectionLocation, 1, GL_FALSE, &projection[0][0]);
+			currentShader = item.shader;
+			// material uniforms belong to the program, set them again
+			currentMaterial = ~0u;
+			++stats.programChanges;
+		}
+		if (item.material != currentMaterial)
+		{
+			glUniform3fv(shader.colorLocation, 1, &m_Materials[item.material][0]);
+			currentMaterial = item.material;
+			++stats.materialChanges;
+		}
+		if (mesh.vao != currentVao)
+		{
+			GLStateCache::instance().bindVertexArray(mesh.vao);
+			currentVao = mesh.vao;
+			++stats.meshChanges;
+		}
+
+		glUniformMatrix4fv(shader.modelLocation, 1, GL_FALSE, &item.model[0][0]);
+		glDrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, (void*)(mesh.firstIndex * sizeof(unsigned int)));
+		++stats.draws;
+	}
+
+	stats.submitMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	m_Stats = stats;
+}
+
+
+const RenderQueueStats& RenderQueue::stats() const
+{
+	return m_Stats;
+}
+
+
+void RenderQueue::reportTo(Profiler& profiler) const
+{
+	profiler.addCounter("QUEUE DRAWS", m_Stats.draws);
+	profiler.addCounter("QUEUE PROGRAM CHANGES", m_Stats.programChanges);
+	profiler.addCounter("QUEUE MATERIAL CHANGES", m_Stats.materialChanges);
+	profiler.addCounter("QUEUE MESH CHANGES", m_Stats.meshChanges);
+	profiler.addCounter("QUEUE SORT MS", m_Stats.sortMilliseconds);
+	profiler.addCounter("QUEUE SUBMIT MS", m_Stats.submitMilliseconds);
+}
+
+
+uint64_t RenderQueue::MakeKey(RenderPass pass, unsigned int shader, unsigned int material, unsigned int mesh, uint16_t depth)
+{
+	uint64_t key = (uint64_t)(pass & 0xF) << 60;
+	if (pass == PASS_TRANSPARENT)
+	{
+		// back to front matters more than state for blending
+		key |= (uint64_t)(uint16_t)~depth << 44;
+		key |= (uint64_t)(shader & (MAX_SHADERS - 1)) << 34;
+		key |= (uint64_t)(material & (MAX_MATERIALS - 1)) << 20;
+		key |= (uint64_t)(mesh & (MAX_MESHES - 1));
+	}
+	else
+	{
+		key |= (uint64_t)(shader & (MAX_SHADERS - 1)) << 50;
+		key |= (uint64_t)(material & (MAX_MATERIALS - 1)) << 36;
+		key |= (uint64_t)(mesh & (MAX_MESHES - 1)) << 16;
+		key |= (uint64_t)depth;
+	}
+	return key;
+}
+
+
+uint16_t RenderQueue::QuantizeDepth(float viewDepth) const
+{
+	float normalized = (viewDepth - m_Near) / (m_Far - m_Near);
+	normalized = glm::clamp(normalized, 0.0f, 1.0f);
+	return (uint16_t)(normalized * 65535.0f);
+}
+
+
+void RenderQueue::FindLocations(ShaderSlot& slot)
+{
+	slot.program = slot.shader->id();
+	if (slot.program == 0)
+	{
+		// not built yet, looked up at the first submit after it is
+		slot.modelLocation = slot.viewLocation = slot.projectionLocation = slot.colorLocation = -1;
+		return;
+	}
+	slot.modelLocation = glGetUniformLocation(slot.program, "model");
+	slot.viewLocation = glGetUniformLocation(slot.program, "view");
+	slot.projectionLocation = glGetUniformLocation(slot.program, "projection");
+	slot.colorLocation = glGetUniformLocation(slot.program, "objectColor");
+}
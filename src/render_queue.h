@@ -0,0 +1,175 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <cstdint>
+#include <vector>
+#include <glm.hpp>
+#include "shader.h"
+#include "profiler.h"
+#include "radix_sort.h"
+
+enum RenderPass
+{
+	PASS_DEPTH = 0,
+	PASS_OPAQUE = 1,
+	PASS_TRANSPARENT = 2
+};
+
+/*!
+ * Counters of the last submitted frame
+ *
+ */
+struct RenderQueueStats
+{
+	unsigned int draws = 0;
+	unsigned int programChanges = 0;
+	unsigned int materialChanges = 0;
+	unsigned int meshChanges = 0;
+	double sortMilliseconds = 0.0;
+	double submitMilliseconds = 0.0;
+};
+
+/*!
+ * Sorted list of draws for one frame
+ *
+ * Every draw carries a packed 64 bit key, highest bits first:
+ * pass(4) shader(10) material(14) mesh(20) depth(16) for opaque passes,
+ * transparent draws put the inverted depth right after the pass so they
+ * stay back to front. Sorting the keys groups draws by state, submission
+ * then only binds what differs from the previous draw.
+ */
+class RenderQueue
+{
+public:
+	static const unsigned int MAX_SHADERS = 1 << 10;
+	static const unsigned int MAX_MATERIALS = 1 << 14;
+	static const unsigned int MAX_MESHES = 1 << 20;
+
+	RenderQueue();
+
+	/*!
+	 * Register a shader, it needs 'model', 'view', 'projection' and 'objectColor' uniforms.
+	 * Their locations are looked up again when hot reload swapped the program.
+	 *
+	 * \return : shader index for push
+	 */
+	unsigned int addShader(Shader* shader);
+
+	/*!
+	 * Register a material
+	 *
+	 * \param color : value of 'objectColor'
+	 * \return : material index for push
+	 */
+	unsigned int addMaterial(const glm::vec3& color);
+
+	/*!
+	 * Register a drawable index range
+	 *
+	 * \param vao : vertex array with an element buffer bound
+	 * \param indexCount : number of indices to draw
+	 * \param firstIndex : offset in the element buffer, in indices
+	 * \return : mesh index for push
+	 */
+	unsigned int addMesh(unsigned int vao, unsigned int indexCount, unsigned int firstIndex);
+
+	/*!
+	 * Range used to quantize view depth in the keys
+	 *
+	 */
+	void setDepthRange(float nearPlane, float farPlane);
+
+	/*!
+	 * Drop the draws of the previous frame, registered shaders, materials and meshes stay
+	 *
+	 */
+	void clear();
+
+	/*!
+	 * Queue a draw
+	 *
+	 * \param pass : pass the draw belongs to
+	 * \param shader : index from addShader
+	 * \param material : index from addMaterial
+	 * \param mesh : index from addMesh
+	 * \param model : model matrix
+	 * \param viewDepth : distance along the view direction, positive in front of the camera
+	 */
+	void push(RenderPass pass, unsigned int shader, unsigned int material, unsigned int mesh,
+		const glm::mat4& model, float viewDepth);
+
+	/*!
+	 * Sort the queued draws by key
+	 *
+	 */
+	void sort(JobSystem& jobs);
+
+	/*!
+	 * Issue the sorted draws, skipping binds equal to the previous draw
+	 *
+	 */
+	void submit(const glm::mat4& view, const glm::mat4& projection);
+
+	const RenderQueueStats& stats() const;
+
+	/*!
+	 * Draws, state changes and times of the last frame
+	 *
+	 */
+	void reportTo(Profiler& profiler) const;
+
+	/*!
+	 * Pack a sort key
+	 *
+	 * \param depth : view depth quantized to 16 bits, small is near
+	 */
+	static uint64_t MakeKey(RenderPass pass, unsigned int shader, unsigned int material, unsigned int mesh, uint16_t depth);
+
+private:
+
+	struct ShaderSlot
+	{
+		Shader* shader;
+		unsigned int program;       // the locations belong to this program
+		int modelLocation;
+		int viewLocation;
+		int projectionLocation;
+		int colorLocation;
+	};
+
+	struct MeshSlot
+	{
+		unsigned int vao;
+		unsigned int indexCount;
+		unsigned int firstIndex;
+	};
+
+	struct DrawItem
+	{
+		glm::mat4 model;
+		unsigned int shader;
+		unsigned int material;
+		unsigned int mesh;
+	};
+
+	std::vector<ShaderSlot> m_Shaders;
+	std::vector<glm::vec3> m_Materials;
+	std::vector<MeshSlot> m_Meshes;
+
+	std::vector<DrawItem> m_Items;
+	std::vector<SortEntry> m_Keys;
+	std::vector<SortEntry> m_SortScratch;
+
+	float m_Near;
+	float m_Far;
+	RenderQueueStats m_Stats;
+
+	uint16_t QuantizeDepth(float viewDepth) const;
+
+	/*!
+	 * Look the uniform locations up in the current program of the shader
+	 *
+	 */
+	static void FindLocations(ShaderSlot& slot);
+};
+#endif
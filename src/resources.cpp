@@ -0,0 +1,48 @@
+#include "resources.h"
+#include <cstdlib>
+#include <sys/stat.h>
+
+namespace
+{
+	bool IsDirectory(const std::string& path)
+	{
+		struct stat status;
+		return stat(path.c_str(), &status) == 0 && (status.st_mode & S_IFDIR) != 0;
+	}
+
+	std::string WithTrailingSlash(std::string path)
+	{
+		if (!path.empty() && path.back() != '/' && path.back() != '\\')
+			path += '/';
+		return path;
+	}
+
+	std::string FindResourceDirectory()
+	{
+		const char* environment = std::getenv("OPENGLVIEWER_RESOURCES");
+		if (environment && *environment)
+			return WithTrailingSlash(environment);
+
+#ifdef OPENGLVIEWER_RESOURCE_DIR
+		if (IsDirectory(OPENGLVIEWER_RESOURCE_DIR))
+			return WithTrailingSlash(OPENGLVIEWER_RESOURCE_DIR);
+#endif
+
+		if (IsDirectory("res"))
+			return "res/";
+		return "../res/";
+	}
+}
+
+
+const std::string& ResourceDirectory()
+{
+	static const std::string directory = FindResourceDirectory();
+	return directory;
+}
+
+
+std::string ResourcePath(const std::string& name)
+{
+	return ResourceDirectory() + name;
+}
@@ -0,0 +1,20 @@
+#ifndef RESOURCES_H
+#define RESOURCES_H
+
+#include <string>
+
+/*!
+ * Directory holding the glsl files, with a trailing slash
+ *
+ * Taken from the OPENGLVIEWER_RESOURCES environment variable when set,
+ * else from the source tree path baked in by CMake, else "../res/".
+ */
+const std::string& ResourceDirectory();
+
+/*!
+ * Path of a file inside the resource directory
+ *
+ * \param name : file name, like "vertex.glsl"
+ */
+std::string ResourcePath(const std::string& name);
+#endif
@@ -1,18 +1,20 @@
 #include "shader.h"
+#include "gl_state_cache.h"
+#include "gpu_resources.h"
+#include <cstring>
 #include <string>
-#include <fstream>
-#include <sstream>
 #include <iostream>
 #include <glew.h>
 
 
 Shader::Shader()
+	: m_ShaderID(0)
 {
 }
 
 Shader::~Shader()
 {
-	glDeleteProgram(m_ShaderID);
+	GpuResources::instance().release(m_Program);
 }
 
 
@@ -22,70 +24,121 @@ unsigned int Shader::CompileShader(const std::string& source, unsigned int type)
 	const char* src = source.c_str();
 	glShaderSource(shader_id, 1, &src, nullptr);
 	glCompileShader(shader_id);
-	
+
+	// status is checked in CheckBuild so drivers can compile in the background meanwhile
+	return shader_id;
+}
+
+
+const char* Shader::StageName(unsigned int type)
+{
 	switch (type)
 	{
 	case GL_VERTEX_SHADER:
-		if (IsCompileError(shader_id, "VERTEX"))
-			return 0;
-
+		return "VERTEX";
 	case GL_FRAGMENT_SHADER:
-		if (IsCompileError(shader_id, "FRAGMENT"))
-			return 0;
+		return "FRAGMENT";
+	case GL_COMPUTE_SHADER:
+		return "COMPUTE";
 	}
+	return "UNKNOWN";
+}
 
-	return shader_id;
+
+Shader::Shader(const char * vertexPath, const char * fragmentPath)
+	: Shader(ShaderPreprocessor::Load(vertexPath, fragmentPath, std::vector<std::string>()))
+{
 }
 
 
+Shader::Shader(const char * computePath)
+	: Shader(ShaderPreprocessor::LoadCompute(computePath, std::vector<std::string>()))
+{
+}
 
-Shader::Shader(const char * vertexPath, const char * fragmentPath)
+
+Shader::Shader(const ShaderSources& sources)
+	: m_ShaderID(0)
 {
-	std::string vertexCode;
-	std::string fragmentCode;
+	CompileStages(sources);
+	LinkProgram();
+	CheckBuild();
+}
+
 
-	std::ifstream vShaderFile;
-	std::ifstream fShaderFile;
-	
-	// ensure file stream objects can throw exceptions:
-	vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	try
+void Shader::CompileStages(const ShaderSources& sources)
+{
+	m_VertexPath = sources.vertexPath;
+	m_FragmentPath = sources.fragmentPath;
+	m_ComputePath = sources.computePath;
+	m_Defines = sources.defines;
+	m_Dependencies = sources.dependencies;
+
+	// partial sources would compile into something else than asked, build nothing
+	if (!sources.complete)
 	{
-		vShaderFile.open(vertexPath);
-		fShaderFile.open(fragmentPath);
-		
-		std::stringstream vShaderStream, fShaderStream;
-	
-		// read file's buffer contents into streams
-		vShaderStream << vShaderFile.rdbuf();
-		fShaderStream << fShaderFile.rdbuf();
-		
-		vShaderFile.close();
-		fShaderFile.close();
-
-		// convert stream into string
-		vertexCode = vShaderStream.str();
-		fragmentCode = fShaderStream.str();
+		std::cout << "ERROR::SHADER::INCOMPLETE SOURCES, NOT COMPILED: " << sources.vertexPath << sources.computePath << " " << sources.fragmentPath << std::endl;
+		return;
 	}
-	catch (std::ifstream::failure e)
+
+	if (!sources.computeCode.empty())
 	{
-		std::cout << "ERROR::SHADER::UNABLE TO READ FILE" << std::endl;
+		m_PendingStages.push_back(CompileShader(sources.computeCode, GL_COMPUTE_SHADER));
+		m_PendingTypes.push_back(GL_COMPUTE_SHADER);
+		return;
 	}
 
-	unsigned int vertexShaderId = CompileShader(vertexCode, GL_VERTEX_SHADER);
-	unsigned int fragmentShaderId = CompileShader(fragmentCode, GL_FRAGMENT_SHADER);
+	m_PendingStages.push_back(CompileShader(sources.vertexCode, GL_VERTEX_SHADER));
+	m_PendingTypes.push_back(GL_VERTEX_SHADER);
+	m_PendingStages.push_back(CompileShader(sources.fragmentCode, GL_FRAGMENT_SHADER));
+	m_PendingTypes.push_back(GL_FRAGMENT_SHADER);
+}
+
+
+void Shader::LinkProgram()
+{
+	m_Locations.clear();
+	if (m_PendingStages.empty())
+	{
+		m_ShaderID = 0;
+		return;
+	}
 
 	// Shader Program
 	m_ShaderID = glCreateProgram();
-	glAttachShader(m_ShaderID, vertexShaderId);
-	glAttachShader(m_ShaderID, fragmentShaderId);
+	for (unsigned int stage : m_PendingStages)
+		glAttachShader(m_ShaderID, stage);
 	glLinkProgram(m_ShaderID);
-	IsCompileError(m_ShaderID, "PROGRAM");
+}
+
+
+bool Shader::CheckBuild()
+{
+	if (m_PendingStages.empty())
+		return false;
 
-	// delete the shaders as they're linked into our program now and no longer necessary
-	glDeleteShader(vertexShaderId);
-	glDeleteShader(fragmentShaderId);
+	bool success = true;
+	for (size_t i = 0; i < m_PendingStages.size(); ++i)
+	{
+		glDetachShader(m_ShaderID, m_PendingStages[i]);
+		// a failing stage is deleted by IsCompileError
+		if (IsCompileError(m_PendingStages[i], StageName(m_PendingTypes[i])))
+			success = false;
+		else
+			glDeleteShader(m_PendingStages[i]);
+	}
+	m_PendingStages.clear();
+	m_PendingTypes.clear();
+
+	// a failed link deletes the program
+	if (IsCompileError(m_ShaderID, "PROGRAM"))
+	{
+		m_ShaderID = 0;
+		success = false;
+	}
+	else
+		m_Program = GpuResources::instance().adoptProgram(m_ShaderID);
+	return success;
 }
 
 
@@ -121,74 +174,145 @@ bool Shader::IsCompileError(unsigned int component_id, std::string type)
 
 void Shader::use()
 {
-	glUseProgram(m_ShaderID);
+	GLStateCache::instance().useProgram(m_ShaderID);
 }
 
 
-void Shader::setBool(const std::string &name, bool value) const
+unsigned int Shader::id() const
 {
-	glUniform1i(glGetUniformLocation(m_ShaderID, name.c_str()), (int)value);
+	return m_ShaderID;
 }
 
 
-void Shader::setInt(const std::string &name, int value) const
+void Shader::replaceProgram(unsigned int program)
 {
-	glUniform1i(glGetUniformLocation(m_ShaderID, name.c_str()), value);
+	GpuResources& resources = GpuResources::instance();
+	resources.release(m_Program);
+	m_Locations.clear();
+	m_ShaderID = program;
+	m_Program = resources.adoptProgram(program);
 }
 
 
-void Shader::setFloat(const std::string &name, float value) const
+int Shader::uniformLocation(const char* name) const
 {
-	glUniform1f(glGetUniformLocation(m_ShaderID, name.c_str()), value);
+	// FNV-1a, compared before the names so most misses skip strcmp
+	uint32_t hash = 2166136261u;
+	for (const char* c = name; *c; ++c)
+		hash = (hash ^ (uint8_t)*c) * 16777619u;
+
+	for (const UniformLocation& cached : m_Locations)
+	{
+		if (cached.hash == hash && std::strcmp(cached.name.c_str(), name) == 0)
+			return cached.location;
+	}
+
+	int location = glGetUniformLocation(m_ShaderID, name);
+	m_Locations.push_back(UniformLocation{ hash, name, location });
+	return location;
+}
+
+
+const std::string& Shader::vertexPath() const
+{
+	return m_VertexPath;
+}
+
+
+const std::string& Shader::fragmentPath() const
+{
+	return m_FragmentPath;
+}
+
+
+const std::string& Shader::computePath() const
+{
+	return m_ComputePath;
+}
+
+
+const std::vector<std::string>& Shader::defines() const
+{
+	return m_Defines;
+}
+
+
+const std::vector<std::string>& Shader::dependencies() const
+{
+	return m_Dependencies;
+}
+
+
+void Shader::setBool(const char* name, bool value) const
+{
+	glUniform1i(uniformLocation(name), (int)value);
 }
 
 
-void Shader::setVec2(const std::string &name, const glm::vec2 &value) const
+void Shader::setInt(const char* name, int value) const
 {
-	glUniform2fv(glGetUniformLocation(m_ShaderID, name.c_str()), 1, &value[0]);
+	glUniform1i(uniformLocation(name), value);
 }
 
-void Shader::setVec2(const std::string &name, float x, float y) const
+
+void Shader::setFloat(const char* name, float value) const
 {
-	glUniform2f(glGetUniformLocation(m_ShaderID, name.c_str()), x, y);
+	glUniform1f(uniformLocation(name), value);
 }
 
 
-void Shader::setVec3(const std::string &name, const glm::vec3 &value) const
+void Shader::setVec2(const char* name, const glm::vec2 &value) const
 {
-	glUniform3fv(glGetUniformLocation(m_ShaderID, name.c_str()), 1, &value[0]);
+	glUniform2fv(uniformLocation(name), 1, &value[0]);
 }
 
-void Shader::setVec3(const std::string &name, float x, float y, float z) const
+void Shader::setVec2(const char* name, float x, float y) const
 {
-	glUniform3f(glGetUniformLocation(m_ShaderID, name.c_str()), x, y, z);
+	glUniform2f(uniformLocation(name), x, y);
 }
 
 
-void Shader::setVec4(const std::string &name, const glm::vec4 &value) const
+void Shader::setVec3(const char* name, const glm::vec3 &value) const
 {
-	glUniform4fv(glGetUniformLocation(m_ShaderID, name.c_str()), 1, &value[0]);
+	glUniform3fv(uniformLocation(name), 1, &value[0]);
 }
 
-void Shader::setVec4(const std::string &name, float x, float y, float z, float w) const
+void Shader::setVec3(const char* name, float x, float y, float z) const
 {
-	glUniform4f(glGetUniformLocation(m_ShaderID, name.c_str()), x, y, z, w);
+	glUniform3f(uniformLocation(name), x, y, z);
 }
 
 
-void Shader::setMat2(const std::string &name, const glm::mat2 &mat) const
+void Shader::setVec4(const char* name, const glm::vec4 &value) const
+{
+	glUniform4fv(uniformLocation(name), 1, &value[0]);
+}
+
+void Shader::setVec4(const char* name, float x, float y, float z, float w) const
 {
-	glUniformMatrix2fv(glGetUniformLocation(m_ShaderID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+	glUniform4f(uniformLocation(name), x, y, z, w);
 }
 
 
-void Shader::setMat3(const std::string &name, const glm::mat3 &mat) const
+void Shader::setMat2(const char* name, const glm::mat2 &mat) const
 {
-	glUniformMatrix3fv(glGetUniformLocation(m_ShaderID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+	glUniformMatrix2fv(uniformLocation(name), 1, GL_FALSE, &mat[0][0]);
 }
 
 
-void Shader::setMat4(const std::string &name, const glm::mat4 &mat) const
+void Shader::setMat3(const char* name, const glm::mat3 &mat) const
 {
-	glUniformMatrix4fv(glGetUniformLocation(m_ShaderID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
-}
\ No newline at end of file
+	glUniformMatrix3fv(uniformLocation(name), 1, GL_FALSE, &mat[0][0]);
+}
+
+
+void Shader::setMat4(const char* name, const glm::mat4 &mat) const
+{
+	glUniformMatrix4fv(uniformLocation(name), 1, GL_FALSE, &mat[0][0]);
+}
+
+
+void Shader::setMat4Array(const char* name, const glm::mat4* mats, int count) const
+{
+	glUniformMatrix4fv(uniformLocation(name), count, GL_FALSE, &mats[0][0][0]);
+}
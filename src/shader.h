@@ -1,9 +1,13 @@
 #ifndef SHADER_H
 #define SHADER_H
 
+#include <cstdint>
 #include <string>
+#include <vector>
 #include <glew.h>
 #include <glm.hpp>
+#include "shader_preprocessor.h"
+#include "gpu_resources.h"
 
 class Shader
 {
@@ -18,13 +22,72 @@ public:
 	 * \param fragmentPath : path till fragment shader
 	 */
 	Shader(const char* vertexPath, const char* fragmentPath);
+
+	/*!
+	 * Construct compute shader program
+	 *
+	 * \param computePath : path till compute shader
+	 */
+	explicit Shader(const char* computePath);
+
+	/*!
+	 * Construct shader program out of preprocessed sources
+	 *
+	 * \param sources : as returned by ShaderPreprocessor::Load or LoadCompute
+	 */
+	explicit Shader(const ShaderSources& sources);
+
+	Shader(const Shader&) = delete;
+	Shader& operator=(const Shader&) = delete;
 	
 	/*!
-	 * Using the Shader program
+	 * Using the Shader program, redundant binds are filtered by GLStateCache
 	 *
 	 */
 	void use();
 
+	/*!
+	 * Shader program id as generated by OpenGL
+	 *
+	 */
+	unsigned int id() const;
+
+	/*!
+	 * Swap in a new linked program, the current one is deleted.
+	 * Used by hot reload once the new program linked successfully.
+	 *
+	 * \param program : linked program id
+	 */
+	void replaceProgram(unsigned int program);
+
+	/*!
+	 * Location of a uniform, asked to OpenGL once per program and then cached
+	 *
+	 * \param name : name of variable in shader
+	 * \return : -1 if the program has no active uniform of that name
+	 */
+	int uniformLocation(const char* name) const;
+
+	/*!
+	 * Paths the program was built from, empty for unused stages
+	 *
+	 */
+	const std::string& vertexPath() const;
+	const std::string& fragmentPath() const;
+	const std::string& computePath() const;
+
+	/*!
+	 * Defines injected by the preprocessor
+	 *
+	 */
+	const std::vector<std::string>& defines() const;
+
+	/*!
+	 * Every file read to build the program, includes too
+	 *
+	 */
+	const std::vector<std::string>& dependencies() const;
+
 	// unifrom setters
 	//----------------
 
@@ -34,7 +97,7 @@ public:
 	 * \param name : name of variable in shader
 	 * \param value : value to link with shader variable
 	 */
-	void setBool(const std::string &name, bool value) const;
+	void setBool(const char* name, bool value) const;
 
 	/*!
 	 * uniform to set 'int'
@@ -42,7 +105,7 @@ public:
 	 * \param name : name of variable in shader
 	 * \param value : value to link with shader variable
 	 */
-	void setInt(const std::string &name, int value) const;
+	void setInt(const char* name, int value) const;
 
 	/*!
 	 * uniform to set 'float'
@@ -50,7 +113,7 @@ public:
 	 * \param name : name of variable in shader
 	 * \param value : value to link with shader variable
 	 */
-	void setFloat(const std::string &name, float value) const;
+	void setFloat(const char* name, float value) const;
 
 
 	/*!
@@ -59,7 +122,7 @@ public:
 	 * \param name : name of variable in shader
 	 * \param value : glm::vec2 to be link in shader variable
 	 */
-	void setVec2(const std::string &name, const glm::vec2 &value) const;
+	void setVec2(const char* name, const glm::vec2 &value) const;
 
 	/*!
 	 * uniform to set 'vec2'
@@ -68,7 +131,7 @@ public:
 	 * \param x : x component of vector
 	 * \param y : y component of vector
 	 */
-	void setVec2(const std::string &name, float x, float y) const;
+	void setVec2(const char* name, float x, float y) const;
 
 	/*!
 	 * uniform to set 'vec3'
@@ -76,7 +139,7 @@ public:
 	 * \param name : name of variable in shader
 	 * \param value : glm::vec3 to be link in shader variable
 	 */
-	void setVec3(const std::string &name, const glm::vec3 &value) const;
+	void setVec3(const char* name, const glm::vec3 &value) const;
 	
 	/*!
 	 * uniform to set 'vec3'
@@ -86,7 +149,7 @@ public:
 	 * \param y : y component of vector
 	 * \param z : z component of vector
 	 */
-	void setVec3(const std::string &name, float x, float y, float z) const;
+	void setVec3(const char* name, float x, float y, float z) const;
 
 	/*!
 	 * uniform to set 'vec4'
@@ -94,7 +157,7 @@ public:
 	 * \param name : name of variable in shader
 	 * \param value : glm::vec4 to be link in shader variable
 	 */
-	void setVec4(const std::string &name, const glm::vec4 &value) const;
+	void setVec4(const char* name, const glm::vec4 &value) const;
 	
 	/*!
 	 * uniform to set 'vec4'
@@ -105,7 +168,7 @@ public:
 	 * \param z : z component of vector
 	 * \param w : w component of vector
 	 */
-	void setVec4(const std::string &name, float x, float y, float z, float w) const;
+	void setVec4(const char* name, float x, float y, float z, float w) const;
 
 	/*!
 	 * uniform to set 'mat2'
@@ -113,7 +176,7 @@ public:
 	 * \param name : name of variable in shader
 	 * \param mat : glm::mat2 to be link in shader variable
 	 */
-	void setMat2(const std::string &name, const glm::mat2 &mat) const;
+	void setMat2(const char* name, const glm::mat2 &mat) const;
 
 	/*!
 	 * uniform to set 'mat3'
@@ -121,7 +184,7 @@ public:
 	 * \param name : name of variable in shader
 	 * \param mat : glm::mat3 to be link in shader variable
 	 */
-	void setMat3(const std::string &name, const glm::mat3 &mat) const;
+	void setMat3(const char* name, const glm::mat3 &mat) const;
 
 
 	/*!
@@ -130,7 +193,16 @@ public:
 	 * \param name : name of variable in shader
 	 * \param mat : glm::mat4 to be link in shader variable
 	 */
-	void setMat4(const std::string &name, const glm::mat4 &mat) const;
+	void setMat4(const char* name, const glm::mat4 &mat) const;
+
+	/*!
+	 * uniform to set 'mat4[]'
+	 *
+	 * \param name : name of the array in shader, without index
+	 * \param mats : first matrix to be link in shader variable
+	 * \param count : number of matrices, starting at element 0
+	 */
+	void setMat4Array(const char* name, const glm::mat4* mats, int count) const;
 	
 	//----------------
 
@@ -141,22 +213,74 @@ private:
 	 * 
 	 */
 	unsigned int m_ShaderID;
+
+	// ownership of m_ShaderID, the program is deleted through GpuResources
+	GpuHandle m_Program;
+
+	struct UniformLocation
+	{
+		uint32_t hash;
+		std::string name;
+		int location;
+	};
+
+	// filled by uniformLocation, cleared whenever m_ShaderID changes
+	mutable std::vector<UniformLocation> m_Locations;
+
+	std::string m_VertexPath;
+	std::string m_FragmentPath;
+	std::string m_ComputePath;
+	std::vector<std::string> m_Defines;
+	std::vector<std::string> m_Dependencies;
+
+	// stages compiled but not checked yet, see CheckBuild
+	std::vector<unsigned int> m_PendingStages;
+	std::vector<unsigned int> m_PendingTypes;
+
+	friend class ShaderBatch;
 	
 	/*!
-	* Shader Compilation
+	* Shader Compilation, issued only, status is checked by CheckBuild
 	*
 	* \param source : shader source to compile
 	* \param type : type of shader as defined in OpenGL
 	* \return : shader id generated by compilation in OpenGL server
 	*/
 	unsigned int CompileShader(const std::string& source, unsigned int type);
+
+	/*!
+	 * Issue the compilation of every stage of the sources
+	 *
+	 */
+	void CompileStages(const ShaderSources& sources);
+
+	/*!
+	 * Create the program out of the pending stages and issue the link
+	 *
+	 */
+	void LinkProgram();
+
+	/*!
+	 * Check and report compile and link status, delete the stages
+	 *
+	 * \return : true(bool) if the program is usable
+	 */
+	bool CheckBuild();
+
+	/*!
+	 * Name of a stage for IsCompileError
+	 *
+	 * \param type : type of shader as defined in OpenGL
+	 * \return : VERTEX/FRAGMENT/COMPUTE
+	 */
+	static const char* StageName(unsigned int type);
 	
 	/*!
 	 * Checking for compilation error
 	 *
 	 * \param component_id : as generated by OpenGL server
 	 * \param type : type of component we want to check.
-	 * should be pass in string like PROGRAM/VERTEX/FRAGMENT
+	 * should be pass in string like PROGRAM/VERTEX/FRAGMENT/COMPUTE
 	 * \return : true(bool) if compilation error else false(bool)
 	 */
 	bool IsCompileError(unsigned int component_id, std::string type);
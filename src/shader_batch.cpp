@@ -0,0 +1,43 @@
+#include "shader_batch.h"
+#include <chrono>
+#include <glew.h>
+
+
+void ShaderBatch::add(Shader* shader, const ShaderSources& sources)
+{
+	Entry entry;
+	entry.shader = shader;
+	entry.sources = sources;
+	m_Entries.push_back(entry);
+}
+
+
+unsigned int ShaderBatch::build()
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	if (GLEW_KHR_parallel_shader_compile)
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+
+	for (Entry& entry : m_Entries)
+		entry.shader->CompileStages(entry.sources);
+	for (Entry& entry : m_Entries)
+		entry.shader->LinkProgram();
+
+	unsigned int failures = 0;
+	for (Entry& entry : m_Entries)
+	{
+		if (!entry.shader->CheckBuild())
+			++failures;
+	}
+	m_Entries.clear();
+
+	m_LastBuildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	return failures;
+}
+
+
+double ShaderBatch::lastBuildMilliseconds() const
+{
+	return m_LastBuildMilliseconds;
+}
@@ -0,0 +1,50 @@
+#ifndef SHADER_BATCH_H
+#define SHADER_BATCH_H
+
+#include <vector>
+#include "shader.h"
+
+/*!
+ * Builds many shader programs at once
+ *
+ * Every compile is issued first, then every link, and only then the
+ * statuses are read. Querying a status forces the driver to finish that
+ * work, doing it last leaves it free to compile the whole batch in parallel
+ * (and KHR_parallel_shader_compile gets enabled when available).
+ */
+class ShaderBatch
+{
+public:
+	/*!
+	 * Queue a program
+	 *
+	 * \param shader : default constructed shader receiving the program, has to outlive build
+	 * \param sources : as returned by ShaderPreprocessor::Load or LoadCompute
+	 */
+	void add(Shader* shader, const ShaderSources& sources);
+
+	/*!
+	 * Compile, link and check every queued program, the queue is emptied
+	 *
+	 * \return : number of programs that failed, errors are printed by Shader
+	 */
+	unsigned int build();
+
+	/*!
+	 * Wall time of the last build, from the first compile to the last status check
+	 *
+	 */
+	double lastBuildMilliseconds() const;
+
+private:
+
+	struct Entry
+	{
+		Shader* shader;
+		ShaderSources sources;
+	};
+
+	std::vector<Entry> m_Entries;
+	double m_LastBuildMilliseconds = 0.0;
+};
+#endif
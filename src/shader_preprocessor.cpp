@@ -0,0 +1,198 @@
+#include "shader_preprocessor.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+	const int MAX_INCLUDE_DEPTH = 16;
+
+	std::string DirectoryOf(const std::string& path)
+	{
+		size_t slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+	}
+
+	size_t DependencyIndex(std::vector<std::string>& dependencies, const std::string& path)
+	{
+		auto found = std::find(dependencies.begin(), dependencies.end(), path);
+		if (found != dependencies.end())
+			return found - dependencies.begin();
+		dependencies.push_back(path);
+		return dependencies.size() - 1;
+	}
+
+	bool IsIdentifierChar(char c)
+	{
+		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+	}
+
+	/*!
+	 * Whole word search, "NORMAL" does not match "NO_NORMALS"
+	 *
+	 */
+	bool ContainsIdentifier(const std::string& text, const std::string& name)
+	{
+		for (size_t at = text.find(name); at != std::string::npos; at = text.find(name, at + 1))
+		{
+			bool startsWord = at == 0 || !IsIdentifierChar(text[at - 1]);
+			bool endsWord = at + name.size() >= text.size() || !IsIdentifierChar(text[at + name.size()]);
+			if (startsWord && endsWord)
+				return true;
+		}
+		return false;
+	}
+
+	/*!
+	 * Append a file to output with its includes expanded
+	 *
+	 * \param versionEnd : set to the offset right after the #version line of the root file
+	 */
+	bool ProcessFile(const std::string& path, int depth, std::vector<std::string>& included,
+		std::vector<std::string>& dependencies, std::string& output, size_t* versionEnd)
+	{
+		if (depth > MAX_INCLUDE_DEPTH)
+		{
+			std::cout << "ERROR::SHADER::INCLUDE TOO DEEP: " << path << std::endl;
+			return false;
+		}
+
+		std::string content;
+		if (!ShaderPreprocessor::ReadFile(path, content))
+			return false;
+
+		size_t fileIndex = DependencyIndex(dependencies, path);
+		included.push_back(path);
+		if (depth > 0)
+			output += "#line 1 " + std::to_string(fileIndex) + "\n";
+
+		std::istringstream lines(content);
+		std::string line;
+		int lineNumber = 0;
+		while (std::getline(lines, line))
+		{
+			++lineNumber;
+			size_t first = line.find_first_not_of(" \t");
+			std::string trimmed = first == std::string::npos ? std::string() : line.substr(first);
+
+			if (trimmed.compare(0, 8, "#version") == 0)
+			{
+				// only the root file may set the version, includes just lose theirs
+				if (depth == 0)
+				{
+					output += line + "\n";
+					if (versionEnd)
+						*versionEnd = output.size();
+					output += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+				}
+				continue;
+			}
+
+			if (trimmed.compare(0, 8, "#include") == 0)
+			{
+				size_t open = trimmed.find('"');
+				size_t close = open == std::string::npos ? open : trimmed.find('"', open + 1);
+				if (close == std::string::npos)
+				{
+					std::cout << "ERROR::SHADER::MALFORMED INCLUDE: " << path << ":" << lineNumber << std::endl;
+					return false;
+				}
+
+				std::string includePath = DirectoryOf(path) + trimmed.substr(open + 1, close - open - 1);
+				if (std::find(included.begin(), included.end(), includePath) == included.end())
+				{
+					if (!ProcessFile(includePath, depth + 1, included, dependencies, output, nullptr))
+						return false;
+				}
+				output += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+				continue;
+			}
+
+			output += line + "\n";
+		}
+		return true;
+	}
+}
+
+
+bool ShaderPreprocessor::ReadFile(const std::string& path, std::string& content)
+{
+	std::ifstream shaderFile;
+
+	// ensure file stream objects can throw exceptions:
+	shaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+	try
+	{
+		shaderFile.open(path);
+
+		// read file's buffer contents into stream
+		std::stringstream shaderStream;
+		shaderStream << shaderFile.rdbuf();
+		shaderFile.close();
+
+		// convert stream into string
+		content = shaderStream.str();
+		return true;
+	}
+	catch (const std::ifstream::failure&)
+	{
+		std::cout << "ERROR::SHADER::UNABLE TO READ FILE: " << path << std::endl;
+	}
+	return false;
+}
+
+
+bool ShaderPreprocessor::Process(const std::string& path, const std::vector<std::string>& defines,
+	std::string& output, std::vector<std::string>& dependencies)
+{
+	std::vector<std::string> included;
+	std::string body;
+	size_t versionEnd = 0;
+	if (!ProcessFile(path, 0, included, dependencies, body, &versionEnd))
+		return false;
+
+	std::string defineLines;
+	for (std::string define : defines)
+	{
+		std::replace(define.begin(), define.end(), '=', ' ');
+		std::string name = define.substr(0, define.find(' '));
+		if (!name.empty() && ContainsIdentifier(body, name))
+			defineLines += "#define " + define + "\n";
+	}
+
+	output = body.substr(0, versionEnd) + defineLines + body.substr(versionEnd);
+	return true;
+}
+
+
+ShaderSources ShaderPreprocessor::Load(const std::string& vertexPath, const std::string& fragmentPath,
+	const std::vector<std::string>& defines)
+{
+	ShaderSources sources;
+	sources.vertexPath = vertexPath;
+	sources.fragmentPath = fragmentPath;
+	sources.defines = defines;
+	// both stages are read so every dependency gets watched, even after a failure
+	bool vertexRead = Process(vertexPath, defines, sources.vertexCode, sources.dependencies);
+	bool fragmentRead = Process(fragmentPath, defines, sources.fragmentCode, sources.dependencies);
+	sources.complete = vertexRead && fragmentRead;
+	if (!sources.complete)
+	{
+		sources.vertexCode.clear();
+		sources.fragmentCode.clear();
+	}
+	return sources;
+}
+
+
+ShaderSources ShaderPreprocessor::LoadCompute(const std::string& computePath, const std::vector<std::string>& defines)
+{
+	ShaderSources sources;
+	sources.computePath = computePath;
+	sources.defines = defines;
+	sources.complete = Process(computePath, defines, sources.computeCode, sources.dependencies);
+	if (!sources.complete)
+		sources.computeCode.clear();
+	return sources;
+}
@@ -0,0 +1,77 @@
+#ifndef SHADER_PREPROCESSOR_H
+#define SHADER_PREPROCESSOR_H
+
+#include <string>
+#include <vector>
+
+/*!
+ * Shader files after preprocessing, ready to compile
+ *
+ */
+struct ShaderSources
+{
+	std::string vertexPath;
+	std::string fragmentPath;
+	std::string computePath;
+	std::vector<std::string> defines;
+
+	std::string vertexCode;
+	std::string fragmentCode;
+	std::string computeCode;
+
+	// every file read, the stage files and their includes
+	std::vector<std::string> dependencies;
+
+	// false when a file or an include could not be read, the code is then left empty
+	bool complete = false;
+};
+
+/*!
+ * Source level preprocessing done before handing shaders to OpenGL
+ *
+ * Resolves #include "file" relative to the including file (each file is
+ * included once) and injects #define lines right after #version. Defines
+ * whose name never appears in the source are dropped, so variants that only
+ * differ by unused keywords end up with the same source.
+ * #line directives keep compile errors pointing at the original lines, the
+ * source string number is the index of the file in dependencies.
+ */
+namespace ShaderPreprocessor
+{
+	/*!
+	 * Read a whole file
+	 *
+	 * \param path : path till file
+	 * \param content : receives the content of the file
+	 * \return : false(bool) if the file can not be read
+	 */
+	bool ReadFile(const std::string& path, std::string& content);
+
+	/*!
+	 * Preprocess one shader file
+	 *
+	 * \param path : path till shader file
+	 * \param defines : "NAME" or "NAME VALUE" or "NAME=VALUE"
+	 * \param output : receives the preprocessed source
+	 * \param dependencies : files read are appended, duplicates skipped
+	 * \return : false(bool) if the file or one of its includes can not be read
+	 */
+	bool Process(const std::string& path, const std::vector<std::string>& defines,
+		std::string& output, std::vector<std::string>& dependencies);
+
+	/*!
+	 * Preprocess a vertex + fragment pair
+	 *
+	 * \return : sources, not complete and without code if a file can not be read
+	 */
+	ShaderSources Load(const std::string& vertexPath, const std::string& fragmentPath,
+		const std::vector<std::string>& defines);
+
+	/*!
+	 * Preprocess a compute shader
+	 *
+	 * \return : sources, not complete and without code if a file can not be read
+	 */
+	ShaderSources LoadCompute(const std::string& computePath, const std::vector<std::string>& defines);
+}
+#endif
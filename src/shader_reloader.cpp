@@ -0,0 +1,287 @@
+#include "shader_reloader.h"
+#include <algorithm>
+#include <iostream>
+#include <glew.h>
+#include <glfw3.h>
+
+
+ShaderReloader::ShaderReloader(GLFWwindow* window)
+	: m_ParallelCompile(GLEW_KHR_parallel_shader_compile != GL_FALSE), m_WorkerWindow(nullptr), m_Quit(false)
+{
+	if (m_ParallelCompile)
+	{
+		// let the driver use as many compiler threads as it wants
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+		return;
+	}
+
+	// hidden window only there for a context sharing programs with the main one
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	m_WorkerWindow = glfwCreateWindow(1, 1, "Shader Compiler", NULL, window);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+	if (!m_WorkerWindow)
+	{
+		std::cout << "ERROR::SHADER RELOADER::UNABLE TO CREATE COMPILE CONTEXT, RELOAD DISABLED" << std::endl;
+		return;
+	}
+	m_Worker = std::thread(&ShaderReloader::WorkerLoop, this);
+}
+
+ShaderReloader::~ShaderReloader()
+{
+	if (m_Worker.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Quit = true;
+		}
+		m_WakeUp.notify_all();
+		m_Worker.join();
+	}
+	if (m_WorkerWindow)
+		glfwDestroyWindow(m_WorkerWindow);
+
+	for (Pending& pending : m_Pending)
+	{
+		std::string log;
+		FinishProgram(pending.program, pending.stages, log);
+		glDeleteProgram(pending.program);
+	}
+	for (const Result& result : m_Results)
+		glDeleteProgram(result.program);
+}
+
+
+void ShaderReloader::watch(Shader* shader)
+{
+	m_Shaders.push_back(shader);
+	m_Generation[shader] = 0;
+	WatchDependencies(shader, shader->dependencies());
+}
+
+
+void ShaderReloader::WatchDependencies(Shader* shader, const std::vector<std::string>& dependencies)
+{
+	for (const std::string& path : dependencies)
+		m_Watcher.watchFile(path);
+	m_Dependencies[shader] = dependencies;
+}
+
+
+void ShaderReloader::update()
+{
+	if (m_Watcher.poll(m_Changed))
+	{
+		for (Shader* shader : m_Shaders)
+		{
+			const std::vector<std::string>& dependencies = m_Dependencies[shader];
+			for (const std::string& path : m_Changed)
+			{
+				if (std::find(dependencies.begin(), dependencies.end(), path) != dependencies.end())
+				{
+					StartRebuild(shader);
+					break;
+				}
+			}
+		}
+	}
+
+	if (m_ParallelCompile)
+	{
+		PollPending();
+		return;
+	}
+
+	std::vector<Result> results;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		results.swap(m_Results);
+	}
+	for (const Result& result : results)
+		ApplyResult(result);
+}
+
+
+void ShaderReloader::StartRebuild(Shader* shader)
+{
+	if (!m_ParallelCompile && !m_Worker.joinable())
+		return;
+
+	Job job;
+	job.shader = shader;
+	job.generation = ++m_Generation[shader];
+	if (shader->computePath().empty())
+		job.sources = ShaderPreprocessor::Load(shader->vertexPath(), shader->fragmentPath(), shader->defines());
+	else
+		job.sources = ShaderPreprocessor::LoadCompute(shader->computePath(), shader->defines());
+
+	// an edit may have added includes
+	WatchDependencies(shader, job.sources.dependencies);
+	if (!job.sources.complete)
+	{
+		std::cout << "ERROR::SHADER RELOADER::KEEPING PREVIOUS PROGRAM, SOURCES INCOMPLETE" << std::endl;
+		return;
+	}
+
+	if (m_ParallelCompile)
+	{
+		Pending pending;
+		pending.shader = shader;
+		pending.generation = job.generation;
+		pending.program = BuildProgram(job.sources, pending.stages);
+		m_Pending.push_back(pending);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Jobs.push_back(job);
+	}
+	m_WakeUp.notify_one();
+}
+
+
+void ShaderReloader::PollPending()
+{
+	for (size_t i = 0; i < m_Pending.size(); )
+	{
+		Pending& pending = m_Pending[i];
+
+		int completed = GL_FALSE;
+		glGetProgramiv(pending.program, GL_COMPLETION_STATUS_KHR, &completed);
+		if (!completed)
+		{
+			++i;
+			continue;
+		}
+
+		Result result;
+		result.shader = pending.shader;
+		result.generation = pending.generation;
+		result.program = pending.program;
+		if (!FinishProgram(pending.program, pending.stages, result.log))
+		{
+			glDeleteProgram(result.program);
+			result.program = 0;
+		}
+		ApplyResult(result);
+
+		m_Pending[i] = m_Pending.back();
+		m_Pending.pop_back();
+	}
+}
+
+
+void ShaderReloader::ApplyResult(const Result& result)
+{
+	if (!result.program)
+	{
+		std::cout << "ERROR::SHADER RELOADER::KEEPING PREVIOUS PROGRAM\n" << result.log << "\n -- --------------------------------------------------- -- " << std::endl;
+		return;
+	}
+
+	// an older build finishing after a newer edit is dropped
+	if (result.generation != m_Generation[result.shader])
+	{
+		glDeleteProgram(result.program);
+		return;
+	}
+
+	result.shader->replaceProgram(result.program);
+	if (result.shader->computePath().empty())
+		std::cout << "SHADER RELOADED: " << result.shader->vertexPath() << " " << result.shader->fragmentPath() << std::endl;
+	else
+		std::cout << "SHADER RELOADED: " << result.shader->computePath() << std::endl;
+}
+
+
+void ShaderReloader::WorkerLoop()
+{
+	glfwMakeContextCurrent(m_WorkerWindow);
+
+	for (;;)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_WakeUp.wait(lock, [this]() { return m_Quit || !m_Jobs.empty(); });
+			if (m_Quit)
+				break;
+			job = m_Jobs.front();
+			m_Jobs.pop_front();
+		}
+
+		Result result;
+		result.shader = job.shader;
+		result.generation = job.generation;
+
+		std::vector<unsigned int> stages;
+		result.program = BuildProgram(job.sources, stages);
+		if (!FinishProgram(result.program, stages, result.log))
+		{
+			glDeleteProgram(result.program);
+			result.program = 0;
+		}
+		// the render context must see a complete program
+		glFinish();
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Results.push_back(result);
+	}
+
+	glfwMakeContextCurrent(NULL);
+}
+
+
+unsigned int ShaderReloader::BuildProgram(const ShaderSources& sources, std::vector<unsigned int>& stages)
+{
+	unsigned int program = glCreateProgram();
+
+	const std::string* codes[] = { &sources.vertexCode, &sources.fragmentCode, &sources.computeCode };
+	const GLenum types[] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_COMPUTE_SHADER };
+	for (int i = 0; i < 3; ++i)
+	{
+		if (codes[i]->empty())
+			continue;
+
+		unsigned int stage = glCreateShader(types[i]);
+		const char* source = codes[i]->c_str();
+		glShaderSource(stage, 1, &source, nullptr);
+		glCompileShader(stage);
+		glAttachShader(program, stage);
+		stages.push_back(stage);
+	}
+
+	glLinkProgram(program);
+	return program;
+}
+
+
+bool ShaderReloader::FinishProgram(unsigned int program, std::vector<unsigned int>& stages, std::string& log)
+{
+	char infoLog[1024];
+	int success;
+
+	for (unsigned int stage : stages)
+	{
+		glGetShaderiv(stage, GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			glGetShaderInfoLog(stage, 1024, NULL, infoLog);
+			log += infoLog;
+		}
+		glDetachShader(program, stage);
+		glDeleteShader(stage);
+	}
+	stages.clear();
+
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		glGetProgramInfoLog(program, 1024, NULL, infoLog);
+		log += infoLog;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,116 @@
+#ifndef SHADER_RELOADER_H
+#define SHADER_RELOADER_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "shader.h"
+#include "file_watcher.h"
+
+struct GLFWwindow;
+
+/*!
+ * Hot reload of shader programs
+ *
+ * Watches the source files of registered shaders, includes too. An edited program is
+ * rebuilt in the background and swapped in between two frames only once it
+ * linked successfully, a broken edit keeps the running program.
+ * With KHR_parallel_shader_compile the driver compiles on its own threads and
+ * the completion status is polled every frame, otherwise a worker thread
+ * compiles with a hidden context sharing objects with the main one.
+ */
+class ShaderReloader
+{
+public:
+	/*!
+	 * \param window : window owning the main context, must be current on the calling thread
+	 */
+	explicit ShaderReloader(GLFWwindow* window);
+	~ShaderReloader();
+
+	ShaderReloader(const ShaderReloader&) = delete;
+	ShaderReloader& operator=(const ShaderReloader&) = delete;
+
+	/*!
+	 * Reload the shader when one of its source files changes
+	 *
+	 * \param shader : has to outlive the reloader
+	 */
+	void watch(Shader* shader);
+
+	/*!
+	 * Check for edits and swap finished programs, once per frame on the render thread
+	 *
+	 */
+	void update();
+
+private:
+
+	struct Job
+	{
+		Shader* shader;
+		unsigned int generation;
+		ShaderSources sources;
+	};
+
+	/*!
+	 * Program being built, only used with KHR_parallel_shader_compile
+	 *
+	 */
+	struct Pending
+	{
+		Shader* shader;
+		unsigned int generation;
+		unsigned int program;
+		std::vector<unsigned int> stages;
+	};
+
+	struct Result
+	{
+		Shader* shader;
+		unsigned int generation;
+		unsigned int program;
+		std::string log;
+	};
+
+	FileWatcher m_Watcher;
+	std::vector<Shader*> m_Shaders;
+	std::unordered_map<Shader*, unsigned int> m_Generation;
+	std::unordered_map<Shader*, std::vector<std::string>> m_Dependencies;
+	std::vector<std::string> m_Changed;
+	bool m_ParallelCompile;
+
+	std::vector<Pending> m_Pending;
+
+	GLFWwindow* m_WorkerWindow;
+	std::thread m_Worker;
+	std::mutex m_Mutex;
+	std::condition_variable m_WakeUp;
+	std::deque<Job> m_Jobs;
+	std::vector<Result> m_Results;
+	bool m_Quit;
+
+	void WatchDependencies(Shader* shader, const std::vector<std::string>& dependencies);
+	void StartRebuild(Shader* shader);
+	void PollPending();
+	void ApplyResult(const Result& result);
+	void WorkerLoop();
+
+	/*!
+	 * Create, compile and link without waiting on the driver
+	 *
+	 */
+	static unsigned int BuildProgram(const ShaderSources& sources, std::vector<unsigned int>& stages);
+
+	/*!
+	 * Status of a finished build, stages are deleted
+	 *
+	 * \return : true(bool) if the program linked, log holds the errors otherwise
+	 */
+	static bool FinishProgram(unsigned int program, std::vector<unsigned int>& stages, std::string& log);
+};
+#endif
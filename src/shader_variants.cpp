@@ -0,0 +1,111 @@
+#include "shader_variants.h"
+#include <iostream>
+
+
+uint64_t ShaderVariants::keyword(const std::string& name)
+{
+	for (size_t i = 0; i < m_Keywords.size(); ++i)
+	{
+		if (m_Keywords[i] == name)
+			return 1ull << i;
+	}
+
+	if (m_Keywords.size() == MAX_KEYWORDS)
+	{
+		std::cout << "ERROR::SHADER VARIANTS::TOO MANY KEYWORDS, IGNORING: " << name << std::endl;
+		return 0;
+	}
+	m_Keywords.push_back(name);
+	return 1ull << (m_Keywords.size() - 1);
+}
+
+
+Shader& ShaderVariants::get(const std::string& vertexPath, const std::string& fragmentPath, uint64_t keywords)
+{
+	Shader& shader = request(vertexPath, fragmentPath, keywords);
+	if (m_BatchedCount > 0)
+		prewarm();
+	return shader;
+}
+
+
+Shader& ShaderVariants::request(const std::string& vertexPath, const std::string& fragmentPath, uint64_t keywords)
+{
+	std::string key = VariantKey(vertexPath, fragmentPath, keywords);
+	auto variant = m_Variants.find(key);
+	if (variant != m_Variants.end())
+		return *variant->second;
+
+	ShaderSources sources = ShaderPreprocessor::Load(vertexPath, fragmentPath, defines(keywords));
+
+	// unused keywords were stripped by the preprocessor, equal sources give equal programs,
+	// a variant that failed to load keeps a program of its own
+	std::string sourceKey = sources.complete ? sources.vertexCode + '\0' + sources.fragmentCode : key;
+	std::unique_ptr<Shader>& program = m_ProgramsBySource[sourceKey];
+	if (!program)
+	{
+		program.reset(new Shader());
+		m_Batch.add(program.get(), sources);
+		++m_BatchedCount;
+	}
+
+	m_Variants[key] = program.get();
+	return *program;
+}
+
+
+void ShaderVariants::prewarm()
+{
+	unsigned int batched = m_BatchedCount;
+	m_BatchedCount = 0;
+	unsigned int failures = m_Batch.build();
+	std::cout << "SHADER VARIANTS::PREWARMED " << batched << " PROGRAMS IN "
+		<< m_Batch.lastBuildMilliseconds() << " ms, " << failures << " FAILED" << std::endl;
+}
+
+
+void ShaderVariants::prewarm(const std::vector<Request>& requests)
+{
+	for (const Request& request : requests)
+		this->request(request.vertexPath, request.fragmentPath, request.keywords);
+	prewarm();
+}
+
+
+size_t ShaderVariants::variantCount() const
+{
+	return m_Variants.size();
+}
+
+
+size_t ShaderVariants::programCount() const
+{
+	return m_ProgramsBySource.size();
+}
+
+
+std::vector<Shader*> ShaderVariants::programs() const
+{
+	std::vector<Shader*> shaders;
+	for (const auto& program : m_ProgramsBySource)
+		shaders.push_back(program.second.get());
+	return shaders;
+}
+
+
+std::string ShaderVariants::VariantKey(const std::string& vertexPath, const std::string& fragmentPath, uint64_t keywords) const
+{
+	return vertexPath + '\0' + fragmentPath + '\0' + std::to_string(keywords);
+}
+
+
+std::vector<std::string> ShaderVariants::defines(uint64_t keywords) const
+{
+	std::vector<std::string> defines;
+	for (size_t i = 0; i < m_Keywords.size(); ++i)
+	{
+		if (keywords & (1ull << i))
+			defines.push_back(m_Keywords[i]);
+	}
+	return defines;
+}
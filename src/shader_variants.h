@@ -0,0 +1,107 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "shader.h"
+#include "shader_batch.h"
+
+/*!
+ * Permutations of a shader selected by feature keywords
+ *
+ * A keyword becomes a #define of the same name in the variants asking for
+ * it, so features are resolved at compile time instead of branching in the
+ * shader. Only requested permutations are compiled, either lazily on first
+ * use or up front with prewarm. Variants whose preprocessed sources are
+ * identical, like ones differing only by keywords the shader never tests,
+ * share one program.
+ */
+class ShaderVariants
+{
+public:
+	static const unsigned int MAX_KEYWORDS = 64;
+
+	/*!
+	 * Register a feature keyword
+	 *
+	 * \param name : define name, like "INSTANCED"
+	 * \return : bit to combine into a keyword mask, the same bit for the same name
+	 */
+	uint64_t keyword(const std::string& name);
+
+	/*!
+	 * Program for a vertex + fragment pair with a set of keywords, compiled on first request.
+	 * Variants requested and not prewarmed yet are built first.
+	 *
+	 * \param vertexPath : path till vertex shader
+	 * \param fragmentPath : path till fragment shader
+	 * \param keywords : mask of keyword bits
+	 */
+	Shader& get(const std::string& vertexPath, const std::string& fragmentPath, uint64_t keywords);
+
+	/*!
+	 * Declare a variant to compile with the next prewarm
+	 *
+	 * \return : the variant, its program is 0 until prewarm or get ran
+	 */
+	Shader& request(const std::string& vertexPath, const std::string& fragmentPath, uint64_t keywords);
+
+	/*!
+	 * Variant request for prewarm
+	 *
+	 */
+	struct Request
+	{
+		std::string vertexPath;
+		std::string fragmentPath;
+		uint64_t keywords;
+	};
+
+	/*!
+	 * Compile the requested variants ahead of their first use, as one ShaderBatch
+	 * so the driver can compile them in parallel
+	 *
+	 */
+	void prewarm();
+
+	/*!
+	 * Request a list of variants and prewarm them
+	 *
+	 */
+	void prewarm(const std::vector<Request>& requests);
+
+	/*!
+	 * Define names of a keyword mask, for sources loaded outside of the variants
+	 *
+	 */
+	std::vector<std::string> defines(uint64_t keywords) const;
+
+	/*!
+	 * Requested variants and distinct programs behind them
+	 *
+	 */
+	size_t variantCount() const;
+	size_t programCount() const;
+
+	/*!
+	 * Every distinct program, to register them with a ShaderReloader
+	 *
+	 */
+	std::vector<Shader*> programs() const;
+
+private:
+
+	std::vector<std::string> m_Keywords;
+	std::unordered_map<std::string, Shader*> m_Variants;
+	std::unordered_map<std::string, std::unique_ptr<Shader>> m_ProgramsBySource;
+
+	// requested programs waiting for prewarm
+	ShaderBatch m_Batch;
+	unsigned int m_BatchedCount = 0;
+
+	std::string VariantKey(const std::string& vertexPath, const std::string& fragmentPath, uint64_t keywords) const;
+};
+#endif
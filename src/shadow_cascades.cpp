@@ -0,0 +1,258 @@
+#include "shadow_cascades.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <gtc/matrix_transform.hpp>
+#include "gl_state_cache.h"
+
+
+ShadowCascades::ShadowCascades()
+	: ShadowCascades(Options())
+{
+}
+
+ShadowCascades::ShadowCascades(const Options& options)
+	: m_Options(options), m_LightDirection(0.0f), m_Viewport(0), m_TargetFramebuffer(0)
+{
+	m_Options.cascadeCount = glm::clamp(m_Options.cascadeCount, 1u, MAX_CASCADES);
+	m_Options.resolution = std::max(m_Options.resolution, 16u);
+
+	// cascades are the quarters of the atlases
+	GpuResources& resources = GpuResources::instance();
+	GLStateCache& state = GLStateCache::instance();
+	GLsizei size = (GLsizei)(m_Options.resolution * 2);
+	GpuHandle* atlases[] = { &m_StaticAtlas, &m_CompositeAtlas };
+	GpuHandle* framebuffers[] = { &m_StaticFramebuffer, &m_CompositeFramebuffer };
+	for (int i = 0; i < 2; ++i)
+	{
+		*atlases[i] = resources.createTexture(GL_TEXTURE_2D);
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, size, size);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+		resources.setTextureBytes(*atlases[i], (uint64_t)size * size * sizeof(float));
+
+		*framebuffers[i] = resources.createFramebuffer();
+		state.bindFramebuffer(GL_FRAMEBUFFER, resources.name(*framebuffers[i]));
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, resources.name(*atlases[i]), 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			std::cout << "ERROR::SHADOW CASCADES::INCOMPLETE FRAMEBUFFER" << std::endl;
+	}
+	state.bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+ShadowCascades::~ShadowCascades()
+{
+	GpuResources& resources = GpuResources::instance();
+	resources.release(m_StaticFramebuffer);
+	resources.release(m_CompositeFramebuffer);
+	resources.release(m_StaticAtlas);
+	resources.release(m_CompositeAtlas);
+}
+
+
+void ShadowCascades::update(const glm::mat4& view, float fovY, float aspect, float nearPlane, const glm::vec3& lightDirection,
+	const glm::uvec2& viewport, GLuint framebuffer)
+{
+	m_Viewport = viewport;
+	m_TargetFramebuffer = framebuffer;
+	glm::vec3 direction = glm::normalize(lightDirection);
+	if (glm::dot(direction, m_LightDirection) < 0.99999f)
+	{
+		m_LightDirection = direction;
+		invalidate();
+	}
+
+	glm::mat4 cameraToWorld = glm::inverse(view);
+	float tanY = std::tan(fovY * 0.5f);
+	float tanX = tanY * aspect;
+	glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	float splitNear = nearPlane;
+	for (unsigned int i = 0; i < m_Options.cascadeCount; ++i)
+	{
+		// practical split scheme, a blend of uniform and logarithmic
+		float ratio = (float)(i + 1) / m_Options.cascadeCount;
+		float uniform = nearPlane + (m_Options.maxDistance - nearPlane) * ratio;
+		float logarithmic = nearPlane * std::pow(m_Options.maxDistance / nearPlane, ratio);
+		float splitFar = uniform + (logarithmic - uniform) * m_Options.splitLambda;
+
+		// bounding sphere of the slice of the frustum, it does not change as the camera turns
+		glm::vec3 corners[8];
+		glm::vec3 center(0.0f);
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			float depth = (corner & 4) ? splitFar : splitNear;
+			glm::vec4 point((corner & 1 ? 1.0f : -1.0f) * tanX * depth, (corner & 2 ? 1.0f : -1.0f) * tanY * depth, -depth, 1.0f);
+			corners[corner] = glm::vec3(cameraToWorld * point);
+			center += corners[corner] * 0.125f;
+		}
+		float radius = 0.0f;
+		for (const glm::vec3& corner : corners)
+			radius = std::max(radius, glm::length(corner - center));
+
+		Cascade& cascade = m_Cascades[i];
+		cascade.splitFar = splitFar;
+		cascade.staticDrawn = false;
+		bool contained = glm::length(center - cascade.center) + radius <= cascade.radius;
+		bool tooCoarse = radius * (1.0f + m_Options.margin) < cascade.radius * 0.5f;
+		if (!cascade.staticValid || !contained || tooCoarse)
+		{
+			cascade.staticValid = false;
+			cascade.radius = radius * (1.0f + m_Options.margin);
+
+			// center snapped to whole texels in light space so refits do not swim
+			glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), direction, up);
+			float texel = 2.0f * cascade.radius / m_Options.resolution;
+			glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+			lightCenter.x = std::floor(lightCenter.x / texel) * texel;
+			lightCenter.y = std::floor(lightCenter.y / texel) * texel;
+			cascade.center = glm::vec3(glm::inverse(lightView) * glm::vec4(lightCenter, 1.0f));
+
+			float depthRange = cascade.radius + m_Options.casterDistance;
+			glm::mat4 casterView = glm::lookAt(cascade.center - direction * depthRange, cascade.center, up);
+			glm::mat4 projection = glm::ortho(-cascade.radius, cascade.radius, -cascade.radius, cascade.radius, 0.0f, depthRange + cascade.radius);
+			cascade.viewProjection = projection * casterView;
+		}
+		splitNear = splitFar;
+	}
+}
+
+
+void ShadowCascades::invalidate()
+{
+	for (Cascade& cascade : m_Cascades)
+		cascade.staticValid = false;
+}
+
+
+void ShadowCascades::invalidate(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	for (unsigned int i = 0; i < m_Options.cascadeCount; ++i)
+	{
+		Cascade& cascade = m_Cascades[i];
+		if (!cascade.staticValid)
+			continue;
+
+		glm::vec3 ndcMin(INFINITY), ndcMax(-INFINITY);
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			glm::vec3 point((corner & 1) ? boundsMax.x : boundsMin.x, (corner & 2) ? boundsMax.y : boundsMin.y, (corner & 4) ? boundsMax.z : boundsMin.z);
+			glm::vec3 ndc = glm::vec3(cascade.viewProjection * glm::vec4(point, 1.0f));
+			ndcMin = glm::min(ndcMin, ndc);
+			ndcMax = glm::max(ndcMax, ndc);
+		}
+		if (ndcMax.x >= -1.0f && ndcMin.x <= 1.0f && ndcMax.y >= -1.0f && ndcMin.y <= 1.0f && ndcMax.z >= -1.0f && ndcMin.z <= 1.0f)
+			cascade.staticValid = false;
+	}
+}
+
+
+void ShadowCascades::render(const std::function<void(const glm::mat4&)>& drawStatic, const std::function<void(const glm::mat4&)>& drawDynamic)
+{
+	GpuResources& resources = GpuResources::instance();
+	GLStateCache& state = GLStateCache::instance();
+	m_Stats = ShadowStats();
+
+	state.depthMask(GL_TRUE);
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(1.5f, 2.0f);
+	for (unsigned int i = 0; i < m_Options.cascadeCount; ++i)
+	{
+		Cascade& cascade = m_Cascades[i];
+		if (!cascade.staticValid)
+		{
+			state.bindFramebuffer(GL_FRAMEBUFFER, resources.name(m_StaticFramebuffer));
+			DrawCascade(i, true, drawStatic);
+			cascade.staticValid = true;
+			cascade.staticDrawn = true;
+			++m_Stats.staticRenders;
+		}
+
+		// the composite follows the cache, plus the dynamic casters of this frame
+		if (!cascade.staticDrawn && !drawDynamic && !cascade.compositeDynamic)
+		{
+			++m_Stats.cachedCascades;
+			continue;
+		}
+		glm::ivec4 rect = CascadeRect(i);
+		glCopyImageSubData(resources.name(m_StaticAtlas), GL_TEXTURE_2D, 0, rect.x, rect.y, 0,
+			resources.name(m_CompositeAtlas), GL_TEXTURE_2D, 0, rect.x, rect.y, 0, rect.z, rect.w, 1);
+		cascade.compositeDynamic = (bool)drawDynamic;
+		if (drawDynamic)
+		{
+			state.bindFramebuffer(GL_FRAMEBUFFER, resources.name(m_CompositeFramebuffer));
+			DrawCascade(i, false, drawDynamic);
+			++m_Stats.composites;
+		}
+	}
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	state.setEnabled(GL_SCISSOR_TEST, false);
+	state.bindFramebuffer(GL_FRAMEBUFFER, m_TargetFramebuffer);
+	state.viewport(0, 0, (GLsizei)m_Viewport.x, (GLsizei)m_Viewport.y);
+}
+
+
+void ShadowCascades::bind(Shader& shader, unsigned int unit) const
+{
+	GLStateCache::instance().bindTexture(unit, GL_TEXTURE_2D, GpuResources::instance().name(m_CompositeAtlas));
+	shader.setInt("shadowAtlas", (int)unit);
+	shader.setInt("cascadeCount", (int)m_Options.cascadeCount);
+	shader.setVec3("sunDirection", m_LightDirection);
+
+	glm::mat4 matrices[MAX_CASCADES];
+	glm::vec4 splits(0.0f), texels(0.0f);
+	for (unsigned int i = 0; i < m_Options.cascadeCount; ++i)
+	{
+		// clip space of the cascade to its quarter of the atlas
+		glm::vec2 tile(i % 2 ? 0.5f : 0.0f, i / 2 ? 0.5f : 0.0f);
+		glm::mat4 toAtlas = glm::translate(glm::mat4(1.0f), glm::vec3(tile + 0.25f, 0.5f));
+		toAtlas = glm::scale(toAtlas, glm::vec3(0.25f, 0.25f, 0.5f));
+		matrices[i] = toAtlas * m_Cascades[i].viewProjection;
+		splits[i] = m_Cascades[i].splitFar;
+		texels[i] = 2.0f * m_Cascades[i].radius / m_Options.resolution;
+	}
+	shader.setMat4Array("cascadeMatrices", matrices, (int)m_Options.cascadeCount);
+	shader.setVec4("cascadeSplits", splits);
+	shader.setVec4("cascadeTexels", texels);
+	shader.setFloat("shadowAtlasTexel", 1.0f / (m_Options.resolution * 2));
+}
+
+
+const ShadowStats& ShadowCascades::stats() const
+{
+	return m_Stats;
+}
+
+
+void ShadowCascades::reportTo(Profiler& profiler) const
+{
+	profiler.addCounter("SHADOW STATIC RENDERS", m_Stats.staticRenders);
+	profiler.addCounter("SHADOW COMPOSITES", m_Stats.composites);
+	profiler.addCounter("SHADOW CACHED CASCADES", m_Stats.cachedCascades);
+}
+
+
+glm::ivec4 ShadowCascades::CascadeRect(unsigned int cascade) const
+{
+	int size = (int)m_Options.resolution;
+	return glm::ivec4((cascade % 2) * size, (cascade / 2) * size, size, size);
+}
+
+
+void ShadowCascades::DrawCascade(unsigned int cascade, bool clear, const std::function<void(const glm::mat4&)>& draw)
+{
+	GLStateCache& state = GLStateCache::instance();
+	glm::ivec4 rect = CascadeRect(cascade);
+	state.viewport(rect.x, rect.y, rect.z, rect.w);
+	state.setEnabled(GL_SCISSOR_TEST, true);
+	glScissor(rect.x, rect.y, rect.z, rect.w);
+	if (clear)
+		glClear(GL_DEPTH_BUFFER_BIT);
+	draw(m_Cascades[cascade].viewProjection);
+}
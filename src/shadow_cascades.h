@@ -0,0 +1,141 @@
+#ifndef SHADOW_CASCADES_H
+#define SHADOW_CASCADES_H
+
+#include <functional>
+#include <glm.hpp>
+#include <glew.h>
+#include "gpu_resources.h"
+#include "profiler.h"
+#include "shader.h"
+
+/*!
+ * Counters of ShadowCascades, for the last frame
+ *
+ */
+struct ShadowStats
+{
+	unsigned int staticRenders = 0;     // cascades whose static casters were drawn again
+	unsigned int composites = 0;        // cascades where dynamic casters were drawn over the cache
+	unsigned int cachedCascades = 0;    // cascades used as they were
+};
+
+/*!
+ * Cached cascaded shadow maps of a directional light
+ *
+ * The cascades are tiles of a persistent atlas holding the depth of the
+ * static casters only. A cascade is fitted around a bounding sphere of its
+ * part of the view frustum, grown by a margin, and only drawn again when
+ * the sphere leaves the cached one, when the light turns or when static
+ * casters inside it change. Dynamic casters are drawn every frame over a
+ * copy of the static depth in a second atlas, the one sampled by shading,
+ * so a static scene costs the lookups and nothing more.
+ */
+class ShadowCascades
+{
+public:
+	static const unsigned int MAX_CASCADES = 4;
+
+	struct Options
+	{
+		unsigned int cascadeCount = 4;
+		unsigned int resolution = 1024;     // texels per side of a cascade
+		float maxDistance = 20.0f;          // depth covered by the last cascade
+		float splitLambda = 0.75f;          // 0 uniform splits, 1 logarithmic splits
+		float margin = 0.25f;               // extra radius of a cached cascade, relative
+		float casterDistance = 20.0f;       // casters this far towards the light still cast
+	};
+
+	ShadowCascades();
+	explicit ShadowCascades(const Options& options);
+	~ShadowCascades();
+
+	ShadowCascades(const ShadowCascades&) = delete;
+	ShadowCascades& operator=(const ShadowCascades&) = delete;
+
+	/*!
+	 * Fit the cascades to the camera and find those to draw again, call once per frame
+	 *
+	 * \param view : world to view matrix of the camera
+	 * \param fovY : vertical field of view, radians
+	 * \param aspect : width / height of the projection
+	 * \param nearPlane : near plane of the projection
+	 * \param lightDirection : direction the light travels, world space
+	 * \param viewport : framebuffer size, restored after render
+	 * \param framebuffer : framebuffer bound after render, 0 for the window
+	 */
+	void update(const glm::mat4& view, float fovY, float aspect, float nearPlane, const glm::vec3& lightDirection,
+		const glm::uvec2& viewport, GLuint framebuffer = 0);
+
+	/*!
+	 * Static casters changed everywhere, every cascade is drawn again
+	 *
+	 */
+	void invalidate();
+
+	/*!
+	 * Static casters changed inside a box, the cascades covering it are drawn again
+	 *
+	 */
+	void invalidate(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+	/*!
+	 * Draw what changed into the atlases
+	 *
+	 * The callbacks draw depth only with the given light view projection,
+	 * the shadow program bound by the caller.
+	 *
+	 * \param drawStatic : draws the static casters
+	 * \param drawDynamic : draws the casters moving this frame, can be empty
+	 */
+	void render(const std::function<void(const glm::mat4&)>& drawStatic, const std::function<void(const glm::mat4&)>& drawDynamic);
+
+	/*!
+	 * Bind the atlas and set the cascade uniforms, the shader has to be in use
+	 *
+	 * \param shader : program including res/shadows.glsl
+	 * \param unit : texture unit for the atlas
+	 */
+	void bind(Shader& shader, unsigned int unit) const;
+
+	const ShadowStats& stats() const;
+
+	void reportTo(Profiler& profiler) const;
+
+private:
+
+	struct Cascade
+	{
+		float splitFar = 0.0f;          // view depth where the cascade ends
+		glm::vec3 center;               // cached fit, world space
+		float radius = 0.0f;
+		glm::mat4 viewProjection;       // light view projection of the cached fit
+		bool staticValid = false;
+		bool compositeDynamic = false;  // the composite holds dynamic casters
+		bool staticDrawn = false;       // this frame
+	};
+
+	Options m_Options;
+	Cascade m_Cascades[MAX_CASCADES];
+	glm::vec3 m_LightDirection;
+	glm::uvec2 m_Viewport;
+	GLuint m_TargetFramebuffer;
+	ShadowStats m_Stats;
+
+	GpuHandle m_StaticAtlas;
+	GpuHandle m_CompositeAtlas;
+	GpuHandle m_StaticFramebuffer;
+	GpuHandle m_CompositeFramebuffer;
+
+	/*!
+	 * Viewport of a cascade in the atlas
+	 *
+	 */
+	glm::ivec4 CascadeRect(unsigned int cascade) const;
+
+	/*!
+	 * Clear a cascade of the bound framebuffer and draw into it
+	 *
+	 */
+	void DrawCascade(unsigned int cascade, bool clear, const std::function<void(const glm::mat4&)>& draw);
+};
+#endif
@@ -0,0 +1,245 @@
+#include "terrain.h"
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include "mesh_cache.h"
+
+namespace
+{
+	std::string Lower(std::string text)
+	{
+		std::transform(text.begin(), text.end(), text.begin(), ::tolower);
+		return text;
+	}
+
+	bool EndsWith(const std::string& text, const std::string& suffix)
+	{
+		return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+	}
+
+	/*!
+	 * Next number of a PGM header, comments skipped
+	 *
+	 */
+	bool ReadPgmValue(std::istream& file, unsigned int& value)
+	{
+		int c = file.get();
+		while (file && (isspace(c) || c == '#'))
+		{
+			if (c == '#')
+			{
+				while (file && c != '\n')
+					c = file.get();
+			}
+			c = file.get();
+		}
+		if (!file || !isdigit(c))
+			return false;
+
+		value = 0;
+		while (file && isdigit(c))
+		{
+			value = value * 10 + (unsigned int)(c - '0');
+			c = file.get();
+		}
+		// the single whitespace after the last value is part of the header
+		return (bool)file;
+	}
+
+	/*!
+	 * Read a row of the heightmap as 16 bits samples
+	 *
+	 */
+	bool ReadRow(std::ifstream& file, const HeightmapInfo& info, unsigned int row, std::vector<char>& raw, std::vector<uint16_t>& samples)
+	{
+		unsigned int sampleBytes = info.sixteenBits ? 2 : 1;
+		raw.resize((size_t)info.size.x * sampleBytes);
+		file.clear();
+		file.seekg((std::streamoff)(info.dataOffset + (uint64_t)row * info.size.x * sampleBytes));
+		file.read(raw.data(), (std::streamsize)raw.size());
+		if (!file)
+			return false;
+
+		samples.resize(info.size.x);
+		const unsigned char* bytes = (const unsigned char*)raw.data();
+		for (unsigned int x = 0; x < info.size.x; ++x)
+		{
+			if (!info.sixteenBits)
+				samples[x] = (uint16_t)(bytes[x] * 257);
+			else if (info.bigEndian)
+				samples[x] = (uint16_t)((bytes[x * 2] << 8) | bytes[x * 2 + 1]);
+			else
+				samples[x] = (uint16_t)(bytes[x * 2] | (bytes[x * 2 + 1] << 8));
+		}
+		return true;
+	}
+}
+
+
+bool HeightmapIO::ReadPgmHeader(const std::string& path, HeightmapInfo& info)
+{
+	std::ifstream file(path, std::ios::binary);
+	char magic[2] = { 0, 0 };
+	unsigned int maxValue = 0;
+	info = HeightmapInfo();
+	if (!file.read(magic, 2) || magic[0] != 'P' || magic[1] != '5' ||
+		!ReadPgmValue(file, info.size.x) || !ReadPgmValue(file, info.size.y) || !ReadPgmValue(file, maxValue) ||
+		info.size.x < 2 || info.size.y < 2 || maxValue == 0 || maxValue > 65535)
+	{
+		std::cout << "ERROR::TERRAIN::NOT A BINARY PGM HEIGHTMAP: " << path << std::endl;
+		return false;
+	}
+
+	info.sixteenBits = maxValue > 255;
+	info.bigEndian = true;
+	info.dataPath = path;
+	info.dataOffset = (uint64_t)file.tellg();
+	return true;
+}
+
+
+bool HeightmapIO::ParseRawName(const std::string& path, HeightmapInfo& info)
+{
+	info = HeightmapInfo();
+	std::string name = Lower(path.substr(path.find_last_of("/\\") == std::string::npos ? 0 : path.find_last_of("/\\") + 1));
+
+	// first "AxB" group of the name
+	bool hasSize = false;
+	for (size_t i = 0; i < name.size() && !hasSize; ++i)
+	{
+		if (!isdigit((unsigned char)name[i]) || (i > 0 && isdigit((unsigned char)name[i - 1])))
+			continue;
+		unsigned int x = 0, y = 0;
+		char separator = 0;
+		std::istringstream dims(name.substr(i));
+		if (dims >> x >> separator >> y && separator == 'x')
+		{
+			info.size = glm::uvec2(x, y);
+			hasSize = true;
+		}
+	}
+
+	if (!hasSize || info.size.x < 2 || info.size.y < 2)
+	{
+		std::cout << "ERROR::TERRAIN::RAW FILE NAME MUST HOLD THE SIZE, E.G. NAME_16385X16385.R16: " << path << std::endl;
+		return false;
+	}
+	info.sixteenBits = !EndsWith(name, ".r8");
+	info.dataPath = path;
+	return true;
+}
+
+
+bool HeightmapIO::ReadInfo(const std::string& path, HeightmapInfo& info)
+{
+	if (EndsWith(Lower(path), ".pgm"))
+		return ReadPgmHeader(path, info);
+	return ParseRawName(path, info);
+}
+
+
+glm::uvec2 TerrainTiles::LevelTiles(const glm::uvec2& size, unsigned int level)
+{
+	unsigned int span = TILE_SIZE << level;
+	return glm::max(glm::uvec2(1), (size - glm::uvec2(1) + glm::uvec2(span - 1)) / span);
+}
+
+
+unsigned int TerrainTiles::FirstTile(const glm::uvec2& size, unsigned int level)
+{
+	unsigned int first = 0;
+	for (unsigned int l = 0; l < level; ++l)
+	{
+		glm::uvec2 tiles = LevelTiles(size, l);
+		first += tiles.x * tiles.y;
+	}
+	return first;
+}
+
+
+bool TerrainTiles::Build(const HeightmapInfo& info, const std::string& path)
+{
+	std::ifstream source(info.dataPath, std::ios::binary);
+	if (!source.is_open())
+	{
+		std::cout << "ERROR::TERRAIN::UNABLE TO OPEN FILE: " << info.dataPath << std::endl;
+		return false;
+	}
+
+	Header header;
+	header.size = info.size;
+	header.levelCount = 1;
+	while (header.levelCount < MAX_LEVELS && LevelTiles(info.size, header.levelCount - 1) != glm::uvec2(1))
+		++header.levelCount;
+	header.tileCount = FirstTile(info.size, header.levelCount);
+
+	MeshCacheWriter writer;
+	if (!writer.open(path))
+		return false;
+	writer.beginSection(MeshCache::TAG_TERRAIN_TILES);
+
+	std::vector<Tile> table;
+	table.reserve(header.tileCount);
+	std::vector<char> raw;
+	std::vector<uint16_t> row;
+	std::vector<uint16_t> strip;
+	std::vector<uint16_t> tile((size_t)TILE_SAMPLES * TILE_SAMPLES);
+	uint64_t offset = 0;
+	for (unsigned int level = 0; level < header.levelCount; ++level)
+	{
+		// every level is decimated straight from the source, reading about half the rows of the previous one
+		unsigned int step = 1u << level;
+		glm::uvec2 tiles = LevelTiles(info.size, level);
+		unsigned int stripWidth = tiles.x * TILE_SIZE + 1;
+		strip.resize((size_t)stripWidth * TILE_SAMPLES);
+		for (unsigned int ty = 0; ty < tiles.y; ++ty)
+		{
+			for (unsigned int y = 0; y < TILE_SAMPLES; ++y)
+			{
+				unsigned int sourceRow = std::min((ty * TILE_SIZE + y) * step, info.size.y - 1);
+				if (!ReadRow(source, info, sourceRow, raw, row))
+				{
+					std::cout << "ERROR::TERRAIN::TRUNCATED DATA: " << info.dataPath << std::endl;
+					return false;
+				}
+				uint16_t* out = strip.data() + (size_t)y * stripWidth;
+				for (unsigned int x = 0; x < stripWidth; ++x)
+					out[x] = row[std::min((uint64_t)x * step, (uint64_t)info.size.x - 1)];
+			}
+
+			for (unsigned int tx = 0; tx < tiles.x; ++tx)
+			{
+				Tile entry;
+				entry.offset = offset;
+				entry.heightMin = 0xFFFF;
+				entry.heightMax = 0;
+				entry.padding = 0;
+				for (unsigned int y = 0; y < TILE_SAMPLES; ++y)
+				{
+					const uint16_t* in = strip.data() + (size_t)y * stripWidth + tx * TILE_SIZE;
+					std::copy(in, in + TILE_SAMPLES, tile.begin() + (size_t)y * TILE_SAMPLES);
+					for (unsigned int x = 0; x < TILE_SAMPLES; ++x)
+					{
+						entry.heightMin = std::min(entry.heightMin, in[x]);
+						entry.heightMax = std::max(entry.heightMax, in[x]);
+					}
+				}
+				writer.appendSection(tile.data(), TILE_BYTES);
+				offset += TILE_BYTES;
+				table.push_back(entry);
+			}
+		}
+	}
+	writer.endSection();
+	writer.addSection(MeshCache::TAG_TERRAIN_HEADER, &header, sizeof(header));
+	writer.addSection(MeshCache::TAG_TERRAIN_TILE_TABLE, table.data(), table.size() * sizeof(Tile));
+	if (!writer.close())
+		return false;
+
+	std::cout << "TERRAIN::" << header.tileCount << " TILES IN " << header.levelCount << " LEVELS, "
+		<< offset / (1024 * 1024) << " MB" << std::endl;
+	return true;
+}
@@ -0,0 +1,101 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <cstdint>
+#include <string>
+#include <glm.hpp>
+
+/*!
+ * Where and how the samples of a heightmap are stored
+ *
+ */
+struct HeightmapInfo
+{
+	glm::uvec2 size = glm::uvec2(0);
+	bool sixteenBits = true;
+	bool bigEndian = false;
+	std::string dataPath;
+	uint64_t dataOffset = 0;
+};
+
+namespace HeightmapIO
+{
+	/*!
+	 * Read the header of a binary PGM (P5), 8 or 16 bits big endian samples
+	 *
+	 * \param path : path of the .pgm file
+	 * \param info : receives the layout of the samples
+	 * \return : false(bool) if the file is not a binary PGM
+	 */
+	bool ReadPgmHeader(const std::string& path, HeightmapInfo& info);
+
+	/*!
+	 * Layout of a headerless file out of its name, e.g. "site_16385x16385.r16"
+	 *
+	 * .r16 and .raw are 16 bits little endian, .r8 is 8 bits.
+	 *
+	 * \return : false(bool) if the name does not hold the size
+	 */
+	bool ParseRawName(const std::string& path, HeightmapInfo& info);
+
+	/*!
+	 * Layout of a .pgm or headerless heightmap
+	 *
+	 */
+	bool ReadInfo(const std::string& path, HeightmapInfo& info);
+}
+
+/*!
+ * Tile pyramid of a heightmap used for CDLOD rendering and streaming
+ *
+ * Level l holds the heightmap decimated by 2^l cut into TILE_SIZE quad
+ * tiles of TILE_SAMPLES^2 samples, neighbouring tiles share their border
+ * samples. Decimation rather than filtering keeps every even sample of a
+ * level equal to the sample of the next level, so a fully morphed node
+ * matches its coarser neighbour without cracks. Sizes of 2^n + 1 cover
+ * the tiles exactly, other sizes are extended by repeating the border.
+ */
+namespace TerrainTiles
+{
+	const unsigned int TILE_SIZE = 64;
+	const unsigned int TILE_SAMPLES = TILE_SIZE + 1;
+	const uint64_t TILE_BYTES = (uint64_t)TILE_SAMPLES * TILE_SAMPLES * sizeof(uint16_t);
+	const unsigned int MAX_LEVELS = 16;
+
+	struct Header
+	{
+		glm::uvec2 size;        // samples of the heightmap
+		uint32_t levelCount;
+		uint32_t tileCount;     // all levels
+	};
+
+	struct Tile
+	{
+		uint64_t offset;        // in the tile data section
+		uint16_t heightMin;
+		uint16_t heightMax;
+		uint32_t padding;
+	};
+
+	/*!
+	 * Tiles along x and y of a level
+	 *
+	 */
+	glm::uvec2 LevelTiles(const glm::uvec2& size, unsigned int level);
+
+	/*!
+	 * Index in the tile table of the first tile of a level
+	 *
+	 */
+	unsigned int FirstTile(const glm::uvec2& size, unsigned int level);
+
+	/*!
+	 * Build the tile pyramid out of core, a strip of tiles at a time
+	 *
+	 * \param info : layout of the source heightmap
+	 * \param path : path of the cache file
+	 * \return : false(bool) if the source can not be read or the cache written
+	 */
+	bool Build(const HeightmapInfo& info, const std::string& path);
+}
+#endif
@@ -0,0 +1,486 @@
+#include "terrain_renderer.h"
+#include <algorithm>
+#include <cfloat>
+#include <iostream>
+#include <gtc/matrix_transform.hpp>
+#include "gl_state_cache.h"
+#include "mesh_cache.h"
+
+namespace
+{
+	const unsigned int HALF_TILE = TerrainTiles::TILE_SIZE / 2;
+	const unsigned int QUADRANT_INDICES = HALF_TILE * HALF_TILE * 6;
+
+	bool BoxInSphere(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::vec3& center, float radius)
+	{
+		glm::vec3 closest = glm::clamp(center, boundsMin, boundsMax);
+		glm::vec3 offset = closest - center;
+		return glm::dot(offset, offset) <= radius * radius;
+	}
+}
+
+
+TerrainRenderer::TerrainRenderer()
+	: m_HeightScale(0.0f), m_CameraPosition(0.0f), m_DataOffset(0), m_Frame(0)
+{
+	memset(&m_Header, 0, sizeof(m_Header));
+}
+
+TerrainRenderer::~TerrainRenderer()
+{
+	close();
+}
+
+
+bool TerrainRenderer::open(const std::string& path, const Options& options)
+{
+	close();
+
+	MeshCacheReader reader;
+	std::vector<TerrainTiles::Header> header;
+	uint64_t dataSize = 0;
+	if (!reader.open(path) || !reader.readArray(MeshCache::TAG_TERRAIN_HEADER, header) || header.size() != 1 ||
+		header[0].levelCount == 0 || header[0].levelCount > TerrainTiles::MAX_LEVELS ||
+		!reader.readArray(MeshCache::TAG_TERRAIN_TILE_TABLE, m_Tiles) || m_Tiles.size() != header[0].tileCount ||
+		!reader.sectionRange(MeshCache::TAG_TERRAIN_TILES, m_DataOffset, dataSize))
+	{
+		std::cout << "ERROR::TERRAIN RENDERER::NO TILE PYRAMID IN: " << path << std::endl;
+		m_Tiles.clear();
+		return false;
+	}
+	if (!m_Reader.open(path, options.ioThreads))
+	{
+		m_Tiles.clear();
+		return false;
+	}
+
+	m_Header = header[0];
+	m_Options = options;
+	m_Slots.assign(m_Tiles.size(), TileSlot());
+	for (unsigned int level = 0; level < m_Header.levelCount; ++level)
+	{
+		m_FirstTile[level] = TerrainTiles::FirstTile(m_Header.size, level);
+		m_LevelTiles[level] = TerrainTiles::LevelTiles(m_Header.size, level);
+	}
+	m_HeightScale = options.heightScale * (float)(std::max(m_Header.size.x, m_Header.size.y) - 1);
+
+	GLint maxLayers = 0;
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+	unsigned int layers = std::max(1u, std::min(options.tileCacheSize, (unsigned int)std::max(maxLayers, 1)));
+	m_LayerOwner.assign(layers, -1);
+	m_FreeLayers.clear();
+	for (int layer = (int)layers - 1; layer >= 0; --layer)
+		m_FreeLayers.push_back(layer);
+
+	GpuResources& resources = GpuResources::instance();
+	GLStateCache& state = GLStateCache::instance();
+
+	m_Heights = resources.createTexture(GL_TEXTURE_2D_ARRAY);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_R16, TerrainTiles::TILE_SAMPLES, TerrainTiles::TILE_SAMPLES, (GLsizei)layers);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	resources.setTextureBytes(m_Heights, TerrainTiles::TILE_BYTES * layers);
+
+	// the shared grid, indices grouped by quadrant so a node can draw any of its quarters
+	std::vector<float> vertices;
+	vertices.reserve(TerrainTiles::TILE_SAMPLES * TerrainTiles::TILE_SAMPLES * 2);
+	for (unsigned int y = 0; y < TerrainTiles::TILE_SAMPLES; ++y)
+	{
+		for (unsigned int x = 0; x < TerrainTiles::TILE_SAMPLES; ++x)
+		{
+			vertices.push_back((float)x);
+			vertices.push_back((float)y);
+		}
+	}
+	std::vector<unsigned short> indices;
+	indices.reserve(QUADRANT_INDICES * 4);
+	for (unsigned int quadrant = 0; quadrant < 4; ++quadrant)
+	{
+		unsigned int x0 = (quadrant & 1) * HALF_TILE;
+		unsigned int y0 = (quadrant >> 1) * HALF_TILE;
+		for (unsigned int y = y0; y < y0 + HALF_TILE; ++y)
+		{
+			for (unsigned int x = x0; x < x0 + HALF_TILE; ++x)
+			{
+				// counter clock wise seen from above, +y up and rows along +z
+				unsigned short corner = (unsigned short)(y * TerrainTiles::TILE_SAMPLES + x);
+				unsigned short right = (unsigned short)(corner + 1);
+				unsigned short below = (unsigned short)(corner + TerrainTiles::TILE_SAMPLES);
+				unsigned short diagonal = (unsigned short)(below + 1);
+				indices.insert(indices.end(), { corner, below, diagonal, corner, diagonal, right });
+			}
+		}
+	}
+
+	m_GridVao = resources.createVertexArray();
+	state.bindVertexArray(resources.name(m_GridVao));
+	m_GridVertices = resources.createBuffer(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+	m_GridIndices = resources.createBuffer(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned short), indices.data(), GL_STATIC_DRAW);
+
+	m_InstanceBuffer = resources.createBuffer(GL_ARRAY_BUFFER, options.maxNodes * sizeof(NodeInstance), nullptr, GL_STREAM_DRAW);
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(NodeInstance), (void*)offsetof(NodeInstance, node));
+	glEnableVertexAttribArray(1);
+	glVertexAttribDivisor(1, 1);
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(NodeInstance), (void*)offsetof(NodeInstance, tile));
+	glEnableVertexAttribArray(2);
+	glVertexAttribDivisor(2, 1);
+	state.bindVertexArray(0);
+
+	m_CommandBuffer = resources.createBuffer(GL_DRAW_INDIRECT_BUFFER, options.maxNodes * 4 * sizeof(DrawElementsIndirectCommand), nullptr, GL_STREAM_DRAW);
+	m_Instances.reserve(options.maxNodes);
+	m_Commands.reserve(options.maxNodes * 4);
+
+	m_Stats = TerrainStats();
+	m_Stats.tiles = (unsigned int)m_Tiles.size();
+	std::cout << "TERRAIN RENDERER::" << m_Header.size.x << "x" << m_Header.size.y << " SAMPLES, "
+		<< m_Header.levelCount << " LEVELS, " << layers << " CACHED TILES" << std::endl;
+	return true;
+}
+
+
+void TerrainRenderer::close()
+{
+	m_Reader.close();
+	m_Uploads.clear();
+	if (m_Tiles.empty())
+		return;
+
+	GpuResources& resources = GpuResources::instance();
+	resources.release(m_Heights);
+	resources.release(m_GridVao);
+	resources.release(m_GridVertices);
+	resources.release(m_GridIndices);
+	resources.release(m_InstanceBuffer);
+	resources.release(m_CommandBuffer);
+	m_Tiles.clear();
+	m_Slots.clear();
+	m_LayerOwner.clear();
+	m_FreeLayers.clear();
+	m_Instances.clear();
+	m_Commands.clear();
+}
+
+
+glm::mat4 TerrainRenderer::terrainTransform() const
+{
+	glm::vec3 extent = glm::vec3(m_Header.size.x - 1, 0.0f, m_Header.size.y - 1);
+	float scale = 2.0f / std::max(std::max(extent.x, extent.z), 1.0f);
+	return glm::translate(glm::scale(glm::mat4(1.0f), glm::vec3(scale)), -0.5f * extent);
+}
+
+
+void TerrainRenderer::update(const glm::mat4& modelViewProjection, const glm::vec3& cameraPosition, float screenScale, LinearArena& arena)
+{
+	++m_Frame;
+	m_Instances.clear();
+	m_Commands.clear();
+	if (m_Tiles.empty())
+		return;
+
+	// reads not started yet are dropped and their layers given back
+	FrameVector<AsyncFileReader::Request> none{ ArenaAllocator<AsyncFileReader::Request>(arena) };
+	FrameVector<uint64_t> dropped{ ArenaAllocator<uint64_t>(arena) };
+	m_Reader.replaceQueue(none, dropped);
+	for (uint64_t tile : dropped)
+	{
+		TileSlot& slot = m_Slots[tile];
+		m_LayerOwner[slot.layer] = -1;
+		m_FreeLayers.push_back(slot.layer);
+		slot.layer = -1;
+		slot.state = TILE_UNLOADED;
+	}
+
+	// a leaf splits once one of its quads, one sample wide, would cover less than quadPixels
+	float leafRange = std::max(screenScale / std::max(m_Options.quadPixels, 0.01f), 2.0f * TerrainTiles::TILE_SIZE);
+	unsigned int top = m_Header.levelCount - 1;
+	for (unsigned int level = 0; level < top; ++level)
+		m_Ranges[level] = leafRange * (float)(1u << level);
+	m_Ranges[top] = FLT_MAX;
+
+	m_CameraPosition = cameraPosition;
+	m_Requests.clear();
+	Frustum frustum(modelViewProjection);
+	for (unsigned int y = 0; y < m_LevelTiles[top].y; ++y)
+	{
+		for (unsigned int x = 0; x < m_LevelTiles[top].x; ++x)
+		{
+			if (UseTile(top, x, y))
+				SelectNode(top, x, y, frustum);
+		}
+	}
+
+	unsigned int pending = 0;
+	m_Stats.residentTiles = 0;
+	for (const TileSlot& slot : m_Slots)
+	{
+		pending += slot.state == TILE_QUEUED || slot.state == TILE_LOADED ? 1 : 0;
+		m_Stats.residentTiles += slot.state == TILE_RESIDENT ? 1 : 0;
+	}
+	m_Stats.residentBytes = m_Stats.residentTiles * TerrainTiles::TILE_BYTES;
+
+	// tiles of the cache not used by this frame, least recently used at the back
+	FrameVector<std::pair<uint64_t, unsigned int>> evictable{ ArenaAllocator<std::pair<uint64_t, unsigned int>>(arena) };
+	for (int owner : m_LayerOwner)
+	{
+		if (owner >= 0 && m_Slots[owner].state == TILE_RESIDENT && m_Slots[owner].lastUsedFrame < m_Frame)
+			evictable.push_back(std::make_pair(m_Slots[owner].lastUsedFrame, (unsigned int)owner));
+	}
+	std::sort(evictable.begin(), evictable.end(), [](const std::pair<uint64_t, unsigned int>& a, const std::pair<uint64_t, unsigned int>& b)
+	{
+		return a.first > b.first;
+	});
+
+	std::sort(m_Requests.begin(), m_Requests.end(), [](const AsyncFileReader::Request& a, const AsyncFileReader::Request& b)
+	{
+		return a.priority > b.priority;
+	});
+	FrameVector<AsyncFileReader::Request> accepted{ ArenaAllocator<AsyncFileReader::Request>(arena) };
+	for (const AsyncFileReader::Request& request : m_Requests)
+	{
+		if (pending + accepted.size() >= m_Options.maxPendingReads)
+			break;
+		if (m_FreeLayers.empty())
+		{
+			if (evictable.empty())
+				break;
+			Evict(evictable.back().second);
+			evictable.pop_back();
+		}
+
+		TileSlot& slot = m_Slots[request.id];
+		slot.layer = m_FreeLayers.back();
+		m_FreeLayers.pop_back();
+		m_LayerOwner[slot.layer] = (int)request.id;
+		slot.state = TILE_QUEUED;
+		accepted.push_back(request);
+	}
+	m_Stats.pendingReads = pending + (unsigned int)accepted.size();
+
+	if (!accepted.empty())
+		m_Reader.replaceQueue(accepted, dropped);
+
+	m_Stats.selectedNodes = (unsigned int)m_Instances.size();
+	m_Stats.drawCommands = (unsigned int)m_Commands.size();
+	m_Stats.drawnTriangles = 0;
+	for (const DrawElementsIndirectCommand& command : m_Commands)
+		m_Stats.drawnTriangles += command.count / 3;
+}
+
+
+void TerrainRenderer::upload()
+{
+	if (m_Tiles.empty())
+		return;
+
+	size_t previous = m_Uploads.size();
+	m_Reader.takeCompleted(m_Uploads);
+	for (size_t i = previous; i < m_Uploads.size(); ++i)
+		m_Slots[m_Uploads[i].id].state = TILE_LOADED;
+
+	GpuResources& resources = GpuResources::instance();
+	GLStateCache& state = GLStateCache::instance();
+	size_t done = 0;
+	for (; done < m_Uploads.size() && done < m_Options.uploadTilesPerFrame; ++done)
+	{
+		AsyncFileReader::Result& completed = m_Uploads[done];
+		TileSlot& slot = m_Slots[completed.id];
+		if (completed.data.size() != TerrainTiles::TILE_BYTES)
+		{
+			// failed read, free the layer and let the next update retry
+			m_LayerOwner[slot.layer] = -1;
+			m_FreeLayers.push_back(slot.layer);
+			slot.layer = -1;
+			slot.state = TILE_UNLOADED;
+			continue;
+		}
+
+		state.bindTexture(0, GL_TEXTURE_2D_ARRAY, resources.name(m_Heights));
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, slot.layer, TerrainTiles::TILE_SAMPLES, TerrainTiles::TILE_SAMPLES, 1,
+			GL_RED, GL_UNSIGNED_SHORT, completed.data.data());
+		slot.state = TILE_RESIDENT;
+	}
+	m_Uploads.erase(m_Uploads.begin(), m_Uploads.begin() + done);
+}
+
+
+void TerrainRenderer::draw(Shader& shader)
+{
+	if (m_Commands.empty())
+		return;
+
+	GpuResources& resources = GpuResources::instance();
+	GLStateCache& state = GLStateCache::instance();
+	shader.use();
+	shader.setInt("heights", 0);
+	shader.setFloat("heightScale", m_HeightScale);
+	shader.setVec3("cameraPosition", m_CameraPosition);
+	state.bindTexture(0, GL_TEXTURE_2D_ARRAY, resources.name(m_Heights));
+
+	resources.setBufferData(m_InstanceBuffer, GL_ARRAY_BUFFER, m_Instances.size() * sizeof(NodeInstance), m_Instances.data(), GL_STREAM_DRAW);
+	resources.setBufferData(m_CommandBuffer, GL_DRAW_INDIRECT_BUFFER, m_Commands.size() * sizeof(DrawElementsIndirectCommand), m_Commands.data(), GL_STREAM_DRAW);
+
+	state.bindVertexArray(resources.name(m_GridVao));
+	state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, resources.name(m_CommandBuffer));
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, (void*)0, (GLsizei)m_Commands.size(), 0);
+}
+
+
+const TerrainStats& TerrainRenderer::stats() const
+{
+	return m_Stats;
+}
+
+
+void TerrainRenderer::reportTo(Profiler& profiler) const
+{
+	const double MB = 1.0 / (1024.0 * 1024.0);
+	profiler.addCounter("TERRAIN NODES", m_Stats.selectedNodes);
+	profiler.addCounter("TERRAIN TRIANGLES", (double)m_Stats.drawnTriangles);
+	profiler.addCounter("TERRAIN RESIDENT TILES", m_Stats.residentTiles);
+	profiler.addCounter("TERRAIN RESIDENT MB", m_Stats.residentBytes * MB);
+	profiler.addCounter("TERRAIN PENDING READS", m_Stats.pendingReads);
+}
+
+
+bool TerrainRenderer::SelectNode(unsigned int level, unsigned int x, unsigned int y, const Frustum& frustum)
+{
+	glm::vec3 boundsMin, boundsMax;
+	NodeBounds(level, x, y, boundsMin, boundsMax);
+	if (!BoxInSphere(boundsMin, boundsMax, m_CameraPosition, m_Ranges[level]))
+		return false;
+	if (!frustum.isBoxVisible(boundsMin, boundsMax))
+		return true;
+
+	if (level == 0 || !BoxInSphere(boundsMin, boundsMax, m_CameraPosition, m_Ranges[level - 1]))
+	{
+		AddNode(level, x, y, 0xF);
+		return true;
+	}
+
+	// split only once every child is on the GPU, the node stands in for them meanwhile
+	glm::uvec2 childTiles = m_LevelTiles[level - 1];
+	bool childrenResident = true;
+	for (unsigned int quadrant = 0; quadrant < 4; ++quadrant)
+	{
+		unsigned int childX = x * 2 + (quadrant & 1);
+		unsigned int childY = y * 2 + (quadrant >> 1);
+		if (childX < childTiles.x && childY < childTiles.y && !UseTile(level - 1, childX, childY))
+			childrenResident = false;
+	}
+	if (!childrenResident)
+	{
+		AddNode(level, x, y, 0xF);
+		return true;
+	}
+
+	unsigned int quadrants = 0;
+	for (unsigned int quadrant = 0; quadrant < 4; ++quadrant)
+	{
+		unsigned int childX = x * 2 + (quadrant & 1);
+		unsigned int childY = y * 2 + (quadrant >> 1);
+		if (childX < childTiles.x && childY < childTiles.y && !SelectNode(level - 1, childX, childY, frustum))
+			quadrants |= 1u << quadrant;
+	}
+	if (quadrants)
+		AddNode(level, x, y, quadrants);
+	return true;
+}
+
+
+void TerrainRenderer::AddNode(unsigned int level, unsigned int x, unsigned int y, unsigned int quadrants)
+{
+	if (m_Instances.size() >= m_Options.maxNodes)
+		return;
+
+	// morph over the far end of the range, into the grid of the parent level
+	float size = (float)(TerrainTiles::TILE_SIZE << level);
+	float morphStart = 1e30f, morphEnd = 2e30f;
+	if (level + 1 < m_Header.levelCount)
+	{
+		float previous = level > 0 ? m_Ranges[level - 1] : 0.0f;
+		morphEnd = m_Ranges[level];
+		morphStart = morphEnd - (morphEnd - previous) * m_Options.morphRegion;
+	}
+
+	unsigned int instance = (unsigned int)m_Instances.size();
+	NodeInstance node;
+	node.node = glm::vec4(x * size, y * size, size, (float)level);
+	node.tile = glm::vec4((float)m_Slots[TileIndex(level, x, y)].layer, morphStart, morphEnd, 0.0f);
+	m_Instances.push_back(node);
+
+	// quadrants are contiguous in the index buffer, neighbours merge into one command
+	for (unsigned int quadrant = 0; quadrant < 4; ++quadrant)
+	{
+		if (!(quadrants & (1u << quadrant)))
+			continue;
+		if (!m_Commands.empty() && m_Commands.back().baseInstance == instance &&
+			m_Commands.back().firstIndex + m_Commands.back().count == quadrant * QUADRANT_INDICES)
+		{
+			m_Commands.back().count += QUADRANT_INDICES;
+			continue;
+		}
+		DrawElementsIndirectCommand command;
+		command.count = QUADRANT_INDICES;
+		command.instanceCount = 1;
+		command.firstIndex = quadrant * QUADRANT_INDICES;
+		command.baseVertex = 0;
+		command.baseInstance = instance;
+		m_Commands.push_back(command);
+	}
+}
+
+
+bool TerrainRenderer::UseTile(unsigned int level, unsigned int x, unsigned int y)
+{
+	unsigned int tile = TileIndex(level, x, y);
+	TileSlot& slot = m_Slots[tile];
+	slot.lastUsedFrame = m_Frame;
+	if (slot.state == TILE_RESIDENT)
+		return true;
+
+	if (slot.state == TILE_UNLOADED)
+	{
+		// coarse tiles first, the nearest first within a level
+		glm::vec3 boundsMin, boundsMax;
+		NodeBounds(level, x, y, boundsMin, boundsMax);
+		glm::vec3 closest = glm::clamp(m_CameraPosition, boundsMin, boundsMax);
+		float size = (float)(TerrainTiles::TILE_SIZE << level);
+		float priority = (float)level + 1.0f / (1.0f + glm::length(m_CameraPosition - closest) / size);
+		m_Requests.push_back(AsyncFileReader::Request{ tile, m_DataOffset + m_Tiles[tile].offset, TerrainTiles::TILE_BYTES, priority });
+	}
+	return false;
+}
+
+
+void TerrainRenderer::NodeBounds(unsigned int level, unsigned int x, unsigned int y, glm::vec3& boundsMin, glm::vec3& boundsMax) const
+{
+	const TerrainTiles::Tile& tile = m_Tiles[TileIndex(level, x, y)];
+	float size = (float)(TerrainTiles::TILE_SIZE << level);
+	float scale = m_HeightScale / 65535.0f;
+	boundsMin = glm::vec3(x * size, tile.heightMin * scale, y * size);
+	boundsMax = glm::vec3((x + 1) * size, tile.heightMax * scale, (y + 1) * size);
+}
+
+
+unsigned int TerrainRenderer::TileIndex(unsigned int level, unsigned int x, unsigned int y) const
+{
+	return m_FirstTile[level] + y * m_LevelTiles[level].x + x;
+}
+
+
+void TerrainRenderer::Evict(unsigned int tile)
+{
+	TileSlot& slot = m_Slots[tile];
+	if (slot.state != TILE_RESIDENT)
+		return;
+
+	m_LayerOwner[slot.layer] = -1;
+	m_FreeLayers.push_back(slot.layer);
+	slot.layer = -1;
+	slot.state = TILE_UNLOADED;
+}
@@ -0,0 +1,182 @@
+#ifndef TERRAIN_RENDERER_H
+#define TERRAIN_RENDERER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm.hpp>
+#include "async_file_reader.h"
+#include "draw_commands.h"
+#include "frustum.h"
+#include "gpu_resources.h"
+#include "profiler.h"
+#include "shader.h"
+#include "terrain.h"
+
+/*!
+ * Counters of TerrainRenderer
+ *
+ */
+struct TerrainStats
+{
+	unsigned int tiles = 0;
+	unsigned int selectedNodes = 0;
+	unsigned int drawCommands = 0;
+	uint64_t drawnTriangles = 0;
+	unsigned int residentTiles = 0;
+	unsigned int pendingReads = 0;
+	uint64_t residentBytes = 0;
+};
+
+/*!
+ * CDLOD renderer of a tile pyramid written by TerrainTiles::Build
+ *
+ * Every quadtree node is one tile of the pyramid drawn with the same
+ * TILE_SIZE^2 grid mesh, displaced in the vertex shader from a texture
+ * array of resident tiles. Nodes are picked by distance ranges derived
+ * from the on-screen size of a grid quad, so the number of nodes, and the
+ * triangle count, follow the screen resolution and not the terrain size.
+ * Vertices morph into the grid of the parent level before the switch, and
+ * children are only used once their tiles are streamed in.
+ */
+class TerrainRenderer
+{
+public:
+	struct Options
+	{
+		unsigned int tileCacheSize = 1024;     // resident tiles, layers of the height texture
+		unsigned int ioThreads = 2;
+		unsigned int uploadTilesPerFrame = 32;
+		unsigned int maxPendingReads = 64;
+		unsigned int maxNodes = 2048;
+		float quadPixels = 6.0f;               // on screen size of a grid quad when a node splits
+		float morphRegion = 0.3f;              // part of a range used to morph into the parent level
+		float heightScale = 0.05f;             // full height range as a fraction of the terrain width
+	};
+
+	TerrainRenderer();
+	~TerrainRenderer();
+
+	TerrainRenderer(const TerrainRenderer&) = delete;
+	TerrainRenderer& operator=(const TerrainRenderer&) = delete;
+
+	/*!
+	 * Open a tile pyramid, create the grid mesh and start the I/O threads
+	 *
+	 * \param path : cache written by TerrainTiles::Build
+	 * \param options : cache size and level of detail settings
+	 * \return : false(bool) if the file holds no tile pyramid
+	 */
+	bool open(const std::string& path, const Options& options);
+
+	void close();
+
+	/*!
+	 * Model matrix of the terrain, one unit per sample scaled to a width of 2 and centered on the origin
+	 *
+	 */
+	glm::mat4 terrainTransform() const;
+
+	/*!
+	 * Select the quadtree nodes to draw and the tiles to stream, call once per frame
+	 *
+	 * \param modelViewProjection : projection * view * model * terrainTransform()
+	 * \param cameraPosition : camera position in the terrain space, one unit per sample
+	 * \param screenScale : pixels per unit at distance 1
+	 * \param arena : frame memory for the lists built on the way, see FrameArena::threadArena
+	 */
+	void update(const glm::mat4& modelViewProjection, const glm::vec3& cameraPosition, float screenScale, LinearArena& arena);
+
+	/*!
+	 * Copy finished reads into the height texture, at most uploadTilesPerFrame per call
+	 *
+	 */
+	void upload();
+
+	/*!
+	 * Draw the selected nodes with a single indirect draw
+	 *
+	 * \param shader : program built from vertex_terrain.glsl, its matrices and lighting already set
+	 */
+	void draw(Shader& shader);
+
+	const TerrainStats& stats() const;
+
+	void reportTo(Profiler& profiler) const;
+
+private:
+
+	enum TileState
+	{
+		TILE_UNLOADED,
+		TILE_QUEUED,
+		TILE_LOADED,
+		TILE_RESIDENT
+	};
+
+	struct TileSlot
+	{
+		TileState state = TILE_UNLOADED;
+		int layer = -1;
+		uint64_t lastUsedFrame = 0;
+	};
+
+	// per instance attributes of a selected node, locations 1 and 2 of vertex_terrain.glsl
+	struct NodeInstance
+	{
+		glm::vec4 node;     // origin x, origin z, size, level
+		glm::vec4 tile;     // layer, morph start, morph end, unused
+	};
+
+	Options m_Options;
+	TerrainTiles::Header m_Header;
+	std::vector<TerrainTiles::Tile> m_Tiles;
+	std::vector<TileSlot> m_Slots;
+	std::vector<int> m_FreeLayers;
+	std::vector<int> m_LayerOwner;         // tile of every layer, -1 when free
+	unsigned int m_FirstTile[TerrainTiles::MAX_LEVELS];
+	glm::uvec2 m_LevelTiles[TerrainTiles::MAX_LEVELS];
+	float m_Ranges[TerrainTiles::MAX_LEVELS];
+	float m_HeightScale;                   // terrain units per normalized height
+	glm::vec3 m_CameraPosition;
+	std::vector<NodeInstance> m_Instances;
+	std::vector<DrawElementsIndirectCommand> m_Commands;
+	std::vector<AsyncFileReader::Request> m_Requests;
+	uint64_t m_DataOffset;
+	uint64_t m_Frame;
+	TerrainStats m_Stats;
+	AsyncFileReader m_Reader;
+	std::vector<AsyncFileReader::Result> m_Uploads;
+
+	GpuHandle m_Heights;
+	GpuHandle m_GridVao;
+	GpuHandle m_GridVertices;
+	GpuHandle m_GridIndices;
+	GpuHandle m_InstanceBuffer;
+	GpuHandle m_CommandBuffer;
+
+	/*!
+	 * CDLOD selection of a node and its subtree
+	 *
+	 * \return : false(bool) if the node is out of its range and its parent has to cover it
+	 */
+	bool SelectNode(unsigned int level, unsigned int x, unsigned int y, const Frustum& frustum);
+
+	/*!
+	 * Queue the draw of a node, quadrants is a mask of the quarters to draw
+	 *
+	 */
+	void AddNode(unsigned int level, unsigned int x, unsigned int y, unsigned int quadrants);
+
+	/*!
+	 * Keep a tile in the cache this frame, request it when missing
+	 *
+	 * \return : false(bool) if the tile is not resident yet
+	 */
+	bool UseTile(unsigned int level, unsigned int x, unsigned int y);
+
+	void NodeBounds(unsigned int level, unsigned int x, unsigned int y, glm::vec3& boundsMin, glm::vec3& boundsMax) const;
+	unsigned int TileIndex(unsigned int level, unsigned int x, unsigned int y) const;
+	void Evict(unsigned int tile);
+};
+#endif
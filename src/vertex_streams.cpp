@@ -0,0 +1,143 @@
+#include "vertex_streams.h"
+#include <algorithm>
+#include "gl_state_cache.h"
+
+
+VertexStreams::VertexStreams()
+	: m_VertexCount(0), m_IndexCount(0)
+{
+}
+
+VertexStreams::~VertexStreams()
+{
+	Release();
+}
+
+
+void VertexStreams::upload(const Mesh& mesh)
+{
+	Release();
+	GpuResources& resources = GpuResources::instance();
+	GLStateCache& state = GLStateCache::instance();
+
+	std::vector<glm::vec3> normals(mesh.normals.begin(), mesh.normals.begin() + std::min(mesh.normals.size(), mesh.positions.size()));
+	normals.resize(mesh.positions.size(), glm::vec3(0.0f, 0.0f, 1.0f));
+	m_VertexCount = (unsigned int)mesh.positions.size();
+	m_IndexCount = (unsigned int)mesh.indices.size();
+
+	// no vertex array bound, the element buffer would attach to it
+	state.bindVertexArray(0);
+	m_Positions = resources.createBuffer(GL_ARRAY_BUFFER, m_VertexCount * sizeof(glm::vec3), mesh.positions.data(), GL_STATIC_DRAW);
+	m_Attributes = resources.createBuffer(GL_ARRAY_BUFFER, m_VertexCount * sizeof(glm::vec3), normals.data(), GL_STATIC_DRAW);
+	if (m_IndexCount > 0)
+		m_Indices = resources.createBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IndexCount * sizeof(unsigned int), mesh.indices.data(), GL_STATIC_DRAW);
+
+	// formats tied to binding points, the buffers are attached to the bindings
+	m_Vao = resources.createVertexArray();
+	m_DepthVao = resources.createVertexArray();
+	for (GpuHandle vao : { m_Vao, m_DepthVao })
+	{
+		state.bindVertexArray(resources.name(vao));
+		glVertexAttribFormat(0, 3, GL_FLOAT, GL_FALSE, 0);
+		glVertexAttribBinding(0, POSITION_BINDING);
+		glEnableVertexAttribArray(0);
+		glBindVertexBuffer(POSITION_BINDING, resources.name(m_Positions), 0, sizeof(glm::vec3));
+		if (vao.index == m_Vao.index)
+		{
+			glVertexAttribFormat(1, 3, GL_FLOAT, GL_FALSE, 0);
+			glVertexAttribBinding(1, ATTRIBUTE_BINDING);
+			glEnableVertexAttribArray(1);
+			glBindVertexBuffer(ATTRIBUTE_BINDING, resources.name(m_Attributes), 0, sizeof(glm::vec3));
+		}
+		if (m_IndexCount > 0)
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, resources.name(m_Indices));
+	}
+	state.bindVertexArray(0);
+}
+
+
+void VertexStreams::setInstanceBuffer(GLuint buffer)
+{
+	GpuResources& resources = GpuResources::instance();
+	GLStateCache& state = GLStateCache::instance();
+	for (GpuHandle vao : { m_Vao, m_DepthVao })
+	{
+		// model matrix, one column per location, advanced once per instance
+		state.bindVertexArray(resources.name(vao));
+		for (GLuint column = 0; column < 4; ++column)
+		{
+			glVertexAttribFormat(3 + column, 4, GL_FLOAT, GL_FALSE, column * sizeof(glm::vec4));
+			glVertexAttribBinding(3 + column, INSTANCE_BINDING);
+			glEnableVertexAttribArray(3 + column);
+		}
+		glVertexBindingDivisor(INSTANCE_BINDING, 1);
+		glBindVertexBuffer(INSTANCE_BINDING, buffer, 0, sizeof(glm::mat4));
+	}
+	state.bindVertexArray(0);
+}
+
+
+void VertexStreams::bind() const
+{
+	GLStateCache::instance().bindVertexArray(GpuResources::instance().name(m_Vao));
+}
+
+
+GLuint VertexStreams::vertexArray() const
+{
+	return GpuResources::instance().name(m_Vao);
+}
+
+
+void VertexStreams::bindDepth() const
+{
+	GLStateCache::instance().bindVertexArray(GpuResources::instance().name(m_DepthVao));
+}
+
+
+void VertexStreams::addToGroup(unsigned int group) const
+{
+	GpuResources& resources = GpuResources::instance();
+	for (GpuHandle handle : { m_Positions, m_Attributes, m_Indices, m_Vao, m_DepthVao })
+	{
+		if (!handle.isNull())
+			resources.addToGroup(handle, group);
+	}
+}
+
+
+unsigned int VertexStreams::vertexCount() const
+{
+	return m_VertexCount;
+}
+
+
+unsigned int VertexStreams::indexCount() const
+{
+	return m_IndexCount;
+}
+
+
+size_t VertexStreams::positionBytes() const
+{
+	return (size_t)m_VertexCount * sizeof(glm::vec3);
+}
+
+
+size_t VertexStreams::gpuBytes() const
+{
+	return (size_t)m_VertexCount * sizeof(glm::vec3) * 2 + (size_t)m_IndexCount * sizeof(unsigned int);
+}
+
+
+void VertexStreams::Release()
+{
+	GpuResources& resources = GpuResources::instance();
+	for (GpuHandle* handle : { &m_Positions, &m_Attributes, &m_Indices, &m_Vao, &m_DepthVao })
+	{
+		resources.release(*handle);
+		*handle = GpuHandle();
+	}
+	m_VertexCount = 0;
+	m_IndexCount = 0;
+}
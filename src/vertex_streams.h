@@ -0,0 +1,99 @@
+#ifndef VERTEX_STREAMS_H
+#define VERTEX_STREAMS_H
+
+#include <vector>
+#include <glm.hpp>
+#include <glew.h>
+#include "gpu_resources.h"
+#include "mesh.h"
+
+/*!
+ * Vertex attributes of a mesh split in separate streams
+ *
+ * Positions sit alone in a tightly packed buffer, the other attributes
+ * (normals) in a second one. Two vertex arrays share the buffers: the
+ * full one for shading and one reading the position stream only, for
+ * depth, shadow and occlusion passes which then fetch half the bytes.
+ * Locations follow res/vertex.glsl: 0 position, 1 normal, 3 to 6 the
+ * model matrix of instanced draws.
+ */
+class VertexStreams
+{
+public:
+	// vertex buffer binding points of both vertex arrays
+	static const GLuint POSITION_BINDING = 0;
+	static const GLuint ATTRIBUTE_BINDING = 1;
+	static const GLuint INSTANCE_BINDING = 2;
+
+	VertexStreams();
+	~VertexStreams();
+
+	VertexStreams(const VertexStreams&) = delete;
+	VertexStreams& operator=(const VertexStreams&) = delete;
+
+	/*!
+	 * Create the buffers and vertex arrays, replacing previous ones
+	 *
+	 * \param mesh : missing normals are written as +Z, indices are optional
+	 */
+	void upload(const Mesh& mesh);
+
+	/*!
+	 * Feed a buffer of model matrices, one per instance, to both vertex arrays
+	 *
+	 * \param buffer : GL name of the buffer, locations 3 to 6
+	 */
+	void setInstanceBuffer(GLuint buffer);
+
+	/*!
+	 * Bind every stream, for shading
+	 *
+	 */
+	void bind() const;
+
+	/*!
+	 * Bind the position stream only, for depth only passes
+	 *
+	 */
+	void bindDepth() const;
+
+	/*!
+	 * GL name of the vertex array of bind, for code issuing its own draws
+	 *
+	 */
+	GLuint vertexArray() const;
+
+	/*!
+	 * Make the buffers and vertex arrays part of a GpuResources residency group
+	 *
+	 */
+	void addToGroup(unsigned int group) const;
+
+	unsigned int vertexCount() const;
+	unsigned int indexCount() const;
+
+	/*!
+	 * Bytes of the position stream, what depth only passes read per vertex
+	 *
+	 */
+	size_t positionBytes() const;
+
+	/*!
+	 * Bytes held in GPU buffers, all streams and indices
+	 *
+	 */
+	size_t gpuBytes() const;
+
+private:
+
+	GpuHandle m_Positions;
+	GpuHandle m_Attributes;
+	GpuHandle m_Indices;
+	GpuHandle m_Vao;
+	GpuHandle m_DepthVao;
+	unsigned int m_VertexCount;
+	unsigned int m_IndexCount;
+
+	void Release();
+};
+#endif
@@ -0,0 +1,350 @@
+#include "volume.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "mesh_cache.h"
+
+namespace
+{
+	std::string Trim(const std::string& text)
+	{
+		size_t begin = text.find_first_not_of(" \t\r\n");
+		size_t end = text.find_last_not_of(" \t\r\n");
+		return begin == std::string::npos ? std::string() : text.substr(begin, end - begin + 1);
+	}
+
+	std::string Lower(std::string text)
+	{
+		std::transform(text.begin(), text.end(), text.begin(), ::tolower);
+		return text;
+	}
+
+	std::string Directory(const std::string& path)
+	{
+		size_t slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+	}
+
+	bool ParseType(const std::string& name, VolumeType& type)
+	{
+		std::string lower = Lower(name);
+		if (lower == "uchar" || lower == "unsigned char" || lower == "uint8" || lower == "uint8_t")
+			type = VOLUME_UINT8;
+		else if (lower == "short" || lower == "short int" || lower == "signed short" || lower == "int16" || lower == "int16_t")
+			type = VOLUME_INT16;
+		else if (lower == "ushort" || lower == "unsigned short" || lower == "uint16" || lower == "uint16_t")
+			type = VOLUME_UINT16;
+		else if (lower == "float" || lower == "float32")
+			type = VOLUME_FLOAT;
+		else
+			return false;
+		return true;
+	}
+
+	/*!
+	 * Read slices [first, first + count) as floats
+	 *
+	 */
+	bool ReadSlices(std::ifstream& file, const VolumeInfo& info, unsigned int first, unsigned int count,
+		std::vector<char>& raw, std::vector<float>& values)
+	{
+		unsigned int voxelBytes = VolumeIO::VoxelBytes(info.type);
+		uint64_t sliceVoxels = (uint64_t)info.size.x * info.size.y;
+		raw.resize((size_t)(sliceVoxels * count * voxelBytes));
+		file.clear();
+		file.seekg((std::streamoff)(info.dataOffset + first * sliceVoxels * voxelBytes));
+		file.read(raw.data(), (std::streamsize)raw.size());
+		if (!file)
+			return false;
+
+		size_t voxels = (size_t)(sliceVoxels * count);
+		values.resize(voxels);
+		for (size_t i = 0; i < voxels; ++i)
+		{
+			char bytes[4];
+			memcpy(bytes, raw.data() + i * voxelBytes, voxelBytes);
+			if (info.bigEndian)
+				std::reverse(bytes, bytes + voxelBytes);
+
+			switch (info.type)
+			{
+			case VOLUME_UINT8: values[i] = (float)(unsigned char)bytes[0]; break;
+			case VOLUME_INT16: { int16_t value; memcpy(&value, bytes, 2); values[i] = (float)value; break; }
+			case VOLUME_UINT16: { uint16_t value; memcpy(&value, bytes, 2); values[i] = (float)value; break; }
+			case VOLUME_FLOAT: { float value; memcpy(&value, bytes, 4); values[i] = value; break; }
+			}
+		}
+		return true;
+	}
+}
+
+
+bool VolumeIO::ReadNrrdHeader(const std::string& path, VolumeInfo& info)
+{
+	std::ifstream file(path, std::ios::binary);
+	std::string line;
+	if (!file.is_open() || !std::getline(file, line) || line.compare(0, 4, "NRRD") != 0)
+	{
+		std::cout << "ERROR::VOLUME::NOT A NRRD FILE: " << path << std::endl;
+		return false;
+	}
+
+	info = VolumeInfo();
+	int dimension = 0;
+	std::string encoding = "raw";
+	std::string dataFile;
+	bool hasType = false;
+	while (std::getline(file, line))
+	{
+		line = Trim(line);
+		if (line.empty())
+			break;
+		if (line[0] == '#')
+			continue;
+
+		size_t colon = line.find(':');
+		if (colon == std::string::npos)
+			continue;
+		std::string key = Lower(Trim(line.substr(0, colon)));
+		std::string value = Trim(line.substr(colon + 1));
+		if (!value.empty() && value[0] == '=')
+			value = Trim(value.substr(1));
+		std::istringstream values(value);
+
+		if (key == "type")
+			hasType = ParseType(value, info.type);
+		else if (key == "dimension")
+			values >> dimension;
+		else if (key == "sizes")
+			values >> info.size.x >> info.size.y >> info.size.z;
+		else if (key == "encoding")
+			encoding = Lower(value);
+		else if (key == "endian")
+			info.bigEndian = Lower(value) == "big";
+		else if (key == "spacings")
+			values >> info.spacing.x >> info.spacing.y >> info.spacing.z;
+		else if (key == "space directions")
+		{
+			// one vector per axis, the spacing is its length
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				size_t open = value.find('(');
+				size_t close = value.find(')', open);
+				if (open == std::string::npos || close == std::string::npos)
+					break;
+				std::string vector = value.substr(open + 1, close - open - 1);
+				std::replace(vector.begin(), vector.end(), ',', ' ');
+				std::istringstream components(vector);
+				glm::vec3 direction(0.0f);
+				components >> direction.x >> direction.y >> direction.z;
+				info.spacing[axis] = glm::length(direction);
+				value = value.substr(close + 1);
+			}
+		}
+		else if (key == "data file" || key == "datafile")
+			dataFile = value;
+	}
+
+	if (dimension != 3 || !hasType || info.size.x == 0 || info.size.y == 0 || info.size.z == 0)
+	{
+		std::cout << "ERROR::VOLUME::NRRD IS NOT A 3D SCALAR FIELD OF A SUPPORTED TYPE: " << path << std::endl;
+		return false;
+	}
+	if (encoding != "raw")
+	{
+		std::cout << "ERROR::VOLUME::ONLY RAW NRRD ENCODING IS SUPPORTED: " << encoding << std::endl;
+		return false;
+	}
+
+	if (dataFile.empty())
+	{
+		info.dataPath = path;
+		info.dataOffset = (uint64_t)file.tellg();
+	}
+	else
+	{
+		bool absolute = dataFile[0] == '/' || (dataFile.size() > 1 && dataFile[1] == ':');
+		info.dataPath = absolute ? dataFile : Directory(path) + dataFile;
+		info.dataOffset = 0;
+	}
+	return true;
+}
+
+
+bool VolumeIO::ParseRawName(const std::string& path, VolumeInfo& info)
+{
+	info = VolumeInfo();
+	std::string name = Lower(path.substr(path.find_last_of("/\\") == std::string::npos ? 0 : path.find_last_of("/\\") + 1));
+
+	// first "AxBxC" group of the name
+	bool hasSize = false;
+	for (size_t i = 0; i < name.size() && !hasSize; ++i)
+	{
+		if (!isdigit((unsigned char)name[i]) || (i > 0 && isdigit((unsigned char)name[i - 1])))
+			continue;
+		unsigned int x = 0, y = 0, z = 0;
+		char separator1 = 0, separator2 = 0;
+		std::istringstream dims(name.substr(i));
+		if (dims >> x >> separator1 >> y >> separator2 >> z && separator1 == 'x' && separator2 == 'x')
+		{
+			info.size = glm::uvec3(x, y, z);
+			hasSize = true;
+		}
+	}
+
+	bool hasType = false;
+	const char* types[] = { "uint16", "int16", "uint8", "float" };
+	for (const char* type : types)
+	{
+		if (name.find(type) != std::string::npos)
+		{
+			hasType = ParseType(type, info.type);
+			break;
+		}
+	}
+
+	if (!hasSize || !hasType || info.size.x == 0 || info.size.y == 0 || info.size.z == 0)
+	{
+		std::cout << "ERROR::VOLUME::RAW FILE NAME MUST HOLD SIZE AND TYPE, E.G. NAME_256X256X128_UINT16.RAW: " << path << std::endl;
+		return false;
+	}
+	info.dataPath = path;
+	return true;
+}
+
+
+bool VolumeIO::ReadInfo(const std::string& path, VolumeInfo& info)
+{
+	std::string lower = Lower(path);
+	if (lower.size() > 5 && (lower.compare(lower.size() - 5, 5, ".nrrd") == 0 || lower.compare(lower.size() - 5, 5, ".nhdr") == 0))
+		return ReadNrrdHeader(path, info);
+	return ParseRawName(path, info);
+}
+
+
+unsigned int VolumeIO::VoxelBytes(VolumeType type)
+{
+	switch (type)
+	{
+	case VOLUME_UINT8: return 1;
+	case VOLUME_INT16: return 2;
+	case VOLUME_UINT16: return 2;
+	case VOLUME_FLOAT: return 4;
+	}
+	return 1;
+}
+
+
+bool VolumeBricks::Build(const VolumeInfo& info, const std::string& path)
+{
+	std::ifstream source(info.dataPath, std::ios::binary);
+	if (!source.is_open())
+	{
+		std::cout << "ERROR::VOLUME::UNABLE TO OPEN FILE: " << info.dataPath << std::endl;
+		return false;
+	}
+
+	// value range for the 16 bits normalization, one slice at a time
+	std::vector<char> raw;
+	std::vector<float> values;
+	float valueMin = INFINITY, valueMax = -INFINITY;
+	for (unsigned int z = 0; z < info.size.z; ++z)
+	{
+		if (!ReadSlices(source, info, z, 1, raw, values))
+		{
+			std::cout << "ERROR::VOLUME::TRUNCATED DATA: " << info.dataPath << std::endl;
+			return false;
+		}
+		for (float value : values)
+		{
+			valueMin = std::min(valueMin, value);
+			valueMax = std::max(valueMax, value);
+		}
+	}
+	float scale = valueMax > valueMin ? 65535.0f / (valueMax - valueMin) : 0.0f;
+
+	Header header;
+	header.size = info.size;
+	header.bricks = (info.size + glm::uvec3(BRICK_SIZE - 1)) / BRICK_SIZE;
+	header.spacing = info.spacing;
+	header.valueMin = valueMin;
+	header.valueMax = valueMax;
+	header.storedBricks = 0;
+
+	MeshCacheWriter writer;
+	if (!writer.open(path))
+		return false;
+	writer.beginSection(MeshCache::TAG_VOLUME_BRICKS);
+
+	std::vector<Brick> table((size_t)header.bricks.x * header.bricks.y * header.bricks.z);
+	std::vector<uint16_t> slab;
+	std::vector<uint16_t> brick((size_t)BRICK_STORED * BRICK_STORED * BRICK_STORED);
+	uint64_t offset = 0;
+	size_t sliceVoxels = (size_t)info.size.x * info.size.y;
+	for (unsigned int bz = 0; bz < header.bricks.z; ++bz)
+	{
+		// slices of the brick layer with their apron, clamped at the borders
+		int first = std::max((int)(bz * BRICK_SIZE) - 1, 0);
+		int last = std::min((int)((bz + 1) * BRICK_SIZE), (int)info.size.z - 1);
+		if (!ReadSlices(source, info, (unsigned int)first, (unsigned int)(last - first + 1), raw, values))
+		{
+			std::cout << "ERROR::VOLUME::TRUNCATED DATA: " << info.dataPath << std::endl;
+			return false;
+		}
+		slab.resize(values.size());
+		for (size_t i = 0; i < values.size(); ++i)
+			slab[i] = (uint16_t)std::lround((values[i] - valueMin) * scale);
+
+		for (unsigned int by = 0; by < header.bricks.y; ++by)
+		{
+			for (unsigned int bx = 0; bx < header.bricks.x; ++bx)
+			{
+				uint16_t low = 0xFFFF, high = 0;
+				size_t out = 0;
+				for (unsigned int z = 0; z < BRICK_STORED; ++z)
+				{
+					int sz = glm::clamp((int)(bz * BRICK_SIZE + z) - 1, 0, (int)info.size.z - 1) - first;
+					for (unsigned int y = 0; y < BRICK_STORED; ++y)
+					{
+						int sy = glm::clamp((int)(by * BRICK_SIZE + y) - 1, 0, (int)info.size.y - 1);
+						const uint16_t* row = slab.data() + sz * sliceVoxels + (size_t)sy * info.size.x;
+						for (unsigned int x = 0; x < BRICK_STORED; ++x)
+						{
+							int sx = glm::clamp((int)(bx * BRICK_SIZE + x) - 1, 0, (int)info.size.x - 1);
+							uint16_t value = row[sx];
+							brick[out++] = value;
+							low = std::min(low, value);
+							high = std::max(high, value);
+						}
+					}
+				}
+
+				Brick& entry = table[((size_t)bz * header.bricks.y + by) * header.bricks.x + bx];
+				entry.valueMin = low;
+				entry.valueMax = high;
+				entry.stored = low != high ? 1 : 0;
+				entry.offset = offset;
+				if (entry.stored)
+				{
+					writer.appendSection(brick.data(), BRICK_BYTES);
+					offset += BRICK_BYTES;
+					++header.storedBricks;
+				}
+			}
+		}
+	}
+	writer.endSection();
+	writer.addSection(MeshCache::TAG_VOLUME_HEADER, &header, sizeof(header));
+	writer.addSection(MeshCache::TAG_VOLUME_BRICK_TABLE, table.data(), table.size() * sizeof(Brick));
+	if (!writer.close())
+		return false;
+
+	uint64_t denseBytes = (uint64_t)info.size.x * info.size.y * info.size.z * VolumeIO::VoxelBytes(info.type);
+	std::cout << "VOLUME::" << header.storedBricks << " OF " << table.size() << " BRICKS STORED, "
+		<< offset / (1024 * 1024) << " MB FOR " << denseBytes / (1024 * 1024) << " MB DENSE" << std::endl;
+	return true;
+}
@@ -0,0 +1,99 @@
+#ifndef VOLUME_H
+#define VOLUME_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm.hpp>
+
+enum VolumeType
+{
+	VOLUME_UINT8,
+	VOLUME_INT16,
+	VOLUME_UINT16,
+	VOLUME_FLOAT
+};
+
+/*!
+ * Where and how the voxels of a scalar field are stored
+ *
+ */
+struct VolumeInfo
+{
+	glm::uvec3 size = glm::uvec3(0);
+	VolumeType type = VOLUME_UINT8;
+	glm::vec3 spacing = glm::vec3(1.0f);   // voxel size along each axis
+	std::string dataPath;
+	uint64_t dataOffset = 0;
+	bool bigEndian = false;
+};
+
+namespace VolumeIO
+{
+	/*!
+	 * Parse a NRRD header, detached data files and attached raw data are supported
+	 *
+	 * \param path : path of the .nrrd or .nhdr file
+	 * \param info : receives the layout
+	 * \return : false(bool) if the header is not a raw encoded 3D scalar field
+	 */
+	bool ReadNrrdHeader(const std::string& path, VolumeInfo& info);
+
+	/*!
+	 * Layout of a headerless raw file out of its name, e.g. "head_256x256x128_uint16.raw"
+	 *
+	 * \return : false(bool) if the name does not hold the size and the type
+	 */
+	bool ParseRawName(const std::string& path, VolumeInfo& info);
+
+	/*!
+	 * Layout of a .nrrd, .nhdr or .raw file
+	 *
+	 */
+	bool ReadInfo(const std::string& path, VolumeInfo& info);
+
+	unsigned int VoxelBytes(VolumeType type);
+}
+
+/*!
+ * Bricked cache of a volume used for paging
+ *
+ * The field is cut into BRICK_SIZE^3 bricks stored with a one voxel apron,
+ * normalized to 16 bits so every brick uploads as is into the atlas. Bricks
+ * of constant value are not stored, their value is kept in the range table
+ * so the renderer can draw them without any texture memory.
+ */
+namespace VolumeBricks
+{
+	const unsigned int BRICK_SIZE = 32;
+	const unsigned int BRICK_STORED = BRICK_SIZE + 2;
+	const uint64_t BRICK_BYTES = (uint64_t)BRICK_STORED * BRICK_STORED * BRICK_STORED * sizeof(uint16_t);
+
+	struct Header
+	{
+		glm::uvec3 size;        // voxels
+		uint32_t storedBricks;
+		glm::uvec3 bricks;      // bricks per axis
+		float valueMin;         // input value mapped to 0
+		glm::vec3 spacing;
+		float valueMax;         // input value mapped to 65535
+	};
+
+	struct Brick
+	{
+		uint64_t offset;        // in the brick data section, unused for constant bricks
+		uint16_t valueMin;      // normalized range of the brick, apron included
+		uint16_t valueMax;
+		uint32_t stored;        // 0 when the brick is constant
+	};
+
+	/*!
+	 * Build the bricked cache out of core, slab of bricks after slab of bricks
+	 *
+	 * \param info : layout of the source volume
+	 * \param path : path of the cache file
+	 * \return : false(bool) if the source can not be read or the cache written
+	 */
+	bool Build(const VolumeInfo& info, const std::string& path);
+}
+#endif
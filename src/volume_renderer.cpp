@@ -0,0 +1,463 @@
+#include "volume_renderer.h"
+#include <algorithm>
+#include <iostream>
+#include <gtc/matrix_transform.hpp>
+#include "frustum.h"
+#include "gl_state_cache.h"
+#include "mesh_cache.h"
+
+namespace
+{
+	const unsigned char PAGE_MISSING = 0;
+	const unsigned char PAGE_RESIDENT = 1;
+	const unsigned char PAGE_CONSTANT = 2;
+
+	// unit cube, counter clock wise seen from outside
+	const float CUBE[] = {
+		0,0,0, 0,1,0, 1,1,0,  1,1,0, 1,0,0, 0,0,0,
+		0,0,1, 1,0,1, 1,1,1,  1,1,1, 0,1,1, 0,0,1,
+		0,1,1, 0,1,0, 0,0,0,  0,0,0, 0,0,1, 0,1,1,
+		1,1,1, 1,0,1, 1,0,0,  1,0,0, 1,1,0, 1,1,1,
+		0,0,0, 1,0,0, 1,0,1,  1,0,1, 0,0,1, 0,0,0,
+		0,1,0, 0,1,1, 1,1,1,  1,1,1, 1,1,0, 0,1,0
+	};
+}
+
+
+VolumeRenderer::VolumeRenderer()
+	: m_PageTableDirty(false), m_TransferLow(0.1f), m_TransferHigh(0.6f), m_DataOffset(0), m_Frame(0), m_QueryIndex(0)
+{
+	memset(&m_Header, 0, sizeof(m_Header));
+}
+
+VolumeRenderer::~VolumeRenderer()
+{
+	close();
+}
+
+
+bool VolumeRenderer::open(const std::string& path, const Options& options)
+{
+	close();
+
+	MeshCacheReader reader;
+	std::vector<VolumeBricks::Header> header;
+	uint64_t dataSize = 0;
+	if (!reader.open(path) || !reader.readArray(MeshCache::TAG_VOLUME_HEADER, header) || header.size() != 1 ||
+		!reader.readArray(MeshCache::TAG_VOLUME_BRICK_TABLE, m_Bricks) ||
+		m_Bricks.size() != (size_t)header[0].bricks.x * header[0].bricks.y * header[0].bricks.z ||
+		!reader.sectionRange(MeshCache::TAG_VOLUME_BRICKS, m_DataOffset, dataSize))
+	{
+		std::cout << "ERROR::VOLUME RENDERER::NO BRICKED VOLUME IN: " << path << std::endl;
+		m_Bricks.clear();
+		return false;
+	}
+	if (!m_Reader.open(path, options.ioThreads))
+	{
+		m_Bricks.clear();
+		return false;
+	}
+
+	m_Header = header[0];
+	m_Options = options;
+	m_Slots.assign(m_Bricks.size(), BrickSlot());
+
+	unsigned int slotsPerAxis = std::max(1u, options.atlasBricksPerAxis);
+	unsigned int slotCount = slotsPerAxis * slotsPerAxis * slotsPerAxis;
+	m_AtlasOwner.assign(slotCount, -1);
+	m_FreeAtlasSlots.clear();
+	for (int slot = (int)slotCount - 1; slot >= 0; --slot)
+		m_FreeAtlasSlots.push_back(slot);
+
+	GpuResources& resources = GpuResources::instance();
+	GLStateCache& state = GLStateCache::instance();
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	// atlas of paged bricks, filtered, the apron keeps filtering inside each brick
+	GLsizei atlasSize = (GLsizei)(slotsPerAxis * VolumeBricks::BRICK_STORED);
+	m_Atlas = resources.createTexture(GL_TEXTURE_3D);
+	glTexStorage3D(GL_TEXTURE_3D, 1, GL_R16, atlasSize, atlasSize, atlasSize);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	uint64_t atlasBytes = (uint64_t)atlasSize * atlasSize * atlasSize * sizeof(uint16_t);
+	resources.setTextureBytes(m_Atlas, atlasBytes);
+
+	// one texel per brick: value range, and the page table
+	glm::uvec3 bricks = m_Header.bricks;
+	std::vector<uint16_t> ranges(m_Bricks.size() * 2);
+	m_PageTable.assign(m_Bricks.size() * 4, 0);
+	m_Stats = VolumeStats();
+	for (size_t brick = 0; brick < m_Bricks.size(); ++brick)
+	{
+		ranges[brick * 2] = m_Bricks[brick].valueMin;
+		ranges[brick * 2 + 1] = m_Bricks[brick].valueMax;
+		m_PageTable[brick * 4 + 3] = m_Bricks[brick].stored ? PAGE_MISSING : PAGE_CONSTANT;
+		m_Stats.storedBricks += m_Bricks[brick].stored;
+	}
+
+	m_RangeTexture = resources.createTexture(GL_TEXTURE_3D);
+	state.bindTexture(2, GL_TEXTURE_3D, resources.name(m_RangeTexture));
+	glTexStorage3D(GL_TEXTURE_3D, 1, GL_RG16, bricks.x, bricks.y, bricks.z);
+	glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, bricks.x, bricks.y, bricks.z, GL_RG, GL_UNSIGNED_SHORT, ranges.data());
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	resources.setTextureBytes(m_RangeTexture, ranges.size() * sizeof(uint16_t));
+
+	m_PageTexture = resources.createTexture(GL_TEXTURE_3D);
+	state.bindTexture(1, GL_TEXTURE_3D, resources.name(m_PageTexture));
+	glTexStorage3D(GL_TEXTURE_3D, 1, GL_RGBA8UI, bricks.x, bricks.y, bricks.z);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	resources.setTextureBytes(m_PageTexture, m_PageTable.size());
+	m_PageTableDirty = true;
+
+	m_CubeVao = resources.createVertexArray();
+	state.bindVertexArray(resources.name(m_CubeVao));
+	m_CubeBuffer = resources.createBuffer(GL_ARRAY_BUFFER, sizeof(CUBE), CUBE, GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+
+	for (RayQuery& query : m_Queries)
+	{
+		glGenQueries(1, &query.samples);
+		glGenQueries(1, &query.time);
+		query.pending = false;
+	}
+
+	m_Stats.bricks = (unsigned int)m_Bricks.size();
+	m_Stats.denseBytes = (uint64_t)m_Header.size.x * m_Header.size.y * m_Header.size.z * sizeof(uint16_t);
+	m_Stats.storedBytes = (uint64_t)m_Stats.storedBricks * VolumeBricks::BRICK_BYTES;
+	m_Stats.atlasBytes = atlasBytes + ranges.size() * sizeof(uint16_t) + m_PageTable.size();
+	std::cout << "VOLUME RENDERER::" << m_Stats.storedBricks << " BRICKS OF " << m_Stats.bricks << ", ATLAS "
+		<< atlasBytes / (1024 * 1024) << " MB FOR " << m_Stats.denseBytes / (1024 * 1024) << " MB DENSE" << std::endl;
+	return true;
+}
+
+
+void VolumeRenderer::close()
+{
+	m_Reader.close();
+	m_Uploads.clear();
+	if (m_Bricks.empty())
+		return;
+
+	GpuResources& resources = GpuResources::instance();
+	resources.release(m_Atlas);
+	resources.release(m_PageTexture);
+	resources.release(m_RangeTexture);
+	resources.release(m_CubeVao);
+	resources.release(m_CubeBuffer);
+	for (RayQuery& query : m_Queries)
+	{
+		glDeleteQueries(1, &query.samples);
+		glDeleteQueries(1, &query.time);
+		query = RayQuery();
+	}
+	m_Bricks.clear();
+	m_Slots.clear();
+	m_AtlasOwner.clear();
+	m_FreeAtlasSlots.clear();
+}
+
+
+void VolumeRenderer::setTransferWindow(float low, float high)
+{
+	m_TransferLow = low;
+	m_TransferHigh = std::max(high, low + 1e-4f);
+}
+
+
+glm::mat4 VolumeRenderer::volumeTransform() const
+{
+	glm::vec3 extent = glm::vec3(m_Header.size) * m_Header.spacing;
+	float largest = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f));
+	glm::vec3 scale = extent / largest;
+	return glm::scale(glm::translate(glm::mat4(1.0f), -0.5f * scale), scale);
+}
+
+
+void VolumeRenderer::update(const glm::mat4& modelViewProjection, const glm::vec3& cameraPosition, LinearArena& arena)
+{
+	++m_Frame;
+	if (m_Bricks.empty())
+		return;
+
+	// reads not started yet are dropped and their atlas slots given back
+	FrameVector<AsyncFileReader::Request> none{ ArenaAllocator<AsyncFileReader::Request>(arena) };
+	FrameVector<uint64_t> dropped{ ArenaAllocator<uint64_t>(arena) };
+	m_Reader.replaceQueue(none, dropped);
+	for (uint64_t brick : dropped)
+	{
+		BrickSlot& slot = m_Slots[brick];
+		m_AtlasOwner[slot.atlasSlot] = -1;
+		m_FreeAtlasSlots.push_back(slot.atlasSlot);
+		slot.atlasSlot = -1;
+		slot.state = BRICK_UNLOADED;
+	}
+
+	Frustum frustum(modelViewProjection);
+	glm::vec3 size = glm::vec3(m_Header.size);
+	uint16_t visibleFrom = (uint16_t)glm::clamp(m_TransferLow * 65535.0f, 0.0f, 65535.0f);
+	FrameVector<AsyncFileReader::Request> requests{ ArenaAllocator<AsyncFileReader::Request>(arena) };
+	unsigned int pending = 0;
+	m_Stats.emptyBricks = 0;
+	m_Stats.residentBricks = 0;
+	for (unsigned int z = 0, brick = 0; z < m_Header.bricks.z; ++z)
+	{
+		for (unsigned int y = 0; y < m_Header.bricks.y; ++y)
+		{
+			for (unsigned int x = 0; x < m_Header.bricks.x; ++x, ++brick)
+			{
+				BrickSlot& slot = m_Slots[brick];
+				if (slot.state == BRICK_QUEUED || slot.state == BRICK_LOADED)
+					++pending;
+				else if (slot.state == BRICK_RESIDENT)
+					++m_Stats.residentBricks;
+
+				const VolumeBricks::Brick& entry = m_Bricks[brick];
+				if (!entry.stored)
+					continue;
+				if (entry.valueMax < visibleFrom)
+				{
+					++m_Stats.emptyBricks;
+					continue;
+				}
+
+				glm::vec3 boundsMin = glm::vec3(x, y, z) * (float)VolumeBricks::BRICK_SIZE / size;
+				glm::vec3 boundsMax = glm::min(glm::vec3(x + 1, y + 1, z + 1) * (float)VolumeBricks::BRICK_SIZE / size, glm::vec3(1.0f));
+				if (!frustum.isBoxVisible(boundsMin, boundsMax))
+					continue;
+
+				slot.lastUsedFrame = m_Frame;
+				if (slot.state == BRICK_UNLOADED)
+				{
+					glm::vec3 closest = glm::clamp(cameraPosition, boundsMin, boundsMax);
+					float priority = 1.0f / (1.0f + glm::length(cameraPosition - closest));
+					requests.push_back(AsyncFileReader::Request{ brick, m_DataOffset + entry.offset, VolumeBricks::BRICK_BYTES, priority });
+				}
+			}
+		}
+	}
+
+	// bricks of the atlas not needed by this frame, least recently used at the back
+	FrameVector<std::pair<uint64_t, unsigned int>> evictable{ ArenaAllocator<std::pair<uint64_t, unsigned int>>(arena) };
+	for (int owner : m_AtlasOwner)
+	{
+		if (owner >= 0 && m_Slots[owner].state == BRICK_RESIDENT && m_Slots[owner].lastUsedFrame < m_Frame)
+			evictable.push_back(std::make_pair(m_Slots[owner].lastUsedFrame, (unsigned int)owner));
+	}
+	std::sort(evictable.begin(), evictable.end(), [](const std::pair<uint64_t, unsigned int>& a, const std::pair<uint64_t, unsigned int>& b)
+	{
+		return a.first > b.first;
+	});
+
+	std::sort(requests.begin(), requests.end(), [](const AsyncFileReader::Request& a, const AsyncFileReader::Request& b)
+	{
+		return a.priority > b.priority;
+	});
+	FrameVector<AsyncFileReader::Request> accepted{ ArenaAllocator<AsyncFileReader::Request>(arena) };
+	for (const AsyncFileReader::Request& request : requests)
+	{
+		if (pending + accepted.size() >= m_Options.maxPendingReads)
+			break;
+		if (m_FreeAtlasSlots.empty())
+		{
+			if (evictable.empty())
+				break;
+			Evict(evictable.back().second);
+			evictable.pop_back();
+		}
+
+		BrickSlot& slot = m_Slots[request.id];
+		slot.atlasSlot = m_FreeAtlasSlots.back();
+		m_FreeAtlasSlots.pop_back();
+		m_AtlasOwner[slot.atlasSlot] = (int)request.id;
+		slot.state = BRICK_QUEUED;
+		accepted.push_back(request);
+	}
+	m_Stats.pendingReads = pending + (unsigned int)accepted.size();
+
+	if (!accepted.empty())
+		m_Reader.replaceQueue(accepted, dropped);
+}
+
+
+void VolumeRenderer::upload()
+{
+	if (m_Bricks.empty())
+		return;
+
+	size_t previous = m_Uploads.size();
+	m_Reader.takeCompleted(m_Uploads);
+	for (size_t i = previous; i < m_Uploads.size(); ++i)
+		m_Slots[m_Uploads[i].id].state = BRICK_LOADED;
+
+	GpuResources& resources = GpuResources::instance();
+	GLStateCache& state = GLStateCache::instance();
+	unsigned int slotsPerAxis = std::max(1u, m_Options.atlasBricksPerAxis);
+	size_t done = 0;
+	for (; done < m_Uploads.size() && done < m_Options.uploadBricksPerFrame; ++done)
+	{
+		AsyncFileReader::Result& completed = m_Uploads[done];
+		unsigned int brick = (unsigned int)completed.id;
+		BrickSlot& slot = m_Slots[brick];
+		if (completed.data.size() != VolumeBricks::BRICK_BYTES)
+		{
+			// failed read, free the slot and let the next update retry
+			m_AtlasOwner[slot.atlasSlot] = -1;
+			m_FreeAtlasSlots.push_back(slot.atlasSlot);
+			slot.atlasSlot = -1;
+			slot.state = BRICK_UNLOADED;
+			continue;
+		}
+
+		glm::ivec3 atlas(slot.atlasSlot % slotsPerAxis, (slot.atlasSlot / slotsPerAxis) % slotsPerAxis, slot.atlasSlot / (slotsPerAxis * slotsPerAxis));
+		glm::ivec3 texel = atlas * (int)VolumeBricks::BRICK_STORED;
+		state.bindTexture(0, GL_TEXTURE_3D, resources.name(m_Atlas));
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage3D(GL_TEXTURE_3D, 0, texel.x, texel.y, texel.z,
+			VolumeBricks::BRICK_STORED, VolumeBricks::BRICK_STORED, VolumeBricks::BRICK_STORED,
+			GL_RED, GL_UNSIGNED_SHORT, completed.data.data());
+
+		slot.state = BRICK_RESIDENT;
+		SetPage(brick, slot.atlasSlot, PAGE_RESIDENT);
+	}
+	m_Uploads.erase(m_Uploads.begin(), m_Uploads.begin() + done);
+
+	if (m_PageTableDirty)
+	{
+		state.bindTexture(1, GL_TEXTURE_3D, resources.name(m_PageTexture));
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, m_Header.bricks.x, m_Header.bricks.y, m_Header.bricks.z,
+			GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, m_PageTable.data());
+		m_PageTableDirty = false;
+	}
+}
+
+
+void VolumeRenderer::draw(Shader& shader, const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection,
+	const glm::vec3& cameraPosition)
+{
+	if (m_Bricks.empty())
+		return;
+	ReadQueries();
+
+	GpuResources& resources = GpuResources::instance();
+	GLStateCache& state = GLStateCache::instance();
+	shader.use();
+	shader.setMat4("model", model);
+	shader.setMat4("view", view);
+	shader.setMat4("projection", projection);
+	shader.setVec3("cameraPosition", cameraPosition);
+	shader.setVec3("volumeSize", glm::vec3(m_Header.size));
+	shader.setFloat("atlasSize", (float)(std::max(1u, m_Options.atlasBricksPerAxis) * VolumeBricks::BRICK_STORED));
+	float largest = (float)std::max(std::max(m_Header.size.x, m_Header.size.y), m_Header.size.z);
+	shader.setFloat("stepSize", 1.0f / (largest * std::max(m_Options.samplesPerVoxel, 0.1f)));
+	shader.setFloat("transferLow", m_TransferLow);
+	shader.setFloat("transferHigh", m_TransferHigh);
+	shader.setInt("atlas", 0);
+	shader.setInt("pageTable", 1);
+	shader.setInt("brickRange", 2);
+	state.bindTexture(0, GL_TEXTURE_3D, resources.name(m_Atlas));
+	state.bindTexture(1, GL_TEXTURE_3D, resources.name(m_PageTexture));
+	state.bindTexture(2, GL_TEXTURE_3D, resources.name(m_RangeTexture));
+
+	// back faces so the ray is cast from inside the volume too, composited over the scene
+	state.setEnabled(GL_BLEND, true);
+	state.blendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	state.cullFace(GL_FRONT);
+	state.setEnabled(GL_DEPTH_TEST, false);
+	state.depthMask(GL_FALSE);
+
+	RayQuery& query = m_Queries[m_QueryIndex];
+	bool measure = !query.pending;
+	if (measure)
+	{
+		glBeginQuery(GL_SAMPLES_PASSED, query.samples);
+		glBeginQuery(GL_TIME_ELAPSED, query.time);
+	}
+	state.bindVertexArray(resources.name(m_CubeVao));
+	glDrawArrays(GL_TRIANGLES, 0, 36);
+	if (measure)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		glEndQuery(GL_SAMPLES_PASSED);
+		query.pending = true;
+		m_QueryIndex = (m_QueryIndex + 1) % QUERY_COUNT;
+	}
+
+	state.depthMask(GL_TRUE);
+	state.setEnabled(GL_DEPTH_TEST, true);
+	state.cullFace(GL_BACK);
+	state.setEnabled(GL_BLEND, false);
+}
+
+
+const VolumeStats& VolumeRenderer::stats() const
+{
+	return m_Stats;
+}
+
+
+void VolumeRenderer::reportTo(Profiler& profiler) const
+{
+	const double MB = 1.0 / (1024.0 * 1024.0);
+	profiler.addCounter("VOLUME MRAYS PER SECOND", m_Stats.raysPerSecond * 1e-6);
+	profiler.addCounter("VOLUME RESIDENT BRICKS", m_Stats.residentBricks);
+	profiler.addCounter("VOLUME EMPTY BRICKS", m_Stats.emptyBricks);
+	profiler.addCounter("VOLUME PENDING READS", m_Stats.pendingReads);
+	profiler.addCounter("VOLUME DENSE MB", m_Stats.denseBytes * MB);
+	profiler.addCounter("VOLUME ATLAS MB", m_Stats.atlasBytes * MB);
+}
+
+
+void VolumeRenderer::SetPage(unsigned int brick, int atlasSlot, unsigned char flag)
+{
+	unsigned int slotsPerAxis = std::max(1u, m_Options.atlasBricksPerAxis);
+	unsigned char* texel = &m_PageTable[brick * 4];
+	texel[0] = atlasSlot < 0 ? 0 : (unsigned char)(atlasSlot % slotsPerAxis);
+	texel[1] = atlasSlot < 0 ? 0 : (unsigned char)((atlasSlot / slotsPerAxis) % slotsPerAxis);
+	texel[2] = atlasSlot < 0 ? 0 : (unsigned char)(atlasSlot / (slotsPerAxis * slotsPerAxis));
+	texel[3] = flag;
+	m_PageTableDirty = true;
+}
+
+
+void VolumeRenderer::Evict(unsigned int brick)
+{
+	BrickSlot& slot = m_Slots[brick];
+	if (slot.state != BRICK_RESIDENT)
+		return;
+
+	m_AtlasOwner[slot.atlasSlot] = -1;
+	m_FreeAtlasSlots.push_back(slot.atlasSlot);
+	slot.atlasSlot = -1;
+	slot.state = BRICK_UNLOADED;
+	SetPage(brick, -1, PAGE_MISSING);
+}
+
+
+void VolumeRenderer::ReadQueries()
+{
+	for (RayQuery& query : m_Queries)
+	{
+		if (!query.pending)
+			continue;
+
+		GLint available = 0;
+		glGetQueryObjectiv(query.time, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			continue;
+
+		GLuint64 nanoseconds = 0;
+		GLuint64 samples = 0;
+		glGetQueryObjectui64v(query.time, GL_QUERY_RESULT, &nanoseconds);
+		glGetQueryObjectui64v(query.samples, GL_QUERY_RESULT, &samples);
+		query.pending = false;
+		if (nanoseconds > 0)
+			m_Stats.raysPerSecond = (double)samples / ((double)nanoseconds * 1e-9);
+	}
+}
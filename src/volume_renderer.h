@@ -0,0 +1,169 @@
+#ifndef VOLUME_RENDERER_H
+#define VOLUME_RENDERER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm.hpp>
+#include "async_file_reader.h"
+#include "gpu_resources.h"
+#include "profiler.h"
+#include "shader.h"
+#include "volume.h"
+
+/*!
+ * Counters of VolumeRenderer
+ *
+ */
+struct VolumeStats
+{
+	unsigned int bricks = 0;
+	unsigned int storedBricks = 0;      // not constant
+	unsigned int emptyBricks = 0;       // invisible under the transfer function
+	unsigned int residentBricks = 0;
+	unsigned int pendingReads = 0;
+	uint64_t denseBytes = 0;            // the whole field as a single 16 bits texture
+	uint64_t storedBytes = 0;           // bricks on disk
+	uint64_t atlasBytes = 0;            // texture memory used by the renderer
+	double raysPerSecond = 0.0;         // from GPU queries, a few frames late
+};
+
+/*!
+ * Raycaster of a bricked volume written by VolumeBricks::Build
+ *
+ * Bricks are paged into a fixed size 3D atlas texture, a page table maps
+ * every brick of the field to its atlas slot. The ray marcher jumps over
+ * bricks whose value range is invisible under the transfer function and
+ * over bricks not paged in yet, and stops once the ray is opaque. Constant
+ * bricks are drawn from the range texture and never take atlas space, so
+ * fields larger than the GPU memory are viewed through the atlas.
+ */
+class VolumeRenderer
+{
+public:
+	struct Options
+	{
+		unsigned int atlasBricksPerAxis = 12;
+		unsigned int ioThreads = 2;
+		unsigned int uploadBricksPerFrame = 32;
+		unsigned int maxPendingReads = 64;
+		float samplesPerVoxel = 2.0f;
+	};
+
+	VolumeRenderer();
+	~VolumeRenderer();
+
+	VolumeRenderer(const VolumeRenderer&) = delete;
+	VolumeRenderer& operator=(const VolumeRenderer&) = delete;
+
+	/*!
+	 * Open a bricked cache, create the textures and start the I/O threads
+	 *
+	 * \param path : cache written by VolumeBricks::Build
+	 * \param options : atlas size and paging limits
+	 * \return : false(bool) if the file holds no bricked volume
+	 */
+	bool open(const std::string& path, const Options& options);
+
+	void close();
+
+	/*!
+	 * Window of the transfer function, normalized values below low are transparent
+	 *
+	 */
+	void setTransferWindow(float low, float high);
+
+	/*!
+	 * Model matrix of the unit cube of the volume, physical proportions centered on the origin
+	 *
+	 */
+	glm::mat4 volumeTransform() const;
+
+	/*!
+	 * Pick the bricks to page in, call once per frame
+	 *
+	 * \param modelViewProjection : projection * view * model * volumeTransform()
+	 * \param cameraPosition : camera position in the unit cube of the volume
+	 * \param arena : frame memory for the lists built on the way, see FrameArena::threadArena
+	 */
+	void update(const glm::mat4& modelViewProjection, const glm::vec3& cameraPosition, LinearArena& arena);
+
+	/*!
+	 * Copy finished reads into the atlas, at most uploadBricksPerFrame per call
+	 *
+	 */
+	void upload();
+
+	/*!
+	 * Raycast the volume, after the opaque geometry
+	 *
+	 * The cube is drawn without depth test and blended over the frame,
+	 * opaque geometry inside the volume does not clip the rays.
+	 *
+	 * \param shader : program built from vertex_volume.glsl and fragment_volume.glsl
+	 * \param model : model * volumeTransform()
+	 * \param cameraPosition : camera position in the unit cube of the volume
+	 */
+	void draw(Shader& shader, const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection,
+		const glm::vec3& cameraPosition);
+
+	const VolumeStats& stats() const;
+
+	void reportTo(Profiler& profiler) const;
+
+private:
+
+	enum BrickState
+	{
+		BRICK_UNLOADED,
+		BRICK_QUEUED,
+		BRICK_LOADED,
+		BRICK_RESIDENT
+	};
+
+	struct BrickSlot
+	{
+		BrickState state = BRICK_UNLOADED;
+		int atlasSlot = -1;
+		uint64_t lastUsedFrame = 0;
+	};
+
+	// timings of a raycast, read back a few frames later so the CPU never waits
+	struct RayQuery
+	{
+		GLuint samples = 0;
+		GLuint time = 0;
+		bool pending = false;
+	};
+
+	static const unsigned int QUERY_COUNT = 4;
+
+	Options m_Options;
+	VolumeBricks::Header m_Header;
+	std::vector<VolumeBricks::Brick> m_Bricks;
+	std::vector<BrickSlot> m_Slots;
+	std::vector<int> m_FreeAtlasSlots;
+	std::vector<int> m_AtlasOwner;              // brick of each atlas slot, -1 when free
+	std::vector<unsigned char> m_PageTable;     // RGBA8UI texels: atlas slot xyz, flag
+	bool m_PageTableDirty;
+	float m_TransferLow;
+	float m_TransferHigh;
+	uint64_t m_DataOffset;
+	uint64_t m_Frame;
+	VolumeStats m_Stats;
+	AsyncFileReader m_Reader;
+	std::vector<AsyncFileReader::Result> m_Uploads;
+
+	GpuHandle m_Atlas;
+	GpuHandle m_PageTexture;
+	GpuHandle m_RangeTexture;
+	GpuHandle m_CubeVao;
+	GpuHandle m_CubeBuffer;
+	RayQuery m_Queries[QUERY_COUNT];
+	unsigned int m_QueryIndex;
+
+	void SetPage(unsigned int brick, int atlasSlot, unsigned char flag);
+	void Evict(unsigned int brick);
+	void ReadQueries();
+};
+#endif